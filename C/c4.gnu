@@ -40,6 +40,8 @@ CBL {
 		c4db_getLastSequence;
 		c4db_getMaxRevTreeDepth;
 		c4db_setMaxRevTreeDepth;
+		c4db_setDocumentCacheSize;
+		c4db_getDocumentCacheStats;
 		c4db_getUUIDs;
 		c4db_getExtraInfo;
 		c4db_setExtraInfo;
@@ -118,10 +120,16 @@ CBL {
 		c4blob_getSize;
 		c4blob_getContents;
 		c4blob_getFilePath;
+		c4blob_mapContents;
+		c4blobmap_contents;
 		c4blob_openReadStream;
 		c4blob_create;
 		c4blob_delete;
 		c4blob_openWriteStream;
+		c4blob_openResumableWriteStream;
+		c4blob_importFileAsync;
+		c4blob_cancelImport;
+		c4blob_freeImport;
 		c4db_getBlobStore;
 
 		c4stream_read;
@@ -20,6 +20,8 @@
 #include "c4BlobStore.h"
 #include "c4Database.hh"
 #include "BlobStore.hh"
+#include "BlobImporter.hh"
+#include "MappedFile.hh"
 
 
 // This is a no-op class that just serves to make c4BlobStore type-compatible with BlobStore.
@@ -31,6 +33,15 @@ public:
 };
 
 
+// Likewise, this makes C4BlobMapping type-compatible with MappedFile.
+struct C4BlobMapping : public MappedFile {
+public:
+    explicit C4BlobMapping(const FilePath &path)
+    :MappedFile(path)
+    { }
+};
+
+
 static inline const blobKey& asInternal(const C4BlobKey &key) {return *(blobKey*)&key;}
 static inline const C4BlobKey& external(const blobKey &key) {return *(C4BlobKey*)&key;}
 static inline const blobKey* asInternal(const C4BlobKey *key) {return (const blobKey*)key;}
@@ -38,6 +49,8 @@ static SeekableReadStream* asInternal(C4ReadStream* s)        {return (SeekableR
 static inline C4ReadStream* external(SeekableReadStream* s) {return (C4ReadStream*)s;}
 static BlobWriteStream* asInternal(C4WriteStream* s)          {return (BlobWriteStream*)s;}
 static inline C4WriteStream* external(BlobWriteStream* s)   {return (C4WriteStream*)s;}
+static BlobImporter* asInternal(C4BlobImport* i)              {return (BlobImporter*)i;}
+static inline C4BlobImport* external(BlobImporter* i)       {return (C4BlobImport*)i;}
 
 
 bool c4blob_keyFromString(C4Slice str, C4BlobKey* outKey) noexcept {
@@ -68,6 +81,7 @@ C4BlobStore* c4blob_openStore(C4Slice dirPath,
         BlobStore::Options options = {};
         options.create = (flags & kC4DB_Create) != 0;
         options.writeable = !(flags & kC4DB_ReadOnly);
+        options.chunked = (flags & kC4DB_ChunkedBlobs) != 0;
         if (key) {
             options.encryptionAlgorithm = (EncryptionAlgorithm)key->algorithm;
             options.encryptionKey = alloc_slice(key->bytes, sizeof(key->bytes));
@@ -119,8 +133,12 @@ C4SliceResult c4blob_getContents(C4BlobStore* store, C4BlobKey key, C4Error* out
 
 C4StringResult c4blob_getFilePath(C4BlobStore* store, C4BlobKey key, C4Error* outError) noexcept {
     try {
-        auto path = store->get(asInternal(key)).path();
-        if (!path.exists()) {
+        auto blob = store->get(asInternal(key));
+        auto path = blob.path();
+        if (blob.isChunked()) {
+            recordError(LiteCoreDomain, kC4ErrorUnsupported, outError);
+            return {nullptr, 0};
+        } else if (!path.exists()) {
             recordError(LiteCoreDomain, kC4ErrorNotFound, outError);
             return {nullptr, 0};
         } else if (store->isEncrypted()) {
@@ -133,6 +151,30 @@ C4StringResult c4blob_getFilePath(C4BlobStore* store, C4BlobKey key, C4Error* ou
 }
 
 
+C4BlobMapping* c4blob_mapContents(C4BlobStore* store, C4BlobKey key, C4Error* outError) noexcept {
+    try {
+        auto blob = store->get(asInternal(key));
+        if (blob.isChunked()) {
+            recordError(LiteCoreDomain, kC4ErrorUnsupported, outError);
+            return nullptr;
+        } else if (!blob.exists()) {
+            recordError(LiteCoreDomain, kC4ErrorNotFound, outError);
+            return nullptr;
+        } else if (store->isEncrypted()) {
+            recordError(LiteCoreDomain, kC4ErrorWrongFormat, outError);
+            return nullptr;
+        }
+        return retain(new C4BlobMapping(blob.path()));
+    } catchError(outError)
+    return nullptr;
+}
+
+
+C4Slice c4blobmap_contents(C4BlobMapping* mapping) noexcept {
+    return mapping->contents();
+}
+
+
 C4BlobKey c4blob_computeKey(C4Slice contents) {
     return external(blobKey::computeFrom(contents));
 }
@@ -217,6 +259,17 @@ C4WriteStream* c4blob_openWriteStream(C4BlobStore* store, C4Error* outError) noe
 }
 
 
+C4WriteStream* c4blob_openResumableWriteStream(C4BlobStore* store,
+                                               C4BlobKey expectedKey,
+                                               C4Error* outError) noexcept
+{
+    try {
+        return external(new BlobWriteStream(*store, asInternal(expectedKey)));
+    } catchError(outError)
+    return nullptr;
+}
+
+
 bool c4stream_write(C4WriteStream* stream, const void *bytes, size_t length, C4Error* outError) noexcept {
     if (length == 0)
         return true;
@@ -257,3 +310,51 @@ void c4stream_closeWriter(C4WriteStream* stream) noexcept {
         delete asInternal(stream);
     } catchExceptions()
 }
+
+
+#pragma mark - ASYNC IMPORT:
+
+
+C4BlobImport* c4blob_importFileAsync(C4BlobStore* store,
+                                     C4String filePath,
+                                     C4BlobImportProgressCallback progress,
+                                     C4BlobImportCompletionCallback completion,
+                                     void *context,
+                                     C4Error* outError) noexcept
+{
+    try {
+        BlobImporter::ProgressCallback progressFn;
+        if (progress) {
+            progressFn = [=](uint64_t bytesImported, uint64_t totalBytes) {
+                progress(context, bytesImported, totalBytes);
+            };
+        }
+        auto completionFn = [=](const blobKey *key, const std::exception *x) {
+            C4BlobKey c4key = {};
+            C4Error error = {};
+            if (key)
+                c4key = external(*key);
+            else
+                recordException(*x, &error);
+            completion(context, c4key, error);
+        };
+        Retained<BlobImporter> importer = new BlobImporter(*store, FilePath(toString(filePath)),
+                                                           progressFn, completionFn);
+        importer->start();
+        return external(retain(importer.get()));
+    } catchError(outError)
+    return nullptr;
+}
+
+
+void c4blob_cancelImport(C4BlobImport* import) noexcept {
+    asInternal(import)->cancel();
+}
+
+
+void c4blob_freeImport(C4BlobImport* import) noexcept {
+    if (!import)
+        return;
+    asInternal(import)->stop();
+    release(asInternal(import));
+}
@@ -22,6 +22,7 @@
 #include "c4Private.h"
 
 #include "Document.hh"
+#include "DocumentCache.hh"
 #include "SQLiteDataFile.hh"
 #include "KeyStore.hh"
 #include "Record.hh"
@@ -242,6 +243,21 @@ void c4db_setMaxRevTreeDepth(C4Database *database, uint32_t depth) noexcept {
 }
 
 
+bool c4db_setDocumentCacheSize(C4Database *database, size_t maxBytes, C4Error *outError) noexcept {
+    return tryCatch(outError, bind(&Database::setDocumentCacheSize, database, maxBytes));
+}
+
+
+C4DocumentCacheStats c4db_getDocumentCacheStats(C4Database *database) noexcept {
+    C4DocumentCacheStats result = {};
+    if (auto cache = database->documentCache(); cache) {
+        auto stats = cache->stats();
+        result = {stats.hits, stats.misses, stats.count, stats.size};
+    }
+    return result;
+}
+
+
 bool c4db_getUUIDs(C4Database* database, C4UUID *publicUUID, C4UUID *privateUUID,
                    C4Error *outError) noexcept
 {
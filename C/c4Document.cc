@@ -328,6 +328,7 @@ bool c4db_markSynced(C4Database *database, C4String docID, C4SequenceNumber sequ
             if (database->defaultKeyStore().setDocumentFlag(docID, sequence,
                                                             DocumentFlags::kSynced,
                                                             database->transaction())) {
+                database->documentFlagsChanged(docID);
                 return true;
             }
         }
@@ -79,6 +79,12 @@ typedef struct C4BlobKey {
 /** A simple parsed-URL type. */
 typedef struct C4Address C4Address;
 
+/** An asynchronous import of a file into a blob store. */
+typedef struct c4BlobImport C4BlobImport;
+
+/** A read-only memory-mapping of a blob's contents. */
+typedef struct C4BlobMapping C4BlobMapping;
+
 /** Opaque handle for an object that manages storage of blobs. */
 typedef struct c4BlobStore C4BlobStore;
 
@@ -142,6 +148,8 @@ void* c4base_retain(void *obj) C4API;
 void c4base_release(void *obj) C4API;
 
 // These types are reference counted and have c4xxx_retain / c4xxx_release functions:
+static inline C4BlobMapping* c4blobmap_retain(C4BlobMapping* r) C4API {return (C4BlobMapping*)c4base_retain(r);}
+static inline void           c4blobmap_release(C4BlobMapping* r) C4API {c4base_release(r);}
 static inline C4Cert* c4cert_retain(C4Cert* r) C4API {return (C4Cert*)c4base_retain(r);}
 static inline void    c4cert_release(C4Cert* r) C4API {c4base_release(r);}
 static inline C4KeyPair* c4keypair_retain(C4KeyPair* r) C4API {return (C4KeyPair*)c4base_retain(r);}
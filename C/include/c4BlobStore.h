@@ -55,7 +55,7 @@ extern "C" {
         created if necessary.
         Call c4blob_freeStore() when finished using the BlobStore.
         @param dirPath  The filesystem path of the directory holding the attachments.
-        @param flags  Specifies options like create, read-only
+        @param flags  Specifies options like create, read-only, chunked (kC4DB_ChunkedBlobs)
         @param encryptionKey  Optional encryption algorithm & key
         @param outError  Error is returned here
         @return  The BlobStore reference, or NULL on error */
@@ -81,8 +81,9 @@ extern "C" {
        to c4blob_freeStore, c4blob_deleteStore or c4db_close. */
 
     /** Gets the content size of a blob given its key. Returns -1 if it doesn't exist.
-        WARNING: If the blob is encrypted, the return value is a conservative estimate that may
-        be up to 16 bytes larger than the actual size. */
+        WARNING: If the blob is encrypted and was written by an older version of LiteCore, the
+        return value is a conservative estimate that may be up to 16 bytes larger than the
+        actual size. */
     int64_t c4blob_getSize(C4BlobStore* C4NONNULL, C4BlobKey) C4API;
 
     /** Reads the entire contents of a blob into memory. Caller is responsible for freeing it. */
@@ -97,6 +98,18 @@ extern "C" {
         Also, it goes without saying that the caller MUST not modify the file! */
     C4StringResult c4blob_getFilePath(C4BlobStore* C4NONNULL, C4BlobKey, C4Error*) C4API;
 
+    /** Memory-maps the file that stores the blob, so its contents can be accessed (via
+        \ref c4blobmap_contents) without being copied into memory. The contents stay valid until
+        the mapping is released with \ref c4blobmap_release, even if the blob is deleted
+        meanwhile. (On Windows, though, the blob can't be deleted while it's mapped.)
+        Like \ref c4blob_getFilePath, this fails with kC4ErrorWrongFormat if the blob is encrypted
+        or kC4ErrorUnsupported if it isn't stored as a single file; the caller should then fall
+        back to \ref c4blob_getContents or a read stream. */
+    C4BlobMapping* c4blob_mapContents(C4BlobStore* C4NONNULL, C4BlobKey, C4Error*) C4API;
+
+    /** Returns a mapped blob's contents. They're valid as long as the mapping is. */
+    C4Slice c4blobmap_contents(C4BlobMapping* C4NONNULL) C4API;
+
     /** Derives the key of the given data, without storing it. */
     C4BlobKey c4blob_computeKey(C4Slice contents);
 
@@ -161,6 +174,16 @@ extern "C" {
         the store, and then c4stream_closeWriter. */
     C4WriteStream* c4blob_openWriteStream(C4BlobStore* C4NONNULL, C4Error*) C4API;
 
+    /** Opens a write stream for downloading a blob whose key is already known, which can be
+        resumed after an interruption. If a previous stream for the same key was closed without
+        being installed, its data is kept and this stream continues after it; call
+        c4stream_bytesWritten to find out how much data is already present.
+        c4stream_install checks the key as usual, and discards the partial data if it's wrong.
+        (Encrypted stores don't support resuming, so there the stream always starts empty.) */
+    C4WriteStream* c4blob_openResumableWriteStream(C4BlobStore* C4NONNULL,
+                                                   C4BlobKey expectedKey,
+                                                   C4Error*) C4API;
+
     /** Writes data to a stream. */
     bool c4stream_write(C4WriteStream* C4NONNULL,
                         const void *bytes C4NONNULL,
@@ -189,6 +212,46 @@ extern "C" {
     void c4stream_closeWriter(C4WriteStream*) C4API;
 
 
+    /** @} */
+
+
+    /** \name Asynchronous Import
+        @{ */
+
+    /** Callback reporting the progress of a blob import. */
+    typedef void (*C4BlobImportProgressCallback)(void *context,
+                                                 uint64_t bytesImported,
+                                                 uint64_t totalBytes);
+
+    /** Callback reporting that a blob import has finished. If it succeeded, `error.code` is 0 and
+        `key` is the new blob's key. If it was cancelled, the error is POSIX `ECANCELED`. */
+    typedef void (*C4BlobImportCompletionCallback)(void *context,
+                                                   C4BlobKey key,
+                                                   C4Error error);
+
+    /** Starts adding the contents of a file to the store as a new blob, in the background.
+        The file is read in large chunks, which are digested, encrypted (if the store is) and
+        written on separate threads, so that these overlap with each other and with the reading.
+        The callbacks are called on those background threads. `progress` may be NULL.
+        Call \ref c4blob_freeImport when done with the returned object, and before freeing the
+        store. */
+    C4BlobImport* c4blob_importFileAsync(C4BlobStore* C4NONNULL,
+                                         C4String filePath,
+                                         C4BlobImportProgressCallback progress,
+                                         C4BlobImportCompletionCallback completion C4NONNULL,
+                                         void *context,
+                                         C4Error*) C4API;
+
+    /** Stops an import as soon as possible; its completion callback will get an `ECANCELED`
+        error, and no blob is added. Does nothing if the import has already finished. */
+    void c4blob_cancelImport(C4BlobImport* C4NONNULL) C4API;
+
+    /** Frees an import. If it's still running, it's cancelled, and this waits for its threads to
+        stop; no callbacks are made after this returns. May be called from the completion
+        callback, but not from the progress callback. (A NULL parameter is allowed.) */
+    void c4blob_freeImport(C4BlobImport*) C4API;
+
+
     /** @} */
     /** @} */
 
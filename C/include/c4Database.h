@@ -43,6 +43,8 @@ extern "C" {
         kC4DB_SharedKeys    = 0x10, // OBSOLETE; shared keys are always used
         kC4DB_NoUpgrade     = 0x20, ///< Disable upgrading an older-version database
         kC4DB_NonObservable = 0x40, ///< Disable c4DatabaseObserver
+        kC4DB_ExternalRevBodies = 0x80, ///< Store non-current revision bodies outside the doc
+        kC4DB_ChunkedBlobs  = 0x100, ///< Store large blobs as deduplicated chunks
     };
 
     /** Encryption algorithms. */
@@ -202,6 +204,27 @@ extern "C" {
     /** Configures the number of revisions of a document that are tracked. */
     void c4db_setMaxRevTreeDepth(C4Database *database C4NONNULL, uint32_t maxRevTreeDepth) C4API;
 
+    /** Statistics about a database's document cache; see \ref c4db_setDocumentCacheSize. */
+    typedef struct C4DocumentCacheStats {
+        uint64_t hits;          ///< Number of document reads satisfied from the cache
+        uint64_t misses;        ///< Number of document reads that went to the database file
+        uint64_t count;         ///< Number of documents currently in the cache
+        uint64_t bytes;         ///< Approximate memory used by the cached documents
+    } C4DocumentCacheStats;
+
+    /** Enables a cache of recently read documents, holding up to `maxBytes` (approximately) of
+        document data; or disables it if `maxBytes` is 0. It's disabled by default.
+        While it's enabled, \ref c4doc_get reads documents from the cache if it can, skipping the
+        storage engine. The cache is kept up to date with changes made through any C4Database
+        instance on the same file in this process; it's unavailable for databases opened with
+        `kC4DB_NonObservable`, and doesn't see changes made by other processes. */
+    bool c4db_setDocumentCacheSize(C4Database *database C4NONNULL,
+                                   size_t maxBytes,
+                                   C4Error *outError) C4API;
+
+    /** Returns statistics about the database's document cache. (All zeroes if it's disabled.) */
+    C4DocumentCacheStats c4db_getDocumentCacheStats(C4Database *database C4NONNULL) C4API;
+
     typedef struct C4UUID {
         uint8_t bytes[16];
     } C4UUID;
@@ -334,6 +334,7 @@ extern "C" {
     #define kC4ReplicatorOptionRemoteDBUniqueID "remoteDBUniqueID" ///< Stable ID for remote db with unstable URL (string)
     #define kC4ReplicatorOptionProgressLevel    "progress"  ///< If >=1, notify on every doc; if >=2, on every attachment (int)
     #define kC4ReplicatorOptionDisableDeltas    "noDeltas"   ///< Disables delta sync (bool)
+    #define kC4ReplicatorOptionDisableFleeceBodies "noFleeceBodies" ///< Always send rev bodies & deltas as JSON (bool)
     #define kC4ReplicatorOptionMaxRetries       "maxRetries" ///< Max number of retry attempts (int)
     #define kC4ReplicatorOptionMaxRetryInterval "maxRetryInterval" ///< Max delay betw retries (secs)
 
@@ -354,6 +355,7 @@ extern "C" {
 
     // BLIP options:
     #define kC4ReplicatorCompressionLevel       "BLIPCompressionLevel" ///< Data compression level, 0..9
+    #define kC4ReplicatorCompressionDictionary  "BLIPCompressionDictionary" ///< Offer compression with a preset dictionary (bool)
 
     // [1]: Auth dictionary keys:
     #define kC4ReplicatorAuthType       "type"           ///< Auth type; see [2] (string)
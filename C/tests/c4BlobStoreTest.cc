@@ -19,7 +19,10 @@
 #include "c4Test.hh"
 #include "c4BlobStore.h"
 #include "c4Private.h"
+#include <condition_variable>
+#include <errno.h>
 #include <fstream>
+#include <mutex>
 
 using namespace std;
 
@@ -27,10 +30,11 @@ using namespace std;
 class BlobStoreTest {
 public:
     
-    static const int numberOfOptions = 2;       // 0 = unencrypted, 1 = encrypted
+    static const int numberOfOptions = 3;       // 0 = unencrypted, 1 = encrypted, 2 = chunked
 
     BlobStoreTest(int option)
     :encrypted(option == 1)
+    ,chunked(option == 2)
     {
         C4EncryptionKey crypto, *encryption=nullptr;
         if (encrypted) {
@@ -39,11 +43,14 @@ public:
             crypto.algorithm = kC4EncryptionAES256;
             memset(&crypto.bytes, 0xCC, sizeof(crypto.bytes));
             encryption = &crypto;
+        } else if (chunked) {
+            fprintf(stderr, "        ...chunked\n");
+            INFO("(Chunked)");
         }
 
         C4Error error;
         store = c4blob_openStore(TEMPDIR("cbl_blob_test" + kPathSeparator),
-                                 kC4DB_Create,
+                                 kC4DB_Create | (chunked ? kC4DB_ChunkedBlobs : 0),
                                  encryption,
                                  &error);
         REQUIRE(store != nullptr);
@@ -58,6 +65,7 @@ public:
 
     C4BlobStore *store {nullptr};
     const bool encrypted;
+    const bool chunked;
 
     C4BlobKey bogusKey;
 };
@@ -86,6 +94,21 @@ TEST_CASE("parse invalid blob keys", "[blob][C][!throws]") {
 }
 
 
+TEST_CASE("compute blob keys", "[blob][C]") {
+    // Test vectors from FIPS 180-2. (The long ones exercise the hardware SHA-1 code, if any.)
+    auto digest = [](slice data) {
+        C4BlobKey key = c4blob_computeKey(data);
+        return slice(key.bytes, sizeof(key.bytes)).hexString();
+    };
+    CHECK(digest(""_sl) == "da39a3ee5e6b4b0d3255bfef95601890afd80709");
+    CHECK(digest("abc"_sl) == "a9993e364706816aba3e25717850c26c9cd0d89d");
+    CHECK(digest("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"_sl)
+          == "84983e441c3bd26ebaae4aa1f95129e5e54670f1");
+    string million(1000000, 'a');
+    CHECK(digest(slice(million)) == "34aa973cd4c4daa4f61eeb2bdbad27316534016f");
+}
+
+
 N_WAY_TEST_CASE_METHOD(BlobStoreTest, "missing blobs", "[blob][C]") {
     ExpectingExceptions x;
     
@@ -117,11 +140,7 @@ N_WAY_TEST_CASE_METHOD(BlobStoreTest, "create blobs", "[blob][Encryption][C]") {
 
     // Read it back and compare
     int64_t blobSize = c4blob_getSize(store, key);
-    CHECK(blobSize >= blobToStore.size);
-    if (encrypted)
-        CHECK(blobSize <= blobToStore.size + 16);   // getSize is approximate in an encrypted store
-    else
-        CHECK(blobSize == blobToStore.size);
+    CHECK(blobSize == blobToStore.size);
     
     alloc_slice gotBlob = c4blob_getContents(store, key, &error);
     REQUIRE(gotBlob.buf != nullptr);
@@ -146,6 +165,40 @@ N_WAY_TEST_CASE_METHOD(BlobStoreTest, "create blobs", "[blob][Encryption][C]") {
     CHECK(memcmp(&key2, &key, sizeof(key2)) == 0);
 }
 
+N_WAY_TEST_CASE_METHOD(BlobStoreTest, "map blob contents", "[blob][Encryption][C]") {
+    C4Error error;
+    CHECK(c4blob_mapContents(store, bogusKey, &error) == nullptr);
+    CHECK(error.code == kC4ErrorNotFound);
+
+    for (size_t size : {size_t(0), size_t(37), size_t(100000)}) {
+        string data(size, '\0');
+        for (size_t i = 0; i < size; ++i)
+            data[i] = char(i * 7);
+        C4BlobKey key;
+        REQUIRE(c4blob_create(store, slice(data), nullptr, &key, &error));
+
+        C4BlobMapping *mapping = c4blob_mapContents(store, key, &error);
+        if (encrypted) {
+            CHECK(mapping == nullptr);
+            CHECK(error.code == kC4ErrorWrongFormat);
+        } else if (chunked && size >= 65536) {
+            CHECK(mapping == nullptr);
+            CHECK(error.code == kC4ErrorUnsupported);
+        } else {
+            REQUIRE(mapping != nullptr);
+            C4Slice contents = c4blobmap_contents(mapping);
+            CHECK(contents.buf != nullptr);
+            CHECK(slice(contents) == slice(data));
+#ifndef _MSC_VER
+            // The mapping outlives the blob:
+            REQUIRE(c4blob_delete(store, key, &error));
+            CHECK(slice(c4blobmap_contents(mapping)) == slice(data));
+#endif
+            c4blobmap_release(mapping);
+        }
+    }
+}
+
 N_WAY_TEST_CASE_METHOD(BlobStoreTest, "delete blobs", "[blob][Encryption][C]") {
     C4Slice blobToStore = C4STR("This is a blob to store in the store!");
     
@@ -293,9 +346,10 @@ N_WAY_TEST_CASE_METHOD(BlobStoreTest, "write blob with stream", "[blob][Encrypti
 
 N_WAY_TEST_CASE_METHOD(BlobStoreTest, "write blobs of many sizes", "[blob][Encryption][C]") {
     // The interesting sizes for encrypted blobs are right around the file block size (4096)
-    // and the cipher block size (16).
+    // and the cipher block size (16); for chunked blobs, around the max chunk size (65536).
     const vector<size_t> kSizes = {0, 1, 15, 16, 17, 4095, 4096, 4097,
-                                   4096+15, 4096+16, 4096+17, 8191, 8192, 8193};
+                                   4096+15, 4096+16, 4096+17, 8191, 8192, 8193,
+                                   65535, 65536, 65537, 150000};
     for (size_t size : kSizes) {
         //Log("---- %lu-byte blob", size);
         INFO("Testing " << size << "-byte blob");
@@ -391,3 +445,178 @@ N_WAY_TEST_CASE_METHOD(BlobStoreTest, "write identical blob", "[blob][C]") {
         c4stream_closeWriter(stream);
     }
 }
+
+
+N_WAY_TEST_CASE_METHOD(BlobStoreTest, "resume writing blob", "[blob][Encryption][C]") {
+    string contents;
+    for (int i = 0; i < 1000; i++) {
+        char line[32];
+        snprintf(line, sizeof(line), "This is line %03d.\n", i);
+        contents += line;
+    }
+    C4BlobKey key = c4blob_computeKey(slice(contents));
+    const size_t half = contents.size() / 2;
+
+    // Write the first half, then close without installing:
+    C4Error error;
+    C4WriteStream *stream = c4blob_openResumableWriteStream(store, key, &error);
+    REQUIRE(stream);
+    CHECK(c4stream_bytesWritten(stream) == 0);
+    REQUIRE(c4stream_write(stream, contents.data(), half, &error));
+
+    // While it's open, another stream for the same blob can't share its partial data:
+    C4WriteStream *other = c4blob_openResumableWriteStream(store, key, &error);
+    REQUIRE(other);
+    CHECK(c4stream_bytesWritten(other) == 0);
+    c4stream_closeWriter(other);
+    c4stream_closeWriter(stream);
+
+    // Resume, and write the rest:
+    stream = c4blob_openResumableWriteStream(store, key, &error);
+    REQUIRE(stream);
+    uint64_t offset = c4stream_bytesWritten(stream);
+    if (encrypted || chunked) {
+        CHECK(offset == 0);     // encrypted and chunked stores can't resume
+    } else {
+        CHECK(offset == half);
+    }
+    REQUIRE(c4stream_write(stream, contents.data() + offset, contents.size() - offset, &error));
+    CHECK(c4stream_install(stream, &key, &error));
+    c4stream_closeWriter(stream);
+
+    alloc_slice readBack = c4blob_getContents(store, key, &error);
+    CHECK(readBack == slice(contents));
+}
+
+
+N_WAY_TEST_CASE_METHOD(BlobStoreTest, "resume writing blob, key mismatch", "[blob][C][!throws]") {
+    if (encrypted || chunked)
+        return;
+    string contents = "This is the real blob content.";
+    C4BlobKey key = c4blob_computeKey(slice(contents));
+
+    // Leave bogus partial data behind:
+    C4Error error;
+    C4WriteStream *stream = c4blob_openResumableWriteStream(store, key, &error);
+    REQUIRE(stream);
+    REQUIRE(c4stream_write(stream, "Bogus", 5, &error));
+    c4stream_closeWriter(stream);
+
+    // Finishing the download fails the digest check, which discards the partial data:
+    stream = c4blob_openResumableWriteStream(store, key, &error);
+    REQUIRE(stream);
+    CHECK(c4stream_bytesWritten(stream) == 5);
+    REQUIRE(c4stream_write(stream, contents.data() + 5, contents.size() - 5, &error));
+    {
+        ExpectingExceptions x;
+        CHECK(!c4stream_install(stream, &key, &error));
+    }
+    c4stream_closeWriter(stream);
+
+    // So the next attempt starts from scratch:
+    stream = c4blob_openResumableWriteStream(store, key, &error);
+    REQUIRE(stream);
+    CHECK(c4stream_bytesWritten(stream) == 0);
+    REQUIRE(c4stream_write(stream, contents.data(), contents.size(), &error));
+    CHECK(c4stream_install(stream, &key, &error));
+    c4stream_closeWriter(stream);
+}
+
+
+// Records the callbacks of a c4blob_importFileAsync call.
+struct ImportObserver {
+    mutex m;
+    condition_variable cond;
+    C4BlobImport *import {nullptr};
+    bool cancelOnProgress {false};
+    uint64_t bytesImported {0}, totalBytes {0};
+    bool progressInOrder {true};
+    bool done {false};
+    C4BlobKey key {};
+    C4Error error {};
+
+    static void onProgress(void *context, uint64_t bytesImported, uint64_t totalBytes) {
+        auto self = (ImportObserver*)context;
+        unique_lock<mutex> lock(self->m);
+        if (bytesImported <= self->bytesImported || bytesImported > totalBytes)
+            self->progressInOrder = false;
+        self->bytesImported = bytesImported;
+        self->totalBytes = totalBytes;
+        if (self->cancelOnProgress) {
+            self->cond.wait(lock, [&]{return self->import != nullptr;});
+            c4blob_cancelImport(self->import);
+        }
+    }
+
+    static void onComplete(void *context, C4BlobKey key, C4Error error) {
+        auto self = (ImportObserver*)context;
+        unique_lock<mutex> lock(self->m);
+        self->key = key;
+        self->error = error;
+        self->done = true;
+        self->cond.notify_all();
+    }
+
+    void start(C4BlobStore *store, const string &path) {
+        C4Error startError;
+        auto imp = c4blob_importFileAsync(store, slice(path), onProgress, onComplete, this,
+                                          &startError);
+        REQUIRE(imp);
+        unique_lock<mutex> lock(m);
+        import = imp;
+        cond.notify_all();
+    }
+
+    void wait() {
+        unique_lock<mutex> lock(m);
+        REQUIRE(cond.wait_for(lock, chrono::seconds(30), [&]{return done;}));
+    }
+
+    ~ImportObserver() {
+        c4blob_freeImport(import);
+    }
+};
+
+
+N_WAY_TEST_CASE_METHOD(BlobStoreTest, "import blob asynchronously", "[blob][Encryption][C]") {
+    // A few chunks' worth, not a multiple of the chunk size:
+    string contents;
+    for (int i = 0; contents.size() < 3500000; i++) {
+        char line[32];
+        snprintf(line, sizeof(line), "This is line %07d.\n", i);
+        contents += line;
+    }
+    string path = TempDir() + "blob_import_source";
+    {
+        ofstream out(path, ios::binary | ios::trunc);
+        out << contents;
+    }
+
+    ImportObserver obs;
+    SECTION("Import") {
+        obs.start(store, path);
+        obs.wait();
+        CHECK(obs.error.code == 0);
+        CHECK(memcmp(c4blob_computeKey(slice(contents)).bytes, obs.key.bytes, 20) == 0);
+        CHECK(obs.progressInOrder);
+        CHECK(obs.bytesImported == contents.size());
+        CHECK(obs.totalBytes == contents.size());
+        C4Error error;
+        alloc_slice readBack = c4blob_getContents(store, obs.key, &error);
+        CHECK(readBack == slice(contents));
+    }
+    SECTION("Cancel") {
+        obs.cancelOnProgress = true;
+        obs.start(store, path);
+        obs.wait();
+        CHECK(obs.error.domain == POSIXDomain);
+        CHECK(obs.error.code == ECANCELED);
+        CHECK(c4blob_getSize(store, c4blob_computeKey(slice(contents))) == -1);
+    }
+    SECTION("Missing file") {
+        obs.start(store, path + "_missing");
+        obs.wait();
+        CHECK(obs.error.code != 0);
+    }
+    remove(path.c_str());
+}
@@ -468,6 +468,36 @@ N_WAY_TEST_CASE_METHOD(C4DatabaseTest, "Database Auto-Expiration After Reopen",
     C4Log("---- Done...");
 }
 
+N_WAY_TEST_CASE_METHOD(C4DatabaseTest, "Database Auto-Expiration Releases Blobs", "[Database][blob][C][Expiration]")
+{
+    C4Slice docID = C4STR("expire_me");
+    string content = "This attachment expires with its document";
+    C4Error err;
+    C4BlobKey key;
+    {
+        TransactionHelper t(db);
+        key = addDocWithAttachments(docID, {content}, "text/plain")[0];
+    }
+    C4BlobStore* store = c4db_getBlobStore(db, &err);
+    REQUIRE(store);
+    REQUIRE(c4db_compact(db, &err));        // Starts tracking blob references
+    CHECK(c4blob_getSize(store, key) > 0);
+
+    REQUIRE(c4doc_setExpiration(db, docID, c4_now() + 1500*ms, &err));
+    c4db_startHousekeeping(db);
+
+    C4Log("---- Wait till expiration time...");
+    waitAndCheck(1500ms, 10s, [&] {
+        C4Document *doc = c4doc_get(db, docID, true, &err);
+        c4doc_release(doc);
+        return doc == nullptr;
+    });
+
+    // The housekeeper's expiration must have released the document's blob reference:
+    REQUIRE(c4db_compact(db, &err));
+    CHECK(c4blob_getSize(store, key) == -1);
+}
+
 N_WAY_TEST_CASE_METHOD(C4DatabaseTest, "Database CancelExpire", "[Database][C][Expiration]")
 {
     C4Slice docID = C4STR("expire_me");
@@ -505,6 +535,95 @@ N_WAY_TEST_CASE_METHOD(C4DatabaseTest, "Database Expired Multiple Instances", "[
     c4db_release(db2);
 }
 
+N_WAY_TEST_CASE_METHOD(C4DatabaseTest, "Database Document Cache", "[Database][C]") {
+    C4Error error;
+    C4Slice docID = C4STR("hot");
+    createRev(docID, kRevID, kFleeceBody);
+    REQUIRE(c4db_setDocumentCacheSize(db, 1 << 20, &error));
+
+    auto checkRevID = [&](C4Database *inDB, C4Slice expectedRevID) {
+        C4Document *doc = c4doc_get(inDB, docID, true, &error);
+        REQUIRE(doc);
+        CHECK(doc->revID == expectedRevID);
+        CHECK(doc->selectedRev.revID == expectedRevID);
+        c4doc_release(doc);
+    };
+
+    // First read misses and fills the cache; the rest hit:
+    for (int i = 0; i < 3; ++i)
+        checkRevID(db, kRevID);
+    auto stats = c4db_getDocumentCacheStats(db);
+    CHECK(stats.misses == 1);
+    CHECK(stats.hits == 2);
+    CHECK(stats.count == 1);
+    CHECK(stats.bytes > 0);
+
+    SECTION("Local change") {
+        createRev(docID, kRev2ID, kFleeceBody);
+        checkRevID(db, kRev2ID);
+    }
+    SECTION("Change through another instance") {
+        C4Database *db2 = c4db_openAgain(db, &error);
+        REQUIRE(db2);
+        createRev(db2, docID, kRev2ID, kFleeceBody);
+        checkRevID(db, kRev2ID);
+        c4db_release(db2);
+    }
+    SECTION("Marked synced through another instance") {
+        // (This changes only the record's flags, as the replicator does on its own instance.)
+        C4Database *db2 = c4db_openAgain(db, &error);
+        REQUIRE(db2);
+        {
+            TransactionHelper t(db2);
+            C4Document *doc = c4doc_get(db2, docID, true, &error);
+            REQUIRE(doc);
+            REQUIRE(c4db_markSynced(db2, docID, doc->sequence, 1, &error));
+            c4doc_release(doc);
+        }
+        C4Document *doc = c4doc_get(db, docID, true, &error);
+        REQUIRE(doc);
+        alloc_slice remoteRevID = c4doc_getRemoteAncestor(doc, 1);
+        CHECK(remoteRevID == kRevID);
+        c4doc_release(doc);
+        c4db_release(db2);
+    }
+    SECTION("Aborted change") {
+        REQUIRE(c4db_beginTransaction(db, &error));
+        createRev(docID, kRev2ID, kFleeceBody);
+        checkRevID(db, kRev2ID);
+        REQUIRE(c4db_endTransaction(db, false, &error));
+        checkRevID(db, kRevID);
+    }
+    SECTION("Read inside a transaction") {
+        // The cache isn't used at all:
+        {
+            TransactionHelper t(db);
+            checkRevID(db, kRevID);
+        }
+        auto txnStats = c4db_getDocumentCacheStats(db);
+        CHECK(txnStats.hits == stats.hits);
+        CHECK(txnStats.misses == stats.misses);
+    }
+    SECTION("Purge") {
+        {
+            TransactionHelper t(db);
+            REQUIRE(c4db_purgeDoc(db, docID, &error));
+        }
+        CHECK(c4doc_get(db, docID, true, &error) == nullptr);
+        CHECK(error.code == kC4ErrorNotFound);
+    }
+    SECTION("Disable") {
+        REQUIRE(c4db_setDocumentCacheSize(db, 0, &error));
+        stats = c4db_getDocumentCacheStats(db);
+        CHECK(stats.hits == 0);
+        CHECK(stats.count == 0);
+        checkRevID(db, kRevID);
+    }
+    stats = c4db_getDocumentCacheStats(db);
+    CHECK(stats.count <= 1);
+}
+
+
 N_WAY_TEST_CASE_METHOD(C4DatabaseTest, "Database BackgroundDB torture test", "[Database][C][Expiration]")
 {
     // Test for random crashers/race conditions closing a database with a BackgroundDB+Housekeeper.
@@ -609,6 +728,100 @@ N_WAY_TEST_CASE_METHOD(C4DatabaseTest, "Database Compact", "[Database][C]")
 }
 
 
+N_WAY_TEST_CASE_METHOD(C4DatabaseTest, "Database Compact Incrementally", "[Database][blob][C]")
+{
+    // After the first compaction, blob references are tracked as documents change, instead of
+    // being found by scanning the documents; check that both give the same results.
+    C4Error err;
+    C4Slice doc1ID = C4STR("doc001");
+    C4Slice doc2ID = C4STR("doc002");
+    C4Slice doc3ID = C4STR("doc003");
+    C4Slice doc4ID = C4STR("doc004");
+    string content1 = "This is the first attachment";
+    string content2 = "This is the second attachment";
+    string content3 = "This is the third attachment";
+
+    C4BlobKey key1, key2;
+    {
+        TransactionHelper t(db);
+        key1 = addDocWithAttachments(doc1ID, {content1}, "text/plain")[0];
+        key2 = addDocWithAttachments(doc2ID, {content2}, "text/plain")[0];
+    }
+    C4BlobStore* store = c4db_getBlobStore(db, &err);
+    REQUIRE(store);
+    REQUIRE(c4db_compact(db, &err));        // Scans the documents
+    CHECK(c4blob_getSize(store, key1) > 0);
+    CHECK(c4blob_getSize(store, key2) > 0);
+
+    // Another doc referencing blob 1, a new blob, and deleting the only reference to blob 2:
+    C4BlobKey key3;
+    {
+        TransactionHelper t(db);
+        addDocWithAttachments(doc3ID, {content1}, "text/plain");
+        key3 = addDocWithAttachments(doc4ID, {content3}, "text/plain")[0];
+    }
+    createRev(doc2ID, kRev2ID, kC4SliceNull, kRevDeleted);
+    reopenDB();
+    store = c4db_getBlobStore(db, &err);
+    REQUIRE(c4db_compact(db, &err));
+    CHECK(c4blob_getSize(store, key1) > 0);
+    CHECK(c4blob_getSize(store, key2) == -1);
+    CHECK(c4blob_getSize(store, key3) > 0);
+
+    // Purging one of the two docs referencing blob 1 leaves it in place:
+    {
+        TransactionHelper t(db);
+        REQUIRE(c4db_purgeDoc(db, doc1ID, &err));
+    }
+    REQUIRE(c4db_compact(db, &err));
+    CHECK(c4blob_getSize(store, key1) > 0);
+
+    // Deleting the other one removes it:
+    createRev(doc3ID, kRev2ID, kC4SliceNull, kRevDeleted);
+    REQUIRE(c4db_compact(db, &err));
+    CHECK(c4blob_getSize(store, key1) == -1);
+    CHECK(c4blob_getSize(store, key3) > 0);
+
+    // An unreferenced blob is removed:
+    C4BlobKey key4;
+    REQUIRE(c4blob_create(store, c4str("unreferenced"), nullptr, &key4, &err));
+    REQUIRE(c4db_compact(db, &err));
+    CHECK(c4blob_getSize(store, key4) == -1);
+    CHECK(c4blob_getSize(store, key3) > 0);
+}
+
+
+N_WAY_TEST_CASE_METHOD(C4DatabaseTest, "Database Compact Many Docs", "[Database][blob][C]")
+{
+    // The first compaction scans the documents in several transactions; check that documents
+    // in every batch are counted.
+    C4Error err;
+    vector<C4BlobKey> keys;
+    {
+        TransactionHelper t(db);
+        char docID[20];
+        for (int i = 0; i < 2500; ++i) {
+            sprintf(docID, "doc-%04d", i);
+            if (i % 500 == 0)
+                keys.push_back(addDocWithAttachments(c4str(docID), {"Attachment " + to_string(i)},
+                                                     "text/plain")[0]);
+            else
+                createRev(c4str(docID), kRevID, kFleeceBody);
+        }
+    }
+    C4BlobStore* store = c4db_getBlobStore(db, &err);
+    REQUIRE(store);
+    REQUIRE(c4db_compact(db, &err));
+    for (auto &key : keys)
+        CHECK(c4blob_getSize(store, key) > 0);
+
+    createRev(C4STR("doc-2000"), kRev2ID, kC4SliceNull, kRevDeleted);
+    REQUIRE(c4db_compact(db, &err));
+    CHECK(c4blob_getSize(store, keys[4]) == -1);
+    CHECK(c4blob_getSize(store, keys[3]) > 0);
+}
+
+
 N_WAY_TEST_CASE_METHOD(C4DatabaseTest, "Database copy", "[Database][C]") {
     static constexpr slice kNuName = "nudb";
 
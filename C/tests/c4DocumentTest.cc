@@ -21,6 +21,7 @@
 #include "c4Private.h"
 #include "Benchmark.hh"
 #include "fleece/Fleece.hh"
+#include <thread>
 
 using namespace fleece;
 
@@ -906,6 +907,83 @@ N_WAY_TEST_CASE_METHOD(C4Test, "Document Conflict", "[Database][C]") {
     c4doc_release(doc);
 }
 
+N_WAY_TEST_CASE_METHOD(C4Test, "Document External Rev Bodies", "[Database][C]") {
+    if (!isRevTrees())
+        return;
+
+    // Enabling the flag on an existing database upgrades its format, so kC4DB_NoUpgrade
+    // prevents it:
+    C4DatabaseConfig2 config = dbConfig();
+    config.flags |= kC4DB_ExternalRevBodies | kC4DB_NoUpgrade;
+    closeDB();
+    C4Error err;
+    CHECK(c4db_openNamed(kDatabaseName, &config, &err) == nullptr);
+    CHECK(err.domain == LiteCoreDomain);
+    CHECK(err.code == kC4ErrorCantUpgradeDatabase);
+
+    config.flags &= ~kC4DB_NoUpgrade;
+    db = c4db_openNamed(kDatabaseName, &config, &err);
+    REQUIRE(db);
+    C4RawDocument *marker = c4raw_get(db, C4STR("info"), C4STR("externalRevBodies"), &err);
+    CHECK(marker);
+    c4raw_free(marker);
+
+    // Returns true if the body of `revID` is stored outside the doc's record:
+    auto isStoredExternally = [&](C4Slice revID) {
+        std::string key = toString(kDocID) + '\x1F' + toString(revID);
+        C4RawDocument *raw = c4raw_get(db, C4STR("default_bodies"), slice(key), nullptr);
+        c4raw_free(raw);
+        return raw != nullptr;
+    };
+
+    const auto kFleeceBody2 = json2fleece("{'ok':'go'}");
+    const auto kFleeceBody3 = json2fleece("{'ubu':'roi'}");
+    createRev(kDocID, kRevID, kFleeceBody);
+    createRev(kDocID, kRev2ID, kFleeceBody2, kRevKeepBody);
+    createRev(kDocID, kRev3ID, kFleeceBody3);
+    CHECK(!isStoredExternally(kRevID));     // (body was discarded)
+    CHECK(isStoredExternally(kRev2ID));
+    CHECK(!isStoredExternally(kRev3ID));    // (current revision)
+
+    SECTION("Reopen without the flag") {
+        config.flags &= ~kC4DB_ExternalRevBodies;
+        closeDB();
+        db = c4db_openNamed(kDatabaseName, &config, &err);
+        REQUIRE(db);
+    }
+
+    // The current revision's body is there; the kept one's is loaded on demand:
+    C4Document *doc = c4doc_get(db, kDocID, true, &err);
+    REQUIRE(doc);
+    CHECK(doc->selectedRev.revID == kRev3ID);
+    CHECK(doc->selectedRev.body == kFleeceBody3);
+    REQUIRE(c4doc_selectRevision(doc, kRev2ID, false, &err));
+    CHECK(doc->selectedRev.body == kC4SliceNull);
+    CHECK(c4doc_hasRevisionBody(doc));
+    REQUIRE(c4doc_loadRevisionBody(doc, &err));
+    CHECK(doc->selectedRev.body == kFleeceBody2);
+    REQUIRE(c4doc_selectRevision(doc, kRev2ID, true, &err));
+    CHECK(doc->selectedRev.body == kFleeceBody2);
+    REQUIRE(c4doc_selectRevision(doc, kRevID, true, &err));
+    CHECK(!c4doc_hasRevisionBody(doc));
+    c4doc_release(doc);
+
+    // Purging or expiring the doc deletes its stored bodies:
+    SECTION("Purge") {
+        TransactionHelper t(db);
+        REQUIRE(c4db_purgeDoc(db, kDocID, &err));
+    }
+    SECTION("Expire") {
+        REQUIRE(c4doc_setExpiration(db, kDocID, c4_now() + 100, &err));
+        c4db_startHousekeeping(db);
+        for (int i = 0; i < 100 && c4db_nextDocExpiration(db) != 0; ++i)
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        REQUIRE(c4db_nextDocExpiration(db) == 0);
+    }
+    CHECK(!isStoredExternally(kRev2ID));
+}
+
+
 N_WAY_TEST_CASE_METHOD(C4Test, "Document from Fleece", "[Database][C]") {
     if (!isRevTrees())
         return;
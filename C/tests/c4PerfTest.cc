@@ -258,6 +258,24 @@ private:
 };
 
 
+TEST_CASE("Blob digest performance", "[Perf][C][.slow]") {
+    // c4blob_computeKey is SHA-1, as used for blob keys and rev IDs.
+    for (size_t size : {size_t(100), size_t(4096), size_t(10*1024*1024)}) {
+        alloc_slice data(size);
+        litecore::SecureRandomize(data);
+        size_t repeat = max(size_t(10), size_t(100*1024*1024) / size);
+        Benchmark b;
+        for (size_t i = 0; i < repeat; ++i) {
+            b.start();
+            (void)c4blob_computeKey(data);
+            b.stop();
+        }
+        fprintf(stderr, "Digesting %zu bytes: ", size);
+        b.printReport(double(1024*1024) / size, "MB");
+    }
+}
+
+
 N_WAY_TEST_CASE_METHOD(PerfTest, "Import iTunesMusicLibrary", "[Perf][C][.slow]") {
     Stopwatch st;
     auto numDocs = importJSONLines(sFixturesDir + "iTunesMusicLibrary.json");
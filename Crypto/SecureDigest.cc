@@ -18,10 +18,13 @@
 
 #include "SecureDigest.hh"
 #include "Error.hh"
+#include <algorithm>
+#include <utility>
 
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wdocumentation-deprecated-sync"
 #include "mbedtls/sha1.h"
+#include "mbedtls/sha256.h"
 #pragma clang diagnostic pop
 
 #ifdef __APPLE__
@@ -31,12 +34,394 @@
 #ifdef USE_COMMON_CRYPTO
     #include <CommonCrypto/CommonDigest.h>
     #define _CONTEXT ((CC_SHA1_CTX*)_context)
+    #define _CONTEXT256 ((CC_SHA256_CTX*)_context)
 #else
+    #include <atomic>
     #define _CONTEXT ((mbedtls_sha1_context*)_context)
+    #define _CONTEXT256 ((mbedtls_sha256_context*)_context)
+    #define _HW_CONTEXT ((HardwareDigestContext<5>*)_context)
+    #define _HW_CONTEXT256 ((HardwareDigestContext<8>*)_context)
+
+    // Where the CPU has SHA instructions, they're used instead of mbedTLS's portable code.
+    // (CommonCrypto already does this for itself.)
+    #if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+        #define SHA_X86
+        #include <immintrin.h>
+        #ifdef _MSC_VER
+            #include <intrin.h>
+            #define SHA_X86_TARGET
+        #else
+            #include <cpuid.h>
+            #define SHA_X86_TARGET __attribute__((target("sha,sse4.1,ssse3")))
+        #endif
+    #elif (defined(__aarch64__) || defined(_M_ARM64)) \
+            && (defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_SHA2))
+        // (Only if the compiler targets the crypto extensions, since its <arm_neon.h> may not
+        // otherwise declare the intrinsics. The CPU is still checked at runtime.)
+        #define SHA_ARM
+        #include <arm_neon.h>
+        #ifdef _MSC_VER
+            #include <Windows.h>
+        #elif defined(__linux__)
+            #include <sys/auxv.h>
+            #include <asm/hwcap.h>
+        #endif
+    #endif
 #endif
 
 namespace litecore {
 
+
+#ifndef USE_COMMON_CRYPTO
+#pragma mark - HARDWARE SHA-1 AND SHA-256:
+
+
+    // Processes `nBlocks` 64-byte blocks of data, updating the digest state (5 words for SHA-1,
+    // 8 for SHA-256.)
+    using CompressFn = void (*)(uint32_t *state, const uint8_t *data, size_t nBlocks);
+
+
+#if defined(SHA_X86) || defined(SHA_ARM)
+    // The first 32 bits of the fractional parts of the cube roots of the first 64 primes.
+    alignas(16) static constexpr uint32_t kSHA256RoundConstants[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+    };
+#endif
+
+
+#ifdef SHA_X86
+    // Does four rounds (group G of 20) using the SHA-NI instructions, and computes the message
+    // words of group G+4 into w[G % 4]. `e` is the E input of the rounds, already combined with
+    // their message words; on return it's that of the next group.
+    template <size_t G>
+    SHA_X86_TARGET
+    static inline void sha1FourRoundsX86(__m128i &abcd, __m128i &e, __m128i w[4]) {
+        __m128i abcdPrev = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e, G / 5);
+        if constexpr (G < 16) {
+            w[G % 4] = _mm_sha1msg2_epu32(_mm_xor_si128(_mm_sha1msg1_epu32(w[G % 4], w[(G+1) % 4]),
+                                                        w[(G+2) % 4]),
+                                          w[(G+3) % 4]);
+        }
+        if constexpr (G < 19)
+            e = _mm_sha1nexte_epu32(abcdPrev, w[(G+1) % 4]);
+        else
+            e = abcdPrev;
+    }
+
+
+    // All 80 rounds, unrolled at compile time so the message words stay in registers.
+    template <size_t... G>
+    SHA_X86_TARGET
+    static inline void sha1RoundsX86(__m128i &abcd, __m128i &e, __m128i w[4],
+                                     std::index_sequence<G...>)
+    {
+        (sha1FourRoundsX86<G>(abcd, e, w), ...);
+    }
+
+
+    SHA_X86_TARGET
+    static void sha1CompressX86(uint32_t *state, const uint8_t *data, size_t nBlocks) {
+        const __m128i kByteSwap = _mm_set_epi64x(0x0001020304050607, 0x08090a0b0c0d0e0f);
+        __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)state), 0x1B);
+        __m128i e = _mm_set_epi32(int(state[4]), 0, 0, 0);
+        for (; nBlocks > 0; --nBlocks, data += 64) {
+            __m128i abcdSaved = abcd, eSaved = e;
+            __m128i w[4];
+            for (int i = 0; i < 4; ++i)
+                w[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 16*i)), kByteSwap);
+            __m128i eNext = _mm_add_epi32(e, w[0]);
+            sha1RoundsX86(abcd, eNext, w, std::make_index_sequence<20>());
+            e = _mm_sha1nexte_epu32(eNext, eSaved);
+            abcd = _mm_add_epi32(abcd, abcdSaved);
+        }
+        _mm_storeu_si128((__m128i*)state, _mm_shuffle_epi32(abcd, 0x1B));
+        state[4] = uint32_t(_mm_extract_epi32(e, 3));
+    }
+
+
+    // Does four rounds (group G of 16) using the SHA-NI instructions. Groups 3-14 also finish
+    // the message words of group G+1, and groups 1-12 start those of group G+3.
+    template <size_t G>
+    SHA_X86_TARGET
+    static inline void sha256FourRoundsX86(__m128i &abef, __m128i &cdgh, __m128i w[4]) {
+        __m128i wk = _mm_add_epi32(w[G % 4],
+                                   _mm_load_si128((const __m128i*)&kSHA256RoundConstants[4*G]));
+        cdgh = _mm_sha256rnds2_epu32(cdgh, abef, wk);
+        if constexpr (G >= 3 && G < 15) {
+            __m128i &next = w[(G+1) % 4];
+            next = _mm_add_epi32(next, _mm_alignr_epi8(w[G % 4], w[(G+3) % 4], 4));
+            next = _mm_sha256msg2_epu32(next, w[G % 4]);
+        }
+        abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(wk, 0x0E));
+        if constexpr (G >= 1 && G < 13)
+            w[(G+3) % 4] = _mm_sha256msg1_epu32(w[(G+3) % 4], w[G % 4]);
+    }
+
+
+    template <size_t... G>
+    SHA_X86_TARGET
+    static inline void sha256RoundsX86(__m128i &abef, __m128i &cdgh, __m128i w[4],
+                                       std::index_sequence<G...>)
+    {
+        (sha256FourRoundsX86<G>(abef, cdgh, w), ...);
+    }
+
+
+    SHA_X86_TARGET
+    static void sha256CompressX86(uint32_t *state, const uint8_t *data, size_t nBlocks) {
+        const __m128i kByteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0b, 0x0405060700010203);
+        // The instructions want the state as ABEF and CDGH, not ABCD and EFGH:
+        __m128i cdab = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[0]), 0xB1);
+        __m128i efgh = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[4]), 0x1B);
+        __m128i abef = _mm_alignr_epi8(cdab, efgh, 8);
+        __m128i cdgh = _mm_blend_epi16(efgh, cdab, 0xF0);
+        for (; nBlocks > 0; --nBlocks, data += 64) {
+            __m128i abefSaved = abef, cdghSaved = cdgh;
+            __m128i w[4];
+            for (int i = 0; i < 4; ++i)
+                w[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 16*i)), kByteSwap);
+            sha256RoundsX86(abef, cdgh, w, std::make_index_sequence<16>());
+            abef = _mm_add_epi32(abef, abefSaved);
+            cdgh = _mm_add_epi32(cdgh, cdghSaved);
+        }
+        __m128i feba = _mm_shuffle_epi32(abef, 0x1B);
+        __m128i dchg = _mm_shuffle_epi32(cdgh, 0xB1);
+        _mm_storeu_si128((__m128i*)&state[0], _mm_blend_epi16(feba, dchg, 0xF0));
+        _mm_storeu_si128((__m128i*)&state[4], _mm_alignr_epi8(dchg, feba, 8));
+    }
+
+
+    static bool cpuHasSHA() {
+        // Needs SSSE3 & SSE4.1 (CPUID leaf 1, ECX bits 9 & 19) and SHA (leaf 7, EBX bit 29).
+        // The SHA extensions include both SHA-1 and SHA-256.
+#ifdef _MSC_VER
+        int regs[4];
+        __cpuid(regs, 0);
+        if (regs[0] < 7)
+            return false;
+        __cpuid(regs, 1);
+        unsigned ecx = regs[2];
+        __cpuidex(regs, 7, 0);
+        unsigned ebx = regs[1];
+#else
+        unsigned eax, ebx, ecx, edx;
+        if (__get_cpuid_max(0, nullptr) < 7)
+            return false;
+        __cpuid(1, eax, ebx, ecx, edx);
+        unsigned ecx1 = ecx;
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+        ecx = ecx1;
+#endif
+        return (ecx & (1 << 9)) && (ecx & (1 << 19)) && (ebx & (1 << 29));
+    }
+
+    static bool cpuHasSHA1()    {return cpuHasSHA();}
+    static bool cpuHasSHA256()  {return cpuHasSHA();}
+
+    static constexpr CompressFn kHardwareSHA1 = &sha1CompressX86;
+    static constexpr CompressFn kHardwareSHA256 = &sha256CompressX86;
+#endif // SHA_X86
+
+
+#ifdef SHA_ARM
+    // Does four rounds (group G of 20) using the ARMv8 SHA-1 instructions, and computes the
+    // message words of group G+4 into w[G % 4].
+    template <size_t G>
+    static inline void sha1FourRoundsARM(uint32x4_t &abcd, uint32_t &e, uint32x4_t w[4]) {
+        static constexpr uint32_t kK[4] = {0x5A827999, 0x6ED9EBA1, 0x8F1BBCDC, 0xCA62C1D6};
+        uint32x4_t wk = vaddq_u32(w[G % 4], vdupq_n_u32(kK[G / 5]));
+        uint32_t eNext = vsha1h_u32(vgetq_lane_u32(abcd, 0));
+        if constexpr (G < 5)
+            abcd = vsha1cq_u32(abcd, e, wk);        // "choose"
+        else if constexpr (G >= 10 && G < 15)
+            abcd = vsha1mq_u32(abcd, e, wk);        // "majority"
+        else
+            abcd = vsha1pq_u32(abcd, e, wk);        // "parity"
+        e = eNext;
+        if constexpr (G < 16) {
+            w[G % 4] = vsha1su1q_u32(vsha1su0q_u32(w[G % 4], w[(G+1) % 4], w[(G+2) % 4]),
+                                     w[(G+3) % 4]);
+        }
+    }
+
+
+    template <size_t... G>
+    static inline void sha1RoundsARM(uint32x4_t &abcd, uint32_t &e, uint32x4_t w[4],
+                                     std::index_sequence<G...>)
+    {
+        (sha1FourRoundsARM<G>(abcd, e, w), ...);
+    }
+
+
+    static void sha1CompressARM(uint32_t *state, const uint8_t *data, size_t nBlocks) {
+        uint32x4_t abcd = vld1q_u32(state);
+        uint32_t e = state[4];
+        for (; nBlocks > 0; --nBlocks, data += 64) {
+            uint32x4_t abcdSaved = abcd;
+            uint32_t eSaved = e;
+            uint32x4_t w[4];
+            for (int i = 0; i < 4; ++i)
+                w[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 16*i)));
+            sha1RoundsARM(abcd, e, w, std::make_index_sequence<20>());
+            abcd = vaddq_u32(abcd, abcdSaved);
+            e += eSaved;
+        }
+        vst1q_u32(state, abcd);
+        state[4] = e;
+    }
+
+
+    // Does four rounds (group G of 16) using the ARMv8 SHA-256 instructions, and computes the
+    // message words of group G+4 into w[G % 4].
+    template <size_t G>
+    static inline void sha256FourRoundsARM(uint32x4_t &abcd, uint32x4_t &efgh, uint32x4_t w[4]) {
+        uint32x4_t wk = vaddq_u32(w[G % 4], vld1q_u32(&kSHA256RoundConstants[4*G]));
+        if constexpr (G < 12)
+            w[G % 4] = vsha256su0q_u32(w[G % 4], w[(G+1) % 4]);
+        uint32x4_t abcdPrev = abcd;
+        abcd = vsha256hq_u32(abcd, efgh, wk);
+        efgh = vsha256h2q_u32(efgh, abcdPrev, wk);
+        if constexpr (G < 12)
+            w[G % 4] = vsha256su1q_u32(w[G % 4], w[(G+2) % 4], w[(G+3) % 4]);
+    }
+
+
+    template <size_t... G>
+    static inline void sha256RoundsARM(uint32x4_t &abcd, uint32x4_t &efgh, uint32x4_t w[4],
+                                       std::index_sequence<G...>)
+    {
+        (sha256FourRoundsARM<G>(abcd, efgh, w), ...);
+    }
+
+
+    static void sha256CompressARM(uint32_t *state, const uint8_t *data, size_t nBlocks) {
+        uint32x4_t abcd = vld1q_u32(&state[0]);
+        uint32x4_t efgh = vld1q_u32(&state[4]);
+        for (; nBlocks > 0; --nBlocks, data += 64) {
+            uint32x4_t abcdSaved = abcd, efghSaved = efgh;
+            uint32x4_t w[4];
+            for (int i = 0; i < 4; ++i)
+                w[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 16*i)));
+            sha256RoundsARM(abcd, efgh, w, std::make_index_sequence<16>());
+            abcd = vaddq_u32(abcd, abcdSaved);
+            efgh = vaddq_u32(efgh, efghSaved);
+        }
+        vst1q_u32(&state[0], abcd);
+        vst1q_u32(&state[4], efgh);
+    }
+
+
+    static bool cpuHasSHA1() {
+    #ifdef _MSC_VER
+        return IsProcessorFeaturePresent(PF_ARM_V8_CRYPTO_INSTRUCTIONS_AVAILABLE) != 0;
+    #elif defined(__linux__)
+        return (getauxval(AT_HWCAP) & HWCAP_SHA1) != 0;
+    #else
+        return true;    // Compiler was told to target the crypto extensions
+    #endif
+    }
+
+    static bool cpuHasSHA256() {
+    #ifdef _MSC_VER
+        return IsProcessorFeaturePresent(PF_ARM_V8_CRYPTO_INSTRUCTIONS_AVAILABLE) != 0;
+    #elif defined(__linux__)
+        return (getauxval(AT_HWCAP) & HWCAP_SHA2) != 0;
+    #else
+        return true;
+    #endif
+    }
+
+    static constexpr CompressFn kHardwareSHA1 = &sha1CompressARM;
+    static constexpr CompressFn kHardwareSHA256 = &sha256CompressARM;
+#endif // SHA_ARM
+
+
+    // Cleared by UseHardwareDigests(false), for testing.
+    static std::atomic<bool> sUseHardware {true};
+
+
+    // Returns the hardware SHA-1 function if the CPU supports it, else null.
+    static CompressFn hardwareSHA1() {
+#if defined(SHA_X86) || defined(SHA_ARM)
+        static const CompressFn sCompress = cpuHasSHA1() ? kHardwareSHA1 : nullptr;
+        return sUseHardware.load(std::memory_order_relaxed) ? sCompress : nullptr;
+#else
+        return nullptr;
+#endif
+    }
+
+
+    // Returns the hardware SHA-256 function if the CPU supports it, else null.
+    static CompressFn hardwareSHA256() {
+#if defined(SHA_X86) || defined(SHA_ARM)
+        static const CompressFn sCompress = cpuHasSHA256() ? kHardwareSHA256 : nullptr;
+        return sUseHardware.load(std::memory_order_relaxed) ? sCompress : nullptr;
+#else
+        return nullptr;
+#endif
+    }
+
+
+    // The state of a digest computed with a hardware CompressFn. SHA-1 (N=5) and SHA-256 (N=8)
+    // have the same block size and padding; only the state and the block function differ.
+    template <size_t N>
+    struct HardwareDigestContext {
+        CompressFn compress;
+        uint32_t   state[N];
+        uint8_t    buffer[64];      // Data not yet processed (less than a block)
+        uint64_t   length;          // Total length of data added
+
+        void start(CompressFn fn, const uint32_t initialState[N]) {
+            compress = fn;
+            memcpy(state, initialState, sizeof(state));
+            length = 0;
+        }
+
+        void update(const uint8_t *data, size_t size) {
+            if (size == 0)
+                return;
+            size_t buffered = length % 64;
+            length += size;
+            if (buffered > 0) {
+                size_t n = std::min(size, 64 - buffered);
+                memcpy(buffer + buffered, data, n);
+                data += n;
+                size -= n;
+                if (buffered + n < 64)
+                    return;
+                compress(state, buffer, 1);
+            }
+            compress(state, data, size / 64);
+            memcpy(buffer, data + (size & ~size_t(63)), size % 64);
+        }
+
+        void finish(uint8_t result[4*N]) {
+            uint64_t bitLength = length * 8;
+            uint8_t padding[72] = {0x80};
+            size_t padLength = 64 - ((length + 8) % 64);   // 1...64 bytes
+            for (int i = 0; i < 8; ++i)
+                padding[padLength + i] = uint8_t(bitLength >> (56 - 8*i));
+            update(padding, padLength + 8);
+            for (size_t i = 0; i < N; ++i) {
+                for (int j = 0; j < 4; ++j)
+                    result[4*i + j] = uint8_t(state[i] >> (24 - 8*j));
+            }
+        }
+    };
+#endif // USE_COMMON_CRYPTO
+
+
+#pragma mark - SHA1:
+
+
     void SHA1::computeFrom(fleece::slice s) {
         (SHA1Builder() << s).finish(&bytes, sizeof(bytes));
     }
@@ -55,9 +440,19 @@ namespace litecore {
 #ifdef USE_COMMON_CRYPTO
         static_assert(sizeof(_context) >= sizeof(CC_SHA1_CTX));
         CC_SHA1_Init(_CONTEXT);
+        _hardware = true;   // CommonCrypto uses the CPU's instructions itself
 #else
-        mbedtls_sha1_init(_CONTEXT);
-        mbedtls_sha1_starts(_CONTEXT);
+        static_assert(sizeof(_context) >= sizeof(HardwareDigestContext<5>));
+        static constexpr uint32_t kInitialState[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE,
+                                                      0x10325476, 0xC3D2E1F0};
+        auto compress = hardwareSHA1();
+        _hardware = (compress != nullptr);
+        if (_hardware) {
+            _HW_CONTEXT->start(compress, kInitialState);
+        } else {
+            mbedtls_sha1_init(_CONTEXT);
+            mbedtls_sha1_starts(_CONTEXT);
+        }
 #endif
     }
 
@@ -66,7 +461,10 @@ namespace litecore {
 #ifdef USE_COMMON_CRYPTO
         CC_SHA1_Update(_CONTEXT, s.buf, (CC_LONG)s.size);
 #else
-        mbedtls_sha1_update(_CONTEXT, (unsigned char*)s.buf, s.size);
+        if (_hardware)
+            _HW_CONTEXT->update((const uint8_t*)s.buf, s.size);
+        else
+            mbedtls_sha1_update(_CONTEXT, (unsigned char*)s.buf, s.size);
 #endif
         return *this;
     }
@@ -77,8 +475,91 @@ namespace litecore {
 #ifdef USE_COMMON_CRYPTO
         CC_SHA1_Final((uint8_t*)result, _CONTEXT);
 #else
-        mbedtls_sha1_finish(_CONTEXT, (uint8_t*)result);
-        mbedtls_sha1_free(_CONTEXT);
+        if (_hardware) {
+            _HW_CONTEXT->finish((uint8_t*)result);
+        } else {
+            mbedtls_sha1_finish(_CONTEXT, (uint8_t*)result);
+            mbedtls_sha1_free(_CONTEXT);
+        }
+#endif
+    }
+
+
+    bool SHA1::hardwareAccelerated() {
+#ifdef USE_COMMON_CRYPTO
+        return true;    // CommonCrypto takes care of it
+#else
+        return hardwareSHA1() != nullptr;
+#endif
+    }
+
+
+#pragma mark - SHA256:
+
+
+    SHA256Builder::SHA256Builder() {
+        static_assert(sizeof(_context) >= sizeof(mbedtls_sha256_context));
+#ifdef USE_COMMON_CRYPTO
+        static_assert(sizeof(_context) >= sizeof(CC_SHA256_CTX));
+        CC_SHA256_Init(_CONTEXT256);
+        _hardware = true;
+#else
+        static_assert(sizeof(_context) >= sizeof(HardwareDigestContext<8>));
+        static constexpr uint32_t kInitialState[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372,
+                                                      0xa54ff53a, 0x510e527f, 0x9b05688c,
+                                                      0x1f83d9ab, 0x5be0cd19};
+        auto compress = hardwareSHA256();
+        _hardware = (compress != nullptr);
+        if (_hardware) {
+            _HW_CONTEXT256->start(compress, kInitialState);
+        } else {
+            mbedtls_sha256_init(_CONTEXT256);
+            mbedtls_sha256_starts(_CONTEXT256, 0);
+        }
+#endif
+    }
+
+
+    SHA256Builder& SHA256Builder::operator<< (fleece::slice s) {
+#ifdef USE_COMMON_CRYPTO
+        CC_SHA256_Update(_CONTEXT256, s.buf, (CC_LONG)s.size);
+#else
+        if (_hardware)
+            _HW_CONTEXT256->update((const uint8_t*)s.buf, s.size);
+        else
+            mbedtls_sha256_update(_CONTEXT256, (unsigned char*)s.buf, s.size);
+#endif
+        return *this;
+    }
+
+
+    void SHA256Builder::finish(void *result, size_t resultSize) {
+        DebugAssert(resultSize == kDigestSize);
+#ifdef USE_COMMON_CRYPTO
+        CC_SHA256_Final((uint8_t*)result, _CONTEXT256);
+#else
+        if (_hardware) {
+            _HW_CONTEXT256->finish((uint8_t*)result);
+        } else {
+            mbedtls_sha256_finish(_CONTEXT256, (uint8_t*)result);
+            mbedtls_sha256_free(_CONTEXT256);
+        }
+#endif
+    }
+
+
+    bool SHA256Builder::hardwareAccelerated() {
+#ifdef USE_COMMON_CRYPTO
+        return true;
+#else
+        return hardwareSHA256() != nullptr;
+#endif
+    }
+
+
+    void UseHardwareDigests(bool use) {
+#ifndef USE_COMMON_CRYPTO
+        sUseHardware = use;
 #endif
     }
 
@@ -35,6 +35,10 @@ namespace litecore {
         /// Stores a digest; returns false if slice is the wrong size
         bool setDigest(fleece::slice);
 
+        /// True if digests are computed with the CPU's SHA instructions (x86 SHA-NI or ARMv8
+        /// crypto extensions), false if in software.
+        static bool hardwareAccelerated();
+
         /// The digest as a slice
         operator fleece::slice() const        {return {bytes, sizeof(bytes)};}
 
@@ -70,10 +74,41 @@ namespace litecore {
         }
 
     private:
-        uint8_t _context[100];  // big enough to hold any platform's context struct
+        alignas(8) uint8_t _context[112];  // big enough to hold any platform's context struct
+        bool _hardware;                     // true if using the CPU's SHA instructions
+    };
+
+
+    /// Builder for creating SHA-256 digests from piece-by-piece data.
+    class SHA256Builder {
+    public:
+        static constexpr size_t kDigestSize = 32;
+
+        SHA256Builder();
+
+        /// Add data
+        SHA256Builder& operator<< (fleece::slice s);
+
+        /// Add a single byte
+        SHA256Builder& operator<< (uint8_t b)   {return *this << fleece::slice(&b, 1);}
+
+        /// Finish and write the digest to `result`. (Don't reuse the builder.)
+        void finish(void *result, size_t resultSize);
+
+        /// True if digests are computed with the CPU's SHA instructions, false if in software.
+        static bool hardwareAccelerated();
+
+    private:
+        alignas(8) uint8_t _context[128];  // big enough to hold any platform's context struct
+        bool _hardware;
     };
 
 
+    /// For testing: if `use` is false, builders created afterwards compute digests in software
+    /// even if the CPU has SHA instructions, so the two can be compared.
+    void UseHardwareDigests(bool use);
+
+
 }
 
 
@@ -0,0 +1,102 @@
+//
+// SecureDigestTest.cc
+//
+// Copyright (c) 2020 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "SecureDigest.hh"
+#include "SecureSymmetricCrypto.hh"
+#include "LiteCoreTest.hh"
+#include <random>
+
+using namespace litecore;
+using namespace std;
+using namespace fleece;
+
+
+// Digests `data`, adding it to the builder in pieces of random (mostly odd) sizes.
+template <class BUILDER, size_t SIZE>
+static string digestInPieces(slice data, mt19937 &rng) {
+    BUILDER builder;
+    while (data.size > 0) {
+        size_t n = min(data.size, size_t((rng() % 3 == 0) ? rng() % 200 : rng() % 70));
+        builder << slice(data.buf, n);
+        data.moveStart(n);
+    }
+    uint8_t digest[SIZE];
+    builder.finish(digest, SIZE);
+    return slice(digest, SIZE).hexString();
+}
+
+
+static string sha256(slice data) {
+    uint8_t digest[SHA256Builder::kDigestSize];
+    (SHA256Builder() << data).finish(digest, sizeof(digest));
+    return slice(digest, sizeof(digest)).hexString();
+}
+
+
+TEST_CASE("SHA-256 test vectors", "[Crypto]") {
+    // From FIPS 180-2:
+    CHECK(sha256(""_sl) == "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    CHECK(sha256("abc"_sl) == "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    CHECK(sha256("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"_sl)
+          == "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+    CHECK(sha256(slice(string(1000000, 'a')))
+          == "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+}
+
+
+TEST_CASE("HMAC-SHA256 test vectors", "[Crypto]") {
+    // From RFC 4231, test cases 2 and 6:
+    uint8_t digest[kHMACSHA256Size];
+    HMAC_SHA256("Jefe"_sl, {"what do ya want "_sl, "for nothing?"_sl}, digest);
+    CHECK(slice(digest, sizeof(digest)).hexString()
+          == "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843");
+
+    string longKey(131, '\xaa');
+    HMAC_SHA256(slice(longKey), {"Test Using Larger Than Block-Size Key - Hash Key First"_sl},
+                digest);
+    CHECK(slice(digest, sizeof(digest)).hexString()
+          == "60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54");
+}
+
+
+TEST_CASE("Hardware digests match software", "[Crypto]") {
+    if (!SHA1::hardwareAccelerated() && !SHA256Builder::hardwareAccelerated())
+        return;     // Nothing to compare
+    mt19937 rng(1);
+    string data(300000, '\0');
+    for (auto &c : data)
+        c = char(rng());
+
+    for (int i = 0; i < 1000; ++i) {
+        // Every length up to a few blocks, then random ones:
+        size_t size = (i < 200) ? i : rng() % ((i < 900) ? 5000 : data.size());
+        slice input(data.data(), size);
+        auto seed = rng();
+
+        UseHardwareDigests(true);
+        mt19937 rng1(seed);
+        string sha1 = digestInPieces<SHA1Builder, 20>(input, rng1);
+        string sha256 = digestInPieces<SHA256Builder, 32>(input, rng1);
+
+        UseHardwareDigests(false);
+        mt19937 rng2(seed);
+        CHECK(digestInPieces<SHA1Builder, 20>(input, rng2) == sha1);
+        CHECK(digestInPieces<SHA256Builder, 32>(input, rng2) == sha256);
+    }
+    UseHardwareDigests(true);
+}
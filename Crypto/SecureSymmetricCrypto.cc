@@ -24,8 +24,10 @@
     #include <MacTypes.h>
     #include <CommonCrypto/CommonCrypto.h>
 #else
+    #include "SecureDigest.hh"
     #include "mbedtls/cipher.h"
     #include "mbedtls/pkcs5.h"
+    #include "mbedtls/platform_util.h"
 #endif
 
 
@@ -67,6 +69,42 @@ namespace litecore {
     }
 
 
+    void AES256CTR(slice key,
+                   slice iv,
+                   slice dst,
+                   slice src)
+    {
+        DebugAssert(key.size == kCCKeySizeAES256);
+        DebugAssert(iv.size == kCCBlockSizeAES128, "IV is wrong size");
+        DebugAssert(dst.size >= src.size);
+        CCCryptorRef cryptor;
+        CCCryptorStatus status = CCCryptorCreateWithMode(kCCEncrypt, kCCModeCTR, kCCAlgorithmAES,
+                                                         ccNoPadding, iv.buf,
+                                                         key.buf, key.size,
+                                                         nullptr, 0, 0, kCCModeOptionCTR_BE,
+                                                         &cryptor);
+        if (status == kCCSuccess) {
+            size_t outSize;
+            status = CCCryptorUpdate(cryptor, src.buf, src.size, (void*)dst.buf, dst.size, &outSize);
+            CCCryptorRelease(cryptor);
+        }
+        if (status != kCCSuccess)
+            error::_throw(error::CryptoError);
+    }
+
+
+    void HMAC_SHA256(slice key,
+                     std::initializer_list<slice> data,
+                     void *outDigest)
+    {
+        CCHmacContext ctx;
+        CCHmacInit(&ctx, kCCHmacAlgSHA256, key.buf, key.size);
+        for (slice s : data)
+            CCHmacUpdate(&ctx, s.buf, s.size);
+        CCHmacFinal(&ctx, outDigest);
+    }
+
+
     bool DeriveKeyFromPassword(slice password,
                                void *outKey,
                                size_t keyLength)
@@ -133,6 +171,53 @@ namespace litecore {
     }
 
 
+    void AES256CTR(slice key,
+                   slice iv,
+                   slice dst,
+                   slice src)
+    {
+        DebugAssert(dst.size >= src.size);
+        // (CTR mode runs the cipher forwards to decrypt too, hence `encrypt` is always true.)
+        size_t outSize = AES(kAES256KeySize, MBEDTLS_CIPHER_AES_256_CTR, true, key, iv, false,
+                             dst, src);
+        if (outSize != src.size)
+            error::_throw(error::CryptoError);
+    }
+
+
+    void HMAC_SHA256(slice key,
+                     std::initializer_list<slice> data,
+                     void *outDigest)
+    {
+        // HMAC(K, m) = H((K ^ opad) || H((K ^ ipad) || m)), with K padded to the block size, or
+        // first hashed if it's longer. This uses SHA256Builder instead of mbedTLS's HMAC, so
+        // that it gets the CPU's SHA instructions where there are any.
+        constexpr size_t kBlockSize = 64;
+        uint8_t paddedKey[kBlockSize] = {};
+        if (key.size > kBlockSize)
+            (SHA256Builder() << key).finish(paddedKey, SHA256Builder::kDigestSize);
+        else
+            memcpy(paddedKey, key.buf, key.size);
+
+        uint8_t pad[kBlockSize];
+        for (size_t i = 0; i < kBlockSize; ++i)
+            pad[i] = paddedKey[i] ^ 0x36;
+        SHA256Builder inner;
+        inner << slice(pad, kBlockSize);
+        for (slice s : data)
+            inner << s;
+        uint8_t innerDigest[SHA256Builder::kDigestSize];
+        inner.finish(innerDigest, sizeof(innerDigest));
+
+        for (size_t i = 0; i < kBlockSize; ++i)
+            pad[i] = paddedKey[i] ^ 0x5c;
+        (SHA256Builder() << slice(pad, kBlockSize) << slice(innerDigest, sizeof(innerDigest)))
+            .finish(outDigest, kHMACSHA256Size);
+        mbedtls_platform_zeroize(paddedKey, sizeof(paddedKey));
+        mbedtls_platform_zeroize(pad, sizeof(pad));
+    }
+
+
     bool DeriveKeyFromPassword(slice password,
                                void *outKey,
                                size_t keyLength)
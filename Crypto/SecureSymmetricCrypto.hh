@@ -18,6 +18,7 @@
 
 #pragma once
 #include "Base.hh"
+#include <initializer_list>
 
 namespace litecore {
 
@@ -33,6 +34,22 @@ namespace litecore {
                   slice dst,           // output buffer & capacity
                   slice src);          // input data
 
+    /** AES256 in CTR mode. `iv` is the 16-byte initial counter block, which is incremented as a
+        big-endian number. Encryption and decryption are the same operation.
+        `dst` must be at least as large as `src`. */
+    void AES256CTR(slice key,
+                   slice iv,
+                   slice dst,
+                   slice src);
+
+    static const size_t kHMACSHA256Size = 32;
+
+    /** Computes the HMAC-SHA256 of the concatenation of the `data` slices, writing
+        kHMACSHA256Size bytes to `outDigest`. */
+    void HMAC_SHA256(slice key,
+                     std::initializer_list<slice> data,
+                     void *outDigest);
+
     /** Converts a password string into a key using PBKDF2. */
     bool DeriveKeyFromPassword(slice password,
                                void *outKey,
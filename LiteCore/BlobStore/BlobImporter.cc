@@ -0,0 +1,211 @@
+//
+// BlobImporter.cc
+//
+// Copyright (c) 2020 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "BlobImporter.hh"
+#include "Error.hh"
+#include "Logging.hh"
+#include <condition_variable>
+#include <deque>
+#include <errno.h>
+
+namespace litecore {
+    using namespace std;
+    using namespace fleece;
+
+    extern LogDomain BlobLog;
+
+
+    // One stage of the import pipeline: a thread that passes each chunk it's given to a function,
+    // in order. If the function throws, the stage drops the remaining chunks and stops.
+    class BlobImporter::Stage {
+    public:
+        explicit Stage(function<void(slice)> fn)
+        :_fn(move(fn))
+        ,_thread([this]{run();})
+        { }
+
+        ~Stage() {
+            if (_thread.joinable()) {
+                stopThread(true);
+            }
+        }
+
+        // Queues a chunk, first waiting until the queue has room. Returns false if the stage
+        // has failed, in which case there's no point sending it any more.
+        bool push(alloc_slice chunk) {
+            unique_lock<mutex> lock(_mutex);
+            _cond.wait(lock, [&]{return _queue.size() < kMaxQueuedChunks || _exception;});
+            if (_exception)
+                return false;
+            _queue.push_back(move(chunk));
+            _cond.notify_all();
+            return true;
+        }
+
+        // Waits for the thread to finish (after handling the queued chunks, unless `discard` is
+        // true), then rethrows the exception that stopped it, if any.
+        void finish(bool discard) {
+            stopThread(discard);
+            if (_exception)
+                rethrow_exception(_exception);
+        }
+
+    private:
+        void run() {
+            while (true) {
+                alloc_slice chunk;
+                {
+                    unique_lock<mutex> lock(_mutex);
+                    _cond.wait(lock, [&]{return !_queue.empty() || _finishing;});
+                    if (_queue.empty())
+                        return;
+                    chunk = move(_queue.front());
+                    _queue.pop_front();
+                    _cond.notify_all();
+                }
+                try {
+                    _fn(chunk);
+                } catch (...) {
+                    unique_lock<mutex> lock(_mutex);
+                    _exception = current_exception();
+                    _queue.clear();
+                    _cond.notify_all();
+                    return;
+                }
+            }
+        }
+
+        void stopThread(bool discard) {
+            {
+                unique_lock<mutex> lock(_mutex);
+                if (discard)
+                    _queue.clear();
+                _finishing = true;
+                _cond.notify_all();
+            }
+            _thread.join();
+        }
+
+        function<void(slice)>   _fn;
+        mutex                   _mutex;
+        condition_variable      _cond;
+        deque<alloc_slice>      _queue;
+        exception_ptr           _exception;
+        bool                    _finishing {false};
+        thread                  _thread;            // Declared last, as it starts running at once
+    };
+
+
+    BlobImporter::BlobImporter(BlobStore &store, const FilePath &source,
+                               ProgressCallback progress, CompletionCallback completion)
+    :_store(store)
+    ,_source(source)
+    ,_progress(move(progress))
+    ,_completion(move(completion))
+    { }
+
+
+    BlobImporter::~BlobImporter() {
+        if (_thread.joinable()) {
+            // Only happens if the last reference was released by my own thread (see `start`):
+            _thread.detach();
+        }
+    }
+
+
+    void BlobImporter::start() {
+        Assert(!_thread.joinable());
+        retain(this);   // The thread keeps me alive till it exits
+        _thread = thread([this] {
+            run();
+            release(this);
+        });
+    }
+
+
+    void BlobImporter::stop() {
+        cancel();
+        {
+            lock_guard<recursive_mutex> lock(_callbackMutex);
+            _callbacksEnabled = false;
+        }
+        if (_thread.joinable() && _thread.get_id() != this_thread::get_id())
+            _thread.join();
+    }
+
+
+    void BlobImporter::run() {
+        try {
+            blobKey key = import();
+            finished(&key, nullptr);
+        } catch (const std::exception &x) {
+            finished(nullptr, &x);
+        }
+    }
+
+
+    blobKey BlobImporter::import() {
+        LogTo(BlobLog, "Importing %s ...", _source.path().c_str());
+        FileReadStream input(_source);
+        uint64_t totalBytes = input.getLength();
+        BlobWriteStream output(_store);
+        {
+            // The hasher and writer stages each see every chunk, and touch disjoint parts of the
+            // BlobWriteStream, so they can run at the same time:
+            Stage hasher([&](slice chunk) {
+                output._sha1ctx << chunk;
+            });
+            Stage writer([&](slice chunk) {
+                output._writer->write(chunk);
+                output._bytesWritten += chunk.size;
+                lock_guard<recursive_mutex> lock(_callbackMutex);
+                if (_progress && _callbacksEnabled)
+                    _progress(output._bytesWritten, totalBytes);
+            });
+
+            while (!_cancelled) {
+                alloc_slice chunk(kChunkSize);
+                size_t bytesRead = input.read((void*)chunk.buf, chunk.size);
+                if (bytesRead == 0)
+                    break;
+                chunk.shorten(bytesRead);
+                if (!hasher.push(chunk) || !writer.push(chunk))
+                    break;
+            }
+            hasher.finish(_cancelled);
+            writer.finish(_cancelled);
+        }
+        if (_cancelled)
+            error::_throw(error::POSIX, ECANCELED);
+        Blob blob = output.install();
+        LogTo(BlobLog, "Imported %s as %s (%llu bytes)", _source.path().c_str(),
+              blob.key().base64String().c_str(), (unsigned long long)output.bytesWritten());
+        return blob.key();
+    }
+
+
+    void BlobImporter::finished(const blobKey *key, const std::exception *x) {
+        if (x)
+            LogTo(BlobLog, "Import of %s failed: %s", _source.path().c_str(), x->what());
+        lock_guard<recursive_mutex> lock(_callbackMutex);
+        if (_completion && _callbacksEnabled)
+            _completion(key, x);
+        _callbacksEnabled = false;
+    }
+
+}
@@ -0,0 +1,85 @@
+//
+// BlobImporter.hh
+//
+// Copyright (c) 2020 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "BlobStore.hh"
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace litecore {
+
+    /** Imports a file into a BlobStore in the background, so the caller isn't blocked while a
+        large file is digested, encrypted and copied.
+
+        The file is read in large chunks, which flow through a pipeline of three threads: while
+        one chunk is being read, the previous ones are being digested on another thread, and
+        encrypted (if the store is) and written to the blob's temporary file on a third. At most
+        a few chunks are in flight at once, so memory use is bounded however big the file is.
+
+        Progress and completion are reported through callbacks on the import's threads. */
+    class BlobImporter : public RefCounted {
+    public:
+        /** Called after each chunk has been written to the blob's temporary file. */
+        using ProgressCallback = std::function<void(uint64_t bytesImported, uint64_t totalBytes)>;
+
+        /** Called once when the import ends: with the new blob's key if it succeeded, or else
+            with the exception that stopped it. (If it was cancelled, that's an `error` with
+            domain POSIX and code ECANCELED.) */
+        using CompletionCallback = std::function<void(const blobKey*, const std::exception*)>;
+
+        static constexpr size_t kChunkSize = 1024 * 1024;   // Size of reads from the source file
+        static constexpr size_t kMaxQueuedChunks = 4;       // Max chunks waiting for each stage
+
+        BlobImporter(BlobStore&, const FilePath &source, ProgressCallback, CompletionCallback);
+
+        /** Starts the import. */
+        void start();
+
+        /** Makes a running import stop as soon as possible, without installing the blob. */
+        void cancel()                                       {_cancelled = true;}
+
+        /** Cancels the import if it's running, waits for its threads to finish, and ensures that
+            no more callbacks are made. Must be called before the BlobStore is freed.
+            May be called from the completion callback, but not the progress callback (which can
+            call `cancel` instead.) */
+        void stop();
+
+    protected:
+        ~BlobImporter();
+
+    private:
+        class Stage;
+
+        void run();
+        blobKey import();
+        void finished(const blobKey*, const std::exception*);
+
+        BlobStore& _store;
+        FilePath const _source;
+        ProgressCallback _progress;
+        CompletionCallback _completion;
+        std::thread _thread;
+        std::atomic<bool> _cancelled {false};
+        std::recursive_mutex _callbackMutex;        // Held while calling callbacks
+        bool _callbacksEnabled {true};
+    };
+
+}
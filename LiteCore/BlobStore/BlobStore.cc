@@ -17,6 +17,7 @@
 //.
 
 #include "BlobStore.hh"
+#include "ChunkedBlob.hh"
 #include "FilePath.hh"
 #include "Error.hh"
 #include "EncryptedStream.hh"
@@ -24,7 +25,10 @@
 #include "StringUtil.hh"
 #include <stdint.h>
 #include <stdio.h>
+#include <time.h>
 #include <algorithm>
+#include <mutex>
+#include <unordered_set>
 
 namespace litecore {
     using namespace std;
@@ -99,60 +103,176 @@ namespace litecore {
     
     
     Blob::Blob(const BlobStore &store, const blobKey &key)
-    :_path(store.dir(), key.filename()),
+    :_path(store.blobPath(key)),
      _key(key),
      _store(store)
     { }
 
 
+    bool Blob::exists() const {
+        return _path.exists() || isChunked();
+    }
+
+
+    bool Blob::isChunked() const {
+        return _store.chunkStore() && _store.manifestPath(_key).exists();
+    }
+
+
+    void Blob::del() {
+        _path.del();
+        if (_store.chunkStore())
+            _store.manifestPath(_key).del();    // (its chunks are deleted by deleteAllExcept or deleteBlobs)
+    }
+
+
     int64_t Blob::contentLength() const {
         int64_t length = path().dataSize();
-        if (length >= 0 && _store.options().encryptionAlgorithm != kNoEncryption)
-            length -= EncryptedReadStream::kFileSizeOverhead;
+        if (length < 0 && isChunked())
+            return ChunkedBlobReader::readLength(*_store.openFile(_store.manifestPath(_key)));
+        auto &options = _store.options();
+        if (length >= 0 && options.encryptionAlgorithm != kNoEncryption) {
+            // A version 2 file's header tells its exact length; a version 1 file can only be
+            // estimated without decrypting its last block.
+            EncryptedReadStreamV2 v2(make_shared<FileReadStream>(_path),
+                                     options.encryptionAlgorithm, options.encryptionKey);
+            if (v2.readHeader())
+                length = v2.getLength();
+            else
+                length -= EncryptedReadStream::kFileSizeOverhead;
+        }
         return length;
     }
 
 
 
     unique_ptr<SeekableReadStream> Blob::read() const {
-        SeekableReadStream *reader = new FileReadStream(_path);
-        auto &options = _store.options();
-        if (options.encryptionAlgorithm != kNoEncryption) {
-            reader = new EncryptedReadStream(shared_ptr<SeekableReadStream>(reader),
-                                             options.encryptionAlgorithm,
-                                             options.encryptionKey);
+        if (_store.chunkStore() && !_path.exists() && isChunked())
+            return make_unique<ChunkedBlobReader>(*_store.chunkStore(),
+                                                  _store.openFile(_store.manifestPath(_key)));
+        return _store.openFile(_path);
+    }
+
+
+    unique_ptr<SeekableReadStream> BlobStore::openFile(const FilePath &path) const {
+        auto reader = make_unique<FileReadStream>(path);
+        if (_options.encryptionAlgorithm != kNoEncryption) {
+            // Blobs written before the version 2 format was adopted are still readable:
+            return NewEncryptedReadStream(shared_ptr<SeekableReadStream>(move(reader)),
+                                          _options.encryptionAlgorithm,
+                                          _options.encryptionKey);
         }
-        return unique_ptr<SeekableReadStream>{reader};
+        return reader;
     }
 
 
 #pragma mark - BLOB WRITING:
 
 
+    // Paths of temporary and partial blob files currently open for writing. This keeps two
+    // streams (perhaps from different BlobStore instances on the same directory) from appending
+    // to the same partial file, and keeps compaction from deleting any of them.
+    static mutex sOpenFilesMutex;
+    static unordered_set<string> sOpenFiles;
+
+
     BlobWriteStream::BlobWriteStream(BlobStore &store)
     :_store(store)
     {
+        openTempFile();
+    }
+
+
+    BlobWriteStream::BlobWriteStream(BlobStore &store, const blobKey &expectedKey)
+    :_store(store)
+    {
+        if (!store.isEncrypted() && !store.isChunked()) {
+            FilePath partialPath = store.partialBlobPath(expectedKey);
+            lock_guard<mutex> lock(sOpenFilesMutex);
+            _partial = sOpenFiles.insert(partialPath.path()).second;
+            if (_partial)
+                _tmpPath = partialPath;
+        }
+        if (!_partial) {
+            openTempFile();
+            return;
+        }
+
+        try {
+            if (_tmpPath.exists()) {
+                // Digest the data left by the previous stream, so the key can be checked at the end:
+                FileReadStream existing(_tmpPath);
+                uint8_t buffer[32768];
+                size_t bytesRead;
+                while ((bytesRead = existing.read(buffer, sizeof(buffer))) > 0) {
+                    _sha1ctx << slice(buffer, bytesRead);
+                    _bytesWritten += bytesRead;
+                }
+                if (_bytesWritten > 0)
+                    LogTo(BlobLog, "Resuming partial blob %s at offset %llu",
+                          expectedKey.base64String().c_str(), (unsigned long long)_bytesWritten);
+            }
+            _writer = make_shared<FileWriteStream>(_tmpPath, "ab");
+        } catch (...) {
+            releasePartialFile();
+            throw;
+        }
+    }
+
+
+    void BlobWriteStream::openTempFile() {
         FILE *file;
-        _tmpPath = store.dir()["incoming_"].mkTempFile(&file);
+        {
+            // Create and register the file together, so compaction can't find it unregistered:
+            lock_guard<mutex> lock(sOpenFilesMutex);
+            _tmpPath = _store.dir()["incoming_"].mkTempFile(&file);
+            sOpenFiles.insert(_tmpPath.path());
+        }
         _writer = shared_ptr<WriteStream> {new FileWriteStream(file)};
         auto &options = _store.options();
         if (options.encryptionAlgorithm != kNoEncryption) {
-            _writer = make_shared<EncryptedWriteStream>(_writer,
-                                                        options.encryptionAlgorithm,
-                                                        options.encryptionKey);
+            _writer = make_shared<EncryptedWriteStreamV2>(_writer,
+                                                          options.encryptionAlgorithm,
+                                                          options.encryptionKey);
+        }
+        if (_store.isChunked()) {
+            // The data goes to the chunk store, and the temp file gets the manifest:
+            _chunker = make_shared<ChunkedBlobWriter>(*_store.chunkStore(), _writer);
+            _writer = _chunker;
+        }
+    }
+
+
+    void BlobWriteStream::releasePartialFile() noexcept {
+        if (_partial) {
+            lock_guard<mutex> lock(sOpenFilesMutex);
+            sOpenFiles.erase(_tmpPath.path());
+            _partial = false;
         }
     }
 
 
     BlobWriteStream::~BlobWriteStream() {
-        if (!_installed) {
+        if (_partial) {
+            // Keep the partial file for a later stream to resume, unless it was installed:
             try {
-                _tmpPath.del();
+                close();
             } catch (...) {
-                // destructor is not allowed to throw exceptions
-                Warn("BlobWriteStream: unable to delete temporary file %s",
-                     _tmpPath.path().c_str());
+                Warn("BlobWriteStream: error closing partial file %s", _tmpPath.path().c_str());
             }
+            releasePartialFile();
+        } else {
+            if (!_installed) {
+                try {
+                    _tmpPath.del();
+                } catch (...) {
+                    // destructor is not allowed to throw exceptions
+                    Warn("BlobWriteStream: unable to delete temporary file %s",
+                         _tmpPath.path().c_str());
+                }
+            }
+            lock_guard<mutex> lock(sOpenFilesMutex);
+            sOpenFiles.erase(_tmpPath.path());
         }
     }
 
@@ -183,12 +303,19 @@ namespace litecore {
     Blob BlobWriteStream::install(const blobKey *expectedKey) {
         close();
         auto key = computeKey();
-        if (expectedKey && *expectedKey != key)
+        if (expectedKey && *expectedKey != key) {
+            if (_partial)
+                _tmpPath.del();     // Partial data is bad, so don't resume from it
             error::_throw(error::CorruptData);
+        }
         Blob blob(_store, key);
-        if(!blob.path().exists()) {
+        if(!blob.exists()) {
             _tmpPath.setReadOnly(true);
-            _tmpPath.moveTo(blob.path());
+            blob.path().dir().mkdir();      // Create its subdirectory if necessary
+            if (_chunker && _chunker->isChunked())
+                _tmpPath.moveTo(_store.manifestPath(key));
+            else
+                _tmpPath.moveTo(blob.path());
         } else {
             // If the destination already exists, then this blob
             // already exists and doesn't need to be written again
@@ -204,12 +331,78 @@ namespace litecore {
     
 #pragma mark - DELETING:
     
+    static const string kManifestSuffix = ".manifest";
+
+    // Paths of blob files protected from deletion. Like sOpenFiles, this is shared by all
+    // BlobStore instances, since several may be open on the same directory.
+    static mutex sProtectedBlobsMutex;
+    static unordered_multiset<string> sProtectedBlobs;
+
+
+    void BlobStore::protect(const blobKey &key) {
+        lock_guard<mutex> lock(sProtectedBlobsMutex);
+        sProtectedBlobs.insert(blobPath(key).path());
+    }
+
+
+    void BlobStore::unprotect(const blobKey &key) noexcept {
+        lock_guard<mutex> lock(sProtectedBlobsMutex);
+        auto i = sProtectedBlobs.find(blobPath(key).path());
+        if (i != sProtectedBlobs.end())
+            sProtectedBlobs.erase(i);
+    }
+
+
     void BlobStore::deleteAllExcept(const unordered_set<string> &inUse) {
-        _dir.forEachFile([&inUse](const FilePath &path) {
-            if(find(inUse.cbegin(), inUse.cend(), path.fileName()) == inUse.cend()) {
-                path.del();
+        unordered_set<string> chunksInUse;
+        forEachBlobFile([&](const FilePath &path) {
+            string name = path.fileName();
+            bool manifest = hasSuffix(name, kManifestSuffix);
+            if (manifest)
+                name.resize(name.size() - kManifestSuffix.size());
+            if (inUse.count(name) == 0) {
+                // Don't delete files being written, or protected blobs. Checking and deleting under
+                // the locks keeps a writer from protecting the blob, and deciding it exists, in
+                // between:
+                lock_guard<mutex> lock(sOpenFilesMutex);
+                lock_guard<mutex> lock2(sProtectedBlobsMutex);
+                if (sOpenFiles.count(path.path()) == 0 && sProtectedBlobs.count(path.path()) == 0)
+                    path.del();
+            } else if (manifest && _chunkStore) {
+                ChunkedBlobReader reader(*_chunkStore, openFile(path));
+                for (auto &chunk : reader.chunks())
+                    chunksInUse.insert(chunk.key.filename());
+            }
+        });
+        // Then delete the chunks no remaining blob uses:
+        if (_chunkStore)
+            _chunkStore->deleteAllExcept(chunksInUse);
+    }
+
+
+    void BlobStore::deleteBlobs(const vector<blobKey> &keys) {
+        bool deletedManifest = false;
+        for (auto &key : keys) {
+            blobPath(key).del();
+            if (_chunkStore && manifestPath(key).del())
+                deletedManifest = true;
+        }
+        // Chunks have no reference counts, so find the ones remaining manifests still use:
+        if (deletedManifest)
+            deleteUnusedChunks();
+    }
+
+
+    void BlobStore::deleteUnusedChunks() {
+        unordered_set<string> chunksInUse;
+        forEachBlobFile([&](const FilePath &path) {
+            if (hasSuffix(path.fileName(), kManifestSuffix)) {
+                ChunkedBlobReader reader(*_chunkStore, openFile(path));
+                for (auto &chunk : reader.chunks())
+                    chunksInUse.insert(chunk.key.filename());
             }
         });
+        _chunkStore->deleteAllExcept(chunksInUse);
     }
 
 
@@ -230,6 +423,20 @@ namespace litecore {
                 error::_throw(error::NotFound);
             _dir.mkdir();
         }
+        openLayout();
+        openChunkStore();
+    }
+
+
+    void BlobStore::openChunkStore() {
+        FilePath chunkDir = _dir.subdirectoryNamed("chunks");
+        _chunkStore.reset();
+        if (chunkDir.exists() || (_options.chunked && _options.writeable)) {
+            Options chunkOptions = _options;
+            chunkOptions.create = _options.writeable;
+            chunkOptions.chunked = false;
+            _chunkStore = make_unique<BlobStore>(chunkDir, &chunkOptions);
+        }
     }
 
 
@@ -240,10 +447,174 @@ namespace litecore {
     }
 
 
+#pragma mark - LAYOUT:
+
+
+    // Layout version 1 (no "layout" file) has all blob files in the top directory;
+    // version 2 has them in subdirectories.
+    static const string kLayoutFileName = "layout";
+    static constexpr int kShardedLayoutVersion = 2;
+
+
+    static bool isBlobFileName(const string &name) {
+        return hasSuffix(name, ".blob") || hasSuffix(name, kManifestSuffix);
+    }
+
+
+    void BlobStore::openLayout() {
+        FilePath layoutFile = _dir[kLayoutFileName];
+        if (layoutFile.exists()) {
+            alloc_slice contents = FileReadStream(layoutFile).readAll();
+            int version = atoi(string(contents).c_str());
+            if (version > kShardedLayoutVersion)
+                error::_throw(error::DatabaseTooNew, "Unknown blob store layout version %d",
+                              version);
+            _sharded = (version == kShardedLayoutVersion);
+        }
+        if (!_sharded && _options.writeable) {
+            migrateToShards();
+            FileWriteStream out(layoutFile, "wb");
+            out.write(slice(to_string(kShardedLayoutVersion)));
+            out.close();
+            _sharded = true;
+        }
+    }
+
+
+    static string shardName(unsigned index) {
+        static const char kHexDigits[] = "0123456789abcdef";
+        return {kHexDigits[index >> 4], kHexDigits[index & 0xF]};
+    }
+
+
+    static string shardName(const blobKey &key) {
+        return shardName(((const uint8_t*)slice(key).buf)[0]);
+    }
+
+
+    // Moves blob files from the top directory into their subdirectories.
+    void BlobStore::migrateToShards() {
+        uint64_t total = 0, moved;
+        do {
+            // Files are moved while the directory is being read, which may make it skip some;
+            // so repeat until there are none left.
+            moved = 0;
+            _dir.forEachFile([&](const FilePath &path) {
+                string name = path.fileName();
+                if (path.isDir() || !isBlobFileName(name))
+                    return;
+                string keyName = name;
+                if (hasSuffix(keyName, kManifestSuffix))
+                    keyName.resize(keyName.size() - kManifestSuffix.size());
+                blobKey key;
+                if (!key.readFromFilename(keyName))
+                    return;
+                FilePath shard = _dir.subdirectoryNamed(shardName(key));
+                shard.mkdir();
+                path.moveTo(shard[name]);
+                ++moved;
+            });
+            total += moved;
+        } while (moved > 0);
+        if (total > 0)
+            LogTo(BlobLog, "Moved %llu blob files in %s into subdirectories",
+                  (unsigned long long)total, _dir.path().c_str());
+    }
+
+
+    FilePath BlobStore::shardDir(const blobKey &key) const {
+        return _sharded ? _dir.subdirectoryNamed(shardName(key)) : _dir;
+    }
+
+
+    // Calls `fn` on each file in the top directory and, if sharded, in each subdirectory.
+    // (Not on directories, nor on the layout file.)
+    void BlobStore::forEachBlobFile(function_ref<void(const FilePath&)> fn) const {
+        auto eachFile = [&](const FilePath &dir) {
+            dir.forEachFile([&](const FilePath &path) {
+                if (!path.isDir() && path.fileName() != kLayoutFileName)
+                    fn(path);
+            });
+        };
+        eachFile(_dir);
+        if (_sharded) {
+            for (unsigned i = 0; i < 256; ++i) {
+                FilePath shard = _dir.subdirectoryNamed(shardName(i));
+                if (shard.exists())
+                    eachFile(shard);
+            }
+        }
+    }
+
+
+    // Adds the number of blobs in a directory, and the total size of its files, to the totals.
+    static void scanDir(const FilePath &dir, uint64_t &count, uint64_t &size) {
+        dir.forEachFile([&](const FilePath &path) {
+            if (path.isDir() || path.fileName() == kLayoutFileName)
+                return;
+            if (isBlobFileName(path.fileName()))
+                ++count;
+            size += max(path.dataSize(), int64_t(0));
+        });
+    }
+
+
+    void BlobStore::getStats(uint64_t &count, uint64_t &size) const {
+        count = size = 0;
+        // The top directory has only temporary & partial files, whose sizes change, and the
+        // subdirectories; it's not worth caching.
+        scanDir(_dir, count, size);
+        if (!_sharded)
+            return;
+        // Blob files are never modified, only added or deleted, which changes the directory's
+        // mod time. Its resolution may be a second, so a change in the same second as a scan
+        // could go unnoticed; results of such a scan aren't reused.
+        lock_guard<mutex> lock(_statsMutex);
+        for (unsigned i = 0; i < 256; ++i) {
+            FilePath shard = _dir.subdirectoryNamed(shardName(i));
+            time_t mtime = shard.lastModified();
+            auto &stats = _shardStats[i];
+            if (mtime != stats.mtime || !stats.stable) {
+                stats = ShardStats();
+                if (mtime >= 0) {
+                    time_t now = time(nullptr);
+                    scanDir(shard, stats.count, stats.size);
+                    stats.mtime = mtime;
+                    stats.stable = (mtime < now);
+                }
+            }
+            count += stats.count;
+            size += stats.size;
+        }
+    }
+
+
+    uint64_t BlobStore::count() const {
+        uint64_t count, size;
+        getStats(count, size);
+        return count;
+    }
+
+
+    uint64_t BlobStore::totalSize() const {
+        uint64_t count, size;
+        getStats(count, size);
+        if (_chunkStore)
+            size += _chunkStore->totalSize();
+        return size;
+    }
+
+
+#pragma mark - COPYING:
+
+
     void BlobStore::copyBlobsTo(BlobStore &toStore) {
-        _dir.forEachFile([&](const FilePath &path) {
+        forEachBlobFile([&](const FilePath &path) {
+            string name = path.fileName();
+            if (hasSuffix(name, kManifestSuffix))
+                name.resize(name.size() - kManifestSuffix.size());
             blobKey key;
-            if (!key.readFromFilename(path.fileName()))
+            if (!key.readFromFilename(name))
                 return;
             Blob srcBlob(*this, key);
             auto src = srcBlob.read();
@@ -261,6 +632,12 @@ namespace litecore {
     void BlobStore::moveTo(BlobStore &toStore) {
         _dir.moveToReplacingDir(toStore.dir(), true);
         toStore._options = _options;
+        toStore._sharded = _sharded;
+        {
+            lock_guard<mutex> lock(toStore._statsMutex);
+            toStore._shardStats = {};
+        }
+        toStore.openChunkStore();
     }
 
 }
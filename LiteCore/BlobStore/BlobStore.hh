@@ -21,10 +21,15 @@
 #include "FilePath.hh"
 #include "Stream.hh"
 #include "SecureDigest.hh"
+#include "function_ref.hh"
+#include <array>
+#include <mutex>
 #include <unordered_set>
+#include <vector>
 
 namespace litecore {
     class BlobStore;
+    class ChunkedBlobWriter;
     class FilePath;
 
 
@@ -58,17 +63,20 @@ namespace litecore {
     /** Represents a blob stored in a BlobStore. This class is thread-safe. */
     class Blob {
     public:
-        bool exists() const             {return _path.exists();}
+        bool exists() const;
+
+        /** True if the blob is stored as chunks, not as a single file at `path`. */
+        bool isChunked() const;
 
         blobKey key() const             {return _key;}
         FilePath path() const           {return _path;}
-        int64_t contentLength() const;      // An overestimate, if blob is encrypted
+        int64_t contentLength() const;      // May overestimate, if blob is encrypted in old format
 
         alloc_slice contents() const    {return read()->readAll();}
 
         std::unique_ptr<SeekableReadStream> read() const;
 
-        void del()                      {_path.del();}
+        void del();
 
     private:
         friend class BlobStore;
@@ -86,6 +94,17 @@ namespace litecore {
     class BlobWriteStream : public WriteStream {
     public:
         BlobWriteStream(BlobStore&);
+
+        /** Opens a resumable stream for downloading a blob whose key is already known.
+            The data goes into a persistent partial file instead of a temporary one, so if the
+            stream is closed without being installed the data is kept, and the next stream
+            opened for the same key continues where it left off; `bytesWritten` tells how much
+            is already present. If install finds the key doesn't match, the partial data is
+            discarded.
+            Encrypted stores don't support this, nor can two streams share a partial file; in
+            those cases this behaves like the regular constructor. */
+        BlobWriteStream(BlobStore&, const blobKey &expectedKey);
+
         ~BlobWriteStream();
 
         void write(slice) override;
@@ -104,24 +123,44 @@ namespace litecore {
         Blob install(const blobKey *expectedKey =nullptr);
 
     private:
+        friend class BlobImporter;
+
+        void openTempFile();
+        void releasePartialFile() noexcept;
+
         BlobStore &_store;
         FilePath _tmpPath;
         std::shared_ptr<WriteStream> _writer;
+        std::shared_ptr<ChunkedBlobWriter> _chunker;    // Same as _writer, if store is chunked
         uint64_t _bytesWritten {0};
         SHA1Builder _sha1ctx;
         blobKey _key;
         bool _computedKey {false};
         bool _installed {false};
+        bool _partial {false};                  // Is _tmpPath a persistent partial file?
     };
 
 
     /** Manages a content-addressable store of binary blobs, stored as files in a directory.
+
+        If the `chunked` option is set, large blobs are instead split into content-defined chunks
+        (see ChunkedBlobWriter), which are kept in a nested BlobStore in the "chunks"
+        subdirectory; the blob's file is replaced by a manifest listing its chunks. Identical
+        chunks of different blobs are stored only once. Chunked blobs remain readable if the
+        store is later opened without the option.
+
+        Blob files are spread over 256 subdirectories, named by the first byte of the digest in
+        hex, so that no directory gets huge. (Stores created before this layout have all their
+        files in the top directory; they're migrated when opened writeable. The layout version
+        is recorded in a "layout" file.)
+
         This class is thread-safe. */
     class BlobStore {
     public:
         struct Options {
             bool create         :1;     ///< Should the store be created if it doesn't exist?
             bool writeable      :1;     ///< If false, opened read-only
+            bool chunked        :1;     ///< Store new large blobs as deduplicated chunks
             EncryptionAlgorithm encryptionAlgorithm;
             alloc_slice encryptionKey;
             
@@ -134,25 +173,77 @@ namespace litecore {
         const Options& options() const              {return _options;}
         bool isEncrypted() const                    {return _options.encryptionAlgorithm !=
                                                                 kNoEncryption;}
+        bool isChunked() const                      {return _options.chunked && _chunkStore;}
+
+        /** The nested store holding the chunks of chunked blobs, or null if there are none. */
+        BlobStore* chunkStore() const               {return _chunkStore.get();}
+
+        /** True if blob files are in subdirectories; false if it's an old store opened read-only. */
+        bool isSharded() const                      {return _sharded;}
+
+        /** Number of blobs, and total size of the files storing them (including chunks.)
+            Each subdirectory's results are cached until its modification time changes, so
+            these don't need to scan every file each time. */
         uint64_t count() const;
         uint64_t totalSize() const;
 
         void deleteStore()                          {_dir.delRecursive();}
         void deleteAllExcept(const std::unordered_set<std::string>& inUse);
 
+        /** Deletes the given blobs, without scanning the others -- except that if any of them
+            was chunked, the other manifests are read to find which chunks are still in use. */
+        void deleteBlobs(const std::vector<blobKey>&);
+
         bool has(const blobKey &key) const          {return get(key).exists();}
 
+        /** Keeps `deleteAllExcept` from deleting a blob, even one not in use, until a matching
+            call to `unprotect`. (The chunks of a chunked blob being written are protected,
+            since nothing refers to them until its manifest is installed.) Calls may be nested. */
+        void protect(const blobKey&);
+        void unprotect(const blobKey&) noexcept;
+
         const Blob get(const blobKey &key) const    {return Blob(*this, key);}
         Blob get(const blobKey &key)                {return Blob(*this, key);}
 
         Blob put(slice data, const blobKey *expectedKey =nullptr);
 
+        /** The file storing a blob's data (unless it's chunked.) */
+        FilePath blobPath(const blobKey &key) const {return shardDir(key)[key.filename()];}
+
+        /** The file where a resumable BlobWriteStream keeps the partial data of a blob.
+            (These stay in the top directory, since they change size while in use.) */
+        FilePath partialBlobPath(const blobKey &key) const {return _dir[key.filename() + ".partial"];}
+
+        /** The file listing the chunks of a chunked blob. */
+        FilePath manifestPath(const blobKey &key) const {return shardDir(key)[key.filename() + ".manifest"];}
+
         void copyBlobsTo(BlobStore &toStore);       // Copy my blobs into toStore
         void moveTo(BlobStore &toStore);            // Replace toStore's dir & options
 
     private:
+        friend class Blob;
+
+        struct ShardStats {
+            time_t   mtime {-1};                        // Directory's mod time when scanned
+            bool     stable {false};                    // Was mtime before the scan's second?
+            uint64_t count {0}, size {0};
+        };
+
+        void openChunkStore();
+        void openLayout();
+        void migrateToShards();
+        FilePath shardDir(const blobKey&) const;
+        void forEachBlobFile(fleece::function_ref<void(const FilePath&)>) const;
+        void deleteUnusedChunks();
+        void getStats(uint64_t &count, uint64_t &size) const;
+        std::unique_ptr<SeekableReadStream> openFile(const FilePath&) const;
+
         FilePath const  _dir;                           // Location
         Options         _options;                       // Option/capability flags
+        bool            _sharded {false};               // Are blob files in subdirectories?
+        std::unique_ptr<BlobStore> _chunkStore;         // Nested store of chunks, if any
+        mutable std::mutex _statsMutex;                 // Protects _shardStats
+        mutable std::array<ShardStats, 256> _shardStats;
     };
 
 }
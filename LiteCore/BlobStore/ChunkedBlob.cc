@@ -0,0 +1,274 @@
+//
+// ChunkedBlob.cc
+//
+// Copyright (c) 2020 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "ChunkedBlob.hh"
+#include "Error.hh"
+#include "Logging.hh"
+#include "Endian.hh"
+#include <algorithm>
+#include <array>
+
+/*
+    A chunked blob's manifest is:
+
+        "LCBM"  magic number (4 bytes)
+        1       format version (1 byte)
+        0 0 0   reserved (3 bytes)
+        length  total length of the blob (8 bytes, big-endian)
+
+    followed by an entry for each chunk, in order:
+
+        digest  SHA-1 digest of the chunk (20 bytes)
+        size    length of the chunk (4 bytes, big-endian)
+
+    Chunk boundaries are found with FastCDC (Xia et al, "FastCDC: a Fast and Efficient
+    Content-Defined Chunking Approach for Data Deduplication", USENIX ATC '16): a "gear" rolling
+    hash is updated with each byte, and a boundary is placed where the hash's top bits are zero.
+    Before the target average size the test uses more bits, and after it fewer, which narrows the
+    distribution of chunk sizes.
+ */
+
+namespace litecore {
+    using namespace std;
+    using namespace fleece;
+
+    extern LogDomain BlobLog;
+
+
+    static constexpr uint8_t kManifestMagic[5] = {'L', 'C', 'B', 'M', 1};
+    static constexpr size_t kManifestHeaderSize = 16;
+    static constexpr size_t kDigestSize = sizeof(blobKey::digest);
+    static constexpr size_t kManifestEntrySize = kDigestSize + 4;
+
+    // Boundary masks: 16 bits before kAvgChunkSize (2^14), 12 bits after. The top bits of the
+    // gear hash are used, since they depend on the last 64 bytes rather than just a few.
+    static constexpr uint64_t kMaskSmall = 0xFFFF000000000000;
+    static constexpr uint64_t kMaskLarge = 0xFFF0000000000000;
+
+
+    // The gear table: a random 64-bit value per byte value. It's generated from a fixed seed
+    // (with splitmix64) since chunk boundaries, and hence deduplication, depend on it.
+    static const array<uint64_t, 256>& gearTable() {
+        static const array<uint64_t, 256> sTable = [] {
+            array<uint64_t, 256> table;
+            uint64_t x = 0x6C697465636F7265;    // "litecore"
+            for (auto &gear : table) {
+                uint64_t z = (x += 0x9E3779B97F4A7C15);
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+                gear = z ^ (z >> 31);
+            }
+            return table;
+        }();
+        return sTable;
+    }
+
+
+#pragma mark - WRITER:
+
+
+    /*static*/ size_t ChunkedBlobWriter::findBoundary(slice data) {
+        size_t size = data.size;
+        if (size <= kMinChunkSize)
+            return size;
+        size = min(size, kMaxChunkSize);
+        size_t normalSize = min(size, kAvgChunkSize);
+        auto bytes = (const uint8_t*)data.buf;
+        auto &gear = gearTable();
+        uint64_t hash = 0;
+        size_t i = kMinChunkSize;
+        for (; i < normalSize; ++i) {
+            hash = (hash << 1) + gear[bytes[i]];
+            if ((hash & kMaskSmall) == 0)
+                return i + 1;
+        }
+        for (; i < size; ++i) {
+            hash = (hash << 1) + gear[bytes[i]];
+            if ((hash & kMaskLarge) == 0)
+                return i + 1;
+        }
+        return size;
+    }
+
+
+    ChunkedBlobWriter::ChunkedBlobWriter(BlobStore &chunkStore, shared_ptr<WriteStream> output)
+    :_chunkStore(chunkStore)
+    ,_output(move(output))
+    { }
+
+
+    ChunkedBlobWriter::~ChunkedBlobWriter() {
+        for (auto &chunk : _chunks)
+            _chunkStore.unprotect(chunk.key);
+    }
+
+
+    void ChunkedBlobWriter::write(slice data) {
+        _buffer.insert(_buffer.end(), (const uint8_t*)data.buf, (const uint8_t*)data.end());
+        // Only look for a boundary once a maximum-size chunk is buffered, so it's found in the
+        // same place however the data is split into writes:
+        size_t start = 0;
+        while (_buffer.size() - start >= kMaxChunkSize) {
+            slice rest(&_buffer[start], _buffer.size() - start);
+            size_t chunkSize = findBoundary(rest);
+            addChunk(slice(rest.buf, chunkSize));
+            start += chunkSize;
+        }
+        _buffer.erase(_buffer.begin(), _buffer.begin() + start);
+    }
+
+
+    void ChunkedBlobWriter::close() {
+        if (!_output)
+            return;
+        if (_chunks.empty()) {
+            // Too small to be worth chunking, so it's stored whole:
+            _output->write(slice(_buffer.data(), _buffer.size()));
+        } else {
+            size_t start = 0;
+            while (start < _buffer.size()) {
+                slice rest(&_buffer[start], _buffer.size() - start);
+                size_t chunkSize = findBoundary(rest);
+                addChunk(slice(rest.buf, chunkSize));
+                start += chunkSize;
+            }
+            writeManifest();
+            LogVerbose(BlobLog, "Chunked blob of %llu bytes into %zu chunks (%zu already stored)",
+                       (unsigned long long)_length, _chunks.size(), _duplicateChunks);
+        }
+        _buffer.clear();
+        _output->close();
+        _output = nullptr;
+    }
+
+
+    void ChunkedBlobWriter::addChunk(slice chunk) {
+        blobKey key = blobKey::computeFrom(chunk);
+        // Protect the chunk before checking for it, so a compaction can't delete it before the
+        // manifest referring to it is installed. (The destructor unprotects it.)
+        _chunkStore.protect(key);
+        _chunks.push_back({key, _length, uint32_t(chunk.size)});
+        if (_chunkStore.has(key))
+            ++_duplicateChunks;
+        else
+            _chunkStore.put(chunk);
+        _length += chunk.size;
+    }
+
+
+    void ChunkedBlobWriter::writeManifest() {
+        vector<uint8_t> manifest(kManifestHeaderSize + _chunks.size() * kManifestEntrySize);
+        memcpy(&manifest[0], kManifestMagic, sizeof(kManifestMagic));
+        uint64_t length = endian::enc64(_length);
+        memcpy(&manifest[8], &length, sizeof(length));
+        uint8_t *entry = &manifest[kManifestHeaderSize];
+        for (auto &chunk : _chunks) {
+            memcpy(entry, slice(chunk.key).buf, kDigestSize);
+            uint32_t size = endian::enc32(chunk.size);
+            memcpy(entry + kDigestSize, &size, sizeof(size));
+            entry += kManifestEntrySize;
+        }
+        _output->write(slice(manifest.data(), manifest.size()));
+    }
+
+
+#pragma mark - READER:
+
+
+    // Checks a manifest's header and returns the blob length from it.
+    static uint64_t readManifestHeader(slice header) {
+        if (header.size < kManifestHeaderSize
+                || memcmp(header.buf, kManifestMagic, sizeof(kManifestMagic)) != 0)
+            error::_throw(error::CorruptData, "Invalid blob manifest");
+        uint64_t length;
+        memcpy(&length, (const uint8_t*)header.buf + 8, sizeof(length));
+        return endian::dec64(length);
+    }
+
+
+    /*static*/ uint64_t ChunkedBlobReader::readLength(SeekableReadStream &manifest) {
+        uint8_t header[kManifestHeaderSize];
+        size_t bytesRead = manifest.read(header, sizeof(header));
+        return readManifestHeader(slice(header, bytesRead));
+    }
+
+
+    ChunkedBlobReader::ChunkedBlobReader(const BlobStore &chunkStore,
+                                         unique_ptr<SeekableReadStream> manifestStream)
+    :_chunkStore(chunkStore)
+    {
+        alloc_slice manifest = manifestStream->readAll();
+        manifestStream->close();
+        _length = readManifestHeader(manifest);
+        size_t entriesSize = manifest.size - kManifestHeaderSize;
+        if (entriesSize % kManifestEntrySize != 0)
+            error::_throw(error::CorruptData, "Invalid blob manifest");
+        _chunks.reserve(entriesSize / kManifestEntrySize);
+        uint64_t offset = 0;
+        for (size_t pos = kManifestHeaderSize; pos < manifest.size; pos += kManifestEntrySize) {
+            auto entry = (const uint8_t*)manifest.buf + pos;
+            uint32_t size;
+            memcpy(&size, entry + kDigestSize, sizeof(size));
+            size = endian::dec32(size);
+            _chunks.push_back({blobKey(slice(entry, kDigestSize)), offset, size});
+            offset += size;
+        }
+        if (offset != _length)
+            error::_throw(error::CorruptData, "Invalid blob manifest");
+    }
+
+
+    // Makes _chunkStream read the chunk containing `pos`, from that position.
+    void ChunkedBlobReader::openChunkAt(uint64_t pos) {
+        if (!_chunkStream || pos < _chunks[_chunkIndex].offset
+                          || pos >= _chunks[_chunkIndex].offset + _chunks[_chunkIndex].size) {
+            auto next = upper_bound(_chunks.begin(), _chunks.end(), pos,
+                                    [](uint64_t p, const BlobChunk &chunk) {
+                                        return p < chunk.offset;
+                                    });
+            _chunkIndex = (next - _chunks.begin()) - 1;
+            _chunkStream = _chunkStore.get(_chunks[_chunkIndex].key).read();
+            _chunkStreamPos = _chunks[_chunkIndex].offset;
+        }
+        if (_chunkStreamPos != pos) {
+            _chunkStream->seek(pos - _chunks[_chunkIndex].offset);
+            _chunkStreamPos = pos;
+        }
+    }
+
+
+    size_t ChunkedBlobReader::read(void *dst, size_t count) {
+        count = (size_t)min((uint64_t)count, _length - _pos);
+        auto out = (uint8_t*)dst;
+        size_t remaining = count;
+        while (remaining > 0) {
+            openChunkAt(_pos);
+            auto &chunk = _chunks[_chunkIndex];
+            size_t n = (size_t)min((uint64_t)remaining, chunk.offset + chunk.size - _pos);
+            n = _chunkStream->read(out, n);
+            if (n == 0)
+                error::_throw(error::CorruptData, "Blob chunk is missing data");
+            out += n;
+            remaining -= n;
+            _pos += n;
+            _chunkStreamPos += n;
+        }
+        return count;
+    }
+
+}
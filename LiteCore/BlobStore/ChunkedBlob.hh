@@ -0,0 +1,107 @@
+//
+// ChunkedBlob.hh
+//
+// Copyright (c) 2020 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "BlobStore.hh"
+#include <vector>
+
+namespace litecore {
+
+    /** One chunk of a chunked blob, as listed in its manifest. */
+    struct BlobChunk {
+        blobKey  key;           ///< Digest of the chunk's data; its key in the chunk store
+        uint64_t offset;        ///< Offset of the chunk in the blob
+        uint32_t size;          ///< Length of the chunk
+    };
+
+
+    /** Splits the data written to it into content-defined chunks (using FastCDC), adds each chunk
+        to a chunk store unless it's already there, and finally writes a manifest listing the
+        chunks to the output stream.
+
+        Since chunk boundaries depend only on the nearby bytes, blobs that differ by insertions or
+        deletions still share most of their chunks, and each shared chunk is stored only once.
+
+        Data shorter than kMaxChunkSize isn't worth chunking; it's written to the output as-is,
+        and `isChunked` returns false.
+
+        The chunks are protected from deletion by compaction (see BlobStore::protect) until the
+        writer is destroyed, which should be after its output is installed. */
+    class ChunkedBlobWriter : public WriteStream {
+    public:
+        static constexpr size_t kMinChunkSize =  4 * 1024;
+        static constexpr size_t kAvgChunkSize = 16 * 1024;
+        static constexpr size_t kMaxChunkSize = 64 * 1024;
+
+        ChunkedBlobWriter(BlobStore &chunkStore, std::shared_ptr<WriteStream> output);
+        ~ChunkedBlobWriter();
+
+        void write(slice) override;
+        void close() override;
+
+        /** After closing: true if a manifest was written, false if the data itself was. */
+        bool isChunked() const                      {return !_chunks.empty();}
+
+        /** The number of chunks that were already in the chunk store. */
+        size_t duplicateChunks() const              {return _duplicateChunks;}
+
+        /** Returns the length of the first chunk of `data`: a content-defined boundary between
+            kMinChunkSize and kMaxChunkSize, or else the whole of `data` if it's shorter. */
+        static size_t findBoundary(slice data);
+
+    private:
+        void addChunk(slice);
+        void writeManifest();
+
+        BlobStore &_chunkStore;
+        std::shared_ptr<WriteStream> _output;
+        std::vector<uint8_t> _buffer;               // Data not yet added as a chunk
+        std::vector<BlobChunk> _chunks;
+        uint64_t _length {0};                       // Total length of _chunks
+        size_t _duplicateChunks {0};
+    };
+
+
+    /** Reads a chunked blob, given its manifest, by reading its chunks from the chunk store. */
+    class ChunkedBlobReader : public SeekableReadStream {
+    public:
+        ChunkedBlobReader(const BlobStore &chunkStore, std::unique_ptr<SeekableReadStream> manifest);
+
+        /** Reads just the blob's length from its manifest. */
+        static uint64_t readLength(SeekableReadStream &manifest);
+
+        const std::vector<BlobChunk>& chunks() const {return _chunks;}
+
+        uint64_t getLength() const override         {return _length;}
+        size_t read(void *dst NONNULL, size_t count) override;
+        void seek(uint64_t pos) override            {_pos = std::min(pos, _length);}
+        void close() override                       {_chunkStream = nullptr;}
+
+    private:
+        void openChunkAt(uint64_t pos);
+
+        const BlobStore &_chunkStore;
+        std::vector<BlobChunk> _chunks;
+        uint64_t _length {0};
+        uint64_t _pos {0};                              // Current position in the blob
+        std::unique_ptr<SeekableReadStream> _chunkStream;   // Stream of the current chunk
+        size_t _chunkIndex {0};                         // Index of the current chunk
+        uint64_t _chunkStreamPos {0};                   // Position of _chunkStream in the blob
+    };
+
+}
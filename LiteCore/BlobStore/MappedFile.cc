@@ -0,0 +1,93 @@
+//
+// MappedFile.cc
+//
+// Copyright (c) 2020 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "MappedFile.hh"
+#include "Error.hh"
+#include "Logging.hh"
+#include "PlatformIO.hh"
+#include <errno.h>
+
+#ifdef _MSC_VER
+    #include <Windows.h>
+#else
+    #include <sys/mman.h>
+#endif
+
+namespace litecore {
+    using namespace std;
+
+
+    // mmap can't map zero bytes, so empty files get this instead:
+    static const uint8_t kEmptyContents[1] = {0};
+
+
+    MappedFile::MappedFile(const FilePath &path) {
+        // (The file doesn't need to stay open once it's mapped.)
+        FILE *file = fopen_u8(path.path().c_str(), "rb");
+        if (!file)
+            error::_throwErrno();
+        try {
+            fseeko(file, 0, SEEK_END);
+            uint64_t size = ftello(file);
+            if (size > SIZE_MAX)    // overflow check for 32-bit
+                error::_throw(error::UnsupportedOperation, "File is too large to map");
+            if (size == 0) {
+                _contents = slice(kEmptyContents, 0);
+            } else {
+#ifdef _MSC_VER
+                auto handle = (HANDLE)_get_osfhandle(_fileno(file));
+                _mapping = CreateFileMappingW(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                if (!_mapping)
+                    error::_throw(error::IOError, "Couldn't map file (error %lu)", GetLastError());
+                void *addr = MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+                if (!addr) {
+                    auto err = GetLastError();
+                    CloseHandle(_mapping);
+                    _mapping = nullptr;
+                    error::_throw(error::IOError, "Couldn't map file (error %lu)", err);
+                }
+#else
+                void *addr = ::mmap(nullptr, size_t(size), PROT_READ, MAP_SHARED,
+                                    fileno(file), 0);
+                if (addr == MAP_FAILED)
+                    error::_throwErrno();
+#endif
+                _contents = slice(addr, size_t(size));
+            }
+        } catch (...) {
+            fclose(file);
+            throw;
+        }
+        fclose(file);
+    }
+
+
+    MappedFile::~MappedFile() {
+        if (_contents.buf == kEmptyContents)
+            return;
+#ifdef _MSC_VER
+        UnmapViewOfFile(_contents.buf);
+        CloseHandle(_mapping);
+#else
+        // Destructor cannot throw exceptions, so just warn if there was an error:
+        if (::munmap((void*)_contents.buf, _contents.size) != 0)
+            Warn("MappedFile destructor: munmap got error %d", errno);
+#endif
+    }
+
+}
@@ -0,0 +1,45 @@
+//
+// MappedFile.hh
+//
+// Copyright (c) 2020 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "Base.hh"
+#include "FilePath.hh"
+
+namespace litecore {
+
+    /** A read-only memory-mapping of an entire file. Its contents can be accessed directly,
+        without being read into a buffer; the OS pages them in as needed.
+        The mapping lasts until the object is freed, even if the file is deleted meanwhile. */
+    class MappedFile : public RefCounted {
+    public:
+        explicit MappedFile(const FilePath&);
+
+        /** The file's contents. (A zero-length file has an empty, non-null slice.) */
+        slice contents() const                  {return _contents;}
+
+    protected:
+        virtual ~MappedFile();
+
+    private:
+        slice _contents;
+#ifdef _MSC_VER
+        void* _mapping {nullptr};               // HANDLE of the file-mapping object
+#endif
+    };
+
+}
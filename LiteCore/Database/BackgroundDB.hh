@@ -26,7 +26,7 @@ namespace litecore {
 
         void close();
 
-        using TransactionTask = function_ref<bool(DataFile*, SequenceTracker*)>;
+        using TransactionTask = function_ref<bool(DataFile*, SequenceTracker*, Transaction&)>;
 
         void useInTransaction(TransactionTask task);
 
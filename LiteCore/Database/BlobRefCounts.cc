@@ -0,0 +1,228 @@
+//
+// BlobRefCounts.cc
+//
+// Copyright (c) 2020 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "BlobRefCounts.hh"
+#include "DataFile.hh"
+#include "Error.hh"
+#include "KeyStore.hh"
+#include "Logging.hh"
+#include "Record.hh"
+#include "RecordEnumerator.hh"
+#include "varint.hh"
+#include <algorithm>
+
+namespace litecore {
+    using namespace std;
+    using namespace fleece;
+
+
+    static const string kDocBlobsStoreName = "docBlobs";
+    static const string kBlobCountsStoreName = "blobRefCounts";
+    static const string kUnusedBlobsStoreName = "unusedBlobs";
+    static constexpr slice kActiveKey = "blobRefCountsActive"_sl;   // in the info KeyStore
+
+    static constexpr size_t kKeySize = sizeof(blobKey::digest);
+
+
+    // Sorts keys and removes duplicates.
+    static void normalize(vector<blobKey> &keys) {
+        sort(keys.begin(), keys.end(), [](const blobKey &a, const blobKey &b) {
+            return slice(a).compare(slice(b)) < 0;
+        });
+        keys.erase(unique(keys.begin(), keys.end()), keys.end());
+    }
+
+
+    // A docBlobs record is a sequence of revisions, each being a varint-prefixed revID followed
+    // by a varint count of keys and then the keys.
+    static vector<BlobRefCounts::RevisionBlobs> decodeRevisions(slice data) {
+        vector<BlobRefCounts::RevisionBlobs> revs;
+        while (data.size > 0) {
+            uint64_t revIDSize, count;
+            if (!ReadUVarInt(&data, &revIDSize) || revIDSize > data.size)
+                error::_throw(error::CorruptData, "Invalid blob reference record");
+            BlobRefCounts::RevisionBlobs rev {alloc_slice(data.buf, (size_t)revIDSize), {}};
+            data.moveStart((size_t)revIDSize);
+            if (!ReadUVarInt(&data, &count) || count > data.size / kKeySize)
+                error::_throw(error::CorruptData, "Invalid blob reference record");
+            rev.blobs.reserve((size_t)count);
+            for (uint64_t i = 0; i < count; ++i) {
+                rev.blobs.emplace_back(slice(data.buf, kKeySize));
+                data.moveStart(kKeySize);
+            }
+            revs.push_back(move(rev));
+        }
+        return revs;
+    }
+
+
+    static alloc_slice encodeRevisions(const vector<BlobRefCounts::RevisionBlobs> &revs) {
+        string data;
+        uint8_t varint[kMaxVarintLen64];
+        for (auto &rev : revs) {
+            data.append((const char*)varint, PutUVarInt(varint, rev.revID.size));
+            data.append((const char*)rev.revID.buf, rev.revID.size);
+            data.append((const char*)varint, PutUVarInt(varint, rev.blobs.size()));
+            for (auto &key : rev.blobs)
+                data.append((const char*)slice(key).buf, kKeySize);
+        }
+        return alloc_slice(data);
+    }
+
+
+    // The (normalized) set of blobs referenced by any of the revisions.
+    static vector<blobKey> allBlobs(const vector<BlobRefCounts::RevisionBlobs> &revs) {
+        vector<blobKey> blobs;
+        for (auto &rev : revs)
+            blobs.insert(blobs.end(), rev.blobs.begin(), rev.blobs.end());
+        normalize(blobs);
+        return blobs;
+    }
+
+
+    BlobRefCounts::BlobRefCounts(DataFile &dataFile)
+    :_dataFile(dataFile)
+    { }
+
+
+    // (The KeyStores are opened on demand, since opening creates them, which a read-only
+    // database can't do.)
+    KeyStore& BlobRefCounts::docBlobs() {
+        return _dataFile.getKeyStore(kDocBlobsStoreName, KeyStore::Capabilities::defaults);
+    }
+
+    KeyStore& BlobRefCounts::blobCounts() {
+        return _dataFile.getKeyStore(kBlobCountsStoreName, KeyStore::Capabilities::defaults);
+    }
+
+    KeyStore& BlobRefCounts::unusedBlobs() {
+        return _dataFile.getKeyStore(kUnusedBlobsStoreName, KeyStore::Capabilities::defaults);
+    }
+
+
+    bool BlobRefCounts::isActive() {
+        // Another connection to the database may activate the table, so keep checking:
+        if (!_active)
+            _active = _dataFile.getKeyStore(DataFile::kInfoKeyStoreName)
+                                            .get(kActiveKey).bodyAsUInt() != 0;
+        return _active;
+    }
+
+
+    void BlobRefCounts::activate(Transaction &t) {
+        Record rec(kActiveKey);
+        rec.setBodyAsUInt(1);
+        _dataFile.getKeyStore(DataFile::kInfoKeyStoreName).write(rec, t);
+        // (Not setting _active yet, in case the transaction is aborted.)
+    }
+
+
+    vector<BlobRefCounts::RevisionBlobs> BlobRefCounts::documentBlobs(slice docID) {
+        return decodeRevisions(docBlobs().get(docID).body());
+    }
+
+
+    void BlobRefCounts::documentSaved(slice docID, vector<RevisionBlobs> revs, Transaction &t) {
+        revs.erase(remove_if(revs.begin(), revs.end(), [](RevisionBlobs &rev) {
+            normalize(rev.blobs);
+            return rev.blobs.empty();
+        }), revs.end());
+        alloc_slice newData = encodeRevisions(revs);
+        Record oldRec = docBlobs().get(docID);
+        if (newData == oldRec.body())
+            return;
+
+        // Both are sorted, so walk them together to find what was added and removed:
+        vector<blobKey> blobs = allBlobs(revs);
+        vector<blobKey> oldBlobs = allBlobs(decodeRevisions(oldRec.body()));
+        auto before = [](const blobKey &a, const blobKey &b) {
+            return slice(a).compare(slice(b)) < 0;
+        };
+        auto i = oldBlobs.begin(), j = blobs.begin();
+        while (i != oldBlobs.end() || j != blobs.end()) {
+            if (j == blobs.end() || (i != oldBlobs.end() && before(*i, *j))) {
+                adjustCount(*i++, -1, t);
+            } else if (i == oldBlobs.end() || before(*j, *i)) {
+                adjustCount(*j++, +1, t);
+            } else {
+                ++i; ++j;
+            }
+        }
+
+        if (revs.empty())
+            docBlobs().del(docID, t);
+        else
+            docBlobs().set(docID, newData, t);
+    }
+
+
+    void BlobRefCounts::documentPurged(slice docID, Transaction &t) {
+        documentSaved(docID, {}, t);
+    }
+
+
+    void BlobRefCounts::adjustCount(const blobKey &key, int delta, Transaction &t) {
+        KeyStore &counts = blobCounts();
+        Record rec = counts.get(slice(key));
+        uint64_t count = rec.bodyAsUInt();
+        if (delta < 0 && count == 0) {
+            Warn("BlobRefCounts: count of blob %s is already 0", key.base64String().c_str());
+            return;
+        }
+        if (count == 0)
+            unusedBlobs().del(slice(key), t);       // In use again
+        count += delta;
+        if (count == 0) {
+            counts.del(rec, t);
+            unusedBlobs().set(slice(key), ""_sl, t);
+        } else {
+            rec.setBodyAsUInt(count);
+            counts.write(rec, t);
+        }
+    }
+
+
+    vector<blobKey> BlobRefCounts::takeUnusedBlobs(Transaction &t) {
+        vector<blobKey> blobs;
+        KeyStore &unused = unusedBlobs();
+        {
+            RecordEnumerator::Options options;
+            options.sortOption = kUnsorted;
+            options.contentOption = kMetaOnly;
+            RecordEnumerator e(unused, options);
+            while (e.next())
+                blobs.emplace_back(e->key());
+        }
+        for (auto &key : blobs)
+            unused.del(slice(key), t);
+        return blobs;
+    }
+
+
+    unordered_set<string> BlobRefCounts::blobsInUse() {
+        unordered_set<string> blobs;
+        RecordEnumerator::Options options;
+        options.sortOption = kUnsorted;
+        options.contentOption = kMetaOnly;
+        RecordEnumerator e(blobCounts(), options);
+        while (e.next())
+            blobs.insert(blobKey(e->key()).filename());
+        return blobs;
+    }
+
+}
@@ -0,0 +1,88 @@
+//
+// BlobRefCounts.hh
+//
+// Copyright (c) 2020 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "BlobStore.hh"
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace litecore {
+    class DataFile;
+    class KeyStore;
+    class Transaction;
+
+
+    /** A persistent table of how many documents reference each blob, so that unused blobs can be
+        found without reading every document. It's stored in three KeyStores of the database: one
+        maps each document to the blobs each of its revisions references, another each blob to
+        the number of documents referencing it, and the third lists the blobs whose count has
+        dropped to zero since they were last deleted.
+
+        The table is only maintained once it's been built by a full scan of the documents (see
+        `activate`); until then `isActive` returns false and `documentSaved` shouldn't be called
+        except by the scan. Updates must be made in the same transaction as the document
+        changes. */
+    class BlobRefCounts {
+    public:
+        explicit BlobRefCounts(DataFile&);
+
+        /** True if the table has been built and is being maintained. */
+        bool isActive();
+
+        /** The blobs referenced by one revision of a document. */
+        struct RevisionBlobs {
+            alloc_slice revID;
+            std::vector<blobKey> blobs;
+        };
+
+        /** The blobs each revision of a document referenced, as of the last `documentSaved`. */
+        std::vector<RevisionBlobs> documentBlobs(slice docID);
+
+        /** Records the blobs that a document's revisions now reference (in any order, possibly
+            with duplicates), adjusting the blobs' counts. Revisions without blobs can be left
+            out. */
+        void documentSaved(slice docID, std::vector<RevisionBlobs>, Transaction&);
+
+        /** Removes a purged document's references. (Unlike `documentSaved`, this can be called
+            before the table is active, so a document purged after the scan read it is
+            accounted for.) */
+        void documentPurged(slice docID, Transaction&);
+
+        /** Returns the blobs whose count has dropped to zero since the last call, and clears the
+            list. Their files can be deleted. */
+        std::vector<blobKey> takeUnusedBlobs(Transaction&);
+
+        /** Marks the table as complete, after `documentSaved` has been called for every document
+            that references blobs. */
+        void activate(Transaction&);
+
+        /** The filenames (as in `blobKey::filename`) of all referenced blobs. */
+        std::unordered_set<std::string> blobsInUse();
+
+    private:
+        KeyStore& docBlobs();           // docID -> each revID and the blobs it references
+        KeyStore& blobCounts();         // blob key -> number of docs referencing it
+        KeyStore& unusedBlobs();        // blob key -> (empty), for blobs whose count became 0
+        void adjustCount(const blobKey&, int delta, Transaction&);
+
+        DataFile&   _dataFile;
+        bool        _active {false};    // Cached once true, since it never becomes false again
+    };
+
+}
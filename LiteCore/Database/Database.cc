@@ -25,12 +25,16 @@
 #include "Housekeeper.hh"
 #include "DataFile.hh"
 #include "Record.hh"
+#include "VersionedDocument.hh"
 #include "SequenceTracker.hh"
+#include "DocumentCache.hh"
 #include "FleeceImpl.hh"
 #include "BlobStore.hh"
+#include "BlobRefCounts.hh"
 #include "Upgrader.hh"
 #include "SecureRandomize.hh"
 #include "StringUtil.hh"
+#include <algorithm>
 #include <functional>
 
 namespace litecore { namespace constants
@@ -49,6 +53,11 @@ namespace c4Internal {
     static const slice kMaxRevTreeDepthKey = "maxRevTreeDepth"_sl;
     static uint32_t kDefaultMaxRevTreeDepth = 20;
 
+    // Info-store key recording that rev trees may have bodies stored outside the document
+    // (see kC4DB_ExternalRevBodies); its value is the version of that format.
+    static const slice kExternalRevBodiesKey = "externalRevBodies"_sl;
+    static constexpr uint64_t kExternalRevBodiesVersion = 1;
+
     const slice Database::kPublicUUIDKey = "publicUUID"_sl;
     const slice Database::kPrivateUUIDKey = "privateUUID"_sl;
 
@@ -173,9 +182,12 @@ namespace c4Internal {
         if (options.useDocumentKeys)
             _encoder->setSharedKeys(documentKeys());
 
+        _blobRefCounts = make_unique<BlobRefCounts>(*_dataFile);
+
         // Validate that the versioning matches what's used in the database:
         auto &info = _dataFile->getKeyStore(DataFile::kInfoKeyStoreName);
         Record doc = info.get(slice("versioning"));
+        bool isNew = false;
         if (doc.exists()) {
             if (doc.bodyAsUInt() != (uint64_t)inConfig.versioning)
                 error::_throw(error::WrongFormat);
@@ -187,9 +199,25 @@ namespace c4Internal {
             (void)generateUUID(kPublicUUIDKey, t);
             (void)generateUUID(kPrivateUUIDKey, t);
             t.commit();
+            isNew = true;
         } else if (inConfig.versioning != kC4RevisionTrees) {
             error::_throw(error::WrongFormat);
         }
+
+        // Storing rev bodies externally changes the format of the rev trees, so it's recorded
+        // in the file the first time it's enabled:
+        Record bodiesDoc = info.get(kExternalRevBodiesKey);
+        if (bodiesDoc.bodyAsUInt() > kExternalRevBodiesVersion) {
+            error::_throw(error::DatabaseTooNew);
+        } else if ((_config.flags & kC4DB_ExternalRevBodies) && !bodiesDoc.exists()
+                        && options.writeable) {
+            if (!options.upgradeable && !isNew)
+                error::_throw(error::CantUpgradeDatabase);
+            bodiesDoc.setBodyAsUInt(kExternalRevBodiesVersion);
+            Transaction t(*_dataFile);
+            info.write(bodiesDoc, t);
+            t.commit();
+        }
     }
 
 
@@ -257,49 +285,94 @@ namespace c4Internal {
         return factory->deleteFile(path);
     }
 
-    unordered_set<string> Database::collectBlobs() {
-        RecordEnumerator::Options options;
-        options.onlyBlobs = true;
-        options.sortOption = kUnsorted;
-        RecordEnumerator e(defaultKeyStore(), options);
-        unordered_set<string> usedDigests;
-        while (e.next()) {
-            Retained<Document> doc = documentFactory().newDocumentInstance(*e);
-            doc->selectCurrentRevision();
-            do {
-                if(!doc->loadSelectedRevBody()) {
-                    continue;
-                }
-
-                Retained<Doc> fleeceDoc = doc->fleeceDoc();
-                const Dict* body = fleeceDoc->asDict();
+    // Returns the keys of the blobs referenced by the selected revision, if its body is available.
+    static vector<blobKey> findRevisionBlobs(Document *doc) {
+        vector<blobKey> blobs;
+        if (!doc->loadSelectedRevBody())
+            return blobs;
 
-                // Iterate over blobs:
-                Document::findBlobReferences(body, [&](const Dict *blob) {
-                    blobKey key;
-                    if (Document::dictIsBlob(blob, key))    // get the key
-                        usedDigests.insert(key.filename());
-                    return true;
-                });
+        Retained<Doc> fleeceDoc = doc->fleeceDoc();
+        const Dict* body = fleeceDoc->asDict();
 
-                // Now look for old-style _attachments:
-                auto attachments = body->get(slice(kC4LegacyAttachmentsProperty));
-                if (attachments) {
-                    blobKey key;
-                    for (Dict::iterator i(attachments->asDict()); i; ++i) {
-                        auto att = i.value()->asDict();
-                        if (att) {
-                            const Value* digest = att->get(slice(kC4BlobDigestProperty));
-                            if (digest && key.readFromBase64(digest->asString())) {
-                                usedDigests.insert(key.filename());
-                            }
-                        }
+        // Iterate over blobs:
+        Document::findBlobReferences(body, [&](const Dict *blob) {
+            blobKey key;
+            if (Document::dictIsBlob(blob, key))    // get the key
+                blobs.push_back(key);
+            return true;
+        });
+
+        // Now look for old-style _attachments:
+        auto attachments = body->get(slice(kC4LegacyAttachmentsProperty));
+        if (attachments) {
+            blobKey key;
+            for (Dict::iterator i(attachments->asDict()); i; ++i) {
+                auto att = i.value()->asDict();
+                if (att) {
+                    const Value* digest = att->get(slice(kC4BlobDigestProperty));
+                    if (digest && key.readFromBase64(digest->asString())) {
+                        blobs.push_back(key);
                     }
                 }
-            } while(doc->selectNextRevision());
+            }
         }
-        
-        return usedDigests;
+        return blobs;
+    }
+
+    // Returns the keys of the blobs referenced by each of a document's revisions that has a body
+    // and is flagged as having attachments. The bodies of revisions listed in `known` (as recorded
+    // by BlobRefCounts) aren't read again. (Leaves some other revision selected.)
+    static vector<BlobRefCounts::RevisionBlobs> findDocumentBlobs(
+                                        Document *doc,
+                                        vector<BlobRefCounts::RevisionBlobs> known = {})
+    {
+        vector<BlobRefCounts::RevisionBlobs> revs;
+        doc->selectCurrentRevision();
+        do {
+            if (!(doc->selectedRev.flags & kRevHasAttachments) || !doc->hasRevisionBody())
+                continue;
+            slice revID = doc->selectedRev.revID;
+            auto i = find_if(known.begin(), known.end(),
+                             [&](const BlobRefCounts::RevisionBlobs &rev) {
+                                 return rev.revID == revID;
+                             });
+            if (i != known.end())
+                revs.push_back(move(*i));
+            else
+                revs.push_back({alloc_slice(revID), findRevisionBlobs(doc)});
+        } while(doc->selectNextRevision());
+        return revs;
+    }
+
+    // Scans all documents for blob references, and builds the BlobRefCounts table from them,
+    // so that future compactions can skip the scan.
+    // Each batch of documents is scanned in its own transaction, so other writers aren't locked
+    // out for long. Documents are read in sequence order, so one saved after being scanned gets
+    // a higher sequence and is scanned again in a later batch; purges are recorded anyway. The
+    // last batch activates the table.
+    void Database::collectBlobs() {
+        static constexpr unsigned kBatchSize = 1000;
+        RecordEnumerator::Options options;
+        options.includeDeleted = true;
+        sequence_t since = 0;
+        unsigned count;
+        do {
+            TransactionHelper t(this);
+            count = 0;
+            {
+                RecordEnumerator e(defaultKeyStore(), since, options);
+                while (count < kBatchSize && e.next()) {
+                    ++count;
+                    since = e->sequence();
+                    Retained<Document> doc = documentFactory().newDocumentInstance(*e);
+                    _blobRefCounts->documentSaved(doc->docID, findDocumentBlobs(doc),
+                                                  transaction());
+                }
+            }
+            if (count < kBatchSize)
+                _blobRefCounts->activate(transaction());
+            t.commit();
+        } while (count == kBatchSize);
     }
 
     void Database::maintenance(DataFile::MaintenanceType what) {
@@ -307,9 +380,19 @@ namespace c4Internal {
         dataFile()->maintenance(what);
 
         if (what == DataFile::kCompact) {
-            // After DB compaction, garbage-collect blobs:
-            unordered_set<string> digestsInUse = collectBlobs();
-            blobStore()->deleteAllExcept(digestsInUse);
+            // After DB compaction, garbage-collect blobs. The first time, this builds the
+            // BlobRefCounts table and deletes every blob it doesn't list. After that, only the
+            // blobs whose counts have dropped to zero since are deleted, so blobs that were
+            // added but never referenced by a document are left alone.
+            if (!_blobRefCounts->isActive()) {
+                collectBlobs();
+                blobStore()->deleteAllExcept(_blobRefCounts->blobsInUse());
+            } else {
+                // (In a transaction, so no other connection can reference them meanwhile.)
+                TransactionHelper t(this);
+                blobStore()->deleteBlobs(_blobRefCounts->takeUnusedBlobs(transaction()));
+                t.commit();
+            }
         }
     }
 
@@ -415,6 +498,7 @@ namespace c4Internal {
         FilePath blobStorePath = path().subdirectoryNamed(dirname);
         auto options = BlobStore::Options::defaults;
         options.create = options.writeable = (_config.flags & kC4DB_ReadOnly) == 0;
+        options.chunked = (_config.flags & kC4DB_ChunkedBlobs) != 0;
         options.encryptionAlgorithm =(EncryptionAlgorithm)encryptionKey.algorithm;
         if (options.encryptionAlgorithm != kNoEncryption) {
             options.encryptionKey = alloc_slice(encryptionKey.bytes, sizeof(encryptionKey.bytes));
@@ -685,7 +769,56 @@ namespace c4Internal {
     }
 
 
+    void Database::setDocumentCacheSize(size_t maxBytes) {
+        if (!_sequenceTracker)
+            error::_throw(error::UnsupportedOperation);
+        if (maxBytes > 0 && _documentCache) {
+            _documentCache->setCapacity(maxBytes);
+            return;
+        }
+        unique_ptr<DocumentCache> cache;
+        if (maxBytes > 0)
+            cache = make_unique<DocumentCache>(maxBytes);
+        _sequenceTracker->use([&](SequenceTracker &st) {
+            st.setDocumentCache(cache.get());
+        });
+        swap(cache, _documentCache);
+    }
+
+
+    Record Database::getDocumentRecord(slice docID) {
+        // The cache is bypassed inside a transaction, which has to see its own uncommitted
+        // changes, and whose reads can't be cached since it might be rolled back.
+        if (inTransaction())
+            return defaultKeyStore().get(docID);
+        uint64_t generation;
+        if (auto rec = _documentCache->get(docID, generation); rec)
+            return move(*rec);
+        Record rec = defaultKeyStore().get(docID);
+        _documentCache->put(rec, generation);
+        return rec;
+    }
+
+
+    void Database::documentFlagsChanged(slice docID) {
+        // Other instances may have cached the doc, so this goes through the SequenceTracker:
+        if (_sequenceTracker) {
+            _sequenceTracker->use([&](SequenceTracker &st) {
+                st.documentInvalidated(docID);
+            });
+        }
+    }
+
+
     void Database::documentSaved(Document* doc) {
+        // The SequenceTracker isn't told about conflicts as changes (below), but cached copies
+        // of the doc are now out of date:
+        if (_sequenceTracker && (doc->selectedRev.flags & kRevIsConflict)) {
+            _sequenceTracker->use([doc](SequenceTracker &st) {
+                st.documentInvalidated(doc->docID);
+            });
+        }
+
         // CBL-1089
         // Conflicted documents are not eligible to be replicated,
         // so ignore them.  Later when the conflict is resolved
@@ -699,12 +832,24 @@ namespace c4Internal {
                                    doc->selectedRev.body.size);
             });
         }
+
+        if (_blobRefCounts->isActive()) {
+            // Update the blob reference counts. Only the bodies of revisions added since the
+            // last save are read; the others' blobs were recorded then. Revisions whose bodies
+            // have been pruned since are left out, releasing their blobs.
+            alloc_slice revID(doc->selectedRev.revID);
+            auto revs = findDocumentBlobs(doc, _blobRefCounts->documentBlobs(doc->docID));
+            _blobRefCounts->documentSaved(doc->docID, move(revs), transaction());
+            doc->selectRevision(revID, true);
+        }
     }
 
 
     bool Database::purgeDocument(slice docID) {
+        VersionedDocument::deleteExternalBodies(defaultKeyStore(), docID, transaction());
         if (!defaultKeyStore().del(docID, transaction()))
             return false;
+        _blobRefCounts->documentPurged(docID, transaction());
         if (_sequenceTracker) {
             _sequenceTracker->use([&](SequenceTracker &st) {
                 st.documentPurged(docID);
@@ -717,16 +862,28 @@ namespace c4Internal {
     int64_t Database::purgeExpiredDocs() {
         if (_sequenceTracker) {
             return _sequenceTracker->use<int64_t>([&](SequenceTracker &st) {
-                return _dataFile->defaultKeyStore().expireRecords([&](slice docID) {
-                    st.documentPurged(docID);
-                });
+                return expireDocuments(*_dataFile, transaction(), *_blobRefCounts, &st);
             });
         } else {
-            return _dataFile->defaultKeyStore().expireRecords(nullptr);
+            return expireDocuments(*_dataFile, transaction(), *_blobRefCounts, nullptr);
         }
     }
 
 
+    /*static*/ int64_t Database::expireDocuments(DataFile &dataFile, Transaction &t,
+                                                 BlobRefCounts &blobRefCounts,
+                                                 SequenceTracker *sequenceTracker)
+    {
+        KeyStore &store = dataFile.defaultKeyStore();
+        return store.expireRecords([&](slice docID) {
+            VersionedDocument::deleteExternalBodies(store, docID, t);
+            blobRefCounts.documentPurged(docID, t);
+            if (sequenceTracker)
+                sequenceTracker->documentPurged(docID);
+        });
+    }
+
+
     bool Database::setExpiration(slice docID, expiration_t expiration) {
         {
             TransactionHelper t(this);
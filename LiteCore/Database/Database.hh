@@ -39,6 +39,8 @@ namespace litecore {
     class SequenceTracker;
     class BlobStore;
     class BackgroundDB;
+    class BlobRefCounts;
+    class DocumentCache;
     class Housekeeper;
 }
 
@@ -124,6 +126,11 @@ namespace c4Internal {
 
         bool purgeDocument(slice docID);
         int64_t purgeExpiredDocs();
+
+        /** Deletes the expired documents in a DataFile, along with their externally stored
+            revision bodies and their blob references. Used by `purgeExpiredDocs`, and by the
+            Housekeeper on its background DataFile. */
+        static int64_t expireDocuments(DataFile&, Transaction&, BlobRefCounts&, SequenceTracker*);
         bool setExpiration(slice docID, expiration_t);
         bool startHousekeeping();
 
@@ -134,6 +141,18 @@ namespace c4Internal {
 
         DocumentFactory& documentFactory()                  {return *_documentFactory;}
 
+        /** Enables a cache of up to `maxBytes` of recently read documents, or disables it if 0.
+            Not available if the database isn't observable, since it's the SequenceTracker that
+            invalidates cached documents. */
+        void setDocumentCacheSize(size_t maxBytes);
+        DocumentCache* documentCache() const                {return _documentCache.get();}
+
+        /** Reads a document's Record through the document cache, which must be enabled. */
+        Record getDocumentRecord(slice docID);
+
+        /** Must be called when a document's flags are changed without saving a revision. */
+        void documentFlagsChanged(slice docID);
+
         fleece::impl::Encoder& sharedEncoder();
         FLEncoder sharedFLEncoder();
 
@@ -176,7 +195,7 @@ namespace c4Internal {
         UUID generateUUID(slice key, Transaction&, bool overwrite =false);
 
         std::unique_ptr<BlobStore> createBlobStore(const std::string &dirname, C4EncryptionKey) const;
-        std::unordered_set<std::string> collectBlobs();
+        void collectBlobs();
         void removeUnusedBlobs(const std::unordered_set<std::string> &used);
 
         const string                _name;
@@ -187,10 +206,12 @@ namespace c4Internal {
         Transaction*                _transaction {nullptr}; // Current Transaction, or null
         int                         _transactionLevel {0};  // Nesting level of transaction
         unique_ptr<DocumentFactory> _documentFactory;       // Instantiates C4Documents
+        unique_ptr<DocumentCache>   _documentCache;         // Cache of recently read docs
         unique_ptr<fleece::impl::Encoder> _encoder;         // Shared Fleece Encoder
         FLEncoder                   _flEncoder {nullptr};   // Ditto, for clients
         unique_ptr<access_lock<SequenceTracker>> _sequenceTracker; // Doc change tracker/notifier
         mutable unique_ptr<BlobStore> _blobStore;           // Blob storage
+        unique_ptr<BlobRefCounts>   _blobRefCounts;         // Which blobs are in use
         uint32_t                    _maxRevTreeDepth {0};   // Max revision-tree depth
         recursive_mutex             _clientMutex;           // Mutex for c4db_lock/unlock
         unique_ptr<BackgroundDB>    _backgroundDB;          // for background operations
@@ -0,0 +1,127 @@
+//
+// DocumentCache.cc
+//
+// Copyright (c) 2020 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "DocumentCache.hh"
+
+namespace litecore {
+    using namespace std;
+
+
+    // Rough per-entry overhead of the list node, hash-table node and Record, beyond its data.
+    static constexpr size_t kEntryOverhead = 200;
+
+
+    DocumentCache::DocumentCache(size_t capacity)
+    :_capacity(capacity)
+    { }
+
+
+    size_t DocumentCache::capacity() const {
+        lock_guard<mutex> lock(_mutex);
+        return _capacity;
+    }
+
+
+    void DocumentCache::setCapacity(size_t capacity) {
+        lock_guard<mutex> lock(_mutex);
+        _capacity = capacity;
+        evict(capacity);
+    }
+
+
+    optional<Record> DocumentCache::get(slice docID, uint64_t &outGeneration) {
+        lock_guard<mutex> lock(_mutex);
+        outGeneration = generationOf(docID);
+        auto i = _byDocID.find(docID);
+        if (i == _byDocID.end()) {
+            ++_stats.misses;
+            return nullopt;
+        }
+        _lru.splice(_lru.begin(), _lru, i->second);
+        ++_stats.hits;
+        return i->second->record;
+    }
+
+
+    void DocumentCache::put(const Record &rec, uint64_t generation) {
+        if (!rec.exists())
+            return;
+        size_t size = rec.key().size + rec.version().size + rec.body().size + kEntryOverhead;
+        lock_guard<mutex> lock(_mutex);
+        if (generation != generationOf(rec.key()) || size > _capacity)
+            return;
+        auto i = _byDocID.find(rec.key());
+        if (i != _byDocID.end()) {
+            // Another thread got here first:
+            _lru.splice(_lru.begin(), _lru, i->second);
+            return;
+        }
+        evict(_capacity - size);
+        _lru.push_front({rec, size});
+        _byDocID[_lru.front().record.key()] = _lru.begin();
+        _stats.size += size;
+        ++_stats.count;
+    }
+
+
+    void DocumentCache::invalidate(slice docID) {
+        lock_guard<mutex> lock(_mutex);
+        ++generationOf(docID);
+        auto i = _byDocID.find(docID);
+        if (i != _byDocID.end()) {
+            auto entry = i->second;
+            _byDocID.erase(i);
+            _stats.size -= entry->size;
+            --_stats.count;
+            _lru.erase(entry);
+        }
+    }
+
+
+    void DocumentCache::clear() {
+        lock_guard<mutex> lock(_mutex);
+        for (auto &gen : _generations)
+            ++gen;
+        evict(0);
+    }
+
+
+    DocumentCache::Stats DocumentCache::stats() const {
+        lock_guard<mutex> lock(_mutex);
+        return _stats;
+    }
+
+
+    // The generation counter of a docID's hash bucket.
+    uint64_t& DocumentCache::generationOf(slice docID) {
+        return _generations[fleece::sliceHash{}(docID) % kNumGenerations];
+    }
+
+
+    // Evicts least recently used entries until the total size is no more than `capacity`.
+    void DocumentCache::evict(size_t capacity) {
+        while (_stats.size > capacity) {
+            auto &entry = _lru.back();
+            _byDocID.erase(entry.record.key());
+            _stats.size -= entry.size;
+            --_stats.count;
+            _lru.pop_back();
+        }
+    }
+
+}
@@ -0,0 +1,97 @@
+//
+// DocumentCache.hh
+//
+// Copyright (c) 2020 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "Record.hh"
+#include <array>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+
+namespace litecore {
+
+    /** A size-bounded LRU cache of document Records, so that repeatedly reading the same document
+        doesn't have to go back to the storage engine. Records are immutable once cached; a caller
+        gets its own copy, which shares the cached key/version/body buffers.
+
+        The cache doesn't know when documents change. Its owner has to call `invalidate` for every
+        change -- the Database does this through its SequenceTracker, which sees both its own
+        changes and those committed by other Database instances on the same file.
+
+        Since a Record can be read from storage on one thread while another thread commits a change
+        to it, `put` takes the generation number returned by the `get` that missed; if the document
+        has been invalidated since then, the Record may be stale and isn't cached. (Generations are
+        kept per hash bucket of docIDs, so an invalidation rarely affects reads of other docs.)
+
+        Thread-safe. */
+    class DocumentCache {
+    public:
+        struct Stats {
+            uint64_t hits {0}, misses {0};  ///< Number of `get` calls that found/didn't find
+            size_t count {0};               ///< Number of Records in the cache
+            size_t size {0};                ///< Approximate total size of the cached Records
+        };
+
+        /** Creates a cache holding at most `capacity` bytes of Records (approximately.) */
+        explicit DocumentCache(size_t capacity);
+
+        size_t capacity() const;
+
+        /** Changes the capacity, evicting the least recently used Records if necessary. */
+        void setCapacity(size_t capacity);
+
+        /** Looks up a document, returning a copy of its Record if it's cached.
+            Either way, sets `outGeneration` to the value to pass to `put`. */
+        std::optional<Record> get(slice docID, uint64_t &outGeneration);
+
+        /** Adds a Record that was read from storage after a `get` of its docID missed.
+            Does nothing if the Record doesn't exist, is too big for the cache, or if its document
+            (or one in the same hash bucket) has been invalidated since that `get`. */
+        void put(const Record&, uint64_t generation);
+
+        /** Removes a document from the cache. Must be called whenever a document is saved or
+            purged, or its flags change. */
+        void invalidate(slice docID);
+
+        /** Removes all documents. */
+        void clear();
+
+        Stats stats() const;
+
+    private:
+        struct Entry {
+            Record record;
+            size_t size;
+        };
+        using List = std::list<Entry>;
+
+        void evict(size_t capacity);
+        uint64_t& generationOf(slice docID);
+
+        static constexpr size_t kNumGenerations = 1024;
+
+        mutable std::mutex _mutex;
+        List _lru;                                              // Most recently used first
+        std::unordered_map<slice, List::iterator, fleece::sliceHash> _byDocID; // Keys are in Entry
+        size_t _capacity;
+        std::array<uint64_t, kNumGenerations> _generations {};  // Incremented by invalidations
+        Stats _stats;
+    };
+
+}
@@ -20,6 +20,7 @@
 #include "Database.hh"
 #include "SequenceTracker.hh"
 #include "BackgroundDB.hh"
+#include "BlobRefCounts.hh"
 #include "DataFile.hh"
 #include "Logging.hh"
 #include <inttypes.h>
@@ -70,12 +71,10 @@ namespace litecore {
 
     void Housekeeper::_doExpiration() {
         LogToAt(DBLog, Verbose, "Housekeeper: expiring documents...");
-        _bgdb->useInTransaction([&](DataFile* dataFile, SequenceTracker *sequenceTracker) -> bool {
-            KeyStore::ExpirationCallback callback;
-            auto &keyStore = dataFile->defaultKeyStore();
-            if (sequenceTracker)
-                callback = [&](slice docID) { sequenceTracker->documentPurged(docID); };
-            keyStore.expireRecords(callback);
+        _bgdb->useInTransaction([&](DataFile* dataFile, SequenceTracker *sequenceTracker,
+                                    Transaction &t) -> bool {
+            BlobRefCounts blobRefCounts(*dataFile);
+            Database::expireDocuments(*dataFile, t, blobRefCounts, sequenceTracker);
             return true;
         });
 
@@ -18,6 +18,7 @@
 
 #include "SequenceTracker.hh"
 #include "Document.hh"
+#include "DocumentCache.hh"
 #include "Logging.hh"
 #include "StringUtil.hh"
 #include <algorithm>
@@ -100,6 +101,7 @@ namespace litecore {
         }
 
         _transaction.reset();
+        _invalidatedDocIDs.clear();
         removeObsoleteEntries();
     }
 
@@ -123,11 +125,23 @@ namespace litecore {
     }
 
 
+    void SequenceTracker::documentInvalidated(slice docID) {
+        Assert(docID);
+        Assert(inTransaction());
+        if (_documentCache)
+            _documentCache->invalidate(docID);
+        _invalidatedDocIDs.emplace_back(docID);
+    }
+
+
     void SequenceTracker::_documentChanged(const alloc_slice &docID,
                                            const alloc_slice &revID,
                                            sequence_t sequence,
                                            uint64_t bodySize)
     {
+        if (_documentCache)
+            _documentCache->invalidate(docID);
+
         auto shortBodySize = (uint32_t)min(bodySize, (uint64_t)UINT32_MAX);
         bool listChanged = true;
         Entry *entry;
@@ -189,7 +203,11 @@ namespace litecore {
     void SequenceTracker::addExternalTransaction(const SequenceTracker &other) {
         Assert(!inTransaction());
         Assert(other.inTransaction());
-        if (!_changes.empty() || _numDocObservers > 0) {
+        if (_documentCache) {
+            for (auto &docID : other._invalidatedDocIDs)
+                _documentCache->invalidate(docID);
+        }
+        if (!_changes.empty() || _numDocObservers > 0 || _documentCache) {
             logInfo("addExternalTransaction from %s", other.loggingIdentifier().c_str());
             for (auto e = next(other._transaction->_placeholder); e != other._changes.end(); ++e) {
                 if (!e->isPlaceholder()) {
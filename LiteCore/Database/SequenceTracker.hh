@@ -32,6 +32,7 @@ namespace c4Internal {
 
 namespace litecore {
     class DatabaseChangeNotifier;
+    class DocumentCache;
     class DocChangeNotifier;
 
     extern LogDomain ChangesLog; // "Changes"
@@ -57,11 +58,22 @@ namespace litecore {
         /** Document implementation calls this to register the change with the Notifier. */
         void documentPurged(slice docID);
 
+        /** Registers a change to a document that doesn't give it a new sequence, like a change
+            to its flags or a new conflicting revision. Observers aren't notified, but the
+            DocumentCache is invalidated, as are other Database instances' caches once the
+            transaction commits. */
+        void documentInvalidated(slice docID);
+
         /** Copy the other tracker's transaction's changes into myself as committed & external */
         void addExternalTransaction(const SequenceTracker &from);
 
         sequence_t lastSequence() const        {return _lastSequence;}
 
+        /** Registers a DocumentCache to be invalidated whenever a document changes, including
+            changes made by other Database instances and ones reverted by aborted transactions.
+            Pass nullptr to unregister it. */
+        void setDocumentCache(DocumentCache *cache)    {_documentCache = cache;}
+
         /** Tracks a document's current sequence. */
         struct Entry {
             alloc_slice const               docID;
@@ -154,6 +166,8 @@ namespace litecore {
         size_t                                  _numDocObservers {0};
         std::unique_ptr<DatabaseChangeNotifier> _transaction;
         sequence_t                              _preTransactionLastSequence;
+        DocumentCache*                          _documentCache {nullptr};
+        std::vector<alloc_slice>                _invalidatedDocIDs; // In current transaction
     };
 
 
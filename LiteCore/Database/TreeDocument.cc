@@ -61,6 +61,7 @@ namespace c4Internal {
         :Document(other)
         ,_versionedDoc(other._versionedDoc)
         ,_selectedRev(nullptr)
+        ,_selectedInPlace(other._selectedInPlace)
         {
             if (other._selectedRev)
                 _selectedRev = _versionedDoc[other._selectedRev->revID];
@@ -75,6 +76,7 @@ namespace c4Internal {
         void init() {
             _versionedDoc.owner = this;
             _versionedDoc.setPruneDepth(_db->maxRevTreeDepth());
+            _versionedDoc.setExternalBodies((_db->config()->flags & kC4DB_ExternalRevBodies) != 0);
             flags = (C4DocumentFlags)_versionedDoc.flags();
             if (_versionedDoc.exists())
                 flags = (C4DocumentFlags)(flags | kDocExists);
@@ -106,22 +108,43 @@ namespace c4Internal {
         bool hasRevisionBody() noexcept override {
             if (!revisionsLoaded())
                 Warn("c4doc_hasRevisionBody called on doc loaded without kC4IncludeBodies");
-            return _selectedRev && _selectedRev->isBodyAvailable();
+            if (_selectedInPlace)
+                return selectedRev.body.buf != nullptr;
+            auto rev = selectedRevision();
+            return rev && rev->isBodyAvailable();
         }
 
         bool loadSelectedRevBody() override {
             loadRevisions();
+            if (!selectedRev.body.buf) {
+                auto rev = selectedRevision();
+                if (rev && rev->hasExternalBody())
+                    selectedRev.body = rev->body();     // reads it from its KeyStore
+            }
             return selectedRev.body.buf != nullptr;
         }
 
+        // The selected Rev. If the current revision was selected in place, without decoding the
+        // rev tree, this decodes it now. Anything that changes the tree must call this first,
+        // since afterwards the current revision may be a different one.
+        const Rev* selectedRevision() {
+            if (_selectedInPlace) {
+                _selectedInPlace = false;
+                _selectedRev = _versionedDoc.currentRevision();
+            }
+            return _selectedRev;
+        }
+
         bool selectRevision(const Rev *rev) noexcept {   // doesn't throw
             _selectedRev = rev;
+            _selectedInPlace = false;
             if (rev) {
                 _selectedRevIDBuf = rev->revID.expanded();
                 selectedRev.revID = _selectedRevIDBuf;
                 selectedRev.flags = (C4RevisionFlags)rev->flags;
                 selectedRev.sequence = rev->sequence;
-                selectedRev.body = rev->body();
+                // A body stored outside the rev tree isn't read until loadSelectedRevBody():
+                selectedRev.body = rev->hasExternalBody() ? nullslice : rev->body();
                 return true;
             } else {
                 clearSelectedRevision();
@@ -145,35 +168,65 @@ namespace c4Internal {
 
         bool selectCurrentRevision() noexcept override { // doesn't throw
             if (_versionedDoc.revsAvailable()) {
-                selectRevision(_versionedDoc.currentRevision());
+                if (_versionedDoc.isDecoded() || !selectCurrentRevisionInPlace())
+                    selectRevision(_versionedDoc.currentRevision());
                 return true;
             } else {
                 _selectedRev = nullptr;
+                _selectedInPlace = false;
                 Document::selectCurrentRevision();
                 return false;
             }
         }
 
+        // Selects the current revision by reading it directly from the encoded rev tree, so that
+        // the tree needn't be decoded if nothing else is accessed. Returns false if that throws,
+        // in which case the caller falls back to decoding the tree.
+        bool selectCurrentRevisionInPlace() {
+            try {
+                RawRevTree tree(_versionedDoc.encodedTree(), _versionedDoc.encodedSequence());
+                auto rev = tree.currentRevision();
+                if (!rev) {
+                    selectRevision(nullptr);
+                    return true;
+                }
+                alloc_slice revID = rev.revID().expanded();
+                slice body = _versionedDoc.alignedBody(rev.body());
+                _selectedRev = nullptr;
+                _selectedInPlace = true;
+                _selectedRevIDBuf = revID;
+                selectedRev.revID = _selectedRevIDBuf;
+                selectedRev.flags = (C4RevisionFlags)rev.flags();
+                selectedRev.sequence = rev.sequence();
+                selectedRev.body = body;
+                return true;
+            } catch (const std::exception &x) {
+                Warn("Couldn't read current revision in place (%s); decoding the rev tree",
+                     x.what());
+                return false;
+            }
+        }
+
         bool selectParentRevision() noexcept override {
             if (!revisionsLoaded())
                 Warn("Trying to access revision tree of doc loaded without kC4IncludeBodies");
-            if (_selectedRev)
-                selectRevision(_selectedRev->parent);
+            if (auto rev = selectedRevision())
+                selectRevision(rev->parent);
             return _selectedRev != nullptr;
         }
 
         bool selectNextRevision() noexcept override {    // does not throw
             if (!revisionsLoaded())
                 Warn("Trying to access revision tree of doc loaded without kC4IncludeBodies");
-            if (_selectedRev)
-                selectRevision(_selectedRev->next());
+            if (auto rev = selectedRevision())
+                selectRevision(rev->next());
             return _selectedRev != nullptr;
         }
 
         bool selectNextLeafRevision(bool includeDeleted) noexcept override {
             if (!revisionsLoaded())
                 Warn("Trying to access revision tree of doc loaded without kC4IncludeBodies");
-            auto rev = _selectedRev;
+            auto rev = selectedRevision();
             if (!rev)
                 return false;
             do {
@@ -205,12 +258,17 @@ namespace c4Internal {
         }
 
         alloc_slice remoteAncestorRevID(C4RemoteID remote) override {
+            if (!_versionedDoc.isDecoded()) {
+                RawRevTree tree(_versionedDoc.encodedTree(), _versionedDoc.encodedSequence());
+                auto rev = tree.latestRevisionOnRemote(remote);
+                return rev ? rev.revID().expanded() : alloc_slice();
+            }
             auto rev = _versionedDoc.latestRevisionOnRemote(remote);
             return rev ? rev->revID.expanded() : alloc_slice();
         }
 
         void setRemoteAncestorRevID(C4RemoteID remote) override {
-            _versionedDoc.setLatestRevisionOnRemote(remote, _selectedRev);
+            _versionedDoc.setLatestRevisionOnRemote(remote, selectedRevision());
         }
 
         void updateFlags() {
@@ -219,9 +277,10 @@ namespace c4Internal {
         }
 
         bool removeSelectedRevBody() noexcept override {
-            if (!_selectedRev)
+            auto rev = selectedRevision();
+            if (!rev)
                 return false;
-            _versionedDoc.removeBody(_selectedRev);
+            _versionedDoc.removeBody(rev);
             return true;
         }
 
@@ -253,6 +312,7 @@ namespace c4Internal {
         }
 
         int32_t purgeRevision(C4Slice revID) override {
+            selectedRevision();
             int32_t total;
             if (revID.buf)
                 total = _versionedDoc.purge(revidBuffer(revID));
@@ -271,6 +331,7 @@ namespace c4Internal {
                              C4Slice mergedBody, C4RevisionFlags mergedFlags,
                              bool pruneLosingBranch =true) override
         {
+            selectedRevision();
             // Validate the revIDs:
             auto winningRev = _versionedDoc[revidBuffer(winningRevID)];
             auto losingRev = _versionedDoc[revidBuffer(losingRevID)];
@@ -372,6 +433,7 @@ namespace c4Internal {
             Assert(rq.historyCount >= 1);
             int32_t commonAncestor = -1;
             loadRevisions();
+            selectedRevision();
             vector<revidBuffer> revIDBuffers(rq.historyCount);
             for (size_t i = 0; i < rq.historyCount; i++)
                 revIDBuffers[i].parse(rq.history[i]);
@@ -481,7 +543,7 @@ namespace c4Internal {
             auto newRev = _versionedDoc.insert(encodedNewRevID,
                                                body,
                                                (Rev::Flags)rq.revFlags,
-                                               _selectedRev,
+                                               selectedRevision(),
                                                rq.allowConflict,
                                                false,
                                                httpStatus);
@@ -540,6 +602,7 @@ namespace c4Internal {
     private:
         VersionedDocument _versionedDoc;
         const Rev *_selectedRev;
+        bool _selectedInPlace {false};      // Current rev selected w/o decoding tree; see above
     };
 
 
@@ -547,6 +610,8 @@ namespace c4Internal {
 
 
     Retained<Document> TreeDocumentFactory::newDocumentInstance(C4Slice docID) {
+        if (database()->documentCache())
+            return new TreeDocument(database(), database()->getDocumentRecord(docID));
         return new TreeDocument(database(), docID);
     }
 
@@ -590,13 +655,13 @@ namespace c4Internal {
             revidBuffer revID;
             revID.parse(revMap[docID]);
 
-            RevTree tree(docBody, 0);
+            RawRevTree tree(docBody, sequence);     // (reads the tree in place; faster)
 
             // Does it exist in the doc?
-            if (tree[revID]) {
+            if (tree.get(revID)) {
                 if (remoteDBID) {
-                    const Rev *curRemoteRev = tree.latestRevisionOnRemote(remoteDBID);
-                    if (curRemoteRev && curRemoteRev->revID != revID) {
+                    auto curRemoteRev = tree.latestRevisionOnRemote(remoteDBID);
+                    if (curRemoteRev && curRemoteRev.revID() != revID) {
                         return alloc_slice(kC4AncestorExistsButNotCurrent);
                     }
                 }
@@ -610,11 +675,11 @@ namespace c4Internal {
             auto generation = revID.generation();
             char expandedBuf[100];
             unsigned n = 0;
-            for (auto rev : tree.allRevisions()) {
-                if (rev->revID.generation() < generation
-                            && !(mustHaveBodies && !rev->isBodyAvailable())) {
+            for (auto rev = tree.currentRevision(); rev; rev = rev.next()) {
+                if (rev.revID().generation() < generation
+                            && !(mustHaveBodies && !rev.body() && !rev.hasExternalBody())) {
                     slice expanded(expandedBuf, sizeof(expandedBuf));
-                    if (rev->revID.expandInto(expanded)) {
+                    if (rev.revID().expandInto(expanded)) {
                         if (n++ == 0)
                             result << '"';
                         else
@@ -105,7 +105,7 @@ namespace litecore {
         return offsetof(RawRevision, revID)
              + rev.revID.size
              + SizeOfVarInt(rev.sequence)
-             + rev._body.size;
+             + (rev._externalBody ? 0 : rev._body.size);
     }
 
     RawRevision* RawRevision::copyFrom(const Rev &rev) {
@@ -116,13 +116,16 @@ namespace litecore {
         this->parentIndex_BE = endian::enc16(uint16_t(rev.parent ? rev.parent->index() : kNoParent));
 
         uint8_t dstFlags = rev.flags & ~kNonPersistentFlags;
-        if (rev._body)
+        if (rev._externalBody)
+            dstFlags |= RawRevision::kHasExternalData;
+        else if (rev._body)
             dstFlags |= RawRevision::kHasData;
         this->flags = (Rev::Flags)dstFlags;
 
         void *dstData = offsetby(&this->revID[0], rev.revID.size);
         dstData = offsetby(dstData, PutUVarInt(dstData, rev.sequence));
-        memcpy(dstData, rev._body.buf, rev._body.size);
+        if (!rev._externalBody)
+            memcpy(dstData, rev._body.buf, rev._body.size);
 
         return (RawRevision*)offsetby(this, revSize);
     }
@@ -143,6 +146,7 @@ namespace litecore {
             dst._body = slice(data, end);
         else
             dst._body = nullslice;
+        dst._externalBody = (this->flags & RawRevision::kHasExternalData) != 0;
     }
 
 
@@ -157,4 +161,128 @@ namespace litecore {
         }
     }
 
+
+#pragma mark - RAWREVTREE:
+
+
+    RawRevTree::RawRevTree(slice raw_tree, sequence_t curSeq)
+    :_raw(raw_tree)
+    ,_curSeq(curSeq)
+    {
+        if (_raw.size < sizeof(uint32_t))
+            error::_throw(error::CorruptRevisionData);
+    }
+
+    RawRevTree::Revision RawRevTree::revision(const RawRevision *raw) const {
+        return raw->isValid() ? Revision(first(), raw, _curSeq) : Revision();
+    }
+
+    unsigned RawRevTree::count() const {
+        return first()->count();
+    }
+
+    RawRevTree::Revision RawRevTree::currentRevision() const {
+        return revision(first());       // Revs are stored in descending priority
+    }
+
+    RawRevTree::Revision RawRevTree::get(unsigned index) const {
+        const RawRevision *raw = first();
+        for (; index > 0 && raw->isValid(); --index)
+            raw = raw->next();
+        return revision(raw);
+    }
+
+    RawRevTree::Revision RawRevTree::get(revid revID) const {
+        for (const RawRevision *raw = first(); raw->isValid(); raw = raw->next()) {
+            if (revID == slice(raw->revID, raw->revIDLen))
+                return revision(raw);
+        }
+        return Revision();
+    }
+
+    RawRevTree::Revision RawRevTree::latestRevisionOnRemote(RemoteID remote) const {
+        const RawRevision *raw = first();
+        while (raw->isValid())
+            raw = raw->next();
+        auto entry = (const RemoteEntry*)offsetby(raw, sizeof(uint32_t));
+        for (; entry < _raw.end(); ++entry) {
+            if (endian::dec16(entry->remoteDBID_BE) == remote)
+                return get(endian::dec16(entry->revIndex_BE));
+        }
+        return Revision();
+    }
+
+    bool RawRevTree::isLatestRemoteRevision(unsigned index) const {
+        const RawRevision *raw = first();
+        while (raw->isValid())
+            raw = raw->next();
+        auto entry = (const RemoteEntry*)offsetby(raw, sizeof(uint32_t));
+        for (; entry < _raw.end(); ++entry) {
+            if (endian::dec16(entry->revIndex_BE) == index)
+                return true;
+        }
+        return false;
+    }
+
+    // Same as RevTree::hasConflict: since the revs are sorted, there's a conflict if the
+    // second one is active.
+    bool RawRevTree::hasConflict() const {
+        Revision second = currentRevision();
+        if (second)
+            second = second.next();
+        if (!second || !second.isLeaf())
+            return false;
+        return !second.isDeleted() || isLatestRemoteRevision(1);
+    }
+
+
+    RawRevTree::Revision RawRevTree::Revision::at(const RawRevision *raw) const {
+        return raw->isValid() ? Revision(_first, raw, _curSeq) : Revision();
+    }
+
+    revid RawRevTree::Revision::revID() const {
+        return revid(_raw->revID, _raw->revIDLen);
+    }
+
+    Rev::Flags RawRevTree::Revision::flags() const {
+        return (Rev::Flags)(_raw->flags & ~RawRevision::kPersistentOnlyFlags);
+    }
+
+    sequence_t RawRevTree::Revision::sequence() const {
+        const void *data = offsetby(&_raw->revID, _raw->revIDLen);
+        sequence_t seq;
+        GetUVarInt(slice(data, _raw->next()), &seq);
+        return seq ? seq : _curSeq;
+    }
+
+    slice RawRevTree::Revision::body() const {
+        return _raw->body();
+    }
+
+    bool RawRevTree::Revision::hasExternalBody() const {
+        return (_raw->flags & RawRevision::kHasExternalData) != 0;
+    }
+
+    RawRevTree::Revision RawRevTree::Revision::parent() const {
+        auto parentIndex = endian::dec16(_raw->parentIndex_BE);
+        if (parentIndex == RawRevision::kNoParent)
+            return Revision();
+        const RawRevision *raw = _first;
+        for (; parentIndex > 0 && raw->isValid(); --parentIndex)
+            raw = raw->next();
+        return at(raw);
+    }
+
+    RawRevTree::Revision RawRevTree::Revision::next() const {
+        return at(_raw->next());
+    }
+
+    bool RawRevTree::Revision::isAncestorOf(Revision rev) const {
+        for (; rev; rev = rev.parent()) {
+            if (rev == *this)
+                return true;
+        }
+        return false;
+    }
+
 }
@@ -55,8 +55,10 @@ namespace litecore {
         // Private RevisionFlags bits used in encoded form:
         enum : uint8_t {
             kHasData = 0x80,  /**< Does this raw rev contain JSON/Fleece data? */
+            kHasExternalData = Rev::kNew, /**< Is its data stored outside the tree? (Reuses the
+                                               bit of kNew, which is never saved to disk.) */
             kNonPersistentFlags  = (Rev::kNew),         // Not saved to disk
-            kPersistentOnlyFlags = (kHasData),          // Only used on disk, not in memory
+            kPersistentOnlyFlags = (kHasData | kHasExternalData), // Only used on disk, not in memory
         };
 
         uint32_t        size_BE;        // Total size of this tree rev (big-endian)
@@ -68,6 +70,7 @@ namespace litecore {
         // varint       sequence
         // if HasData flag:
         //    char      data[];         // Contains the revision body (JSON)
+        // (If HasExternalData flag, the body is stored elsewhere by the VersionedDocument.)
 
         bool isValid() const {
             return size_BE != 0;
@@ -89,8 +92,74 @@ namespace litecore {
         static size_t sizeToWrite(const Rev&);
         void copyTo(Rev &dst, const std::deque<Rev>&) const;
         RawRevision* copyFrom(const Rev &rev);
+
+        friend class RawRevTree;
     };
 
 #pragma pack()
+
+
+    /** A read-only view of an encoded rev tree, which reads revisions directly from the encoded
+        data instead of decoding the whole tree into Rev objects as RevTree does. Nothing is
+        allocated, so it's cheap to use when only a few revisions -- usually just the current
+        one -- are of interest. */
+    class RawRevTree {
+    public:
+        using RemoteID = RevTree::RemoteID;
+
+        /** A revision in a RawRevTree. A default-constructed one means "none" and tests false.
+            It points into the encoded data, which has to stay valid, but not to the RawRevTree. */
+        class Revision {
+        public:
+            Revision() = default;
+
+            explicit operator bool() const              {return _raw != nullptr;}
+            bool operator== (const Revision &r) const   {return _raw == r._raw;}
+            bool operator!= (const Revision &r) const   {return _raw != r._raw;}
+
+            revid revID() const;
+            Rev::Flags flags() const;
+            sequence_t sequence() const;
+            slice body() const;             // Not necessarily 2-byte aligned, as Fleece needs!
+            bool hasExternalBody() const;
+
+            bool isLeaf() const         {return (flags() & Rev::kLeaf) != 0;}
+            bool isDeleted() const      {return (flags() & Rev::kDeleted) != 0;}
+            bool isConflict() const     {return (flags() & Rev::kIsConflict) != 0;}
+            bool isClosed() const       {return (flags() & Rev::kClosed) != 0;}
+
+            Revision parent() const;
+            Revision next() const;          // next in descending priority, like Rev::next
+            bool isAncestorOf(Revision) const;
+
+        private:
+            Revision(const RawRevision *first, const RawRevision *raw, sequence_t curSeq)
+            :_first(first), _raw(raw), _curSeq(curSeq) { }
+            Revision at(const RawRevision *raw) const;
+
+            const RawRevision* _first {nullptr};    // First revision in the tree
+            const RawRevision* _raw {nullptr};
+            sequence_t         _curSeq {0};
+            friend class RawRevTree;
+        };
+
+        /** `curSeq` is the record's sequence, which is that of any revision saved as 0. */
+        RawRevTree(slice raw_tree, sequence_t curSeq);
+
+        unsigned count() const;
+        Revision currentRevision() const;
+        Revision get(unsigned index) const;
+        Revision get(revid) const;
+        Revision latestRevisionOnRemote(RemoteID) const;
+        bool hasConflict() const;
+
+    private:
+        const RawRevision* first() const    {return (const RawRevision*)_raw.buf;}
+        Revision revision(const RawRevision *raw) const;
+        bool isLatestRemoteRevision(unsigned index) const;
+
+        slice const      _raw;
+        sequence_t const _curSeq;
+    };
     
 }
@@ -45,6 +45,8 @@ namespace litecore {
     ,_sorted(other._sorted)
     ,_changed(other._changed)
     ,_unknown(other._unknown)
+    ,_encodedTree(other._encodedTree)
+    ,_encodedSequence(other._encodedSequence)
     {
         // It's important to have _revs in the same order as other._revs.
         // That means we can't just copy other._revsStorage to _revsStorage;
@@ -67,10 +69,23 @@ namespace litecore {
     }
 
     void RevTree::decode(litecore::slice raw_tree, sequence_t seq) {
+        _encodedTree = nullslice;
         _revsStorage = RawRevision::decodeTree(raw_tree, _remoteRevs, this, seq);
         initRevs();
     }
 
+    void RevTree::decodeLazily(slice raw_tree, sequence_t seq) {
+        _revs.clear();
+        _revsStorage.clear();
+        _remoteRevs.clear();
+        _encodedTree = raw_tree;
+        _encodedSequence = seq;
+    }
+
+    void RevTree::decodeNow() {
+        decode(_encodedTree, _encodedSequence);
+    }
+
     void RevTree::initRevs() {
         _revs.resize(_revsStorage.size());
         auto i = _revs.begin();
@@ -81,6 +96,7 @@ namespace litecore {
     }
 
     alloc_slice RevTree::encode() {
+        materialize();
         sort();
         return RawRevision::encodeTree(_revs, _remoteRevs);
     }
@@ -103,17 +119,20 @@ namespace litecore {
 
     const Rev* RevTree::currentRevision() {
         Assert(!_unknown);
+        materialize();
         sort();
         return _revs.size() == 0 ? nullptr : _revs[0];
     }
 
     const Rev* RevTree::get(unsigned index) const {
         Assert(!_unknown);
+        materialize();
         Assert(index < _revs.size());
         return _revs[index];
     }
 
     const Rev* RevTree::get(revid revID) const {
+        materialize();
         for (Rev *rev : _revs) {
             if (rev->revID == revID)
                 return rev;
@@ -123,6 +142,7 @@ namespace litecore {
     }
 
     const Rev* RevTree::getBySequence(sequence_t seq) const {
+        materialize();
         for (Rev *rev : _revs) {
             if (rev->sequence == seq)
                 return rev;
@@ -132,6 +152,8 @@ namespace litecore {
     }
 
     bool RevTree::hasConflict() const {
+        if (!isDecoded())
+            return RawRevTree(_encodedTree, _encodedSequence).hasConflict();
         if (_revs.size() < 2) {
             Assert(!_unknown);
             return false;
@@ -164,7 +186,12 @@ namespace litecore {
 
     slice Rev::body() const {
         slice body = _body;
-        if ((size_t)body.buf & 1) {
+        if (!body.buf && _externalBody) {
+            // Body is stored outside the tree; have the owner read it:
+            auto xthis = const_cast<Rev*>(this);
+            auto xowner = const_cast<RevTree*>(owner);
+            body = xthis->_body = (slice)xowner->copyBody(owner->readBodyOfRevision(this));
+        } else if ((size_t)body.buf & 1) {
             // Fleece data must be 2-byte-aligned, so we have to copy body to the heap:
             auto xthis = const_cast<Rev*>(this);
             auto xowner = const_cast<RevTree*>(owner);
@@ -226,6 +253,7 @@ namespace litecore {
     std::pair<Rev*,int> RevTree::findCommonAncestor(const std::vector<revidBuffer> history,
                                                     bool allowConflict)
     {
+        materialize();
         Assert(history.size() > 0);
         unsigned lastGen = 0;
         Rev* parent = nullptr;
@@ -327,6 +355,7 @@ namespace litecore {
                                const Rev* parent, bool allowConflict, bool markConflict,
                                int &httpStatus)
     {
+        materialize();
         // Make sure the given revID is valid:
         uint32_t newGen = revID.generation();
         if (newGen == 0) {
@@ -440,7 +469,7 @@ void RevTree::resetConflictSequence(const Rev* winningRev) {
     }
 
     void RevTree::removeBody(const Rev* rev) {
-        if (rev->body()) {
+        if (rev->isBodyAvailable()) {
             const_cast<Rev*>(rev)->removeBody();
             _changed = true;
         }
@@ -455,15 +484,34 @@ void RevTree::resetConflictSequence(const Rev* winningRev) {
 
     // Remove bodies of already-saved revs that are no longer leaves:
     void RevTree::removeNonLeafBodies() {
+        materialize();
         for (Rev *rev : _revs) {
-            if (rev->_body.size > 0 && !(rev->flags & (Rev::kLeaf | Rev::kNew | Rev::kKeepBody))) {
+            if ((rev->_body.size > 0 || rev->_externalBody)
+                    && !(rev->flags & (Rev::kLeaf | Rev::kNew | Rev::kKeepBody))) {
                 rev->removeBody();
                 _changed = true;
             }
         }
     }
 
+    void RevTree::separateBodies(bool externalize) {
+        const Rev *current = currentRevision();
+        for (Rev *rev : _revs) {
+            if (rev == current) {
+                if (rev->_externalBody) {
+                    // A stored-elsewhere rev became current, so bring its body back inline:
+                    if (!rev->body())
+                        error::_throw(error::CorruptRevisionData);
+                    rev->_externalBody = false;
+                }
+            } else if (externalize && rev->_body.buf) {
+                rev->_externalBody = true;
+            }
+        }
+    }
+
     unsigned RevTree::prune(unsigned maxDepth) {
+        materialize();
         Assert(maxDepth > 0);
         if (_revs.size() <= maxDepth)
             return 0;
@@ -529,6 +577,7 @@ void RevTree::resetConflictSequence(const Rev* winningRev) {
     }
 
     int RevTree::purgeAll() {
+        materialize();
         int result = (int)_revs.size();
         _revs.resize(0);
         _changed = true;
@@ -585,6 +634,7 @@ void RevTree::resetConflictSequence(const Rev* winningRev) {
     }
 
     void RevTree::sort() {
+        materialize();
         if (_sorted)
             return;
         std::sort(_revs.begin(), _revs.end(), &compareRevs);
@@ -599,6 +649,7 @@ void RevTree::resetConflictSequence(const Rev* winningRev) {
     }
 
     bool RevTree::hasNewRevisions() const {
+        materialize();
         for (Rev *rev : _revs) {
             if (rev->isNew() || rev->sequence == 0)
                 return true;
@@ -607,6 +658,7 @@ void RevTree::resetConflictSequence(const Rev* winningRev) {
     }
 
     void RevTree::saved(sequence_t newSequence) {
+        materialize();
         for (Rev *rev : _revs) {
             rev->clearFlag(Rev::kNew);
             if (rev->sequence == 0) {
@@ -627,6 +679,7 @@ void RevTree::resetConflictSequence(const Rev* winningRev) {
     }
 
     const Rev* RevTree::latestRevisionOnRemote(RemoteID remote) {
+        materialize();
         Assert(remote != kNoRemoteID);
         auto i = _remoteRevs.find(remote);
         if (i == _remoteRevs.end())
@@ -636,6 +689,7 @@ void RevTree::resetConflictSequence(const Rev* winningRev) {
 
 
     void RevTree::setLatestRevisionOnRemote(RemoteID remote, const Rev *rev) {
+        materialize();
         Assert(remote != kNoRemoteID);
         if (rev) {
             _remoteRevs[remote] = rev;
@@ -652,6 +706,7 @@ void RevTree::resetConflictSequence(const Rev* winningRev) {
     }
 
     void RevTree::dump(std::ostream& out) {
+        materialize();
         int i = 0;
         for (Rev *rev : _revs) {
             out << "\t" << (++i) << ": ";
@@ -39,7 +39,8 @@ namespace litecore {
         sequence_t      sequence;   /**< DB sequence number that this revision has/had */
 
         slice body() const;
-        bool isBodyAvailable() const{return _body.buf != nullptr;}
+        bool isBodyAvailable() const{return _body.buf != nullptr || _externalBody;}
+        bool hasExternalBody() const{return _externalBody;}
 
         bool isLeaf() const         {return (flags & kLeaf) != 0;}
         bool isDeleted() const      {return (flags & kDeleted) != 0;}
@@ -74,11 +75,12 @@ namespace litecore {
 
     private:
         slice       _body;          /**< Revision body (JSON), or empty if not stored in this tree*/
+        bool        _externalBody {false}; /**< Is body stored outside the tree, by the owner? */
 
         void addFlag(Flags f)           {flags = (Flags)(flags | f);}
         void clearFlag(Flags f)         {flags = (Flags)(flags & ~f);}
         void removeBody()               {clearFlag((Flags)(kKeepBody | kHasAttachments));
-                                         _body = nullslice;}
+                                         _body = nullslice; _externalBody = false;}
         bool isMarkedForPurge() const   {return (flags & kPurge) != 0;}
 #if DEBUG
         void dump(std::ostream&);
@@ -98,16 +100,29 @@ namespace litecore {
 
         void decode(slice raw_tree, sequence_t seq);
 
+        /** Like decode(), but postpones creating the Revs until something needs them -- any
+            accessor that returns a Rev, or any change to the tree. Until then the tree can be
+            read in place through a RawRevTree made from `encodedTree()`. The raw data must
+            remain valid until then. */
+        void decodeLazily(slice raw_tree, sequence_t seq);
+
+        /** True unless decodeLazily() was called and the Revs haven't been created yet. */
+        bool isDecoded() const                          {return _encodedTree.buf == nullptr;}
+
+        /** The encoded tree passed to decodeLazily, if it hasn't been decoded yet. */
+        slice encodedTree() const                       {return _encodedTree;}
+        sequence_t encodedSequence() const              {return _encodedSequence;}
+
         alloc_slice encode();
 
-        size_t size() const                             {return _revs.size();}
+        size_t size() const                             {materialize(); return _revs.size();}
         const Rev* get(unsigned index) const;
         const Rev* get(revid) const;
         const Rev* operator[](unsigned index) const {return get(index);}
         const Rev* operator[](revid revID) const    {return get(revID);}
         const Rev* getBySequence(sequence_t) const;
 
-        const std::vector<Rev*>& allRevisions() const   {return _revs;}
+        const std::vector<Rev*>& allRevisions() const   {materialize(); return _revs;}
         const Rev* currentRevision();
         bool hasConflict() const;
         bool hasNewRevisions() const;
@@ -197,12 +212,23 @@ namespace litecore {
         virtual void dump(std::ostream&);
 #endif
 
+        /** Decides which revision bodies to leave out of the encoded tree, for the subclass to
+            store elsewhere: if `externalize` is true, every body but the current revision's;
+            otherwise only the ones that are already stored elsewhere. The current revision's
+            body is always kept in the tree. */
+        void separateBodies(bool externalize);
+
         bool _changed {false};
         bool _unknown {false};
 
     private:
         friend class Rev;
         friend class RawRevision;
+        void materialize() const {
+            if (_usuallyFalse(_encodedTree.buf != nullptr))
+                const_cast<RevTree*>(this)->decodeNow();
+        }
+        void decodeNow();
         void initRevs();
         Rev* _insert(revid, alloc_slice body, Rev *parentRev, Rev::Flags, bool markConflicts);
         bool confirmLeaf(Rev* testRev NONNULL);
@@ -217,6 +243,8 @@ namespace litecore {
         std::vector<alloc_slice> _insertedData;         // Storage for new revids
         RemoteRevMap             _remoteRevs;           // Tracks current rev for a remote DB URL
         unsigned                 _pruneDepth {UINT_MAX};// Tree depth to prune to
+        slice                    _encodedTree;          // Tree not yet decoded (see decodeLazily)
+        sequence_t               _encodedSequence {0};  // Sequence to decode _encodedTree with
     };
 
 }
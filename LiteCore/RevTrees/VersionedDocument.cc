@@ -17,14 +17,17 @@
 //
 
 #include "VersionedDocument.hh"
+#include "RawRevTree.hh"
 #include "Record.hh"
 #include "KeyStore.hh"
 #include "DataFile.hh"
 #include "Error.hh"
+#include "Logging.hh"
 #include "Doc.hh"
 #include "varint.hh"
 #include "MutableArray.hh"
 #include "MutableDict.hh"
+#include <algorithm>
 #include <ostream>
 
 namespace litecore {
@@ -47,6 +50,8 @@ namespace litecore {
     :RevTree(other)
     ,_store(other._store)
     ,_rec(other._rec)
+    ,_externalRevIDs(other._externalRevIDs)
+    ,_externalBodies(other._externalBodies)
     {
         updateScope();
     }
@@ -64,7 +69,8 @@ namespace litecore {
         _unknown = false;
         updateScope();
         if (_rec.body().buf) {
-            RevTree::decode(_rec.body(), _rec.sequence());
+            RevTree::decodeLazily(_rec.body(), _rec.sequence());
+            _externalRevIDs = externalBodyRevIDs();
             // The kSynced flag is set when the document's current revision is pushed to a server.
             // This is done instead of updating the doc body, for reasons of speed. So when loading
             // the document, detect that flag and belatedly update the current revision's flags.
@@ -115,6 +121,104 @@ namespace litecore {
         return versScope->document;
     }
 
+#pragma mark - EXTERNAL BODIES:
+
+    // Bodies of non-current revisions, when stored outside the record, go in a separate
+    // KeyStore keyed by docID and revID. The key separator can't appear in a docID, since
+    // those can't contain control characters.
+    static constexpr const char* kBodyStoreSuffix = "_bodies";
+    static constexpr char kBodyKeySeparator = '\x1F';
+
+    KeyStore& VersionedDocument::bodyStore(KeyStore &docStore) {
+        return docStore.dataFile().getKeyStore(docStore.name() + kBodyStoreSuffix,
+                                               KeyStore::Capabilities::defaults);
+    }
+
+    KeyStore& VersionedDocument::bodyStore() const {
+        return bodyStore(_store);
+    }
+
+    alloc_slice VersionedDocument::bodyKey(slice docID, revid revID) {
+        std::string key(docID);
+        key += kBodyKeySeparator;
+        key += (std::string)revID.expanded();
+        return alloc_slice(key);
+    }
+
+    std::vector<alloc_slice> VersionedDocument::externalBodyRevIDs() const {
+        std::vector<alloc_slice> revIDs;
+        if (!isDecoded()) {
+            RawRevTree raw(encodedTree(), encodedSequence());
+            for (auto rev = raw.currentRevision(); rev; rev = rev.next())
+                if (rev.hasExternalBody())
+                    revIDs.emplace_back(rev.revID());
+        } else {
+            for (auto rev : allRevisions())
+                if (rev->hasExternalBody())
+                    revIDs.emplace_back(rev->revID);
+        }
+        return revIDs;
+    }
+
+    bool VersionedDocument::isBodyOfRevisionAvailable(const Rev *rev) const {
+        return rev->isBodyAvailable();
+    }
+
+    alloc_slice VersionedDocument::readBodyOfRevision(const Rev *rev) const {
+        alloc_slice body = RevTree::readBodyOfRevision(rev);
+        if (!body && rev->hasExternalBody()) {
+            body = bodyStore().get(bodyKey(docID(), rev->revID)).body();
+            if (!body) {
+                alloc_slice revID = rev->revID.expanded();
+                Warn("Stored body of '%.*s' #%.*s is missing", SPLAT(docID()), SPLAT(revID));
+            }
+        }
+        return body;
+    }
+
+    // Called after the record's saved: stores the bodies that were newly moved out of the tree,
+    // and deletes the stored ones that are no longer in it.
+    void VersionedDocument::updateExternalBodies(Transaction &t) {
+        auto revIDs = externalBodyRevIDs();
+        if (revIDs.empty() && _externalRevIDs.empty())
+            return;
+        auto contains = [](const std::vector<alloc_slice> &v, slice revID) {
+            return std::find(v.begin(), v.end(), revID) != v.end();
+        };
+        KeyStore &store = bodyStore();
+        for (auto rev : allRevisions()) {
+            if (rev->hasExternalBody() && !contains(_externalRevIDs, rev->revID))
+                store.set(bodyKey(docID(), rev->revID), rev->body(), t);
+        }
+        for (auto &revID : _externalRevIDs) {
+            if (!contains(revIDs, revID))
+                store.del(bodyKey(docID(), revid(revID)), t);
+        }
+        _externalRevIDs = std::move(revIDs);
+    }
+
+    void VersionedDocument::deleteExternalBodies(KeyStore &docStore, slice docID,
+                                                 Transaction &t)
+    {
+        if (!docStore.dataFile().keyStoreExists(docStore.name() + kBodyStoreSuffix))
+            return;
+        VersionedDocument doc(docStore, docID);
+        if (doc._externalRevIDs.empty())
+            return;
+        KeyStore &store = doc.bodyStore();
+        for (auto &revID : doc._externalRevIDs)
+            store.del(bodyKey(docID, revid(revID)), t);
+    }
+
+
+#pragma mark - FLEECE:
+
+    slice VersionedDocument::alignedBody(slice body) {
+        if ((size_t)body.buf & 1)
+            return (slice)copyBody(body);   // Fleece data must be 2-byte-aligned
+        return body;
+    }
+
     alloc_slice VersionedDocument::copyBody(slice body) {
         return addScope(RevTree::copyBody(body));
     }
@@ -171,6 +275,7 @@ namespace litecore {
         bool createSequence;
         if (currentRevision()) {
             removeNonLeafBodies();
+            separateBodies(_externalBodies);
             auto newBody = encode();
             createSequence = seq == 0 || hasNewRevisions();
             // (Don't call _rec.setBody(), because it'd invalidate all the inner pointers from
@@ -188,6 +293,7 @@ namespace litecore {
             if (seq && !_store.del(_rec.key(), transaction, seq))
                 return kConflict;
         }
+        updateExternalBodies(transaction);
         _changed = false;
         return createSequence ? kNewSequence : kNoNewSequence;
     }
@@ -61,13 +61,28 @@ namespace litecore {
 
         bool changed() const        {return _changed;}
 
+        /** If true, `save` stores the bodies of all revisions except the current one outside the
+            record, in a separate KeyStore, so that reading or updating the current revision
+            doesn't have to load or rewrite them. They're read back when first accessed.
+            (Bodies already stored that way are always readable, whatever this is set to.) */
+        void setExternalBodies(bool external)   {_externalBodies = external;}
+
         enum SaveResult {kConflict, kNoNewSequence, kNewSequence};
         SaveResult save(Transaction& transaction);
 
+        /** Deletes the revision bodies, if any, that the document with this ID stored outside
+            its record. Call this when purging the record itself. */
+        static void deleteExternalBodies(KeyStore&, slice docID, Transaction&);
+
         bool updateMeta();
 
         fleece::Retained<fleece::impl::Doc> fleeceDocFor(slice) const;
 
+        /** Given a revision body read in place from `encodedTree()` (via a RawRevTree), returns
+            it in usable form: copied if it's not 2-byte aligned as Fleece requires, and known to
+            `fleeceDocFor`. */
+        slice alignedBody(slice body);
+
         /** Given a Fleece Value, finds the VersionedDocument it belongs to. */
         static VersionedDocument* containing(const fleece::impl::Value*);
 
@@ -78,6 +93,8 @@ namespace litecore {
         void dump()          {RevTree::dump();}
 #endif
     protected:
+        virtual bool isBodyOfRevisionAvailable(const Rev*) const override;
+        virtual alloc_slice readBodyOfRevision(const Rev*) const override;
         virtual alloc_slice copyBody(slice body) override;
         virtual alloc_slice copyBody(const alloc_slice &body) override;
 #if DEBUG
@@ -99,9 +116,16 @@ namespace litecore {
         void decode();
         void updateScope();
         alloc_slice addScope(const alloc_slice &body);
+        std::vector<alloc_slice> externalBodyRevIDs() const;
+        void updateExternalBodies(Transaction&);
+        KeyStore& bodyStore() const;
+        static KeyStore& bodyStore(KeyStore &docStore);
+        static alloc_slice bodyKey(slice docID, revid);
 
         KeyStore&       _store;
         Record          _rec;
         std::vector<Retained<VersFleeceDoc>> _fleeceScopes;
+        std::vector<alloc_slice> _externalRevIDs;   // Revs whose bodies are in bodyStore()
+        bool            _externalBodies {false};
     };
 }
@@ -133,6 +133,9 @@ namespace litecore {
         KeyStore& getKeyStore(const std::string &name) const;
         KeyStore& getKeyStore(const std::string &name, KeyStore::Capabilities) const;
 
+        /** True if a KeyStore with this name exists in the file, whether opened yet or not. */
+        virtual bool keyStoreExists(const std::string &name) =0;
+
 #if 0 //UNUSED:
         /** The names of all existing KeyStores (whether opened yet or not) */
         virtual std::vector<std::string> allKeyStoreNames() =0;
@@ -58,7 +58,7 @@ namespace litecore {
 #if 0 //UNUSED:
         std::vector<std::string> allKeyStoreNames() override;
 #endif
-        bool keyStoreExists(const std::string &name);
+        bool keyStoreExists(const std::string &name) override;
         bool tableExists(const std::string &name) const;
         bool getSchema(const std::string &name, const std::string &type,
                        const std::string &tableName, std::string &outSQL) const;
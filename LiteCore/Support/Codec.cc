@@ -86,6 +86,36 @@ namespace litecore { namespace blip {
     }
 
 
+    slice ZlibCodec::defaultDictionary() {
+        // zlib finds matches at shorter distances more cheaply, so the most common strings go
+        // at the end. (Changing this breaks compatibility with peers using the old version; give
+        // the new one a new protocol name instead.)
+        static constexpr const char kDictionary[] =
+            // Attachment / blob metadata:
+            "\"content_type\":\"application/octet-stream\",\"content_type\":\"image/jpeg\","
+            "\"content_type\":\"text/plain\",\"@type\":\"blob\",\"_attachments\":{"
+            "\"revpos\":1,\"stub\":true,\"length\":\"digest\":\"sha1-"
+            // Document property names:
+            "\"type\":\"name\":\"title\":\"description\":\"created_at\":\"updated_at\":"
+            "\"timestamp\":\"owner\":\"channels\":[\"status\":\"user\":\"email\":"
+            "\"_id\":\"_rev\":\"_deleted\":true"
+            // BLIP properties are NUL-terminated names and values:
+            "Error-Domain\0" "HTTP\0" "BLIP\0" "LiteCore\0" "Error-Code\0"
+            "Profile\0" "getCheckpoint\0" "setCheckpoint\0" "client\0" "rev\0"
+            "Profile\0" "subChanges\0" "since\0" "continuous\0" "true\0" "batch\0"
+            "activeOnly\0" "filter\0" "channels\0" "versioning\0" "rev-trees\0"
+            "deltas\0" "fleeceBodies\0" "fleeceDeltas\0" "maxHistory\0" "20\0"
+            "Profile\0" "proposeChanges\0" "Profile\0" "changes\0"
+            "[[1,\"" "\",\"1-" "\",\"2-" "\"],[2,\""
+            "Profile\0" "getAttachment\0" "digest\0" "sha1-"
+            // rev messages, by far the most common:
+            "deleted\0" "1\0" "noconflicts\0" "true\0" "deltaSrc\0" "fleeceBody\0" "1\0"
+            "Profile\0" "rev\0" "id\0" "rev\0" "sequence\0" "history\0"
+            "Profile\0" "rev\0" "id\0";
+        return slice(kDictionary, sizeof(kDictionary) - 1);
+    }
+
+
     void ZlibCodec::check(int ret) const {
         if (ret < 0 && ret != Z_BUF_ERROR)
             error::_throw(error::CorruptData, "zlib error %d: %s",
@@ -122,6 +152,7 @@ namespace litecore { namespace blip {
 
     Deflater::Deflater(CompressionLevel level)
     :ZlibCodec(::deflate)
+    ,_level(level)
     {
         check(::deflateInit2(&_z,
                              level,
@@ -137,6 +168,29 @@ namespace litecore { namespace blip {
     }
 
 
+    void Deflater::setDictionary(slice dictionary) {
+        check(::deflateSetDictionary(&_z, (const Bytef*)dictionary.buf, (uInt)dictionary.size));
+    }
+
+
+    void Deflater::setLevel(CompressionLevel level) {
+        if (level == _level)
+            return;
+        // deflateParams first compresses any pending input at the old level. There is none,
+        // since every write ends with a flush, but it still wants an output buffer:
+        uint8_t scratch[64];
+        _z.next_in = nullptr;
+        _z.avail_in = 0;
+        _z.next_out = scratch;
+        _z.avail_out = sizeof(scratch);
+        int result = ::deflateParams(&_z, level, Z_DEFAULT_STRATEGY);
+        check(result);
+        Assert(_z.avail_out == sizeof(scratch));
+        if (result == Z_OK)
+            _level = level;
+    }
+
+
     void Deflater::write(slice &input, slice &output, Mode mode) {
         if (mode == Mode::Raw)
             return _writeRaw(input, output);
@@ -224,6 +278,13 @@ namespace litecore { namespace blip {
     }
 
 
+    void Inflater::setDictionary(slice dictionary) {
+        // (A raw inflater takes the dictionary up front; a zlib-format one would only accept it
+        // after inflate() returned Z_NEED_DICT.)
+        check(::inflateSetDictionary(&_z, (const Bytef*)dictionary.buf, (uInt)dictionary.size));
+    }
+
+
     void Inflater::write(slice &input, slice &output, Mode mode) {
         if (mode == Mode::Raw)
             return _writeRaw(input, output);
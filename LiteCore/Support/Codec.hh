@@ -77,6 +77,13 @@ namespace litecore { namespace blip {
 
     /** Abstract base class of Zlib-based codecs Deflater and Inflater */
     class ZlibCodec : public Codec {
+    public:
+        /** A preset dictionary of strings common in replication traffic: BLIP properties and
+            replicator message bodies. Priming both ends' codecs with the same dictionary (see
+            `setDictionary`) makes the first messages of a connection compress much better,
+            before the running window has filled up with real traffic. */
+        static slice defaultDictionary();
+
     protected:
         using FlateFunc = int (*)(z_stream*, int);
 
@@ -105,11 +112,23 @@ namespace litecore { namespace blip {
         Deflater(CompressionLevel = DefaultCompression);
         ~Deflater();
 
+        /** Primes the compressor with a preset dictionary. Must be called before the first
+            write, and the Inflater at the other end must use the same dictionary. */
+        void setDictionary(slice);
+
+        CompressionLevel level() const                  {return _level;}
+
+        /** Changes the compression level for subsequent writes. This doesn't affect the format,
+            so the Inflater doesn't need to know. Call it only between flushed writes. */
+        void setLevel(CompressionLevel);
+
         void write(slice &input, slice &output, Mode =Mode::Default) override;
         unsigned unflushedBytes() const override;
 
     private:
         void _writeAndFlush(slice &input, slice &output);
+
+        CompressionLevel _level;
     };
 
 
@@ -119,6 +138,10 @@ namespace litecore { namespace blip {
         Inflater();
         ~Inflater();
 
+        /** Primes the decompressor with the preset dictionary the Deflater used.
+            Must be called before the first write. */
+        void setDictionary(slice);
+
         void write(slice &input, slice &output, Mode =Mode::Default) override;
     };
 
@@ -22,7 +22,11 @@
 #include "SecureRandomize.hh"
 #include "SecureSymmetricCrypto.hh"
 #include "Endian.hh"
+#include "function_ref.hh"
 #include <algorithm>
+#include <future>
+#include <thread>
+#include <vector>
 
 /*
     Implementing a random-access encrypted stream is actually kind of tricky.
@@ -50,6 +54,32 @@
     the PKCS7 padding would increase its length, making it overflow.
  
     Finally, the nonce is appended to the end of the stream.
+
+
+ VERSION 2
+
+    Version 2 (EncryptedWriteStreamV2 / EncryptedReadStreamV2) starts with a header:
+
+        "LCEn"  magic number (4 bytes)
+        2       format version (1 byte)
+        0 0 0   reserved (3 bytes)
+        nonce   random, 32 bytes
+        tag     16 bytes; see below
+
+    Two keys are derived from the given encryption key and the nonce, by HMAC-SHA256 of the nonce
+    prefixed with "cipher" or "mac". The header's tag is the HMAC (with the mac key) of the rest of
+    the header, truncated to 16 bytes; it identifies the format and checks the key.
+
+    The data is then divided into kFileBlockSize blocks, as before, but encrypted with AES256 in
+    CTR mode: the initial counter block is the block number (big-endian) followed by 8 zero bytes,
+    so no two blocks ever share a counter value. The ciphertext is the same size as the plaintext.
+    Each block's ciphertext is followed by a 16-byte tag: the truncated HMAC of the block number,
+    a byte that's 1 for the final block and 0 otherwise, and the ciphertext. The tags prevent
+    blocks from being altered, moved, or dropped from the end.
+
+    The final block is always partial (0 to kFileBlockSize-1 bytes), so the length of the data
+    follows from the length of the file. Since no block depends on another, any block can be
+    read and verified on its own, and batches of blocks are encrypted/decrypted in parallel.
  */
 
 
@@ -276,5 +306,316 @@ namespace litecore {
             return 0;
         return _bufferBlockID * kFileBlockSize + _bufferPos;
     }
-    
+
+
+#pragma mark - VERSION 2:
+
+
+    static constexpr uint8_t kV2Magic[5] = {'L', 'C', 'E', 'n', 2};
+
+    // Minimum number of blocks worth spreading over multiple threads.
+    static constexpr size_t kMinParallelBlocks = 32;
+
+
+    // Calls `fn` with each number in [0, n), splitting the work among a few threads if n is large.
+    // The first exception thrown by `fn` is rethrown.
+    static void parallelFor(size_t n, function_ref<void(size_t)> fn) {
+        static const size_t kMaxThreads = min(4u, max(1u, thread::hardware_concurrency()));
+        size_t nThreads = min(kMaxThreads, n / kMinParallelBlocks);
+        if (nThreads <= 1) {
+            for (size_t i = 0; i < n; ++i)
+                fn(i);
+            return;
+        }
+        size_t perThread = (n + nThreads - 1) / nThreads;
+        auto range = [&](size_t t) {
+            for (size_t i = t * perThread; i < min(n, (t + 1) * perThread); ++i)
+                fn(i);
+        };
+        vector<future<void>> others;
+        for (size_t t = 1; t < nThreads; ++t)
+            others.push_back(async(launch::async, range, t));
+        range(0);
+        for (auto &other : others)
+            other.get();
+    }
+
+
+    static bool constantTimeEqual(const uint8_t *a, const uint8_t *b, size_t size) {
+        uint8_t diff = 0;
+        for (size_t i = 0; i < size; ++i)
+            diff |= a[i] ^ b[i];
+        return diff == 0;
+    }
+
+
+    /*static*/ uint64_t EncryptedStreamV2::cleartextLength(uint64_t fileSize) {
+        uint64_t payload = fileSize - kHeaderSize;
+        return (payload / kEncryptedBlockSize) * kFileBlockSize
+                + (payload % kEncryptedBlockSize) - kTagSize;
+    }
+
+
+    EncryptedStreamV2::~EncryptedStreamV2() {
+    }
+
+
+    void EncryptedStreamV2::initEncryptor(EncryptionAlgorithm alg,
+                                          slice encryptionKey,
+                                          slice nonce)
+    {
+        if (alg != kAES256)
+            error::_throw(error::UnsupportedEncryption);
+        DebugAssert(nonce.size == kNonceSize);
+        HMAC_SHA256(encryptionKey, {"cipher"_sl, nonce}, _cipherKey);
+        HMAC_SHA256(encryptionKey, {"mac"_sl, nonce}, _macKey);
+    }
+
+
+    void EncryptedStreamV2::headerTag(slice header, void *outTag) const {
+        uint8_t mac[kHMACSHA256Size];
+        HMAC_SHA256(slice(_macKey, kKeySize), {slice(header.buf, kHeaderSize - kTagSize)}, mac);
+        memcpy(outTag, mac, kTagSize);
+    }
+
+
+    // Encrypts a block, writing the ciphertext followed by the tag to `dst`.
+    // Thread-safe, so that blocks can be encrypted in parallel.
+    void EncryptedStreamV2::encryptBlock(uint64_t blockID, bool finalBlock,
+                                         slice plaintext, void *dst) const
+    {
+        DebugAssert(plaintext.size <= kFileBlockSize, "Block is too large");
+        uint64_t iv[2] = {endian::enc64(blockID), 0};
+        slice ciphertext(dst, plaintext.size);
+        AES256CTR(slice(_cipherKey, kKeySize), slice(iv, sizeof(iv)), ciphertext, plaintext);
+        uint8_t flag = finalBlock;
+        uint8_t mac[kHMACSHA256Size];
+        HMAC_SHA256(slice(_macKey, kKeySize),
+                    {slice(&iv[0], sizeof(iv[0])), slice(&flag, 1), ciphertext},
+                    mac);
+        memcpy((uint8_t*)dst + plaintext.size, mac, kTagSize);
+    }
+
+
+    // Verifies and decrypts a block (ciphertext followed by tag) to `dst`; returns its size.
+    // Throws CorruptData if the tag doesn't match. Thread-safe, like encryptBlock.
+    size_t EncryptedStreamV2::decryptBlock(uint64_t blockID, bool finalBlock,
+                                           slice input, void *dst) const
+    {
+        if (input.size < kTagSize)
+            error::_throw(error::CorruptData);
+        slice ciphertext(input.buf, input.size - kTagSize);
+        uint64_t iv[2] = {endian::enc64(blockID), 0};
+        uint8_t flag = finalBlock;
+        uint8_t mac[kHMACSHA256Size];
+        HMAC_SHA256(slice(_macKey, kKeySize),
+                    {slice(&iv[0], sizeof(iv[0])), slice(&flag, 1), ciphertext},
+                    mac);
+        if (!constantTimeEqual(mac, (const uint8_t*)ciphertext.end(), kTagSize))
+            error::_throw(error::CorruptData, "Encrypted block %llu failed authentication",
+                          (unsigned long long)blockID);
+        AES256CTR(slice(_cipherKey, kKeySize), slice(iv, sizeof(iv)),
+                  slice(dst, ciphertext.size), ciphertext);
+        return ciphertext.size;
+    }
+
+
+#pragma mark - V2 WRITER:
+
+
+    EncryptedWriteStreamV2::EncryptedWriteStreamV2(std::shared_ptr<WriteStream> output,
+                                                   EncryptionAlgorithm alg,
+                                                   slice encryptionKey)
+    :_output(output)
+    {
+        uint8_t header[kHeaderSize] = {};
+        memcpy(header, kV2Magic, sizeof(kV2Magic));
+        slice nonce(&header[8], kNonceSize);
+        SecureRandomize(nonce);
+        initEncryptor(alg, encryptionKey, nonce);
+        headerTag(slice(header, kHeaderSize), &header[kHeaderSize - kTagSize]);
+        _output->write(slice(header, kHeaderSize));
+    }
+
+
+    EncryptedWriteStreamV2::~EncryptedWriteStreamV2() {
+        // Destructors aren't allowed to throw exceptions, so it's not safe to call close().
+        if (_output)
+            Warn("EncryptedWriteStreamV2 was not closed");
+    }
+
+
+    void EncryptedWriteStreamV2::write(slice plaintext) {
+        if (_bufferPos > 0) {
+            // Fill the current partial block buffer:
+            auto capacity = min(kFileBlockSize - _bufferPos, plaintext.size);
+            memcpy(&_buffer[_bufferPos], plaintext.buf, capacity);
+            _bufferPos += capacity;
+            plaintext.moveStart(capacity);
+            if (_bufferPos < kFileBlockSize)
+                return; // done; didn't fill buffer
+            writeBlocks(slice(_buffer, kFileBlockSize), false);
+            _bufferPos = 0;
+        }
+
+        // Write entire blocks straight from the input:
+        size_t wholeBlocks = plaintext.size / kFileBlockSize;
+        if (wholeBlocks > 0)
+            writeBlocks(plaintext.read(wholeBlocks * kFileBlockSize), false);
+
+        // Save remainder (if any) in the buffer.
+        memcpy(_buffer, plaintext.buf, plaintext.size);
+        _bufferPos = plaintext.size;
+    }
+
+
+    // Encrypts & writes either whole blocks, or the final (partial) block.
+    void EncryptedWriteStreamV2::writeBlocks(slice plaintext, bool finalBlock) {
+        size_t nBlocks = finalBlock ? 1 : plaintext.size / kFileBlockSize;
+        vector<uint8_t> ciphertext(plaintext.size + nBlocks * kTagSize);
+        uint64_t firstBlockID = _blockID;
+        parallelFor(nBlocks, [&](size_t i) {
+            size_t start = i * kFileBlockSize;
+            slice block((const uint8_t*)plaintext.buf + start, min(kFileBlockSize, plaintext.size - start));
+            encryptBlock(firstBlockID + i, finalBlock, block, &ciphertext[i * kEncryptedBlockSize]);
+        });
+        _blockID += nBlocks;
+        _output->write(slice(ciphertext.data(), ciphertext.size()));
+        LogVerbose(BlobLog, "WRITE #%2llu-%llu: %llu bytes, final=%d",
+                   (unsigned long long)firstBlockID, (unsigned long long)(_blockID - 1),
+                   (unsigned long long)plaintext.size, finalBlock);
+    }
+
+
+    void EncryptedWriteStreamV2::close() {
+        if (_output) {
+            writeBlocks(slice(_buffer, _bufferPos), true);
+            _output->close();
+            _output = nullptr;
+        }
+    }
+
+
+#pragma mark - V2 READER:
+
+
+    EncryptedReadStreamV2::EncryptedReadStreamV2(std::shared_ptr<SeekableReadStream> input,
+                                                 EncryptionAlgorithm alg,
+                                                 slice encryptionKey)
+    :_input(input)
+    ,_alg(alg)
+    ,_encryptionKey(encryptionKey)
+    { }
+
+
+    bool EncryptedReadStreamV2::readHeader() {
+        uint64_t fileSize = _input->getLength();
+        if (fileSize < kMinFileSize)
+            return false;
+        uint8_t header[kHeaderSize];
+        _input->seek(0);
+        if (_input->read(header, kHeaderSize) < kHeaderSize
+                || memcmp(header, kV2Magic, sizeof(kV2Magic)) != 0)
+            return false;
+        initEncryptor(_alg, _encryptionKey, slice(&header[8], kNonceSize));
+        uint8_t tag[kTagSize];
+        headerTag(slice(header, kHeaderSize), tag);
+        if (!constantTimeEqual(tag, &header[kHeaderSize - kTagSize], kTagSize))
+            return false;
+
+        // It's definitely version 2, so from here on a problem means the file is corrupt:
+        if ((fileSize - kHeaderSize) % kEncryptedBlockSize < kTagSize)
+            error::_throw(error::CorruptData, "Encrypted file has invalid length");
+        _cleartextLength = cleartextLength(fileSize);
+        _finalBlockID = (fileSize - kHeaderSize) / kEncryptedBlockSize;
+
+        // Check the final block now, since its flag is what shows the file wasn't truncated;
+        // a read that stops short of it wouldn't otherwise detect that.
+        loadBlock(_finalBlockID);
+        return true;
+    }
+
+
+    // Reads, verifies and decrypts one block into _buffer, unless it's already there.
+    void EncryptedReadStreamV2::loadBlock(uint64_t blockID) {
+        if (blockID == _bufferBlockID)
+            return;
+        bool finalBlock = (blockID == _finalBlockID);
+        size_t size = finalBlock ? size_t(_cleartextLength - blockID * kFileBlockSize)
+                                 : kFileBlockSize;
+        uint8_t blockBuf[kEncryptedBlockSize];
+        _input->seek(kHeaderSize + blockID * kEncryptedBlockSize);
+        if (_input->read(blockBuf, size + kTagSize) < size + kTagSize)
+            error::_throw(error::CorruptData);
+        _bufferBlockID = UINT64_MAX;
+        _bufferSize = decryptBlock(blockID, finalBlock, slice(blockBuf, size + kTagSize), _buffer);
+        _bufferBlockID = blockID;
+    }
+
+
+    void EncryptedReadStreamV2::close() {
+        if (_input) {
+            _input->close();
+            _input = nullptr;
+        }
+    }
+
+
+    void EncryptedReadStreamV2::seek(uint64_t pos) {
+        _pos = min(pos, _cleartextLength);
+    }
+
+
+    size_t EncryptedReadStreamV2::read(void *dst, size_t count) {
+        count = (size_t)min((uint64_t)count, _cleartextLength - _pos);
+        auto out = (uint8_t*)dst;
+        size_t remaining = count;
+        while (remaining > 0) {
+            uint64_t blockID = _pos / kFileBlockSize;
+            size_t offset = _pos % kFileBlockSize;
+            size_t n;
+            if (offset == 0 && remaining >= kFileBlockSize) {
+                // Decrypt whole blocks straight to the output. (None of them is the final block,
+                // since that one is always partial.)
+                size_t nBlocks = remaining / kFileBlockSize;
+                readBlocks(blockID, nBlocks, out);
+                n = nBlocks * kFileBlockSize;
+            } else {
+                loadBlock(blockID);
+                n = min(remaining, _bufferSize - offset);
+                memcpy(out, &_buffer[offset], n);
+            }
+            out += n;
+            remaining -= n;
+            _pos += n;
+        }
+        return count;
+    }
+
+
+    // Reads, verifies and decrypts a run of whole (non-final) blocks into `dst`.
+    void EncryptedReadStreamV2::readBlocks(uint64_t firstBlockID, size_t nBlocks, void *dst) {
+        vector<uint8_t> ciphertext(nBlocks * kEncryptedBlockSize);
+        _input->seek(kHeaderSize + firstBlockID * kEncryptedBlockSize);
+        if (_input->read(ciphertext.data(), ciphertext.size()) < ciphertext.size())
+            error::_throw(error::CorruptData);
+        parallelFor(nBlocks, [&](size_t i) {
+            decryptBlock(firstBlockID + i, false,
+                         slice(&ciphertext[i * kEncryptedBlockSize], kEncryptedBlockSize),
+                         (uint8_t*)dst + i * kFileBlockSize);
+        });
+    }
+
+
+    unique_ptr<SeekableReadStream> NewEncryptedReadStream(shared_ptr<SeekableReadStream> input,
+                                                          EncryptionAlgorithm alg,
+                                                          slice encryptionKey)
+    {
+        auto v2 = make_unique<EncryptedReadStreamV2>(input, alg, encryptionKey);
+        if (v2->readHeader())
+            return v2;
+        input->seek(0);
+        return make_unique<EncryptedReadStream>(input, alg, encryptionKey);
+    }
+
 }
@@ -88,5 +88,103 @@ namespace litecore {
         uint64_t _finalBlockID;
         size_t _bufferSize {0};
     };
-    
+
+
+#pragma mark - VERSION 2:
+
+
+    /** Abstract base class of EncryptedWriteStreamV2 and EncryptedReadStreamV2, which implement
+        the second version of the encrypted file format (described in EncryptedStream.cc.)
+        Like the first, it's made of 4KB blocks that can each be decrypted on their own; but it
+        uses AES-256 in CTR mode, and authenticates each block with a truncated HMAC-SHA256, so
+        tampering, reordering and truncation are detected. Since nothing chains between blocks,
+        reads and writes that span many blocks process them in parallel. */
+    class EncryptedStreamV2 {
+    public:
+        static constexpr size_t kKeySize = kEncryptionKeySize[kAES256];
+        static constexpr size_t kFileBlockSize = 4096;
+        static constexpr size_t kTagSize = 16;
+        static constexpr size_t kNonceSize = 32;
+        static constexpr size_t kHeaderSize = 8 + kNonceSize + kTagSize;
+        static constexpr size_t kEncryptedBlockSize = kFileBlockSize + kTagSize;
+        static constexpr size_t kMinFileSize = kHeaderSize + kTagSize;   // Empty stream
+
+        /** The exact length of the data in a file of this size. */
+        static uint64_t cleartextLength(uint64_t fileSize);
+
+    protected:
+        EncryptedStreamV2() { }
+        virtual ~EncryptedStreamV2();
+        void initEncryptor(EncryptionAlgorithm alg, slice encryptionKey, slice nonce);
+        void headerTag(slice header, void *outTag) const;
+        void encryptBlock(uint64_t blockID, bool finalBlock, slice plaintext, void *dst) const;
+        size_t decryptBlock(uint64_t blockID, bool finalBlock, slice ciphertext, void *dst) const;
+
+        uint8_t _cipherKey[kKeySize];
+        uint8_t _macKey[kKeySize];
+    };
+
+
+    /** Encrypts data written to it in the version 2 format, and writes it to a wrapped
+        WriteStream. New encrypted blobs are written this way. */
+    class EncryptedWriteStreamV2 : public virtual EncryptedStreamV2, public virtual WriteStream {
+    public:
+        EncryptedWriteStreamV2(std::shared_ptr<WriteStream> output,
+                               EncryptionAlgorithm alg,
+                               slice encryptionKey);
+        ~EncryptedWriteStreamV2();
+
+        void write(slice) override;
+        void close() override;
+
+    private:
+        void writeBlocks(slice plaintext, bool finalBlock);
+
+        std::shared_ptr<WriteStream> _output;    // Wrapped stream that will write the ciphertext
+        uint8_t _buffer[kFileBlockSize];         // Partial block not yet written
+        size_t _bufferPos {0};
+        uint64_t _blockID {0};                   // ID of the next block to write
+    };
+
+
+    /** Provides random access to a data stream encrypted by EncryptedWriteStreamV2.
+        Seeking is O(1): any block can be located, read and checked without reading the others. */
+    class EncryptedReadStreamV2 : public EncryptedStreamV2, public virtual SeekableReadStream {
+    public:
+        EncryptedReadStreamV2(std::shared_ptr<SeekableReadStream> input,
+                              EncryptionAlgorithm alg,
+                              slice encryptionKey);
+
+        /** Reads and checks the file header. Returns false if this isn't a version 2 file
+            encrypted with this key; the stream can't be used then. Throws CorruptData if it is,
+            but has been truncated or its final block altered. */
+        bool readHeader();
+
+        uint64_t getLength() const override                 {return _cleartextLength;}
+        size_t read(void *dst NONNULL, size_t count) override;
+        void seek(uint64_t pos) override;
+        void close() override;
+
+    private:
+        void loadBlock(uint64_t blockID);
+        void readBlocks(uint64_t firstBlockID, size_t nBlocks, void *dst);
+
+        std::shared_ptr<SeekableReadStream> _input;
+        EncryptionAlgorithm _alg;
+        alloc_slice _encryptionKey;
+        uint64_t _cleartextLength {0};
+        uint64_t _finalBlockID {0};
+        uint64_t _pos {0};                          // Current position in the cleartext
+        uint8_t _buffer[kFileBlockSize];            // Most recently read partial block
+        uint64_t _bufferBlockID {UINT64_MAX};
+        size_t _bufferSize {0};
+    };
+
+
+    /** Opens a stream for reading an encrypted file in either format. */
+    std::unique_ptr<SeekableReadStream> NewEncryptedReadStream(
+                                                    std::shared_ptr<SeekableReadStream> input,
+                                                    EncryptionAlgorithm alg,
+                                                    slice encryptionKey);
+
 }
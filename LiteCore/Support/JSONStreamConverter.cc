@@ -0,0 +1,462 @@
+//
+// JSONStreamConverter.cc
+//
+// Copyright (c) 2020 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "JSONStreamConverter.hh"
+#include "NumConversion.hh"
+#include <algorithm>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace litecore {
+    using namespace std;
+    using namespace fleece;
+
+
+    // Maximum nesting depth of arrays/dicts; deeper JSON is rejected.
+    static constexpr size_t kMaxDepth = 1000;
+
+
+    static inline bool isJSONWhitespace(char c) {
+        return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+    }
+
+    static inline bool isNumberChar(char c) {
+        return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+    }
+
+    static inline bool isLiteralChar(char c) {
+        return c >= 'a' && c <= 'z';
+    }
+
+    static inline bool isDigit(char c) {
+        return c >= '0' && c <= '9';
+    }
+
+    // Returns true if `token` matches JSON's number syntax, which (unlike strtod's) doesn't allow
+    // leading zeros, a '+' sign, or a '.' without digits on both sides. Sets `isInteger` if the
+    // number has no fraction or exponent.
+    static bool isValidNumber(slice token, bool &isInteger) {
+        auto p = (const char*)token.buf, end = (const char*)token.end();
+        if (p < end && *p == '-')
+            ++p;
+        if (p == end || !isDigit(*p))
+            return false;
+        if (*p++ == '0') {
+            if (p < end && isDigit(*p))
+                return false;
+        } else {
+            while (p < end && isDigit(*p))
+                ++p;
+        }
+        isInteger = true;
+        if (p < end && *p == '.') {
+            isInteger = false;
+            if (++p == end || !isDigit(*p))
+                return false;
+            while (p < end && isDigit(*p))
+                ++p;
+        }
+        if (p < end && (*p == 'e' || *p == 'E')) {
+            isInteger = false;
+            if (++p < end && (*p == '+' || *p == '-'))
+                ++p;
+            if (p == end || !isDigit(*p))
+                return false;
+            while (p < end && isDigit(*p))
+                ++p;
+        }
+        return p == end;
+    }
+
+    static int hexDigit(char c) {
+        if (c >= '0' && c <= '9')  return c - '0';
+        if (c >= 'a' && c <= 'f')  return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')  return c - 'A' + 10;
+        return -1;
+    }
+
+    static bool readHex4(const char *p, uint32_t *out) {
+        uint32_t result = 0;
+        for (int i = 0; i < 4; ++i) {
+            int d = hexDigit(p[i]);
+            if (d < 0)
+                return false;
+            result = (result << 4) | d;
+        }
+        *out = result;
+        return true;
+    }
+
+    static void appendUTF8(string &str, uint32_t c) {
+        if (c < 0x80) {
+            str += char(c);
+        } else if (c < 0x800) {
+            str += char(0xC0 | (c >> 6));
+            str += char(0x80 | (c & 0x3F));
+        } else if (c < 0x10000) {
+            str += char(0xE0 | (c >> 12));
+            str += char(0x80 | ((c >> 6) & 0x3F));
+            str += char(0x80 | (c & 0x3F));
+        } else {
+            str += char(0xF0 | (c >> 18));
+            str += char(0x80 | ((c >> 12) & 0x3F));
+            str += char(0x80 | ((c >> 6) & 0x3F));
+            str += char(0x80 | (c & 0x3F));
+        }
+    }
+
+
+    JSONStreamConverter::JSONStreamConverter(SharedKeys sk) {
+        if (sk)
+            _encoder.setSharedKeys(sk);
+    }
+
+
+    void JSONStreamConverter::reset() {
+        _encoder.reset();
+        _stack.clear();
+        _pending.clear();
+        _resumeScan = 0;
+        _state = State::Value;
+        _error = kFLNoError;
+        _errorMessage = nullptr;
+        _bytesConsumed = 0;
+    }
+
+
+    bool JSONStreamConverter::fail(FLError err, const char *message) {
+        if (!_error) {
+            _error = err;
+            _errorMessage = message;
+        }
+        return false;
+    }
+
+
+    bool JSONStreamConverter::write(slice json) {
+        if (_error)
+            return false;
+        _bytesConsumed += json.size;
+        if (_pending.empty()) {
+            // Common case: parse directly from the caller's buffer, and save only an unfinished
+            // token at the end:
+            auto start = (const char*)json.buf, end = (const char*)json.end();
+            size_t used = parse(start, end, false);
+            if (!_error && used < json.size)
+                _pending.assign(start + used, end);
+        } else {
+            // Previous chunk ended in mid-token; append to it and continue:
+            _pending.append((const char*)json.buf, json.size);
+            size_t used = parse(_pending.data(), _pending.data() + _pending.size(), false);
+            _pending.erase(0, used);
+        }
+        return !_error;
+    }
+
+
+    Doc JSONStreamConverter::finish(FLError *outError) {
+        if (!_error && !_pending.empty()) {
+            size_t used = parse(_pending.data(), _pending.data() + _pending.size(), true);
+            if (used < _pending.size())
+                fail(kFLJSONError, "JSON ends in the middle of a token");
+            _pending.clear();
+        }
+        if (!_error && _state != State::Done)
+            fail(kFLJSONError, "JSON ends prematurely");
+        Doc doc;
+        if (!_error) {
+            FLError encErr;
+            doc = _encoder.finishDoc(&encErr);
+            if (!doc)
+                fail(encErr, "Fleece encoder failed");
+        }
+        if (outError)
+            *outError = _error;
+        return doc;
+    }
+
+
+    // Parses as much as possible of the range [start, end). Returns the number of bytes consumed;
+    // any remaining bytes are an unfinished token that has to be retried with more data.
+    size_t JSONStreamConverter::parse(const char *start, const char *end, bool final) {
+        // If the previous call stopped in the middle of a string, skip what was already scanned:
+        size_t resumeScan = _resumeScan;
+        _resumeScan = 0;
+
+        const char *pos = start;
+        while (pos < end) {
+            char c = *pos;
+            if (isJSONWhitespace(c)) {
+                ++pos;
+                continue;
+            }
+
+            switch (_state) {
+                case State::Done:
+                    fail(kFLJSONError, "unexpected data after JSON value");
+                    return pos - start;
+                case State::DictColon:
+                    if (c != ':') {
+                        fail(kFLJSONError, "expected ':' after dict key");
+                        return pos - start;
+                    }
+                    _state = State::Value;
+                    ++pos;
+                    continue;
+                case State::ArrayNext:
+                case State::DictNext: {
+                    bool inDict = (_state == State::DictNext);
+                    if (c == ',') {
+                        _state = inDict ? State::DictKey : State::Value;
+                        ++pos;
+                    } else if (c == (inDict ? '}' : ']')) {
+                        if (inDict)
+                            _encoder.endDict();
+                        else
+                            _encoder.endArray();
+                        _stack.pop_back();
+                        valueWritten();
+                        ++pos;
+                    } else {
+                        fail(kFLJSONError, "expected ',' or end of collection");
+                        return pos - start;
+                    }
+                    continue;
+                }
+                case State::ArrayFirst:
+                    if (c == ']') {
+                        _encoder.endArray();
+                        _stack.pop_back();
+                        valueWritten();
+                        ++pos;
+                        continue;
+                    }
+                    break;      // else parse a value, below
+                case State::DictFirstKey:
+                    if (c == '}') {
+                        _encoder.endDict();
+                        _stack.pop_back();
+                        valueWritten();
+                        ++pos;
+                        continue;
+                    }
+                    // fall through
+                case State::DictKey:
+                    if (c != '"') {
+                        fail(kFLJSONError, "expected a string dict key");
+                        return pos - start;
+                    }
+                    break;      // else parse a key, below
+                case State::Value:
+                    break;
+            }
+
+            // At this point we're reading a value, or a dict key:
+            if (c == '{' || c == '[') {
+                if (_stack.size() >= kMaxDepth) {
+                    fail(kFLJSONError, "JSON nested too deeply");
+                    return pos - start;
+                }
+                bool isDict = (c == '{');
+                if (isDict)
+                    _encoder.beginDict();
+                else
+                    _encoder.beginArray();
+                _stack.push_back(isDict);
+                _state = isDict ? State::DictFirstKey : State::ArrayFirst;
+                ++pos;
+
+            } else if (c == '"') {
+                size_t skip = (pos == start) ? max(resumeScan, size_t(1)) : 1;
+                const char *quote = scanString(pos, pos + skip, end);
+                if (!quote)
+                    return pos - start;       // string continues in the next chunk
+                bool asKey = (_state == State::DictFirstKey || _state == State::DictKey);
+                if (!writeString(slice(pos, quote + 1), asKey))
+                    return pos - start;
+                if (asKey)
+                    _state = State::DictColon;
+                else
+                    valueWritten();
+                pos = quote + 1;
+
+            } else if (c == '-' || (c >= '0' && c <= '9') || isLiteralChar(c)) {
+                bool isNumber = !isLiteralChar(c);
+                const char *tokEnd = pos + 1;
+                while (tokEnd < end && (isNumber ? isNumberChar(*tokEnd) : isLiteralChar(*tokEnd)))
+                    ++tokEnd;
+                if (tokEnd == end && !final)
+                    return pos - start;       // token might continue in the next chunk
+                slice token(pos, tokEnd);
+                if (!(isNumber ? writeNumber(token) : writeLiteral(token)))
+                    return pos - start;
+                valueWritten();
+                pos = tokEnd;
+
+            } else {
+                fail(kFLJSONError, "invalid JSON character");
+                return pos - start;
+            }
+        }
+        return pos - start;
+    }
+
+
+    // Returns a pointer to the closing quote of the string starting at `tokenStart`, beginning the
+    // scan at `p`. If the quote isn't in this range, returns null and sets _resumeScan to the
+    // offset from `tokenStart` at which scanning should resume when more data arrives. (This may
+    // be one past `end` if the range ends with a backslash.)
+    const char* JSONStreamConverter::scanString(const char *tokenStart, const char *p,
+                                                const char *end)
+    {
+        while (p < end) {
+            char c = *p;
+            if (c == '"')
+                return p;
+            p += (c == '\\') ? 2 : 1;     // skip escaped character
+        }
+        _resumeScan = size_t(p - tokenStart);
+        return nullptr;
+    }
+
+
+    bool JSONStreamConverter::writeString(slice token, bool asKey) {
+        slice str(token.buf, token.size);
+        str.moveStart(1);
+        str.setSize(str.size - 1);
+        for (auto p = (const uint8_t*)str.buf; p < (const uint8_t*)str.end(); ++p) {
+            if (*p < 0x20)
+                return fail(kFLJSONError, "control character in JSON string");
+        }
+        if (str.findByte('\\')) {
+            // Decode escape sequences:
+            _unescaped.clear();
+            _unescaped.reserve(str.size);
+            auto p = (const char*)str.buf, end = (const char*)str.end();
+            while (p < end) {
+                char c = *p++;
+                if (c != '\\') {
+                    _unescaped += c;
+                    continue;
+                }
+                if (p >= end)
+                    return fail(kFLJSONError, "invalid escape in JSON string");
+                switch (char esc = *p++) {
+                    case '"': case '\\': case '/':
+                        _unescaped += esc; break;
+                    case 'b':   _unescaped += '\b'; break;
+                    case 'f':   _unescaped += '\f'; break;
+                    case 'n':   _unescaped += '\n'; break;
+                    case 'r':   _unescaped += '\r'; break;
+                    case 't':   _unescaped += '\t'; break;
+                    case 'u': {
+                        uint32_t uc;
+                        if (end - p < 4 || !readHex4(p, &uc))
+                            return fail(kFLJSONError, "invalid \\u escape in JSON string");
+                        p += 4;
+                        if (uc >= 0xD800 && uc < 0xDC00) {
+                            // High surrogate; combine with following low surrogate:
+                            uint32_t lo;
+                            if (end - p < 6 || p[0] != '\\' || p[1] != 'u' || !readHex4(p+2, &lo)
+                                    || lo < 0xDC00 || lo >= 0xE000)
+                                return fail(kFLJSONError, "invalid UTF-16 surrogate in JSON string");
+                            p += 6;
+                            uc = 0x10000 + ((uc - 0xD800) << 10) + (lo - 0xDC00);
+                        } else if (uc >= 0xDC00 && uc < 0xE000) {
+                            // Low surrogate without a high one:
+                            return fail(kFLJSONError, "invalid UTF-16 surrogate in JSON string");
+                        }
+                        appendUTF8(_unescaped, uc);
+                        break;
+                    }
+                    default:
+                        return fail(kFLJSONError, "invalid escape in JSON string");
+                }
+            }
+            str = slice(_unescaped);
+        }
+        bool ok = asKey ? _encoder.writeKey(str) : _encoder.writeString(str);
+        if (!ok)
+            return fail(_encoder.error(), "Fleece encoder failed");
+        return true;
+    }
+
+
+    bool JSONStreamConverter::writeNumber(slice token) {
+        bool isInteger;
+        if (!isValidNumber(token, isInteger))
+            return fail(kFLJSONError, "invalid JSON number");
+        // The parsing functions need a C string; most numbers fit in the stack buffer:
+        char stackBuf[64];
+        string heapBuf;
+        char *buf = stackBuf;
+        if (token.size >= sizeof(stackBuf)) {
+            heapBuf.resize(token.size + 1);
+            buf = &heapBuf[0];
+        }
+        memcpy(buf, token.buf, token.size);
+        buf[token.size] = '\0';
+
+        bool ok = false, parsed = false;
+        if (isInteger) {
+            // strtoll/strtoull fail with ERANGE on overflow; then it's stored as a double.
+            char *numEnd;
+            errno = 0;
+            if (buf[0] == '-') {
+                long long i = strtoll(buf, &numEnd, 10);
+                if ((parsed = (errno != ERANGE)))
+                    ok = _encoder.writeInt(i);
+            } else {
+                unsigned long long u = strtoull(buf, &numEnd, 10);
+                if ((parsed = (errno != ERANGE)))
+                    ok = _encoder.writeUInt(u);
+            }
+        }
+        if (!parsed)
+            ok = _encoder.writeDouble(ParseDouble(buf));    // (Not locale-dependent, unlike strtod)
+        if (!ok)
+            return fail(_encoder.error(), "Fleece encoder failed");
+        return true;
+    }
+
+
+    bool JSONStreamConverter::writeLiteral(slice token) {
+        bool ok;
+        if (token == "true"_sl)
+            ok = _encoder.writeBool(true);
+        else if (token == "false"_sl)
+            ok = _encoder.writeBool(false);
+        else if (token == "null"_sl)
+            ok = _encoder.writeNull();
+        else
+            return fail(kFLJSONError, "invalid JSON literal");
+        if (!ok)
+            return fail(_encoder.error(), "Fleece encoder failed");
+        return true;
+    }
+
+
+    void JSONStreamConverter::valueWritten() {
+        if (_stack.empty())
+            _state = State::Done;
+        else
+            _state = _stack.back() ? State::DictNext : State::ArrayNext;
+    }
+
+}
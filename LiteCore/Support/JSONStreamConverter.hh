@@ -0,0 +1,85 @@
+//
+// JSONStreamConverter.hh
+//
+// Copyright (c) 2020 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "fleece/Fleece.hh"
+#include <string>
+#include <vector>
+
+namespace litecore {
+
+    /** Converts JSON to Fleece incrementally, as the JSON arrives in arbitrary-sized chunks.
+        Unlike fleece::Encoder::convertJSON, the input never has to be assembled in one buffer:
+        the only JSON retained between calls to `write` is the unfinished token (string, number
+        or literal) at the end of the previous chunk, if any. Memory use is therefore roughly
+        the size of the Fleece output plus the size of the largest single JSON token. */
+    class JSONStreamConverter {
+    public:
+        using slice = fleece::slice;
+
+        explicit JSONStreamConverter(fleece::SharedKeys sk =fleece::SharedKeys());
+
+        /** Parses the next chunk of JSON. Returns false if a parse or encoding error occurs;
+            after that, further calls are ignored and `error` describes the problem. */
+        bool write(slice json);
+
+        /** Call after the last chunk has been written. Returns the encoded Fleece document,
+            or a null Doc if the JSON was invalid or incomplete. */
+        fleece::Doc finish(FLError *outError =nullptr);
+
+        /** Resets the converter so it can be used for another document. */
+        void reset();
+
+        /** Total number of JSON bytes written so far. */
+        uint64_t bytesConsumed() const              {return _bytesConsumed;}
+
+        FLError error() const                       {return _error;}
+        const char* errorMessage() const            {return _errorMessage;}
+
+    private:
+        enum class State : uint8_t {
+            Value,              // expecting a value
+            ArrayFirst,         // after '[': expecting a value or ']'
+            ArrayNext,          // after an array item: expecting ',' or ']'
+            DictFirstKey,       // after '{': expecting a key or '}'
+            DictKey,            // after ',' in a dict: expecting a key
+            DictColon,          // after a key: expecting ':'
+            DictNext,           // after a dict value: expecting ',' or '}'
+            Done,               // top-level value is complete
+        };
+
+        size_t parse(const char *start, const char *end, bool final);
+        const char* scanString(const char *tokenStart, const char *p, const char *end);
+        bool writeString(slice token, bool asKey);
+        bool writeNumber(slice token);
+        bool writeLiteral(slice token);
+        void valueWritten();
+        bool fail(FLError, const char *message);
+
+        fleece::Encoder         _encoder;
+        std::vector<bool>       _stack;             // true for dict, false for array
+        std::string             _pending;           // Unfinished token carried between chunks
+        size_t                  _resumeScan {0};    // Where to resume scanning _pending's token
+        std::string             _unescaped;         // Scratch buffer for string unescaping
+        State                   _state {State::Value};
+        FLError                 _error {kFLNoError};
+        const char*             _errorMessage {nullptr};
+        uint64_t                _bytesConsumed {0};
+    };
+
+}
@@ -0,0 +1,134 @@
+//
+// LogBuffer.cc
+//
+// Copyright (c) 2020 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "LogBuffer.hh"
+#include <string.h>
+#include <mutex>
+#include <vector>
+
+/*
+    The buffer is a ring of kCapacity bytes. Each record is a Message followed by its args,
+    padded to a multiple of alignof(Message). `_head` and `_tail` count the bytes ever written and
+    read, so the buffer is empty when they're equal.
+
+    A record never wraps around the end of the ring; if one doesn't fit in the space left at the
+    end, that space is skipped. The consumer recognizes the skip either because there isn't room
+    for a Message there, or because the Message there has argsSize == kSkipped.
+ */
+
+namespace litecore {
+    using namespace std;
+    using namespace fleece;
+
+    static constexpr uint32_t kSkipped = UINT32_MAX;
+
+    static mutex sRegistryMutex;
+    static vector<LogBuffer*> sBuffers;     // Every thread's buffer
+
+
+    // The thread's buffer. These are trivially destructible, so they're still usable while the
+    // thread's other thread_locals are being destroyed, when something may log.
+    static thread_local LogBuffer* tBuffer = nullptr;
+    static thread_local bool tBufferAbandoned = false;
+
+
+    LogBuffer* LogBuffer::forCurrentThread() {
+        // Owns the thread's buffer, and marks it abandoned when the thread exits. (The buffer
+        // isn't deleted then, since it may still hold messages; once it's empty it may be, so
+        // tBuffer is cleared.)
+        struct Owner {
+            Owner() {
+                tBuffer = new LogBuffer;
+                lock_guard<mutex> lock(sRegistryMutex);
+                sBuffers.push_back(tBuffer);
+            }
+            ~Owner() {
+                tBuffer->_abandoned = true;
+                tBuffer = nullptr;
+                tBufferAbandoned = true;
+            }
+        };
+        if (!tBuffer && !tBufferAbandoned) {
+            static thread_local Owner tOwner;
+        }
+        return tBuffer;
+    }
+
+
+    /*static*/ void LogBuffer::forEach(function_ref<void(LogBuffer&)> callback) {
+        lock_guard<mutex> lock(sRegistryMutex);
+        for (auto i = sBuffers.begin(); i != sBuffers.end(); ) {
+            LogBuffer *buffer = *i;
+            if (buffer->_abandoned && buffer->empty()) {
+                delete buffer;
+                i = sBuffers.erase(i);
+            } else {
+                callback(*buffer);
+                ++i;
+            }
+        }
+    }
+
+
+    /*static*/ size_t LogBuffer::recordSize(size_t argsSize) {
+        constexpr size_t kAlign = alignof(Message);
+        return (sizeof(Message) + argsSize + kAlign - 1) & ~(kAlign - 1);
+    }
+
+
+    bool LogBuffer::push(const Message &message, slice args) {
+        size_t size = recordSize(args.size);
+        size_t head = _head.load(memory_order_relaxed);
+        size_t tail = _tail.load(memory_order_acquire);
+        size_t room = kCapacity - head % kCapacity;
+        size_t skip = (size > room) ? room : 0;
+        if (head + skip + size - tail > kCapacity)
+            return false;
+
+        if (skip >= sizeof(Message))
+            at(head)->argsSize = kSkipped;
+        head += skip;
+        Message *dst = at(head);
+        *dst = message;
+        dst->argsSize = uint32_t(args.size);
+        memcpy(dst + 1, args.buf, args.size);
+        _head.store(head + size, memory_order_release);
+        return true;
+    }
+
+
+    const LogBuffer::Message* LogBuffer::front() {
+        size_t tail = _tail.load(memory_order_relaxed);
+        if (tail == _head.load(memory_order_acquire))
+            return nullptr;
+        size_t room = kCapacity - tail % kCapacity;
+        if (room < sizeof(Message) || at(tail)->argsSize == kSkipped) {
+            // A skip is always followed by a record, so there's no need to check _head again
+            tail += room;
+            _tail.store(tail, memory_order_release);
+        }
+        return at(tail);
+    }
+
+
+    void LogBuffer::pop() {
+        size_t tail = _tail.load(memory_order_relaxed);
+        _tail.store(tail + recordSize(at(tail)->argsSize), memory_order_release);
+    }
+
+}
@@ -0,0 +1,89 @@
+//
+// LogBuffer.hh
+//
+// Copyright (c) 2020 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "Logging.hh"
+#include "function_ref.hh"
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+namespace litecore {
+
+    /** A lock-free queue of log messages captured by one thread, waiting to be encoded into the
+        log files by another. Each thread that logs gets its own buffer (see `forCurrentThread`),
+        so the only thing a logging thread shares is the buffer's read position.
+
+        There's a single producer, the owning thread, which calls `push`; and a single consumer,
+        which calls `front` and `pop`. (In practice the consumer is whichever thread holds the
+        logging mutex.) */
+    class LogBuffer {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        /** A captured message. Its format string and arguments, encoded by
+            `LogEncoder::captureArgs`, follow it. (The domain name isn't copied, since a
+            LogDomain is never freed.) */
+        struct Message {
+            clock::time_point time;
+            const char*     domain;
+            unsigned        objRef;
+            uint32_t        argsSize;
+            LogLevel        level;
+
+            fleece::slice args() const      {return {this + 1, argsSize};}
+        };
+
+        static constexpr size_t kCapacity = 64 * 1024;
+
+        /** The calling thread's buffer, which is created the first time; or nullptr if the thread
+            is exiting and its buffer has already been abandoned. */
+        static LogBuffer* forCurrentThread();
+
+        /** Calls `callback` for each thread's buffer. Buffers of threads that have exited are
+            deleted once they're empty. Only the consumer may call this. */
+        static void forEach(fleece::function_ref<void(LogBuffer&)> callback);
+
+        /** Adds a message. Returns false, without blocking, if there isn't room. */
+        bool push(const Message&, fleece::slice args);
+
+        /** The oldest message, or nullptr if the buffer is empty. */
+        const Message* front();
+
+        /** Removes the message returned by `front`. */
+        void pop();
+
+        bool empty() const                  {return _head.load(std::memory_order_acquire) == _tail;}
+
+    private:
+        LogBuffer() =default;
+        LogBuffer(const LogBuffer&) =delete;
+
+        static size_t recordSize(size_t argsSize);
+        Message* at(size_t index)           {return (Message*)&_data[index % kCapacity];}
+
+        struct alignas(Message) Storage { uint8_t bytes[kCapacity]; };
+
+        std::unique_ptr<Storage>    _storage {new Storage};
+        uint8_t* const              _data {_storage->bytes};
+        std::atomic<size_t>         _head {0};          // Total bytes written; owned by producer
+        std::atomic<size_t>         _tail {0};          // Total bytes read; owned by consumer
+        std::atomic<bool>           _abandoned {false}; // Set when the owning thread exits
+    };
+
+}
@@ -56,7 +56,7 @@ namespace litecore {
         auto now = LogDecoder::now();
         _writeUVarInt(now.secs);
         _lastElapsed = -(int)now.microsecs;  // so first delta will be accurate
-        _st.reset();
+        _startTime = clock::now();
     }
 
     LogEncoder::~LogEncoder() {
@@ -88,64 +88,92 @@ namespace litecore {
     }
 
 
-    int64_t LogEncoder::_timeElapsed() const {
-        return int64_t(_st.elapsed() * kTicksPerSec);
+    int64_t LogEncoder::_timeElapsed(clock::time_point when) const {
+        return chrono::duration_cast<chrono::microseconds>(when - _startTime).count();
     }
 
+
     void LogEncoder::vlog(const char *domain, const map<unsigned, string> &objectMap,
                           ObjectRef object, const char *format, va_list args) {
-        lock_guard<mutex> lock(_mutex);
+        auto now = clock::now();
+        string capturedArgs;
+        captureArgs(format, args, capturedArgs);
+        logCaptured(domain, objectMap, object, capturedArgs, now);
+    }
 
-        // Write the number of ticks elapsed since the last message:
-        auto elapsed = _timeElapsed();
-        uint64_t delta = elapsed - _lastElapsed;
-        _lastElapsed = elapsed;
-        _writeUVarInt(delta);
 
-        // Write level, domain, format string:
-        _writer.write(&_level, sizeof(_level));
-        _writeStringToken(domain ? domain : "");
+    // Returns the number of leading chars of `str` that are in `chars`. (Like `strspn`, but much
+    // faster for a few chars, since this is called for every substitution of every message.)
+    static inline size_t skipChars(const char *str, const char *chars) {
+        size_t n = 0;
+        for (; str[n] != '\0'; ++n) {
+            const char *ch = chars;
+            while (*ch && *ch != str[n])
+                ++ch;
+            if (!*ch)
+                break;
+        }
+        return n;
+    }
 
-        const auto objRef = (unsigned)object;
-        _writeUVarInt(objRef);
-        if (object != ObjectRef::None && _seenObjects.find(objRef) == _seenObjects.end()) {
-            _seenObjects.insert(objRef);
-            const auto i = objectMap.find(objRef);
-            if(i == objectMap.end()) {
-                _writer.write({"?\0", 2});
+
+    // Parses a printf-style substitution, starting just after the '%', and returns a pointer to
+    // its type character. Sets `minus` and `dotStar` if those flags are present.
+    static const char* parseSubstitution(const char *c, bool &minus, bool &dotStar) {
+        minus = dotStar = false;
+        if (*c == '-') {
+            minus = true;
+            ++c;
+        }
+        c += skipChars(c, "#0- +'");
+        while (isdigit(*c))
+            ++c;
+        if (*c == '.') {
+            ++c;
+            if (*c == '*') {
+                dotStar = true;
+                ++c;
             } else {
-                _writer.write(slice(i->second.c_str()));
-                _writer.write("\0", 1);
+                while (isdigit(*c))
+                    ++c;
             }
         }
+        return c + skipChars(c, "hljtzq");
+    }
 
-        _writeStringToken(format);
+
+    static void appendUVarInt(string &out, uint64_t n) {
+        uint8_t buf[kMaxVarintLen64];
+        out.append((const char*)buf, PutUVarInt(buf, n));
+    }
+
+
+    // Appends a tokenized string: its address, which identifies it in the token table, followed
+    // by a copy of it. (The copy is needed because a captured message may be encoded after the
+    // caller's string has been freed.)
+    static void appendToken(string &out, const char *str) {
+        out.append((const char*)&str, sizeof(str));
+        out.append(str, strlen(str) + 1);
+    }
+
+
+    // Reads a string appended by appendToken, setting `key` to its address.
+    static const char* readToken(const uint8_t* &pos, const void* &key) {
+        memcpy(&key, pos, sizeof(key));
+        auto str = (const char*)pos + sizeof(key);
+        pos = (const uint8_t*)str + strlen(str) + 1;
+        return str;
+    }
+
+
+    /*static*/ void LogEncoder::captureArgs(const char *format, va_list args, string &out) {
+        appendToken(out, format);
 
         // Parse the format string looking for substitutions:
         for (const char *c = format; *c != '\0'; ++c) {
             if (*c == '%') {
-                bool minus = false;
-                bool dotStar = false;
-                ++c;
-                if (*c == '-') {
-                    minus = true;
-                    ++c;
-                }
-                c += strspn(c, "#0- +'");
-                while (isdigit(*c))
-                    ++c;
-                if (*c == '.') {
-                    ++c;
-                    if (*c == '*') {
-                        dotStar = true;
-                        ++c;
-                    } else {
-                        while (isdigit(*c))
-                            ++c;
-                    }
-                }
-                c += strspn(c, "hljtzq");
-
+                bool minus, dotStar;
+                c = parseSubstitution(c + 1, minus, dotStar);
                 switch(*c) {
                     case 'c':
                     case 'd':
@@ -161,9 +189,8 @@ namespace litecore {
                             param = va_arg(args, long);
                         else
                             param = va_arg(args, long long);
-                        uint8_t sign = (param < 0) ? 1 : 0;
-                        _writer.write(&sign, 1);
-                        _writeUVarInt(abs(param));
+                        out.push_back((param < 0) ? 1 : 0);
+                        appendUVarInt(out, abs(param));
                         break;
                     }
                     case 'u':
@@ -179,7 +206,7 @@ namespace litecore {
                             param = va_arg(args, unsigned long);
                         else
                             param = va_arg(args, unsigned long long);
-                        _writeUVarInt(param);
+                        appendUVarInt(out, param);
                         break;
                     }
                     case 'e': case 'E':
@@ -187,7 +214,7 @@ namespace litecore {
                     case 'g': case 'G':
                     case 'a': case 'A': {
                         fleece::endian::littleEndianDouble param = va_arg(args, double);
-                        _writer.write(&param, sizeof(param));
+                        out.append((const char*)&param, sizeof(param));
                         break;
                     }
                     case 's': {
@@ -201,11 +228,10 @@ namespace litecore {
                             size = strlen(str);
                         }
                         if (minus && !dotStar) {
-                            _writeStringToken(str);
+                            appendToken(out, str);
                         } else {
-                            _writeUVarInt(size);
-                            if (size > 0)
-                                _writer.write(str, size);
+                            appendUVarInt(out, size);
+                            out.append(str, size);
                         }
                         break;
                     }
@@ -215,7 +241,7 @@ namespace litecore {
                             param = fleece::endian::encLittle64(param);
                         else
                             param = fleece::endian::encLittle32(param);
-                        _writer.write(&param, sizeof(param));
+                        out.append((const char*)&param, sizeof(param));
                         break;
                     }
 #if __APPLE__
@@ -223,8 +249,8 @@ namespace litecore {
                         // "%@" substitutes an Objective-C or CoreFoundation object's description.
                         CFTypeRef param = va_arg(args, CFTypeRef);
                         if (param == nullptr) {
-                            _writeUVarInt(6);
-                            _writer.write("(null)", 6);
+                            appendUVarInt(out, 6);
+                            out.append("(null)", 6);
                         } else {
                             CFStringRef description;
                             if (CFGetTypeID(param) == CFStringGetTypeID())
@@ -232,8 +258,8 @@ namespace litecore {
                             else
                                 description = CFCopyDescription(param);
                             nsstring_slice descSlice(description);
-                            _writeUVarInt(descSlice.size);
-                            _writer.write(descSlice);
+                            appendUVarInt(out, descSlice.size);
+                            out.append((const char*)descSlice.buf, descSlice.size);
                             if (description != param)
                                 CFRelease(description);
                         }
@@ -247,6 +273,102 @@ namespace litecore {
                 }
             }
         }
+    }
+
+
+    void LogEncoder::logCaptured(const char *domain, const map<unsigned, string> &objectMap,
+                                 ObjectRef object, slice capturedArgs, clock::time_point when)
+    {
+        lock_guard<mutex> lock(_mutex);
+
+        // Write the number of ticks elapsed since the last message. (Messages captured on
+        // different threads may arrive slightly out of order; since the delta is unsigned,
+        // such a message is given the time of the one before it.)
+        auto elapsed = max(_timeElapsed(when), _lastElapsed);
+        uint64_t delta = elapsed - _lastElapsed;
+        _lastElapsed = elapsed;
+        _writeUVarInt(delta);
+
+        // Write level, domain, format string:
+        _writer.write(&_level, sizeof(_level));
+        if (!domain)
+            domain = "";
+        _writeStringToken(domain, domain);
+
+        const auto objRef = (unsigned)object;
+        _writeUVarInt(objRef);
+        if (object != ObjectRef::None && _seenObjects.find(objRef) == _seenObjects.end()) {
+            _seenObjects.insert(objRef);
+            const auto i = objectMap.find(objRef);
+            if(i == objectMap.end()) {
+                _writer.write({"?\0", 2});
+            } else {
+                _writer.write(slice(i->second.c_str()));
+                _writer.write("\0", 1);
+            }
+        }
+
+        auto arg = (const uint8_t*)capturedArgs.buf, end = (const uint8_t*)capturedArgs.end();
+        const void *formatKey;
+        const char *format = readToken(arg, formatKey);
+        _writeStringToken(formatKey, format);
+
+        // The args are already encoded, except for tokenized strings, so walk through them
+        // to find those and copy the rest as-is:
+        auto copied = arg;
+        auto skipUVarInt = [&] {
+            uint64_t n;
+            arg += GetUVarInt(slice(arg, end), &n);
+            return n;
+        };
+        for (const char *c = format; *c != '\0'; ++c) {
+            if (*c == '%') {
+                bool minus, dotStar;
+                c = parseSubstitution(c + 1, minus, dotStar);
+                switch(*c) {
+                    case 'c':
+                    case 'd':
+                    case 'i':
+                        ++arg;              // sign byte
+                        skipUVarInt();
+                        break;
+                    case 'u':
+                    case 'x': case 'X':
+                        skipUVarInt();
+                        break;
+                    case 'e': case 'E':
+                    case 'f': case 'F':
+                    case 'g': case 'G':
+                    case 'a': case 'A':
+                        arg += sizeof(fleece::endian::littleEndianDouble);
+                        break;
+                    case 's':
+                        if (minus && !dotStar) {
+                            _writer.write(copied, arg - copied);
+                            const void *key;
+                            const char *token = readToken(arg, key);
+                            _writeStringToken(key, token);
+                            copied = arg;
+                        } else {
+                            arg += skipUVarInt();
+                        }
+                        break;
+                    case 'p':
+                        arg += sizeof(size_t);
+                        break;
+#if __APPLE__
+                    case '@':
+                        arg += skipUVarInt();
+                        break;
+#endif
+                    case '%':
+                        break;
+                    default:
+                        throw invalid_argument("Unknown type in LogEncoder format string");
+                }
+            }
+        }
+        _writer.write(copied, end - copied);
 
         if (_writer.length() > kBufferSize)
             _flush();
@@ -260,15 +382,17 @@ namespace litecore {
     }
 
 
-    void LogEncoder::_writeStringToken(const char *token) {
-        const auto name = _formats.find((size_t)token);
-        if (name == _formats.end()) {
-            const auto n = (unsigned)_formats.size();
-            _formats.insert({(size_t)token, n});
+    void LogEncoder::_writeStringToken(const void *key, const char *token) {
+        // The key is the string's address, but a caller's string may since have been freed and
+        // its address reused for a different one, so the contents have to match too:
+        auto name = _formats.find((size_t)key);
+        if (name == _formats.end() || name->second.second != token) {
+            const auto n = _tokenCount++;
+            _formats[(size_t)key] = {n, token};
             _writeUVarInt(n);
             _writer.write(token, strlen(token)+1);  // add the actual string the first time
         } else {
-            _writeUVarInt(name->second);
+            _writeUVarInt(name->second.first);
         }
     }
 
@@ -305,7 +429,7 @@ namespace litecore {
         lock_guard<mutex> lock(_mutex);
 
         // Don't flush if there's already been a flush since the timer started:
-        auto timeSinceSave = _timeElapsed() - _lastSaved;
+        auto timeSinceSave = _timeElapsed(clock::now()) - _lastSaved;
         if (timeSinceSave >= kSaveInterval) {
             _flush();
         } else if(_flushTimer) {
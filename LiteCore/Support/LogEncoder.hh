@@ -23,6 +23,7 @@
 #include "PlatformCompat.hh"
 #include "Logging.hh"
 #include <stdarg.h>
+#include <chrono>
 #include <iostream>
 #include <mutex>
 #include <unordered_map>
@@ -47,6 +48,20 @@ namespace litecore {
 
         void log(const char *domain, const std::map<unsigned, std::string>&, ObjectRef, const char *format, ...) __printflike(5, 6);
 
+        using clock = std::chrono::steady_clock;
+
+        /** Encodes a message's arguments and appends them to `out`. This is the part of logging
+            that has to be done before the `va_list`, and the strings it points to, go away; the
+            rest can be done later, on another thread, by `logCaptured`.
+            The encoding is the same as in the file, except that the format string and each
+            tokenized string (`%-s`) are captured as their address plus a copy of their contents,
+            since tokens are assigned by the encoder; the format comes first. */
+        static void captureArgs(const char *format, va_list args, std::string &out);
+
+        /** Logs a message whose arguments were captured by `captureArgs`, at time `when`. */
+        void logCaptured(const char *domain, const std::map<unsigned, std::string>&, ObjectRef,
+                         fleece::slice capturedArgs, clock::time_point when);
+
         void flush();
         
         uint64_t tellp();
@@ -66,9 +81,9 @@ namespace litecore {
         }
 
     private:
-        int64_t _timeElapsed() const;
+        int64_t _timeElapsed(clock::time_point) const;
         void _writeUVarInt(uint64_t);
-        void _writeStringToken(const char *token);
+        void _writeStringToken(const void *key, const char *token);
         void _flush();
         void _scheduleFlush();
         void performScheduledFlush();
@@ -77,11 +92,12 @@ namespace litecore {
         fleece::Writer _writer;
         std::ostream &_out;
         std::unique_ptr<actor::Timer> _flushTimer;
-        fleece::Stopwatch _st;
+        clock::time_point _startTime;
         int64_t _lastElapsed {0};
         int64_t _lastSaved {0};
         LogLevel _level;
-        std::unordered_map<size_t, unsigned> _formats;
+        std::unordered_map<size_t, std::pair<unsigned, std::string>> _formats;
+        unsigned _tokenCount {0};
         std::unordered_set<unsigned> _seenObjects;
     };
 
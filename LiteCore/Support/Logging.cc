@@ -20,11 +20,16 @@
 #include "StringUtil.hh"
 #include "LogEncoder.hh"
 #include "LogDecoder.hh"
+#include "LogBuffer.hh"
 #include "PlatformIO.hh"
 #include "FilePath.hh"
+#include "ThreadUtil.hh"
 #include <string>
 #include <fstream>
 #include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
 #include <ctime>
 
 #if __APPLE__
@@ -53,10 +58,10 @@ namespace litecore {
     static LogDomain _ActorLog("Actor");
     LogDomain &ActorLog = _ActorLog;
 
-    LogLevel LogDomain::sCallbackMinLevel = LogLevel::Uninitialized;
+    atomic<LogLevel> LogDomain::sCallbackMinLevel {LogLevel::Uninitialized};
     static LogDomain::Callback_t sCallback = LogDomain::defaultCallback;
     static bool sCallbackPreformatted = false;
-    LogLevel LogDomain::sFileMinLevel = LogLevel::None;
+    atomic<LogLevel> LogDomain::sFileMinLevel {LogLevel::None};
     unsigned LogDomain::slastObjRef {0};
     map<unsigned, string> LogDomain::sObjNames;
     static ofstream* sFileOut[5] = {}; // File per log level
@@ -67,6 +72,14 @@ namespace litecore {
     static string sInitialMessage;  // For rotation, goes at top of each log
     static mutex sLogMutex;
 
+    // Binary log messages are captured into per-thread LogBuffers, and encoded by a drainer thread:
+    static atomic<bool> sLogBuffering {false};      // True while binary file logging is enabled
+    static atomic<bool> sLogDrainerIdle {false};    // True while the drainer waits for messages
+    static bool sLogDrainerRunning = false;
+    static condition_variable sLogDrainCond;
+    static vector<unsigned> sUnregisteredObjs;      // To be removed from sObjNames by the drainer
+    static constexpr auto kLogDrainInterval = chrono::milliseconds(10);
+
     static const char* const kLevelNames[] = {"debug", "verbose", "info",
                 "warning", "error", nullptr};
     static const char *kLevels[] = {"***", "", "", "WARNING", "ERROR"};
@@ -208,6 +221,10 @@ namespace litecore {
         sMaxCount = max(0, options.maxCount);
         const bool teardown = needsTeardown(options);
         if(teardown) {
+            // Stop buffering before draining, so no new message is left behind in a buffer:
+            sLogBuffering = false;
+            if (sLogDrainerRunning)
+                drainBuffers(LogBuffer::clock::now());
             teardownEncoders();
             teardownFileOut();
         }
@@ -226,6 +243,11 @@ namespace litecore {
             setupFileOut();
             if(!options.isPlaintext) {
                 setupEncoders();
+                if (!sLogDrainerRunning) {
+                    sLogDrainerRunning = true;
+                    thread(runBufferDrainer).detach();
+                }
+                sLogBuffering = true;
             }
 
             if (!sInitialMessage.empty()) {
@@ -245,7 +267,18 @@ namespace litecore {
             static once_flag f;
             call_once(f, []{
                 atexit([]{
-                    if (sLogMutex.try_lock()) {     // avoid deadlock on crash inside logging code
+                    // Use try_lock to avoid deadlock on crash inside logging code; but retry
+                    // a few times, since the drainer thread holds the mutex while it works.
+                    bool locked = false;
+                    for (int i = 0; i < 100 && !(locked = sLogMutex.try_lock()); ++i)
+                        this_thread::sleep_for(chrono::milliseconds(1));
+                    if (locked) {
+                        sLogBuffering = false;
+                        if (sLogDrainerRunning) {
+                            drainBuffers(LogBuffer::clock::now());
+                            sLogDrainerRunning = false;
+                            sLogDrainCond.notify_all();
+                        }
                         if (sLogEncoder[0]) {
                             for(auto& encoder : sLogEncoder) {
                                 encoder->log("", {}, LogEncoder::None,
@@ -301,7 +334,7 @@ namespace litecore {
 
     // Only call while holding sLogMutex!
     LogLevel LogDomain::_callbackLogLevel() noexcept {
-        auto level = sCallbackMinLevel;
+        LogLevel level = sCallbackMinLevel;
         if (level == LogLevel::Uninitialized) {
             // Allow 'LiteCoreLog' env var to set initial callback level:
             level = kC4Cpp_DefaultLog.levelFromEnvironment();
@@ -357,7 +390,7 @@ namespace litecore {
         _level = level;
         // The effective level is the level at which I will actually trigger because there is
         // a place for my output to go:
-        _effectiveLevel = max((LogLevel)_level, min(_callbackLogLevel(), sFileMinLevel));
+        _effectiveLevel = max((LogLevel)_level, min(_callbackLogLevel(), sFileMinLevel.load()));
     }
 
 
@@ -377,16 +410,148 @@ namespace litecore {
 
     static char sFormatBuffer[2048];
 
+
+    // Captures a message into the calling thread's LogBuffer. Returns false if it doesn't fit, or
+    // if the thread is exiting and no longer has a buffer.
+    static bool bufferMessage(LogLevel level, const char *domain, unsigned objRef,
+                              const char *fmt, va_list args)
+    {
+        // (tArgs is initialized before the buffer, so it's destroyed after the buffer is
+        // abandoned; it mustn't be used once there's no buffer.)
+        static thread_local string tArgs;
+        LogBuffer *buffer = LogBuffer::forCurrentThread();
+        if (!buffer)
+            return false;
+        LogBuffer::Message message;
+        message.time = LogBuffer::clock::now();
+        message.domain = domain;
+        message.objRef = objRef;
+        message.level = level;
+
+        tArgs.clear();
+        va_list args2;
+        va_copy(args2, args);
+        LogEncoder::captureArgs(fmt, args2, tArgs);
+        va_end(args2);
+
+        if (!buffer->push(message, fleece::slice(tArgs)))
+            return false;
+        // Wake the drainer if it's waiting. The fence pairs with the one in runBufferDrainer:
+        // either the drainer sees this message, or this sees that the drainer is idle. (Locking
+        // the mutex ensures it's really waiting, not just about to, so the notification isn't
+        // lost.)
+        atomic_thread_fence(memory_order_seq_cst);
+        if (sLogDrainerIdle.load(memory_order_relaxed) && sLogDrainerIdle.exchange(false)) {
+            { lock_guard<mutex> lock(sLogMutex); }
+            sLogDrainCond.notify_one();
+        }
+        return true;
+    }
+
+
+    static void invokeCallback(LogDomain &domain, LogLevel level, const char *fmt, ...);
+
+
+    // Encodes the messages in the threads' LogBuffers that were logged before `until`, in time
+    // order, and returns how many there were. Must have sLogMutex held.
+    // A message that can't be written is dropped, and the error is reported to the callback.
+    size_t LogDomain::drainBuffers(LogBuffer::clock::time_point until) {
+        // Any object unregistered by now has logged its last message, which is in a buffer:
+        vector<unsigned> unregistered;
+        swap(unregistered, sUnregisteredObjs);
+
+        vector<LogBuffer*> buffers;
+        LogBuffer::forEach([&](LogBuffer &buffer) {
+            buffers.push_back(&buffer);
+        });
+
+        size_t count = 0;
+        while (true) {
+            LogBuffer *next = nullptr;
+            const LogBuffer::Message *message = nullptr;
+            for (auto buffer : buffers) {
+                auto m = buffer->front();
+                if (m && m->time <= until && (!message || m->time < message->time)) {
+                    next = buffer;
+                    message = m;
+                }
+            }
+            if (!message)
+                break;
+
+            // The encoder is missing if file logging was turned off after the message was logged:
+            if (auto encoder = sLogEncoder[(int)message->level]) {
+                try {
+                    encoder->logCaptured(message->domain, sObjNames,
+                                         (LogEncoder::ObjectRef)message->objRef,
+                                         message->args(), message->time);
+                    if (encoder->tellp() >= sMaxSize)
+                        Logging::rotateLog(message->level);
+                } catch (const exception &x) {
+                    if (sCallback && LogLevel::Error >= _callbackLogLevel())
+                        invokeCallback(kC4Cpp_DefaultLog, LogLevel::Error,
+                                       "Couldn't write to binary log: %s", x.what());
+                }
+            }
+            next->pop();
+            ++count;
+        }
+
+        for (auto objRef : unregistered)
+            sObjNames.erase(objRef);
+        return count;
+    }
+
+
+    // Body of the drainer thread, which encodes buffered messages into the log files.
+    void LogDomain::runBufferDrainer() {
+        SetThreadName("Logging (Couchbase Lite Core)");
+        unique_lock<mutex> lock(sLogMutex);
+        while (sLogDrainerRunning) {
+            try {
+                if (drainBuffers(LogBuffer::clock::now()) > 0) {
+                    sLogDrainCond.wait_for(lock, kLogDrainInterval);
+                } else {
+                    // Nothing's being logged, so wait until something is, instead of polling.
+                    // The fence pairs with the one in bufferMessage.
+                    sLogDrainerIdle = true;
+                    atomic_thread_fence(memory_order_seq_cst);
+                    if (drainBuffers(LogBuffer::clock::now()) == 0)   // (in case it just was)
+                        sLogDrainCond.wait(lock);
+                    sLogDrainerIdle = false;
+                }
+            } catch (const exception &x) {
+                // An exception escaping this thread would terminate the process
+                sLogDrainerIdle = false;
+                if (sCallback && LogLevel::Error >= _callbackLogLevel())
+                    invokeCallback(kC4Cpp_DefaultLog, LogLevel::Error,
+                                   "Binary log drainer caught exception: %s", x.what());
+                sLogDrainCond.wait_for(lock, kLogDrainInterval);
+            }
+        }
+    }
+
     void LogDomain::vlog(LogLevel level, unsigned objRef, bool doCallback, const char *fmt, va_list args) {
         if (_effectiveLevel == LogLevel::Uninitialized)
             computeLevel();
         if (!willLog(level))
             return;
 
+        // (If the callback level is still uninitialized, this is true, and it's checked below.)
+        const bool toCallback = doCallback && level >= sCallbackMinLevel;
+        bool toFile = level >= sFileMinLevel;
+
+        // A binary log message is captured into this thread's LogBuffer without locking; the
+        // drainer thread will encode it:
+        if (toFile && sLogBuffering && bufferMessage(level, _name, objRef, fmt, args))
+            toFile = false;
+        if (!toCallback && !toFile)
+            return;
+
         unique_lock<mutex> lock(sLogMutex);
 
         // Invoke the client callback:
-        if (doCallback && sCallback && level >= _callbackLogLevel()) {
+        if (toCallback && sCallback && level >= _callbackLogLevel()) {
             auto obj = getObject(objRef);
 
             va_list args2;
@@ -412,8 +577,11 @@ namespace litecore {
             va_end(args2);
         }
 
-        // Write to the encoded log file:
-        if (level >= sFileMinLevel) {
+        // Write to the log file. If this thread's LogBuffer was full, first encode what's in the
+        // buffers, so the messages stay in order:
+        if (toFile) {
+            if (sLogBuffering)
+                drainBuffers(LogBuffer::clock::now());
             dylog(level, _name, (LogEncoder::ObjectRef)objRef, fmt, args);
         }
     }
@@ -539,7 +707,10 @@ namespace litecore {
 
     void LogDomain::unregisterObject(unsigned objectRef) {
         unique_lock<mutex> lock(sLogMutex);
-        sObjNames.erase(objectRef);
+        if (sLogDrainerRunning)
+            sUnregisteredObjs.push_back(objectRef);     // Its messages may not be encoded yet
+        else
+            sObjNames.erase(objectRef);
     }
 
 
@@ -20,6 +20,7 @@
 #include "fleece/slice.hh"
 #include "PlatformCompat.hh"
 #include <atomic>
+#include <chrono>
 #include <map>
 #include <string>
 #include <stdarg.h>
@@ -112,6 +113,8 @@ public:
     static void setCallback(Callback_t callback, bool preformatted);
 
     /** Registers (or unregisters) a file to which log messages will be written in binary format.
+        Binary messages are captured into a per-thread buffer and written by a background thread,
+        so logging doesn't block; calling this again writes out any that are still buffered.
         @param options The options to use when performing file logging
         @param initialMessage  First message that will be written to the log, e.g. version info */
     static void writeEncodedLogsTo(const LogFileOptions& options,
@@ -137,6 +140,8 @@ private:
     static void _invalidateEffectiveLevels() noexcept;
 
     void dylog(LogLevel level, const char* domain, unsigned objRef, const char *fmt, va_list);
+    static size_t drainBuffers(std::chrono::steady_clock::time_point until);
+    static void runBufferDrainer();
 
     std::atomic<LogLevel> _effectiveLevel {LogLevel::Uninitialized};
     std::atomic<LogLevel> _level;
@@ -146,8 +151,8 @@ private:
     static unsigned slastObjRef;
     static std::map<unsigned,std::string> sObjNames;
     static LogDomain* sFirstDomain;
-    static LogLevel sCallbackMinLevel;
-    static LogLevel sFileMinLevel;
+    static std::atomic<LogLevel> sCallbackMinLevel;
+    static std::atomic<LogLevel> sFileMinLevel;
 };
 
 extern "C" LogDomain kC4Cpp_DefaultLog;
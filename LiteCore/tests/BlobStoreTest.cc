@@ -0,0 +1,165 @@
+//
+// BlobStoreTest.cc
+//
+// Copyright (c) 2020 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "LiteCoreTest.hh"
+#include "BlobStore.hh"
+#include "Benchmark.hh"
+
+using namespace std;
+using namespace fleece;
+
+
+class BlobStoreTest : public TestFixture {
+public:
+    FilePath dir;
+
+    BlobStoreTest() {
+        dir = FilePath::tempDirectory().subdirectoryNamed("BlobStoreTest");
+        dir.delRecursive();
+    }
+
+    ~BlobStoreTest() {
+        dir.delRecursive();
+    }
+
+    static string blobData(int i) {
+        return "This is blob #" + to_string(i);
+    }
+};
+
+
+TEST_CASE_METHOD(BlobStoreTest, "Blob store layout", "[blob]") {
+    static constexpr int kNumBlobs = 100;
+    vector<blobKey> keys;
+    for (int i = 0; i < kNumBlobs; ++i)
+        keys.push_back(blobKey::computeFrom(slice(blobData(i))));
+
+    // Create a store in the old flat layout, with all the files in one directory:
+    dir.mkdir();
+    for (int i = 0; i < kNumBlobs; ++i) {
+        FileWriteStream out(dir[keys[i].filename()], "wb");
+        out.write(slice(blobData(i)));
+        out.close();
+    }
+
+    {
+        // Opening it read-only leaves it as it is:
+        BlobStore::Options options = BlobStore::Options::defaults;
+        options.writeable = false;
+        BlobStore store(dir, &options);
+        CHECK(!store.isSharded());
+        CHECK(store.count() == kNumBlobs);
+        CHECK(store.get(keys[7]).path().dir().path() == dir.path());
+        CHECK(store.get(keys[7]).contents() == slice(blobData(7)));
+    }
+
+    // Opening it writeable moves the files into subdirectories:
+    BlobStore store(dir);
+    CHECK(store.isSharded());
+    CHECK(store.count() == kNumBlobs);
+    for (int i = 0; i < kNumBlobs; ++i) {
+        Blob blob = store.get(keys[i]);
+        CHECK(blob.path().dir().parentDir().path() == dir.path());
+        CHECK(blob.contents() == slice(blobData(i)));
+    }
+
+    // New blobs go into subdirectories too:
+    blobKey newKey = store.put("new blob"_sl).key();
+    CHECK(store.get(newKey).path().dir().parentDir().path() == dir.path());
+    CHECK(store.count() == kNumBlobs + 1);
+
+    // Another instance's changes are noticed, although the counts are cached:
+    uint64_t size = store.totalSize();
+    {
+        BlobStore store2(dir);
+        CHECK(store2.isSharded());
+        store2.get(keys[0]).del();
+        store2.put("another new blob"_sl);
+        CHECK(store2.count() == kNumBlobs + 1);
+    }
+    CHECK(store.count() == kNumBlobs + 1);
+    CHECK(store.totalSize() == size - blobData(0).size() + "another new blob"_sl.size);
+
+    // Garbage collection looks in the subdirectories:
+    store.deleteAllExcept({keys[1].filename(), keys[2].filename()});
+    CHECK(store.count() == 2);
+    CHECK(store.get(keys[1]).exists());
+    CHECK(!store.get(keys[3]).exists());
+    CHECK(!store.get(newKey).exists());
+
+    // A layout from the future can't be opened:
+    {
+        FileWriteStream out(dir["layout"], "wb");
+        out.write("99"_sl);
+        out.close();
+    }
+    ExpectException(error::LiteCore, error::DatabaseTooNew, [&]{
+        BlobStore store3(dir);
+    });
+}
+
+
+TEST_CASE_METHOD(BlobStoreTest, "Blob store compaction during writes", "[blob]") {
+    BlobStore store(dir);
+    blobKey key1 = blobKey::computeFrom(slice(blobData(1)));
+    blobKey key2 = blobKey::computeFrom(slice(blobData(2)));
+    string data1 = blobData(1), data2 = blobData(2);
+
+    // Leave the partial data of a download nobody is resuming:
+    {
+        BlobWriteStream stream(store, key2);
+        stream.write(slice(data2.data(), 5));
+    }
+    CHECK(store.partialBlobPath(key2).exists());
+
+    // Compacting doesn't delete the files of streams that are open:
+    BlobWriteStream temp(store);
+    temp.write(slice(data1.data(), 5));
+    BlobWriteStream partial(store, key1);
+    partial.write(slice(data1.data(), 5));
+    store.deleteAllExcept({});
+    CHECK(store.partialBlobPath(key1).exists());
+    CHECK(!store.partialBlobPath(key2).exists());
+
+    temp.write(slice(data1).from(5));
+    CHECK(temp.install(&key1).contents() == slice(data1));
+    partial.write(slice(data1).from(5));
+    CHECK(partial.install(&key1).contents() == slice(data1));
+}
+
+
+TEST_CASE_METHOD(BlobStoreTest, "Blob store count benchmark", "[blob][.Perf]") {
+    static constexpr int kNumBlobs = 100000;
+    BlobStore store(dir);
+    for (int i = 0; i < kNumBlobs; ++i)
+        store.put(slice(blobData(i)));
+
+    Benchmark first, cached;
+    first.start();
+    CHECK(store.count() == kNumBlobs);
+    first.stop();
+    for (int i = 0; i < 10; ++i) {
+        cached.start();
+        CHECK(store.count() == kNumBlobs);
+        cached.stop();
+    }
+    fprintf(stderr, "Counting %d blobs, first time: ", kNumBlobs);
+    first.printReport();
+    fprintf(stderr, "Counting %d blobs, cached:     ", kNumBlobs);
+    cached.printReport();
+}
@@ -0,0 +1,210 @@
+//
+// ChunkedBlobTest.cc
+//
+// Copyright (c) 2020 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "LiteCoreTest.hh"
+#include "ChunkedBlob.hh"
+#include "Benchmark.hh"
+#include <random>
+
+using namespace std;
+using namespace fleece;
+
+
+class ChunkedBlobTest : public TestFixture {
+public:
+    FilePath dir;
+    unique_ptr<BlobStore> store;
+
+    ChunkedBlobTest() {
+        dir = FilePath::tempDirectory().subdirectoryNamed("ChunkedBlobTest");
+        dir.delRecursive();
+        openStore(true);
+    }
+
+    ~ChunkedBlobTest() {
+        store.reset();
+        dir.delRecursive();
+    }
+
+    void openStore(bool chunked) {
+        BlobStore::Options options = BlobStore::Options::defaults;
+        options.chunked = chunked;
+        store.reset();
+        store = make_unique<BlobStore>(dir, &options);
+    }
+
+    // Writes a blob in pieces of random sizes, so chunking can't depend on the write sizes.
+    blobKey writeBlob(slice data, mt19937 &rng) {
+        BlobWriteStream out(*store);
+        while (data.size > 0) {
+            size_t n = min(data.size, size_t(rng() % 50000));
+            out.write(slice(data.buf, n));
+            data.moveStart(n);
+        }
+        return out.install().key();
+    }
+
+    static string randomData(size_t size, mt19937 &rng) {
+        string data(size, '\0');
+        for (auto &c : data)
+            c = char(rng());
+        return data;
+    }
+};
+
+
+TEST_CASE_METHOD(ChunkedBlobTest, "Chunk boundaries", "[blob]") {
+    mt19937 rng(1);
+    string data = randomData(1000000, rng);
+    size_t chunks = 0;
+    for (slice rest(data); rest.size > 0; ++chunks) {
+        size_t size = ChunkedBlobWriter::findBoundary(rest);
+        CHECK(size <= ChunkedBlobWriter::kMaxChunkSize);
+        if (size < rest.size)
+            CHECK(size >= ChunkedBlobWriter::kMinChunkSize);
+        rest.moveStart(size);
+    }
+    // Sizes are random, but their average should be near the target:
+    size_t avg = data.size() / chunks;
+    C4Log("%zu chunks, average size %zu", chunks, avg);
+    CHECK(avg > ChunkedBlobWriter::kAvgChunkSize / 2);
+    CHECK(avg < ChunkedBlobWriter::kAvgChunkSize * 2);
+}
+
+
+TEST_CASE_METHOD(ChunkedBlobTest, "Chunked blob dedup", "[blob]") {
+    mt19937 rng(2);
+    string original = randomData(2000000, rng);
+    blobKey key1 = writeBlob(slice(original), rng);
+    Blob blob1 = store->get(key1);
+    CHECK(blob1.isChunked());
+    CHECK(blob1.contentLength() == int64_t(original.size()));
+    uint64_t sizeAfterFirst = store->totalSize();
+    CHECK(sizeAfterFirst >= original.size());
+
+    // An edited copy shares all but the chunks around the edits:
+    string edited = original;
+    edited.insert(500000, "This is an insertion");
+    edited.erase(1500000, 1000);
+    blobKey key2 = writeBlob(slice(edited), rng);
+    CHECK(key2 != key1);
+    uint64_t added = store->totalSize() - sizeAfterFirst;
+    C4Log("Storing the edited copy added %llu bytes", (unsigned long long)added);
+    CHECK(added < 5 * ChunkedBlobWriter::kMaxChunkSize);
+    CHECK(store->count() == 2);
+
+    // Both read back correctly, including with random access:
+    CHECK(store->get(key1).contents() == slice(original));
+    CHECK(store->get(key2).contents() == slice(edited));
+    auto reader = store->get(key2).read();
+    char buf[100000];
+    for (int i = 0; i < 100; ++i) {
+        size_t pos = rng() % edited.size();
+        size_t count = rng() % sizeof(buf);
+        reader->seek(pos);
+        size_t n = reader->read(buf, count);
+        REQUIRE(n == min(count, edited.size() - pos));
+        REQUIRE(memcmp(buf, &edited[pos], n) == 0);
+    }
+
+    // Small blobs aren't chunked:
+    blobKey key3 = store->put("small"_sl).key();
+    CHECK(!store->get(key3).isChunked());
+
+    // Chunked blobs are still readable with chunking turned off:
+    openStore(false);
+    CHECK(store->get(key1).contents() == slice(original));
+
+    // Garbage collection deletes only the chunks of deleted blobs:
+    store->deleteAllExcept({key2.filename()});
+    CHECK(!store->get(key1).exists());
+    CHECK(!store->get(key3).exists());
+    CHECK(store->get(key2).contents() == slice(edited));
+    CHECK(store->totalSize() < sizeAfterFirst + added);
+}
+
+
+TEST_CASE_METHOD(ChunkedBlobTest, "Chunked blob benchmark", "[blob][.Perf]") {
+    // Stores a series of versions of a file, each an edited copy of the previous one, then
+    // reads them all back; once whole and once chunked.
+    static constexpr size_t kSize = 10 * 1024 * 1024;
+    static constexpr int kVersions = 10, kEditsPerVersion = 10;
+    mt19937 rng(3);
+    vector<string> versions {randomData(kSize, rng)};
+    for (int v = 1; v < kVersions; ++v) {
+        string next = versions.back();
+        for (int e = 0; e < kEditsPerVersion; ++e) {
+            size_t pos = rng() % next.size();
+            next.replace(pos, rng() % 100, randomData(rng() % 100, rng));
+        }
+        versions.push_back(next);
+    }
+
+    for (bool chunked : {false, true}) {
+        dir.delRecursive();
+        openStore(chunked);
+        Benchmark writing, reading;
+        vector<blobKey> keys;
+        uint64_t logicalSize = 0;
+        for (auto &version : versions) {
+            writing.start();
+            keys.push_back(writeBlob(slice(version), rng));
+            writing.stop();
+            logicalSize += version.size();
+        }
+        for (auto &key : keys) {
+            reading.start();
+            alloc_slice contents = store->get(key).contents();
+            reading.stop();
+            CHECK(contents.size > 0);
+        }
+        uint64_t diskSize = store->totalSize();
+        fprintf(stderr, "%s: %llu MB of blobs in %llu MB of files (dedup ratio %.2f)\n",
+                (chunked ? "Chunked" : "Whole  "), (unsigned long long)logicalSize >> 20,
+                (unsigned long long)diskSize >> 20, double(logicalSize) / diskSize);
+        double mb = double(kSize) / (1024 * 1024);
+        fprintf(stderr, "    Write: ");
+        writing.printReport(1.0 / mb, "MB");
+        fprintf(stderr, "    Read:  ");
+        reading.printReport(1.0 / mb, "MB");
+    }
+}
+
+
+TEST_CASE_METHOD(ChunkedBlobTest, "Chunked blob compaction during write", "[blob]") {
+    mt19937 rng(3);
+    string data = randomData(1000000, rng);
+    blobKey key;
+    {
+        BlobWriteStream out(*store);
+        out.write(slice(data.data(), data.size() / 2));
+        // Chunks written so far aren't referenced by any manifest yet, but aren't deleted:
+        uint64_t chunksSize = store->chunkStore()->totalSize();
+        CHECK(chunksSize > 0);
+        store->chunkStore()->deleteAllExcept({});
+        CHECK(store->chunkStore()->totalSize() == chunksSize);
+        out.write(slice(data.data() + data.size() / 2, data.size() - data.size() / 2));
+        key = out.install().key();
+    }
+    CHECK(store->get(key).contents() == slice(data));
+
+    // Once the writer is gone, unreferenced chunks can be deleted again:
+    store->deleteAllExcept({});
+    CHECK(store->count() == 0);
+    CHECK(store->chunkStore()->count() == 0);
+}
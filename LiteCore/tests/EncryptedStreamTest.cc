@@ -0,0 +1,189 @@
+//
+// EncryptedStreamTest.cc
+//
+// Copyright (c) 2020 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "LiteCoreTest.hh"
+#include "EncryptedStream.hh"
+#include "Error.hh"
+#include "Benchmark.hh"
+#include <random>
+#include <string>
+
+using namespace std;
+using namespace fleece;
+using namespace litecore;
+
+
+// In-memory streams, so the tests can look at and alter the encrypted bytes.
+class StringWriteStream : public WriteStream {
+public:
+    explicit StringWriteStream(string &out)        :_out(out) { }
+    void write(slice data) override                 {_out.append((const char*)data.buf, data.size);}
+    void close() override                           { }
+private:
+    string &_out;
+};
+
+
+class StringReadStream : public SeekableReadStream {
+public:
+    explicit StringReadStream(const string &in)     :_in(in) { }
+    uint64_t getLength() const override             {return _in.size();}
+    void seek(uint64_t pos) override                {_pos = min(size_t(pos), _in.size());}
+    size_t read(void *dst, size_t count) override {
+        count = min(count, _in.size() - _pos);
+        memcpy(dst, &_in[_pos], count);
+        _pos += count;
+        return count;
+    }
+    void close() override                           { }
+private:
+    const string &_in;
+    size_t _pos {0};
+};
+
+
+static string randomData(size_t size) {
+    mt19937 rng(size);
+    string data(size, '\0');
+    for (auto &c : data)
+        c = char(rng());
+    return data;
+}
+
+
+// Encrypts `data` in `chunkSize` writes, with either the old or the new format.
+static string encrypt(const string &data, slice key, bool v2, size_t chunkSize = 1000) {
+    string encrypted;
+    auto out = make_shared<StringWriteStream>(encrypted);
+    unique_ptr<WriteStream> writer;
+    if (v2)
+        writer.reset(new EncryptedWriteStreamV2(out, kAES256, key));
+    else
+        writer.reset(new EncryptedWriteStream(out, kAES256, key));
+    for (size_t pos = 0; pos < data.size(); pos += chunkSize)
+        writer->write(slice(&data[pos], min(chunkSize, data.size() - pos)));
+    writer->close();
+    return encrypted;
+}
+
+
+static string decrypt(const string &encrypted, slice key) {
+    auto reader = NewEncryptedReadStream(make_shared<StringReadStream>(encrypted), kAES256, key);
+    string data(size_t(reader->getLength()), '\0');
+    size_t n = reader->read(&data[0], data.size());
+    CHECK(n == data.size());
+    return data;
+}
+
+
+static const uint8_t kKeyBytes[32] = {0xCC, 0xCC, 0xCC, 0xCC, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+static const slice kKey(kKeyBytes, sizeof(kKeyBytes));
+
+
+TEST_CASE("Encrypted stream formats", "[Encryption]") {
+    // The interesting sizes are around the block size, and big enough to be done in parallel:
+    for (size_t size : {0, 1, 4095, 4096, 4097, 8192, 100000, 1000000}) {
+        INFO("size " << size);
+        string data = randomData(size);
+        for (bool v2 : {false, true}) {
+            INFO("v2 = " << v2);
+            string encrypted = encrypt(data, kKey, v2, (size < 100000 ? 1000 : size));
+            if (v2) {
+                CHECK(encrypted.size() == EncryptedStreamV2::kHeaderSize + size
+                                          + (size / 4096 + 1) * EncryptedStreamV2::kTagSize);
+                CHECK(EncryptedStreamV2::cleartextLength(encrypted.size()) == size);
+            }
+            // Both formats are read by NewEncryptedReadStream:
+            CHECK(decrypt(encrypted, kKey) == data);
+        }
+    }
+}
+
+
+TEST_CASE("Encrypted stream random access", "[Encryption]") {
+    string data = randomData(100000);
+    string encrypted = encrypt(data, kKey, true);
+    auto reader = NewEncryptedReadStream(make_shared<StringReadStream>(encrypted), kAES256, kKey);
+    REQUIRE(reader->getLength() == data.size());
+    mt19937 rng(42);
+    char buf[20000];
+    for (int i = 0; i < 200; ++i) {
+        size_t pos = rng() % data.size();
+        size_t count = rng() % sizeof(buf);
+        reader->seek(pos);
+        size_t n = reader->read(buf, count);
+        REQUIRE(n == min(count, data.size() - pos));
+        REQUIRE(memcmp(buf, &data[pos], n) == 0);
+    }
+}
+
+
+TEST_CASE("Encrypted stream tampering", "[Encryption][!throws]") {
+    ExpectingExceptions x;
+    string data = randomData(10000);
+    string encrypted = encrypt(data, kKey, true);
+    string bad;
+
+    SECTION("Altered byte") {
+        bad = encrypted;
+        bad[EncryptedStreamV2::kHeaderSize + 5000] ^= 0x01;
+    }
+    SECTION("Swapped blocks") {
+        bad = encrypted;
+        size_t block = EncryptedStreamV2::kEncryptedBlockSize;
+        auto first = bad.begin() + EncryptedStreamV2::kHeaderSize;
+        swap_ranges(first, first + block, first + block);
+    }
+    SECTION("Truncated") {
+        // Drop the final partial block, leaving two valid but non-final blocks:
+        bad = encrypted.substr(0, EncryptedStreamV2::kHeaderSize
+                                  + 2 * EncryptedStreamV2::kEncryptedBlockSize
+                                  + EncryptedStreamV2::kTagSize);
+    }
+    try {
+        decrypt(bad, kKey);
+        FAIL("Decrypting tampered data didn't fail");
+    } catch (const error &e) {
+        CHECK(e.domain == error::LiteCore);
+        CHECK(e.code == error::CorruptData);
+    }
+}
+
+
+TEST_CASE("Encrypted stream benchmark", "[Encryption][.Perf]") {
+    static constexpr size_t kSize = 16 * 1024 * 1024;
+    static constexpr int kReps = 10;
+    string data = randomData(kSize);
+    for (bool v2 : {false, true}) {
+        Benchmark writing, reading;
+        for (int i = 0; i < kReps; ++i) {
+            writing.start();
+            string encrypted = encrypt(data, kKey, v2, 1024 * 1024);
+            writing.stop();
+            reading.start();
+            string decrypted = decrypt(encrypted, kKey);
+            reading.stop();
+            CHECK(decrypted.size() == kSize);
+        }
+        fprintf(stderr, "Version %d format, %zu MB:\n", (v2 ? 2 : 1), kSize / (1024 * 1024));
+        fprintf(stderr, "    Write: ");
+        writing.printReport(1.0 / (kSize / (1024 * 1024)), "MB");
+        fprintf(stderr, "    Read:  ");
+        reading.printReport(1.0 / (kSize / (1024 * 1024)), "MB");
+    }
+}
@@ -0,0 +1,74 @@
+//
+// JSONStreamConverterTest.cc
+//
+// Copyright (c) 2020 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "LiteCoreTest.hh"
+#include "JSONStreamConverter.hh"
+
+using namespace std;
+using namespace fleece;
+using namespace litecore;
+
+
+TEST_CASE("JSONStreamConverter", "[JSON]") {
+    const string json = "{\"name\": \"Zegpold\", \"n\": [1, -2, 3.5, 1e3, 18446744073709551615],"
+                        " \"esc\": \"a\\\"b\\\\c\\n\\u00e9\\ud83d\\ude00\", \"t\": true,"
+                        " \"f\": false, \"nil\": null, \"empty\": {}, \"nested\": [[], [{\"x\": \"y\"}]]}";
+    Doc expected = Doc::fromJSON(slice(json));
+    REQUIRE(expected);
+
+    // Feed the JSON in chunks of every size from 1 byte up, to exercise token boundaries:
+    for (size_t chunkSize = 1; chunkSize <= json.size(); ++chunkSize) {
+        INFO("chunkSize = " << chunkSize);
+        JSONStreamConverter converter;
+        for (size_t pos = 0; pos < json.size(); pos += chunkSize)
+            REQUIRE(converter.write(slice(json.data() + pos, min(chunkSize, json.size() - pos))));
+        FLError err;
+        Doc doc = converter.finish(&err);
+        REQUIRE(doc);
+        CHECK(err == kFLNoError);
+        CHECK(doc.root().isEqual(expected.root()));
+    }
+
+    // Numbers too long for a small buffer, including an integer too big for 64 bits:
+    string longNumbers = "[0." + string(100, '1') + ", " + string(100, '9') + ", -1" + string(80, '0')
+                       + "e-80]";
+    {
+        JSONStreamConverter converter;
+        REQUIRE(converter.write(slice(longNumbers)));
+        Doc doc = converter.finish();
+        REQUIRE(doc);
+        Array numbers = doc.root().asArray();
+        CHECK(numbers[0].asDouble() == Approx(0.111111111111));
+        CHECK(numbers[1].asDouble() == Approx(1e100));
+        CHECK(numbers[2].asDouble() == Approx(-1.0));
+    }
+
+    // Invalid or truncated JSON, including unpaired UTF-16 surrogates, leading zeros and raw
+    // control characters:
+    for (const char *bad : {"{\"a\": }", "[1, 2", "{\"a\" 1}", "[tru]", "\"abc", "[1] 2",
+                            "\"\\udc00\"", "\"x\\udc00y\"", "\"\\ud83d\"", "\"\\ud83dx\"",
+                            "\"\\ud83d\\u0041\"", "01", "[-01]", "1.", "[1.e5]", "-",
+                            "\"tab\there\"", "{\"a\nb\": 1}"}) {
+        INFO("JSON = " << bad);
+        JSONStreamConverter converter;
+        converter.write(slice(bad));
+        FLError err;
+        CHECK(!converter.finish(&err));
+        CHECK(err != kFLNoError);
+    }
+}
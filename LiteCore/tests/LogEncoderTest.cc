@@ -24,6 +24,7 @@
 #include <regex>
 #include <sstream>
 #include <fstream>
+#include <thread>
 
 #define DATESTAMP "\\w+, \\d{2}/\\d{2}/\\d{2}"
 #define TIMESTAMP "\\d{2}:\\d{2}:\\d{2}\\.\\d{6}\\| "
@@ -176,6 +177,32 @@ TEST_CASE("LogEncoder tokens", "[Log]") {
 }
 
 
+TEST_CASE("LogEncoder reused string addresses", "[Log]") {
+    // A format or tokenized string's memory may be reused for a different string after it's
+    // logged, as with a caller-owned format passed to c4vlog:
+    stringstream out;
+    {
+        LogEncoder logger(out, LogLevel::Info);
+        char format[32], name[32];
+        strcpy(format, "Opened %-s");
+        strcpy(name, "default");
+        logger.log("DB", {}, LogEncoder::None, format, name);
+        strcpy(name, "conflicts");
+        logger.log("DB", {}, LogEncoder::None, format, name);
+        strcpy(format, "Closed %-s");
+        logger.log("DB", {}, LogEncoder::None, format, name);
+        logger.log("DB", {}, LogEncoder::None, format, name);
+    }
+    string result = dumpLog(out.str(), {"", "", "INFO", "", ""});
+    regex expected(TIMESTAMP "---- Logging begins on " DATESTAMP " ----\\n"
+                   TIMESTAMP "\\[DB\\] INFO: Opened default\\n"
+                   TIMESTAMP "\\[DB\\] INFO: Opened conflicts\\n"
+                   TIMESTAMP "\\[DB\\] INFO: Closed conflicts\\n"
+                   TIMESTAMP "\\[DB\\] INFO: Closed conflicts\\n");
+    CHECK(regex_match(result, expected));
+}
+
+
 TEST_CASE("LogEncoder auto-flush", "[Log]") {
     stringstream out;
     LogEncoder logger(out, LogLevel::Info);
@@ -296,3 +323,111 @@ TEST_CASE("Logging plaintext", "[Log]") {
     LogDomain::setFileLogLevel(LogLevel::None); // undo writeEncodedLogsTo() call above
 }
 
+
+TEST_CASE("Logging from multiple threads", "[Log]") {
+    char folderName[64];
+    sprintf(folderName, "Log_Threads_%lld/", chrono::milliseconds(time(nullptr)).count());
+    FilePath tmpLogDir = FilePath::tempDirectory()[folderName];
+    tmpLogDir.delRecursive();
+    tmpLogDir.mkdir();
+
+    // Messages are captured into per-thread buffers and encoded on another thread; make sure
+    // they all arrive, each thread's in order, with their arguments intact:
+    static constexpr int kThreads = 4, kMessages = 5000;
+    LogFileOptions fileOptions { tmpLogDir.canonicalPath(), LogLevel::Info, 100 * 1024 * 1024, 1, false };
+    LogDomain::writeEncodedLogsTo(fileOptions, "Hello");
+    vector<thread> threads;
+    for (int t = 0; t < kThreads; t++) {
+        threads.emplace_back([t] {
+            for (int i = 0; i < kMessages; i++)
+                DBLog.logNoCallback(LogLevel::Info, "Thread %d message %d %-s '%s'",
+                                    t, i, "token", "string");
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+
+    // Switching to another directory writes out everything logged to the first:
+    sprintf(folderName, "Log_Threads2_%lld/", chrono::milliseconds(time(nullptr)).count());
+    FilePath other = FilePath::tempDirectory()[folderName];
+    other.mkdir();
+    LogFileOptions fileOptions2 { other.canonicalPath(), LogLevel::Info, 1024, 1, false };
+    LogDomain::writeEncodedLogsTo(fileOptions2, "Hello");
+
+    vector<string> infoFiles;
+    tmpLogDir.forEachFile([&infoFiles](const FilePath f) {
+        if(f.path().find("info") != string::npos)
+            infoFiles.push_back(f.path());
+    });
+    REQUIRE(infoFiles.size() == 1);
+    ifstream fin(infoFiles[0], ios::binary);
+    LogDecoder decoder(fin);
+    stringstream out;
+    decoder.decodeTo(out, vector<string> { "", "", "INFO", "", "" });
+
+    vector<int> nextMessage(kThreads, 0);
+    int count = 0;
+    string line;
+    while (getline(out, line)) {
+        auto pos = line.find("Thread ");
+        if (pos == string::npos)
+            continue;
+        int t, i;
+        REQUIRE(sscanf(&line[pos], "Thread %d message %d", &t, &i) == 2);
+        REQUIRE(t >= 0);
+        REQUIRE(t < kThreads);
+        CHECK(i == nextMessage[t]);
+        nextMessage[t] = i + 1;
+        CHECK(line.find("token 'string'") != string::npos);
+        ++count;
+    }
+    CHECK(count == kThreads * kMessages);
+
+    LogDomain::setFileLogLevel(LogLevel::None); // undo writeEncodedLogsTo() call above
+}
+
+
+TEST_CASE("Logging during thread exit", "[Log]") {
+    char folderName[64];
+    sprintf(folderName, "Log_ThreadExit_%lld/", chrono::milliseconds(time(nullptr)).count());
+    FilePath tmpLogDir = FilePath::tempDirectory()[folderName];
+    tmpLogDir.delRecursive();
+    tmpLogDir.mkdir();
+
+    // An object whose destructor logs while the thread exits, after the thread's LogBuffer has
+    // been abandoned; the message is written synchronously instead:
+    struct LogsOnExit {
+        ~LogsOnExit() {
+            DBLog.logNoCallback(LogLevel::Info, "Goodbye from thread_local");
+        }
+    };
+    LogFileOptions fileOptions { tmpLogDir.canonicalPath(), LogLevel::Info, 100 * 1024 * 1024, 1, false };
+    LogDomain::writeEncodedLogsTo(fileOptions, "Hello");
+    thread([] {
+        static thread_local LogsOnExit tLogsOnExit;     // Destroyed after the LogBuffer's owner
+        (void)&tLogsOnExit;
+        DBLog.logNoCallback(LogLevel::Info, "Hello from thread");
+    }).join();
+
+    sprintf(folderName, "Log_ThreadExit2_%lld/", chrono::milliseconds(time(nullptr)).count());
+    FilePath other = FilePath::tempDirectory()[folderName];
+    other.mkdir();
+    LogFileOptions fileOptions2 { other.canonicalPath(), LogLevel::Info, 1024, 1, false };
+    LogDomain::writeEncodedLogsTo(fileOptions2, "Hello");
+
+    vector<string> infoFiles;
+    tmpLogDir.forEachFile([&infoFiles](const FilePath f) {
+        if(f.path().find("info") != string::npos)
+            infoFiles.push_back(f.path());
+    });
+    REQUIRE(infoFiles.size() == 1);
+    ifstream fin(infoFiles[0], ios::binary);
+    LogDecoder decoder(fin);
+    stringstream out;
+    decoder.decodeTo(out, vector<string> { "", "", "INFO", "", "" });
+    string result = out.str();
+    CHECK(result.find("Hello from thread") != string::npos);
+    CHECK(result.find("Goodbye from thread_local") != string::npos);
+
+    LogDomain::setFileLogLevel(LogLevel::None); // undo writeEncodedLogsTo() call above
+}
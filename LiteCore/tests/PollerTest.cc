@@ -0,0 +1,182 @@
+//
+// PollerTest.cc
+//
+// Copyright © 2020 Couchbase. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "LiteCoreTest.hh"
+#include "Poller.hh"
+#include "Stopwatch.hh"
+#include <condition_variable>
+#include <random>
+#include <vector>
+
+#ifndef _WIN32      // These tests use pipes, which Windows doesn't have
+#include <sys/resource.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace litecore;
+using namespace litecore::net;
+
+
+// A set of pipes whose read ends are watched by a Poller.
+class PollerTest {
+public:
+    Poller poller;
+    vector<int> readFDs, writeFDs;
+    mutex m;
+    condition_variable cond;
+    int notified {-1};
+    int failedReads {0};        // Listeners run on the Poller's thread, so they can't CHECK
+    struct rlimit savedLimit {};
+    bool changedLimit {false};
+
+    PollerTest() {
+        poller.start();
+    }
+
+    ~PollerTest() {
+        poller.stop();
+        for (int fd : readFDs)  ::close(fd);
+        for (int fd : writeFDs) ::close(fd);
+        if (changedLimit)
+            setrlimit(RLIMIT_NOFILE, &savedLimit);
+    }
+
+    // Opens up to `n` pipes, limited by the process's fd limit. Returns the number opened.
+    size_t openPipes(size_t n) {
+        struct rlimit limit;
+        if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < 2*n + 64) {
+            if (!changedLimit) {
+                savedLimit = limit;
+                changedLimit = true;
+            }
+            limit.rlim_cur = min(rlim_t(2*n + 64), limit.rlim_max);
+            setrlimit(RLIMIT_NOFILE, &limit);
+            getrlimit(RLIMIT_NOFILE, &limit);
+            n = min(n, size_t(limit.rlim_cur - 64) / 2);
+        }
+        for (size_t i = 0; i < n; ++i) {
+            int fd[2];
+            REQUIRE(::pipe(fd) == 0);
+            readFDs.push_back(fd[0]);
+            writeFDs.push_back(fd[1]);
+        }
+        return n;
+    }
+
+    // Registers a one-shot readable listener on pipe `i`, which consumes the byte and notifies.
+    void listen(size_t i) {
+        int fd = readFDs[i];
+        poller.addListener(fd, Poller::kReadable, [this, fd, i] {
+            char c;
+            bool ok = (::read(fd, &c, 1) == 1);
+            unique_lock<mutex> lock(m);
+            if (!ok)
+                ++failedReads;
+            notified = int(i);
+            cond.notify_all();
+        });
+    }
+
+    // Writes a byte to pipe `i` and waits for its listener to be called.
+    void trigger(size_t i) {
+        unique_lock<mutex> lock(m);
+        notified = -1;
+        REQUIRE(::write(writeFDs[i], "x", 1) == 1);
+        REQUIRE(cond.wait_for(lock, chrono::seconds(5), [&]{return notified >= 0;}));
+        CHECK(notified == int(i));
+        CHECK(failedReads == 0);
+    }
+};
+
+
+TEST_CASE_METHOD(PollerTest, "Poller readable", "[Poller]") {
+    openPipes(4);
+    for (size_t i = 0; i < 4; ++i)
+        listen(i);
+    trigger(2);
+    trigger(0);
+
+    // A listener is one-shot; re-registering it gets another notification:
+    listen(2);
+    trigger(2);
+
+    // Removed listeners aren't called:
+    poller.removeListeners(readFDs[3]);
+    REQUIRE(::write(writeFDs[3], "x", 1) == 1);
+    trigger(1);
+    {
+        unique_lock<mutex> lock(m);
+        CHECK(!cond.wait_for(lock, chrono::milliseconds(100), [&]{return notified == 3;}));
+    }
+}
+
+
+TEST_CASE_METHOD(PollerTest, "Poller readable and writeable", "[Poller]") {
+    openPipes(1);
+    // A pipe's write end is immediately writeable:
+    int writeable = 0;
+    poller.addListener(writeFDs[0], Poller::kWriteable, [&] {
+        unique_lock<mutex> lock(m);
+        ++writeable;
+        cond.notify_all();
+    });
+    {
+        unique_lock<mutex> lock(m);
+        REQUIRE(cond.wait_for(lock, chrono::seconds(5), [&]{return writeable > 0;}));
+    }
+    listen(0);
+    trigger(0);
+    CHECK(writeable == 1);
+
+    // interrupt() calls the listeners right away:
+    listen(0);
+    {
+        unique_lock<mutex> lock(m);
+        notified = -1;
+    }
+    ::write(writeFDs[0], "x", 1);  // so the listener's read succeeds
+    poller.interrupt(readFDs[0]);
+    unique_lock<mutex> lock(m);
+    CHECK(cond.wait_for(lock, chrono::seconds(5), [&]{return notified == 0;}));
+    CHECK(failedReads == 0);
+}
+
+
+TEST_CASE_METHOD(PollerTest, "Poller wakeup latency", "[Poller][.Perf]") {
+    static constexpr size_t kNumSockets = 10000, kNumWakeups = 10000;
+    size_t n = openPipes(kNumSockets);
+    if (n < kNumSockets)
+        C4Warn("Poller latency test: only %zu fds available, using %zu pipes", 2*n+64, n);
+    for (size_t i = 0; i < n; ++i)
+        listen(i);
+
+    mt19937 rng(12345);
+    uniform_int_distribution<size_t> pick(0, n - 1);
+    fleece::Stopwatch st;
+    for (size_t w = 0; w < kNumWakeups; ++w) {
+        size_t i = pick(rng);
+        trigger(i);
+        listen(i);
+    }
+    st.stop();
+    C4Log("Poller wakeup latency with %zu idle fds: %.2f µs",
+          n, st.elapsedMS() * 1000.0 / kNumWakeups);
+    st.printReport("Poller wakeup", kNumWakeups, "wakeup");
+}
+
+#endif // _WIN32
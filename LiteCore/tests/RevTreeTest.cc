@@ -17,6 +17,8 @@
 //
 
 #include "RevTree.hh"
+#include "RawRevTree.hh"
+#include "Benchmark.hh"
 
 #include "LiteCoreTest.hh"
 
@@ -50,3 +52,126 @@ TEST_CASE("RevID Parsing") {
     CHECK(!r.tryParse("1-aa "_sl));
     CHECK(!r.tryParse(" 1-aa"_sl));
 }
+
+
+// Encodes a rev tree with a main branch of `depth` revisions "N-aaaa", and a conflicting branch
+// "3-bbbb" off of "2-aaaa". Every revision has a `bodySize`-byte body. The server (remote 1)
+// has "2-aaaa".
+static alloc_slice encodedTestTree(unsigned depth, size_t bodySize) {
+    RevTree tree;
+    int httpStatus;
+    alloc_slice body(string(bodySize, 'x'));
+    const Rev *parent = nullptr;
+    for (unsigned gen = 1; gen <= depth; ++gen) {
+        revidBuffer revID(slice(to_string(gen) + "-aaaa"));
+        parent = tree.insert(revID, body, Rev::kNoFlags, parent, false, false, httpStatus);
+        REQUIRE(parent);
+    }
+    REQUIRE(tree.insert(revidBuffer("3-bbbb"_sl), body, Rev::kNoFlags, revidBuffer("2-aaaa"_sl),
+                        true, true, httpStatus));
+    tree.setLatestRevisionOnRemote(1, tree.get(revidBuffer("2-aaaa"_sl)));
+    tree.saved(42);
+    return tree.encode();
+}
+
+
+TEST_CASE("RawRevTree", "[RevTree]") {
+    alloc_slice encoded = encodedTestTree(10, 100);
+    RevTree tree(encoded, 42);
+    RawRevTree raw(encoded, 42);
+
+    // Every revision matches the decoded one:
+    REQUIRE(raw.count() == tree.size());
+    unsigned i = 0;
+    for (auto rev = raw.currentRevision(); rev; rev = rev.next(), ++i) {
+        const Rev *expected = tree.get(i);
+        INFO("Revision " << i);
+        CHECK(rev.revID() == expected->revID);
+        CHECK(rev.flags() == expected->flags);
+        CHECK(rev.sequence() == expected->sequence);
+        CHECK(rev.body() == expected->body());
+        if (expected->parent)
+            CHECK(rev.parent().revID() == expected->parent->revID);
+        else
+            CHECK(!rev.parent());
+        CHECK(raw.get(rev.revID()) == rev);
+        CHECK(raw.get(i) == rev);
+    }
+    CHECK(i == tree.size());
+
+    CHECK(raw.currentRevision().revID() == revidBuffer("10-aaaa"_sl));
+    CHECK(raw.hasConflict() == tree.hasConflict());
+    CHECK(raw.hasConflict());
+    CHECK(raw.latestRevisionOnRemote(1).revID() == revidBuffer("2-aaaa"_sl));
+    CHECK(!raw.latestRevisionOnRemote(2));
+    CHECK(!raw.get(revidBuffer("99-aaaa"_sl)));
+    CHECK(!raw.get(i));
+
+    auto rev2 = raw.get(revidBuffer("2-aaaa"_sl)), conflict = raw.get(revidBuffer("3-bbbb"_sl));
+    CHECK(rev2.isAncestorOf(raw.currentRevision()));
+    CHECK(rev2.isAncestorOf(conflict));
+    CHECK(!conflict.isAncestorOf(raw.currentRevision()));
+    CHECK(conflict.isLeaf());
+    CHECK(conflict.isConflict());
+}
+
+
+TEST_CASE("RevTree lazy decoding", "[RevTree]") {
+    alloc_slice encoded = encodedTestTree(10, 100);
+    RevTree tree;
+    tree.decodeLazily(encoded, 42);
+    CHECK(!tree.isDecoded());
+    CHECK(tree.encodedTree() == encoded);
+    CHECK(tree.hasConflict());          // answered without decoding
+    CHECK(!tree.isDecoded());
+
+    SECTION("Accessor") {
+        const Rev *current = tree.currentRevision();
+        CHECK(tree.isDecoded());
+        CHECK(current->revID == revidBuffer("10-aaaa"_sl));
+        CHECK(tree.size() == 11);
+        CHECK(tree.encode() == encoded);
+    }
+    SECTION("Mutation") {
+        int httpStatus;
+        CHECK(tree.insert(revidBuffer("11-aaaa"_sl), alloc_slice("body"), Rev::kNoFlags,
+                          revidBuffer("10-aaaa"_sl), false, false, httpStatus));
+        CHECK(tree.isDecoded());
+        CHECK(tree.size() == 12);
+        CHECK(tree.currentRevision()->revID == revidBuffer("11-aaaa"_sl));
+    }
+}
+
+
+TEST_CASE("RevTree current revision benchmark", "[RevTree][.Perf]") {
+    static constexpr int kBatchSize = 1000, kBatches = 100;
+    for (unsigned depth : {2, 20, 100}) {
+        alloc_slice encoded = encodedTestTree(depth, 1000);
+        size_t total = 0;
+
+        Benchmark decoded, inPlace;
+        for (int batch = 0; batch < kBatches; ++batch) {
+            decoded.start();
+            for (int i = 0; i < kBatchSize; ++i) {
+                RevTree tree(encoded, 42);
+                auto rev = tree.currentRevision();
+                total += rev->revID.size + rev->body().size;
+            }
+            decoded.stop();
+
+            inPlace.start();
+            for (int i = 0; i < kBatchSize; ++i) {
+                RawRevTree tree(encoded, 42);
+                auto rev = tree.currentRevision();
+                total += rev.revID().size + rev.body().size;
+            }
+            inPlace.stop();
+        }
+        CHECK(total > 0);
+        fprintf(stderr, "Current revision of %u-deep tree (%zu bytes):\n", depth, encoded.size);
+        fprintf(stderr, "    RevTree:    ");
+        decoded.printReport(1.0 / kBatchSize, "read");
+        fprintf(stderr, "    RawRevTree: ");
+        inPlace.printReport(1.0 / kBatchSize, "read");
+    }
+}
@@ -0,0 +1,119 @@
+//
+// WebSocketImplTest.cc
+//
+// Copyright © 2020 Couchbase. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "LiteCoreTest.hh"
+#include "WebSocketImpl.hh"
+#include <random>
+#include <vector>
+
+using namespace std;
+using namespace fleece;
+using namespace litecore;
+using namespace litecore::websocket;
+
+
+// A framing WebSocketImpl whose "socket" just collects the bytes it's asked to write, and whose
+// delegate collects the messages it receives.
+class CapturingWebSocket : public WebSocketImpl, public Delegate {
+public:
+    string wire;                        // Everything written to the socket
+    vector<alloc_slice> payloads;       // Payload buffers of frames written
+    vector<alloc_slice> received;       // Messages delivered to the delegate
+
+    explicit CapturingWebSocket(Role role)
+    :WebSocketImpl(alloc_slice("ws://localhost/db"_sl), role, true, Parameters{})
+    {
+        WebSocket::connect(this);
+    }
+
+    // Delegate methods:
+    void onWebSocketGotTLSCertificate(slice) override   { }
+    void onWebSocketConnect() override                  { }
+    void onWebSocketClose(CloseStatus) override         { }
+    void onWebSocketMessage(Message *msg) override      {received.push_back(msg->data);}
+
+protected:
+    void connect() override                             { }   // (no connect timeout)
+    void closeSocket() override                         { }
+    void receiveComplete(size_t) override               { }
+    void requestClose(int, slice) override              { }
+
+    void sendBytes(alloc_slice bytes) override {
+        wire.append((const char*)bytes.buf, bytes.size);
+    }
+
+    void sendFrameBytes(alloc_slice header, alloc_slice payload) override {
+        payloads.push_back(payload);
+        WebSocketImpl::sendFrameBytes(header, payload);
+    }
+};
+
+
+// Sends messages with sendBuffer from a WebSocket with the given role, and feeds the bytes
+// written to one with the other role.
+static void testSendBuffer(Role role) {
+    Retained<CapturingWebSocket> sender = new CapturingWebSocket(role);
+    Retained<CapturingWebSocket> receiver = new CapturingWebSocket(
+                                        role == Role::Client ? Role::Server : Role::Client);
+
+    // Sizes that use each of the three frame header lengths:
+    mt19937 rng(1);
+    vector<string> messages;
+    for (size_t size : {0, 1, 125, 126, 1000, 65535, 65536, 100000}) {
+        string message(size, '\0');
+        for (auto &c : message)
+            c = char(rng());
+        messages.push_back(message);
+
+        alloc_slice buffer(message);
+        const void *bufferAddr = buffer.buf;
+        sender->sendBuffer(move(buffer));
+
+        // The payload should be sent from the caller's buffer, not a copy; a client masks it
+        // in place. (A short one could come out of the random mask unchanged.)
+        REQUIRE(sender->payloads.size() == messages.size());
+        alloc_slice sent = sender->payloads.back();
+        CHECK(sent.buf == bufferAddr);
+        if (role == Role::Server)
+            CHECK(sent == slice(message));
+        else if (size >= 100)
+            CHECK(sent != slice(message));
+    }
+
+    // The peer should decode the frames back into the original messages, however the bytes
+    // are split up on arrival:
+    slice wire(sender->wire);
+    while (wire.size > 0) {
+        size_t n = min(wire.size, size_t(rng() % 5000));
+        receiver->onReceive(slice(wire.buf, n));
+        wire.moveStart(n);
+    }
+    REQUIRE(receiver->received.size() == messages.size());
+    for (size_t i = 0; i < messages.size(); ++i)
+        CHECK(receiver->received[i] == slice(messages[i]));
+}
+
+
+TEST_CASE("WebSocketImpl sendBuffer", "[WebSocket]") {
+    SECTION("Client") {
+        testSendBuffer(Role::Client);
+    }
+    SECTION("Server") {
+        testSendBuffer(Role::Server);
+    }
+}
@@ -0,0 +1,99 @@
+//
+// WebSocketMaskTest.cc
+//
+// Copyright © 2020 Couchbase. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "LiteCoreTest.hh"
+#include "WebSocketMask.hh"
+#include "Stopwatch.hh"
+#include <random>
+#include <vector>
+
+using namespace std;
+using namespace litecore::websocket;
+
+
+static void naiveMask(char *dst, const char *src, size_t length, const char mask[4]) {
+    for (size_t i = 0; i < length; ++i)
+        dst[i] = src[i] ^ mask[i % 4];
+}
+
+
+static vector<char> randomBytes(size_t size, mt19937 &rng) {
+    vector<char> bytes(size);
+    for (auto &b : bytes)
+        b = char(rng());
+    return bytes;
+}
+
+
+TEST_CASE("WebSocket masking", "[WebSocket]") {
+    C4Log("WebSocket masking implementation is %s", WebSocketMaskImplementation());
+    mt19937 rng(1234);
+    const char mask[4] = {'\x5A', '\xC3', '\x01', '\xFF'};
+    vector<char> src = randomBytes(300, rng);
+
+    // Every length up to a few vectors' worth, at every alignment within a vector:
+    for (size_t offset = 0; offset < 32; ++offset) {
+        for (size_t length = 0; length + offset <= src.size(); length += (length < 70 ? 1 : 37)) {
+            vector<char> expected(length), actual(length), portable(length);
+            naiveMask(expected.data(), &src[offset], length, mask);
+            ApplyWebSocketMask(actual.data(), &src[offset], length, mask);
+            ApplyWebSocketMaskPortable(portable.data(), &src[offset], length, mask);
+            INFO("offset " << offset << ", length " << length);
+            REQUIRE(actual == expected);
+            REQUIRE(portable == expected);
+        }
+    }
+
+    // In place; masking twice restores the original:
+    vector<char> data = src;
+    ApplyWebSocketMask(data.data(), data.data(), data.size(), mask);
+    vector<char> expected(src.size());
+    naiveMask(expected.data(), src.data(), src.size(), mask);
+    CHECK(data == expected);
+    ApplyWebSocketMask(data.data(), data.data(), data.size(), mask);
+    CHECK(data == src);
+
+    // Overlapping, with dst below src (as when the receiver strips a frame header):
+    for (size_t shift : {1, 4, 10, 14}) {
+        data = src;
+        ApplyWebSocketMask(data.data(), data.data() + shift, src.size() - shift, mask);
+        naiveMask(expected.data(), src.data() + shift, src.size() - shift, mask);
+        INFO("shift " << shift);
+        CHECK(equal(data.begin(), data.end() - shift, expected.begin()));
+    }
+}
+
+
+TEST_CASE("WebSocket masking performance", "[WebSocket][.Perf]") {
+    static constexpr size_t kSize = 64 * 1024 * 1024;
+    static constexpr int kReps = 10;
+    mt19937 rng(5678);
+    vector<char> src = randomBytes(kSize, rng), dst(kSize);
+    const char mask[4] = {'\x12', '\x34', '\x56', '\x78'};
+
+    auto bench = [&](const char *name, void (*fn)(char*, const char*, size_t, const char*)) {
+        fleece::Stopwatch st;
+        for (int i = 0; i < kReps; ++i)
+            fn(dst.data(), src.data(), kSize, mask);
+        double secs = st.elapsed();
+        C4Log("Masking (%-8s): %8.1f MB/sec", name, kReps * (kSize / 1.0e6) / secs);
+    };
+    bench("byte", naiveMask);
+    bench("word", ApplyWebSocketMaskPortable);
+    bench(WebSocketMaskImplementation(), ApplyWebSocketMask);
+}
@@ -23,6 +23,7 @@
 #include "Actor.hh"
 #include "Batcher.hh"
 #include "Codec.hh"
+#include "Headers.hh"
 #include "Error.hh"
 #include "Logging.hh"
 #include "StringUtil.hh"
@@ -31,6 +32,7 @@
 #include <algorithm>
 #include <assert.h>
 #include <atomic>
+#include <deque>
 #include <mutex>
 #include <map>
 #include <unordered_map>
@@ -46,8 +48,18 @@ namespace litecore { namespace blip {
     static const size_t kDefaultFrameSize = 4096;       // Default size of frame
     static const size_t kBigFrameSize = 16384;          // Max size of frame
 
+    // Frames at least this big are handed to the WebSocket in the buffer they were built in;
+    // smaller ones are copied into a buffer of their own size:
+    static const size_t kMinHandoffFrameSize = kBigFrameSize / 2;
+
     static const auto kDefaultCompressionLevel = (Deflater::CompressionLevel)6;
 
+    // Messages at least this big are compressed at the fastest level, unless the link is slow:
+    static const size_t kLargeMessageSize = 32 * 1024;
+
+    // Below this many bytes/sec, the bandwidth saved by compressing harder is worth the CPU time:
+    static const double kSlowLinkBandwidth = 1.0e6;
+
     const char* const kMessageTypeNames[8] = {"REQ", "RES", "ERR", "?3?",
                                               "ACKREQ", "AKRES", "?6?", "?7?"};
 
@@ -55,36 +67,106 @@ namespace litecore { namespace blip {
     static LogDomain BLIPMessagesLog("BLIPMessages", LogLevel::None);
 
 
-    /** Queue of outgoing messages; each message gets to send one frame in turn. */
-    class MessageQueue : public vector<Retained<MessageOut>> {
+    /** Hash index of outgoing messages by number and direction, so an incoming ACK can find
+        its message in constant time. ACK messages themselves aren't indexed; nothing looks
+        them up, and their numbers belong to the peer's messages. */
+    class MessageIndex {
     public:
-        MessageQueue()                          { }
-        MessageQueue(size_t rsrv)               {reserve(rsrv);}
+        MessageOut* find(MessageNo msgNo, bool isResponse) const {
+            auto i = _map.find(key(msgNo, isResponse));
+            return (i != _map.end()) ? i->second.get() : nullptr;
+        }
+
+        bool contains(MessageOut *msg) const {
+            return !msg->isAck() && find(msg->number(), msg->isResponse()) == msg;
+        }
+
+        void add(MessageOut *msg) {
+            if (!msg->isAck())
+                _map.emplace(key(msg->number(), msg->isResponse()), msg);
+        }
+
+        bool remove(MessageOut *msg) {
+            return !msg->isAck() && _map.erase(key(msg->number(), msg->isResponse())) > 0;
+        }
 
-        bool contains(MessageOut *msg) const    {return find(begin(), end(), msg) != end();}
+        size_t size() const                     {return _map.size();}
+        bool empty() const                      {return _map.empty();}
+        void clear()                            {_map.clear();}
+
+        template <class FN> void forEach(FN fn) const {
+            for (auto &item : _map)
+                fn(item.second.get());
+        }
+
+    private:
+        static uint64_t key(MessageNo msgNo, bool isResponse) {return (msgNo << 1) | isResponse;}
+
+        unordered_map<uint64_t, Retained<MessageOut>> _map;
+    };
+
+
+    /** Queue of outgoing messages; each message gets to send one frame in turn.
+        Urgent and normal messages are kept in separate FIFO rings, so pushing and popping are
+        constant-time. Urgent messages are sent first, except that after each full round of the
+        urgent ring (one frame per urgent message) a normal frame is sent, so normal messages
+        can't be starved. */
+    class MessageQueue {
+    public:
+        bool empty() const                      {return _urgent.empty() && _normal.empty();}
+        size_t size() const                     {return _urgent.size() + _normal.size();}
+
+        /** True if the next message to be popped is urgent. */
+        bool nextIsUrgent() const {
+            return !_urgent.empty() && (_normal.empty() || _urgentSinceNormal < _urgent.size());
+        }
+
+        bool contains(MessageOut *msg) const    {return _index.contains(msg);}
 
         MessageOut* findMessage(MessageNo msgNo, bool isResponse) const {
-            auto i = find_if(begin(), end(), [&](const Retained<MessageOut> &msg) {
-                return msg->number() == msgNo && msg->isResponse() == isResponse;
-            });
-            return (i != end()) ? *i : nullptr;
+            return _index.find(msgNo, isResponse);
+        }
+
+        void push(MessageOut *msg) {
+            (msg->urgent() ? _urgent : _normal).emplace_back(msg);
+            _index.add(msg);
         }
 
         Retained<MessageOut> pop() {
-            if (empty())
+            deque<Retained<MessageOut>> *ring;
+            if (nextIsUrgent()) {
+                ring = &_urgent;
+                ++_urgentSinceNormal;
+            } else if (!_normal.empty()) {
+                ring = &_normal;
+                _urgentSinceNormal = 0;
+            } else {
                 return nullptr;
-            Retained<MessageOut> msg(front());
-            erase(begin());
+            }
+            Retained<MessageOut> msg = move(ring->front());
+            ring->pop_front();
+            _index.remove(msg);
             return msg;
         }
 
-        bool remove(MessageOut *msg) {
-            auto i = find(begin(), end(), msg);
-            if (i == end())
-                return false;
-            erase(i);
-            return true;
+        template <class FN> void forEach(FN fn) const {
+            for (auto &msg : _urgent)
+                fn(msg.get());
+            for (auto &msg : _normal)
+                fn(msg.get());
+        }
+
+        void clear() {
+            _urgent.clear();
+            _normal.clear();
+            _index.clear();
+            _urgentSinceNormal = 0;
         }
+
+    private:
+        deque<Retained<MessageOut>> _urgent, _normal;
+        MessageIndex _index;
+        size_t _urgentSinceNormal {0};      // Urgent frames sent since the last normal one
     };
 
 
@@ -103,33 +185,43 @@ namespace litecore { namespace blip {
         unique_ptr<error>       _closingWithError;
         actor::ActorBatcher<BLIPIO,websocket::Message> _incomingFrames;
         MessageQueue            _outbox;
-        MessageQueue            _icebox;
-        bool                    _writeable {true};
+        MessageIndex            _icebox;
+        bool                    _writeable {false};     // becomes true when WebSocket connects
         MessageMap              _pendingRequests, _pendingResponses;
         atomic<MessageNo>       _lastMessageNo {0};
         MessageNo               _numRequestsReceived {0};
         Deflater                _outputCodec;
+        Deflater::CompressionLevel const _compressionLevel;
         Inflater                _inputCodec;
-        unique_ptr<uint8_t[]>   _frameBuf;
+        alloc_slice             _frameBuf;                  // Buffer outgoing frames are built in
         RequestHandlers         _requestHandlers;
         size_t                  _maxOutboxDepth {0}, _totalOutboxDepth {0}, _countOutboxDepth {0};
         uint64_t                _totalBytesWritten {0}, _totalBytesRead {0};
         Stopwatch               _timeOpen;
+        double                  _lastWriteableTime {-1};    // _timeOpen time of last writeable
+        uint64_t                _bytesAtLastWriteable {0};  // _totalBytesWritten at that time
+        double                  _linkBandwidth {0};         // Estimated bytes/sec; 0 if unknown
         atomic_flag             _connectedWebSocket = ATOMIC_FLAG_INIT;
+        bool const              _offeredDictionary;         // Client offered kWSProtocolNameWithDictionary
+        atomic<bool>            _gotHTTPResponse {false};   // onWebSocketGotHTTPResponse called?
 
     public:
 
-        BLIPIO(Connection *connection, WebSocket *webSocket, Deflater::CompressionLevel compressionLevel)
+        BLIPIO(Connection *connection, WebSocket *webSocket,
+               Deflater::CompressionLevel compressionLevel, bool dictionaryOption)
         :Actor(string("BLIP[") + connection->name() + "]")
         ,Logging(BLIPLog)
         ,_connection(connection)
         ,_webSocket(webSocket)
         ,_incomingFrames(this, &BLIPIO::_onWebSocketMessages)
-        ,_outbox(10)
         ,_outputCodec(compressionLevel)
+        ,_compressionLevel(compressionLevel)
+        ,_offeredDictionary(dictionaryOption && webSocket->role() == Role::Client)
         {
             _pendingRequests.reserve(10);
             _pendingResponses.reserve(10);
+            if (dictionaryOption && webSocket->role() == Role::Server)
+                _useDictionary();
         }
 
         void start() {
@@ -180,6 +272,14 @@ namespace litecore { namespace blip {
         virtual void onWebSocketGotHTTPResponse(int status,
                                                 const websocket::Headers &headers) override
         {
+            // If the server accepted the dictionary protocol, switch to it before any frames are
+            // sent or received; both of those happen after this, in onWebSocketConnect.
+            // (A server Connection is told by its kCompressionDictionaryOption instead.)
+            slice protocol = headers["Sec-WebSocket-Protocol"_sl];
+            if (_offeredDictionary
+                    && protocol.hasPrefix(slice(Connection::kWSProtocolNameWithDictionary)))
+                enqueue(&BLIPIO::_useDictionary);
+            _gotHTTPResponse = true;
             _connection->gotHTTPResponse(status, headers);
         }
 
@@ -189,6 +289,13 @@ namespace litecore { namespace blip {
 
         // websocket::Delegate interface:
         virtual void onWebSocketConnect() override {
+            if (_offeredDictionary && !_gotHTTPResponse) {
+                // The socket factory didn't relay the HTTP response, so there's no telling
+                // whether the server picked the dictionary protocol, and frames might not decode:
+                logError("Offered compression dictionary but got no HTTP response; closing");
+                close(kCodeProtocolError, "WebSocket didn't report the HTTP response"_sl);
+                return;
+            }
             _timeOpen.reset();
             _connection->connected();
             onWebSocketWriteable();
@@ -281,24 +388,7 @@ namespace litecore { namespace blip {
         /** Adds a message to the outgoing queue */
         void requeue(MessageOut *msg, bool andWrite =false) {
             DebugAssert(!_outbox.contains(msg));
-            auto i = _outbox.end();
-            if (msg->urgent() && _outbox.size() > 1) {
-                // High-priority gets queued after the last existing high-priority message,
-                // leaving one regular-priority message in between if possible:
-                const bool isNew = (msg->_bytesSent == 0);
-                do {
-                    --i;
-                    if ((*i)->urgent()) {
-                        if ((i+1) != _outbox.end())
-                            ++i;
-                        break;
-                    } else if (isNew && (*i)->_bytesSent == 0) {
-                        break;
-                    }
-                } while (i != _outbox.begin());
-                ++i;
-            }
-            _outbox.emplace(i, msg);  // inserts _at_ position i, before message *i
+            _outbox.push(msg);
 
             if (andWrite)
                 writeToWebSocket();
@@ -310,7 +400,7 @@ namespace litecore { namespace blip {
             logVerbose("Freezing %s #%" PRIu64 "", kMessageTypeNames[msg->type()], msg->number());
             DebugAssert(!_outbox.contains(msg));
             DebugAssert(!_icebox.contains(msg));
-            _icebox.push_back(msg);
+            _icebox.add(msg);
         }
 
 
@@ -323,14 +413,53 @@ namespace litecore { namespace blip {
         }
 
 
+        /** Primes both codecs with the preset dictionary. Must happen before any frames are
+            sent or received. */
+        void _useDictionary() {
+            logInfo("Using preset compression dictionary");
+            slice dict = ZlibCodec::defaultDictionary();
+            _outputCodec.setDictionary(dict);
+            _inputCodec.setDictionary(dict);
+        }
+
+
         /** WebSocketDelegate method -- socket has room to write data. */
         void _onWebSocketWriteable() {
             logVerbose("WebSocket is hungry!");
+            measureLinkBandwidth();
             _writeable = true;
             writeToWebSocket();
         }
 
 
+        /** Updates _linkBandwidth. If the socket had stopped accepting data since the last time it
+            became writeable, the network was the bottleneck in between, so the bytes written in
+            that interval tell us how fast it's going. */
+        void measureLinkBandwidth() {
+            double now = _timeOpen.elapsed();
+            if (!_writeable && _lastWriteableTime >= 0 && now > _lastWriteableTime) {
+                double sample = (_totalBytesWritten - _bytesAtLastWriteable)
+                                    / (now - _lastWriteableTime);
+                _linkBandwidth = (_linkBandwidth > 0) ? 0.75 * _linkBandwidth + 0.25 * sample
+                                                      : sample;
+            }
+            _lastWriteableTime = now;
+            _bytesAtLastWriteable = _totalBytesWritten;
+        }
+
+
+        /** Chooses the deflate level for the next frame of a compressed message. Small messages
+            get the configured level; it costs little, and they're mostly what the dictionary and
+            window are good at. Large ones are where the CPU goes, so they get the fastest level,
+            unless the link has been measured to be slow enough that the bytes are dearer. */
+        Deflater::CompressionLevel compressionLevelFor(MessageOut *msg) const {
+            if (msg->uncompressedSize() < kLargeMessageSize
+                    || (_linkBandwidth > 0 && _linkBandwidth < kSlowLinkBandwidth))
+                return _compressionLevel;
+            return Deflater::FastestCompression;
+        }
+
+
         /** Sends the next frame. */
         void writeToWebSocket() {
             if (!_writeable)
@@ -348,21 +477,36 @@ namespace litecore { namespace blip {
                 {
                     // Set up a buffer for the frame contents:
                     size_t maxSize = kDefaultFrameSize;
-                    if (msg->urgent() || _outbox.empty() || !_outbox.front()->urgent())
+                    if (msg->urgent() || !_outbox.nextIsUrgent())
                         maxSize = kBigFrameSize;
 
                     if (!_frameBuf)
-                        _frameBuf.reset(new uint8_t[kMaxVarintLen64 + 1 + 4 + kBigFrameSize]);
-                    slice out(_frameBuf.get(), maxSize);
+                        _frameBuf = alloc_slice(kBigFrameSize);
+                    slice out(_frameBuf.buf, maxSize);
                     WriteUVarInt(&out, msg->_number);
                     auto flagsPos = (FrameFlags*)out.buf;
                     out.moveStart(1);
 
                     // Ask the MessageOut to write data to fill the buffer:
+                    if (msg->hasFlag(kCompressed))
+                        _outputCodec.setLevel(compressionLevelFor(msg));
                     auto prevBytesSent = msg->_bytesSent;
                     msg->nextFrameToSend(_outputCodec, out, frameFlags);
                     *flagsPos = frameFlags;
-                    slice frame(_frameBuf.get(), out.buf);
+
+                    // A big frame takes _frameBuf with it, so the WebSocket can send it without
+                    // copying. A small one is copied to a buffer of its own size, instead of
+                    // pinning most of 16KB while it waits in the WebSocket's outbox, and
+                    // _frameBuf is reused for the next frame:
+                    alloc_slice frame;
+                    size_t frameSize = slice(_frameBuf.buf, out.buf).size;
+                    if (frameSize >= kMinHandoffFrameSize) {
+                        frame = _frameBuf;
+                        frame.shorten(frameSize);
+                        _frameBuf.reset();
+                    } else {
+                        frame = alloc_slice(_frameBuf.buf, frameSize);
+                    }
                     bytesWritten += frame.size;
 
                     logVerbose("    Sending frame: %s #%" PRIu64 " %c%c%c%c, bytes %u--%u",
@@ -374,7 +518,7 @@ namespace litecore { namespace blip {
                                prevBytesSent, msg->_bytesSent - 1);
                     //logVerbose("    %s", frame.hexString().c_str());
                     // Write it to the WebSocket:
-                    _writeable = _webSocket->send(frame);
+                    _writeable = _webSocket->sendBuffer(move(frame));
                 }
                 
                 // Return message to the queue if it has more frames left to send:
@@ -497,7 +641,7 @@ namespace litecore { namespace blip {
             bool frozen = false;
             Retained<MessageOut> msg = _outbox.findMessage(msgNo, onResponse);
             if (!msg) {
-                msg = _icebox.findMessage(msgNo, onResponse);
+                msg = _icebox.find(msgNo, onResponse);
                 if (!msg) {
                     //logVerbose("Received ACK of non-current message (%s #%" PRIu64 ")",
                     //      (onResponse ? "RES" : "REQ"), msgNo);
@@ -558,11 +702,11 @@ namespace litecore { namespace blip {
         }
 
 
-        void cancelAll(MessageQueue &queue) {   // either _outbox or _icebox
+        template <class QUEUE>
+        void cancelAll(QUEUE &queue) {          // either _outbox or _icebox
             if (!queue.empty())
                 logInfo("Notifying %zd outgoing messages they're canceled", queue.size());
-            for (auto &msg : queue)
-                msg->disconnected();
+            queue.forEach([](MessageOut *msg) {msg->disconnected();});
             queue.clear();
         }
 
@@ -586,19 +730,24 @@ namespace litecore { namespace blip {
         }
 
 
-        void handleRequestBeginning(MessageIn *request) {
-            
-        }
-
         void handleRequestReceived(MessageIn *request, MessageIn::ReceiveState state) {
             try {
                 if (state == MessageIn::kOther)
                     return;
                 bool beginning = (state == MessageIn::kBeginning);
+                if (!beginning && request->_dispatchedAtBeginning)
+                    return;     // Its handler already got it at the beginning
                 auto profile = request->property("Profile"_sl);
                 if (profile) {
-                    auto i = _requestHandlers.find({profile.asString(), beginning});
+                    string profileStr = profile.asString();
+                    auto i = _requestHandlers.find({profileStr, beginning});
+                    if (i == _requestHandlers.end() && !beginning) {
+                        // A message that arrived all at once never had a 'beginning' state,
+                        // so give it to the 'beginning' handler, if any:
+                        i = _requestHandlers.find({profileStr, true});
+                    }
                     if (i != _requestHandlers.end()) {
+                        request->_dispatchedAtBeginning = beginning;
                         i->second(request);
                         return;
                     }
@@ -638,8 +787,11 @@ namespace litecore { namespace blip {
         if (levelP.isInteger())
             _compressionLevel = (int8_t)levelP.asInt();
 
+        bool dictionaryOption = options.get(kCompressionDictionaryOption).asBool();
+
         // Now connect the websocket:
-        _io = new BLIPIO(this, webSocket, (Deflater::CompressionLevel)_compressionLevel);
+        _io = new BLIPIO(this, webSocket, (Deflater::CompressionLevel)_compressionLevel,
+                         dictionaryOption);
     }
 
 
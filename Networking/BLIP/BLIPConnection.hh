@@ -51,6 +51,17 @@ namespace litecore { namespace blip {
             0 (no compression) to 9 (best compression). */
         static constexpr const char *kCompressionLevelOption = "BLIPCompressionLevel";
 
+        /** Variant of kWSProtocolName whose compressed frames are primed with the preset
+            dictionary `ZlibCodec::defaultDictionary()`. A client can offer it ahead of the plain
+            name; if the server's response picks it, both sides use the dictionary. */
+        static constexpr const char *kWSProtocolNameWithDictionary = "BLIP_3.d1";
+
+        /** Boolean option. On a server-side Connection, set it if the HTTP handshake accepted
+            kWSProtocolNameWithDictionary. On a client, set it if the WebSocket offered that
+            protocol; the Connection then uses the dictionary if the HTTP response picks it, and
+            closes with a protocol error if the WebSocket never reports the HTTP response. */
+        static constexpr const char *kCompressionDictionaryOption = "BLIPCompressionDictionary";
+
         /** Creates a BLIP connection on a WebSocket. */
         Connection(websocket::WebSocket*,
                    const fleece::AllocedDict &options,
@@ -73,7 +84,11 @@ namespace litecore { namespace blip {
 
         typedef std::function<void(MessageIn*)> RequestHandler;
 
-        /** Registers a callback that will be called when a message with a given profile arrives. */
+        /** Registers a callback that will be called when a message with a given profile arrives.
+            If `atBeginning` is true, the callback is called as soon as the message's properties
+            have arrived, even if the body is incomplete; it will not be called again when the
+            message completes. (A message that arrives in a single frame is passed to such a
+            callback when it's complete, unless there's also a handler with atBeginning=false.) */
         void setRequestHandler(std::string profile, bool atBeginning, RequestHandler);
 
         /** Closes the connection. */
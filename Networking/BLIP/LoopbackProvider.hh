@@ -42,14 +42,20 @@ namespace litecore { namespace websocket {
     private:
         Retained<Driver> _driver;
         actor::delay_t _latency;
+        double _bandwidth;
 
     public:
 
+        /** `latency` is the one-way delay before a sent message arrives at the peer.
+            `bandwidth`, if nonzero, limits the rate (bytes/sec) at which messages are sent:
+            each message occupies the simulated link for `size/bandwidth` seconds. */
         LoopbackWebSocket(const fleece::alloc_slice &url,
                           Role role,
-                          actor::delay_t latency =actor::delay_t::zero())
+                          actor::delay_t latency =actor::delay_t::zero(),
+                          double bandwidth =0)
         :WebSocket(url, role)
         ,_latency(latency)
+        ,_bandwidth(bandwidth)
         { }
 
         /** Binds two LoopbackWebSocket objects to each other, so after they open, each will
@@ -90,7 +96,7 @@ namespace litecore { namespace websocket {
         }
 
         virtual Driver* createDriver() {
-            return new Driver(this, _latency);
+            return new Driver(this, _latency, _bandwidth);
         }
 
         Driver* driver() const    {return _driver;}
@@ -143,10 +149,11 @@ namespace litecore { namespace websocket {
         class Driver : public actor::Actor, protected Logging {
         public:
 
-            Driver(LoopbackWebSocket *ws, actor::delay_t latency)
+            Driver(LoopbackWebSocket *ws, actor::delay_t latency, double bandwidth =0)
             :Logging(WSLogDomain)
             ,_webSocket(ws)
             ,_latency(latency)
+            ,_bandwidth(bandwidth)
             { }
 
             virtual std::string loggingIdentifier() const override {
@@ -225,7 +232,7 @@ namespace litecore { namespace websocket {
                     Assert(_state == State::connected);
                     logDebug("SEND: %s", formatMsg(msg, binary).c_str());
                     Retained<Message> message(new LoopbackMessage(_webSocket, msg, binary));
-                    _peer->received(message, _latency);
+                    _peer->received(message, _latency + transmissionDelay(msg.size));
                 } else {
                     logInfo("SEND: Failed, socket is closed");
                 }
@@ -277,6 +284,20 @@ namespace litecore { namespace websocket {
             }
 
 
+            // With limited bandwidth, a message can't start transmitting until the previous one
+            // has finished; returns the time until this one is fully transmitted.
+            actor::delay_t transmissionDelay(size_t msgSize) {
+                if (_bandwidth <= 0)
+                    return actor::delay_t::zero();
+                auto now = std::chrono::steady_clock::now();
+                if (_linkBusyUntil < now)
+                    _linkBusyUntil = now;
+                _linkBusyUntil += std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                                    actor::delay_t(msgSize / _bandwidth));
+                return _linkBusyUntil - now;
+            }
+
+
             static std::string formatMsg(fleece::slice msg, bool binary, size_t maxBytes = 64) {
                 std::stringstream desc;
                 size_t size = std::min(msg.size, maxBytes);
@@ -307,6 +328,8 @@ namespace litecore { namespace websocket {
 
             Retained<LoopbackWebSocket> _webSocket;
             actor::delay_t _latency {0.0};
+            double _bandwidth {0};                  // Bytes/sec, or 0 for unlimited
+            std::chrono::steady_clock::time_point _linkBusyUntil;   // When link finishes sending
             Retained<LoopbackWebSocket> _peer;
             websocket::Headers _responseHeaders;
             std::atomic<size_t> _bufferedBytes {0};
@@ -241,12 +241,23 @@ namespace litecore { namespace blip {
             codec.readAndVerifyChecksum(checksumSlice);
 
             bodyBytesReceived = _in->bytesWritten();
+            if (_bodyStream) {
+                // Pass the frame's data to the stream callback instead of accumulating it:
+                bodyBytesReceived += _bodyStreamedBytes;
+                _bodyStreamedBytes += _in->bytesWritten();
+                alloc_slice data = _in->finish();
+                _in->reset();
+                if (data.size > 0 || !(frameFlags & kMoreComing))
+                    _bodyStream(data, !(frameFlags & kMoreComing));
+            }
 
             if (!(frameFlags & kMoreComing)) {
                 // Completed!
                 if (_propertiesRemaining.size > 0)
                     throw std::runtime_error("message ends before end of properties");
-                _body = _in->finish();
+                if (!_bodyStream)
+                    _body = _in->finish();
+                _bodyStream = nullptr;
                 _in.reset();
                 _complete = true;
 
@@ -299,6 +310,21 @@ namespace litecore { namespace blip {
     }
 
 
+    void MessageIn::disconnected() {
+        BodyStreamCallback stream;
+        {
+            lock_guard<mutex> lock(_receiveMutex);
+            stream = move(_bodyStream);
+            _bodyStream = nullptr;
+        }
+        // Tell the stream the body has ended; since isComplete() is still false, the receiver
+        // can tell that the message was cut off.
+        if (stream)
+            stream(nullslice, true);
+        Message::disconnected();
+    }
+
+
     void MessageIn::setProgressCallback(MessageProgressCallback callback) {
         lock_guard<mutex> lock(_receiveMutex);
         _onProgress = callback;
@@ -333,6 +359,28 @@ namespace litecore { namespace blip {
     }
 
 
+    void MessageIn::streamBody(BodyStreamCallback callback) {
+        lock_guard<mutex> lock(_receiveMutex);
+        Assert(!_bodyStream);
+        if (_complete) {
+            // Already got the entire body, so just hand it over:
+            alloc_slice body = move(_body);
+            _body = nullslice;
+            callback(body, true);
+        } else {
+            if (_in) {
+                // Deliver what's been received so far:
+                _bodyStreamedBytes = _in->bytesWritten();
+                alloc_slice data = _in->finish();
+                _in->reset();
+                if (data.size > 0)
+                    callback(data, false);
+            }
+            _bodyStream = move(callback);
+        }
+    }
+
+
     alloc_slice MessageIn::extractBody() {
         lock_guard<mutex> lock(_receiveMutex);
         alloc_slice body = _body;
@@ -57,6 +57,10 @@ namespace litecore { namespace blip {
 
     using MessageProgressCallback = std::function<void(const MessageProgress&)>;
 
+    /** Callback that receives a message's body incrementally. `data` is the next piece of the
+        (decompressed) body; `complete` is true on the final call. */
+    using BodyStreamCallback = std::function<void(fleece::slice data, bool complete)>;
+
 
     struct Error {
         const fleece::slice domain;
@@ -98,6 +102,7 @@ namespace litecore { namespace blip {
 
     protected:
         friend class BLIPIO;
+        friend class MessageIndex;
         
         Message(FrameFlags f, MessageNo n)
         :_flags(f), _number(n)
@@ -157,6 +162,14 @@ namespace litecore { namespace blip {
             body() will return only the data that's been read since this call. */
         alloc_slice extractBody();
 
+        /** Directs the rest of the body to a callback as it arrives, instead of buffering it in
+            memory. Any part of the body that's already been received is passed to the callback
+            immediately, before this method returns. Subsequent calls are made on the BLIP I/O
+            thread as frames arrive, so the callback should be quick and thread-safe; the final
+            call has `complete` set to true. After this, `body()` and `extractBody()` return
+            null. */
+        void streamBody(BodyStreamCallback);
+
         /** Converts the body from JSON to Fleece and returns a pointer to the root object. */
         fleece::Value JSONBody();
 
@@ -195,6 +208,7 @@ namespace litecore { namespace blip {
         virtual ~MessageIn();
         virtual bool isIncoming() const     {return true;}
         ReceiveState receivedFrame(Codec&, slice frame, FrameFlags);
+        void disconnected();
 
         std::string description();
 
@@ -212,9 +226,12 @@ namespace litecore { namespace blip {
         alloc_slice _properties;                // Just the (still encoded) properties
         alloc_slice _body;                      // Just the body
         alloc_slice _bodyAsFleece;              // Body re-encoded into Fleece [lazy]
+        BodyStreamCallback _bodyStream;         // Receives body data, if streaming
+        MessageSize _bodyStreamedBytes {0};     // # of body bytes passed to _bodyStream
         const MessageSize _outgoingSize {0};
         bool _complete {false};
         bool _responded {false};
+        bool _dispatchedAtBeginning {false};    // Handed to a request handler before completion
     };
 
 } }
@@ -46,6 +46,7 @@ namespace litecore { namespace blip {
         }
 
         void dontCompress()                     {_flags = (FrameFlags)(_flags & ~kCompressed);}
+        size_t uncompressedSize() const         {return _contents.uncompressedSize();}
         void nextFrameToSend(Codec &codec, slice &dst, FrameFlags &outFlags);
         void receivedAck(uint32_t byteCount);
         bool needsAck()                         {return _unackedBytes >= kMaxUnackedBytes;}
@@ -67,6 +68,7 @@ namespace litecore { namespace blip {
             slice& dataToSend();
             bool hasMoreDataToSend() const;
             void getPropsAndBody(slice &props, slice &body) const;
+            size_t uncompressedSize() const     {return _dataSource ? SIZE_MAX : _payload.size;}
         private:
             void readFromDataSource();
 
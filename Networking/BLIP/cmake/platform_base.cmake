@@ -14,6 +14,7 @@ function(set_source_files_base)
         ${HTTP_LOCATION}/Headers.cc
         ${WEBSOCKETS_LOCATION}/WebSocketImpl.cc
         ${WEBSOCKETS_LOCATION}/WebSocketInterface.cc
+        ${WEBSOCKETS_LOCATION}/WebSocketMask.cc
         ${SUPPORT_LOCATION}/Actor.cc
         ${SUPPORT_LOCATION}/ActorProperty.cc
 #       ${SUPPORT_LOCATION}/Async.cc
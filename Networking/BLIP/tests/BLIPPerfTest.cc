@@ -0,0 +1,317 @@
+//
+// BLIPPerfTest.cc
+//
+// Copyright (c) 2020 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "LiteCoreTest.hh"
+#include "BLIPConnection.hh"
+#include "MessageBuilder.hh"
+#include "LoopbackProvider.hh"
+#include "Codec.hh"
+#include "Headers.hh"
+#include "Stopwatch.hh"
+#include <condition_variable>
+#include <mutex>
+
+using namespace std;
+using namespace fleece;
+using namespace litecore;
+using namespace litecore::blip;
+using namespace litecore::websocket;
+
+
+// Two BLIP Connections talking over a LoopbackWebSocket pair. The server echoes the body of
+// every request it receives.
+class BLIPPerfTest : public ConnectionDelegate {
+public:
+    Retained<Connection> client, server;
+    mutex m;
+    condition_variable cond;
+    int closed {0};
+    unsigned completed {0}, failed {0};
+    bool compress {false};
+
+    BLIPPerfTest(bool useDictionary =false) {
+        AllocedDict options;
+        Headers responseHeaders;
+        if (useDictionary) {
+            fleece::Encoder enc;
+            enc.beginDict();
+            enc.writeKey(slice(Connection::kCompressionDictionaryOption));
+            enc.writeBool(true);
+            enc.endDict();
+            options = AllocedDict(enc.finish());
+            responseHeaders.add("Sec-WebSocket-Protocol"_sl,
+                                slice(Connection::kWSProtocolNameWithDictionary));
+        }
+        client = new Connection(new LoopbackWebSocket(alloc_slice("ws://srv/"_sl), Role::Client),
+                                options, *this);
+        server = new Connection(new LoopbackWebSocket(alloc_slice("ws://cli/"_sl), Role::Server),
+                                options, *this);
+        LoopbackWebSocket::bind(client->webSocket(), server->webSocket(), responseHeaders);
+        server->setRequestHandler("echo", false, [this](MessageIn *request) {
+            MessageBuilder reply(request);
+            reply.compressed = compress;
+            reply.write(request->body());
+            request->respond(reply);
+        });
+        client->start();
+        server->start();
+    }
+
+    ~BLIPPerfTest() {
+        client->close();
+        unique_lock<mutex> lock(m);
+        cond.wait_for(lock, chrono::seconds(10), [&]{return closed == 2;});
+        lock.unlock();
+        client->terminate();
+        server->terminate();
+    }
+
+    virtual void onTLSCertificate(slice certData) override { }
+
+    virtual void onClose(Connection::CloseStatus, Connection::State) override {
+        unique_lock<mutex> lock(m);
+        ++closed;
+        cond.notify_all();
+    }
+
+    // Sends `count` echo requests at once, each with a `bodySize`-byte body, `urgentEvery`th
+    // one marked urgent; then waits for all the replies.
+    void sendConcurrently(unsigned count, size_t bodySize, unsigned urgentEvery) {
+        string body(bodySize, '*');
+        for (unsigned i = 0; i < count; ++i) {
+            MessageBuilder msg("echo"_sl);
+            msg.urgent = (urgentEvery > 0 && i % urgentEvery == 0);
+            msg.compressed = compress;
+            msg.write(slice(body));
+            msg.onProgress = [this](const MessageProgress &progress) {
+                if (progress.state == MessageProgress::kComplete
+                        || progress.state == MessageProgress::kDisconnected) {
+                    unique_lock<mutex> lock(m);
+                    if (progress.state == MessageProgress::kComplete && progress.reply
+                            && !progress.reply->isError())
+                        ++completed;
+                    else
+                        ++failed;
+                    cond.notify_all();
+                }
+            };
+            client->sendRequest(msg);
+        }
+
+        unique_lock<mutex> lock(m);
+        REQUIRE(cond.wait_for(lock, chrono::seconds(300),
+                              [&]{return completed + failed >= count;}));
+        CHECK(failed == 0);
+        CHECK(completed == count);
+    }
+};
+
+
+TEST_CASE_METHOD(BLIPPerfTest, "BLIP concurrent messages", "[BLIP]") {
+    sendConcurrently(100, 20000, 3);
+}
+
+
+TEST_CASE_METHOD(BLIPPerfTest, "BLIP many concurrent messages", "[BLIP][.Perf]") {
+    unsigned count = 5000;
+    size_t bodySize = 0;
+    unsigned urgentEvery = 0;
+    SECTION("Small") {
+        bodySize = 100;
+    }
+    SECTION("Multi-frame") {
+        bodySize = 50000;
+    }
+    SECTION("Multi-frame, mixed urgent") {
+        bodySize = 50000;
+        urgentEvery = 4;
+    }
+    SECTION("Large, needing ACKs") {
+        count = 500;
+        bodySize = 500000;
+    }
+    Stopwatch st;
+    sendConcurrently(count, bodySize, urgentEvery);
+    st.printReport("Echo request", count, "message");
+}
+
+
+// Same, but both sides use the preset compression dictionary.
+class BLIPDictionaryTest : public BLIPPerfTest {
+public:
+    BLIPDictionaryTest() :BLIPPerfTest(true) { }
+};
+
+
+TEST_CASE_METHOD(BLIPDictionaryTest, "BLIP compression dictionary", "[BLIP]") {
+    compress = true;
+    sendConcurrently(100, 20000, 3);
+}
+
+
+// A client WebSocket that opens without reporting the HTTP response, as a C4SocketFactory that
+// never calls c4socket_gotHTTPResponse does.
+class NoResponseWebSocket : public WebSocket {
+public:
+    NoResponseWebSocket() :WebSocket(alloc_slice("ws://srv/"_sl), Role::Client) { }
+    bool send(slice, bool) override                 {return true;}
+    void close(int status, slice message) override {
+        delegate().onWebSocketClose(CloseStatus(kWebSocketClose, status, message));
+    }
+protected:
+    void connect() override                         {delegate().onWebSocketConnect();}
+};
+
+
+// If the client offered the dictionary but can't tell whether the server picked it, it must
+// close instead of risking frames it can't decode.
+TEST_CASE("BLIP compression dictionary without HTTP response", "[BLIP]") {
+    struct Delegate : public ConnectionDelegate {
+        mutex m;
+        condition_variable cond;
+        bool connected {false}, closed {false};
+        Connection::CloseStatus status;
+
+        void onTLSCertificate(slice) override   { }
+        void onConnect() override               {connected = true;}
+        void onClose(Connection::CloseStatus s, Connection::State) override {
+            unique_lock<mutex> lock(m);
+            status = s;
+            closed = true;
+            cond.notify_all();
+        }
+    } delegate;
+
+    fleece::Encoder enc;
+    enc.beginDict();
+    enc.writeKey(slice(Connection::kCompressionDictionaryOption));
+    enc.writeBool(true);
+    enc.endDict();
+    Retained<Connection> client = new Connection(new NoResponseWebSocket,
+                                                 AllocedDict(enc.finish()), delegate);
+    client->start();
+
+    unique_lock<mutex> lock(delegate.m);
+    REQUIRE(delegate.cond.wait_for(lock, chrono::seconds(10), [&]{return delegate.closed;}));
+    CHECK(!delegate.connected);
+    CHECK(delegate.status.reason == kWebSocketClose);
+    CHECK(delegate.status.code == kCodeProtocolError);
+}
+
+
+// Compresses a stream of small rev-message-like frames the way BLIP does, with and without the
+// preset dictionary, and checks that the dictionary helps and round-trips.
+TEST_CASE("BLIP compression dictionary size", "[BLIP]") {
+    static constexpr int kNumMessages = 20;
+    vector<string> frames;
+    for (int i = 0; i < kNumMessages; ++i) {
+        char buf[400];
+        int n = snprintf(buf, sizeof(buf),
+                         "Profile%crev%cid%cdoc-%04d%crev%c1-%08x%csequence%c%d%c"
+                         "{\"type\":\"user\",\"name\":\"User %d\",\"email\":\"u%d@example.com\","
+                         "\"created_at\":\"2020-06-%02dT12:00:00Z\",\"channels\":[\"public\"]}",
+                         0, 0, 0, i, 0, 0, 0x1234567u * (i + 1), 0, 0, 100 + i, 0,
+                         i, i, 1 + i % 28);
+        frames.emplace_back(buf, n);
+    }
+
+    auto compressAll = [&](bool useDictionary) -> size_t {
+        Deflater deflater;
+        Inflater inflater;
+        if (useDictionary) {
+            deflater.setDictionary(ZlibCodec::defaultDictionary());
+            inflater.setDictionary(ZlibCodec::defaultDictionary());
+        }
+        size_t total = 0;
+        for (auto &frame : frames) {
+            char compressed[1000], decompressed[1000];
+            slice input(frame), output(compressed, sizeof(compressed));
+            deflater.write(input, output, Codec::Mode::SyncFlush);
+            CHECK(input.size == 0);
+            slice compressedData(compressed, output.buf);
+            total += compressedData.size;
+
+            slice output2(decompressed, sizeof(decompressed));
+            inflater.write(compressedData, output2, Codec::Mode::SyncFlush);
+            CHECK(slice(decompressed, output2.buf) == slice(frame));
+        }
+        return total;
+    };
+
+    size_t plain = compressAll(false), withDict = compressAll(true);
+    size_t original = 0;
+    for (auto &frame : frames)
+        original += frame.size();
+    C4Log("%d rev messages, %zu bytes: compressed to %zu bytes; %zu with dictionary (%.0f%% less)",
+          kNumMessages, original, plain, withDict, 100.0 * (1.0 - double(withDict) / plain));
+    CHECK(withDict < plain);
+}
+
+
+// Deflates JSON-like frames through one stream, switching levels between frames as BLIPIO does,
+// and checks the Inflater at the other end doesn't notice.
+TEST_CASE("BLIP compression level changes", "[BLIP]") {
+    string text;
+    for (int i = 0; i < 2000; ++i)
+        text += "{\"type\":\"reading\",\"sensor\":" + to_string(i % 17)
+              + ",\"value\":" + to_string(i * 7919 % 1000) + "},";
+    const Deflater::CompressionLevel levels[] = {Deflater::FastestCompression,
+                                                 Deflater::BestCompression,
+                                                 (Deflater::CompressionLevel)6};
+    Deflater deflater((Deflater::CompressionLevel)6);
+    Inflater inflater;
+    slice remaining(text);
+    string result;
+    vector<char> compressed(8000), decompressed(8000);
+    for (int i = 0; remaining.size > 0; ++i) {
+        deflater.setLevel(levels[i % 3]);
+        CHECK(deflater.level() == levels[i % 3]);
+        slice input = remaining;
+        input.setSize(min(input.size, size_t(4000)));
+        remaining.moveStart(input.size);
+        slice output(compressed.data(), compressed.size());
+        deflater.write(input, output, Codec::Mode::SyncFlush);
+        REQUIRE(input.size == 0);
+
+        slice frame(compressed.data(), output.buf);
+        slice output2(decompressed.data(), decompressed.size());
+        inflater.write(frame, output2, Codec::Mode::SyncFlush);
+        result.append(decompressed.data(), slice(decompressed.data(), output2.buf).size);
+    }
+    CHECK(result == text);
+}
+
+
+TEST_CASE("BLIP compression level speed", "[BLIP][.Perf]") {
+    string text;
+    for (int i = 0; i < 200000; ++i)
+        text += "{\"type\":\"reading\",\"sensor\":" + to_string(i % 17)
+              + ",\"value\":" + to_string(i * 7919 % 1000) + "},";
+    vector<char> compressed(text.size() + 1024);
+    for (auto level : {Deflater::FastestCompression, (Deflater::CompressionLevel)6,
+                       Deflater::BestCompression}) {
+        Deflater deflater(level);
+        Stopwatch st;
+        slice input(text), output(compressed.data(), compressed.size());
+        deflater.write(input, output, Codec::Mode::SyncFlush);
+        double secs = st.elapsed();
+        size_t size = slice(compressed.data(), output.buf).size;
+        C4Log("Level %d: %zu -> %zu bytes (%.1f%%) at %.1f MB/sec",
+              level, text.size(), size, 100.0 * size / text.size(), text.size() / 1.0e6 / secs);
+    }
+}
@@ -318,8 +318,21 @@ namespace litecore { namespace net {
                          "Server failed to upgrade connection"_sl);
         }
 
-        if (_webSocketProtocol && _responseHeaders["Sec-Websocket-Protocol"_sl] != _webSocketProtocol) {
-            return failure(WebSocketDomain, 403, "Server did not accept protocol"_sl);
+        if (_webSocketProtocol) {
+            // We may have offered a comma-separated list; the server must pick one of them:
+            slice accepted = _responseHeaders["Sec-Websocket-Protocol"_sl];
+            bool ok = false;
+            if (accepted) {
+                string_view offers((const char*)_webSocketProtocol.buf, _webSocketProtocol.size);
+                split(offers, ",", [&](string_view offered) {
+                    while (!offered.empty() && offered.front() == ' ')
+                        offered.remove_prefix(1);
+                    if (slice(offered.data(), offered.size()) == accepted)
+                        ok = true;
+                });
+            }
+            if (!ok)
+                return failure(WebSocketDomain, 403, "Server did not accept protocol"_sl);
         }
 
         // Check the returned nonce:
@@ -32,6 +32,9 @@
 #include <unistd.h>
 #include <poll.h>
 #endif
+#ifdef LITECORE_USE_EPOLL
+#include <sys/epoll.h>
+#endif
 
 #define WSLog (*(LogDomain*)kC4WebSocketLog)
 #define LOG(LEVEL, ...) LogToAt(WSLog, LEVEL, ##__VA_ARGS__)
@@ -76,10 +79,28 @@ namespace litecore { namespace net {
         _interruptReadFD = readSock.release();
         _interruptWriteFD = writeSock.release();
 #endif
+
+#ifdef LITECORE_USE_EPOLL
+        _epollFD = ::epoll_create1(EPOLL_CLOEXEC);
+        if (_epollFD < 0)
+            throwSocketError();
+        // The interrupt pipe stays registered (level-triggered) for the Poller's lifetime:
+        epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.fd = _interruptReadFD;
+        if (::epoll_ctl(_epollFD, EPOLL_CTL_ADD, _interruptReadFD, &ev) < 0)
+            throwSocketError();
+#endif
     }
 
 
     Poller::~Poller() {
+        if (_thread.joinable())
+            stop();
+#ifdef LITECORE_USE_EPOLL
+        if (_epollFD >= 0)
+            ::close(_epollFD);
+#endif
         if (_interruptReadFD >= 0) {
 #ifndef _WIN32
             ::close(_interruptReadFD);
@@ -101,17 +122,27 @@ namespace litecore { namespace net {
     void Poller::addListener(int fd, Event event, Listener listener) {
         Assert(fd >= 0);
         lock_guard<mutex> lock(_mutex);
-        _listeners[fd][event] = listener;
+        auto &listeners = _listeners[fd];
+        listeners[event] = listener;
+#ifdef LITECORE_USE_EPOLL
+        // epoll_ctl takes effect immediately, even while the poll thread is waiting
+        rearm(fd, listeners);
+#else
         if (_waiting)
             interrupt(0);
+#endif
     }
 
 
     void Poller::removeListeners(int fd) {
         Assert(fd >= 0);
         lock_guard<mutex> lock(_mutex);
-        if (auto i = _listeners.find(fd); i != _listeners.end())
+        if (auto i = _listeners.find(fd); i != _listeners.end()) {
             _listeners.erase(i);
+#ifdef LITECORE_USE_EPOLL
+            ::epoll_ctl(_epollFD, EPOLL_CTL_DEL, fd, nullptr);  // fails harmlessly if fd is closed
+#endif
+        }
         // no need to interrupt the poll thread
     }
 
@@ -150,7 +181,6 @@ namespace litecore { namespace net {
             while (poll())
                 ;
         });
-        _thread.detach();
         return *this;
     }
 
@@ -160,6 +190,21 @@ namespace litecore { namespace net {
         _thread.join();
     }
 
+
+    // Handles a message read from the interrupt pipe. Returns false if the loop should stop.
+    bool Poller::handleInterruption(int message) {
+        LOG(Debug, "Poller: interruption %d", message);
+        if (message < 0) {
+            // Receiving a negative message aborts the loop
+            return false;
+        } else if (message > 0) {
+            // A positive message is a file descriptor to call:
+            callAndRemoveListener(message, kReadable);
+            callAndRemoveListener(message, kWriteable);
+        }
+        return true;
+    }
+
 #ifdef WIN32
     // WSAPoll has proven to be weirdly unreliable, so fall back
     // to a select based implementation
@@ -217,15 +262,7 @@ namespace litecore { namespace net {
         if(FD_ISSET(_interruptReadFD, &fds_read)) {
             int message;
             ::recv(_interruptReadFD, (char *)&message, sizeof(message), 0);
-            LOG(Debug, "Poller: interruption %d", message);
-            if (message < 0) {
-                // Receiving a negative message aborts the loop
-                result = false;
-            } else if (message > 0) {
-                // A positive message is a file descriptor to call:
-                callAndRemoveListener(message, kReadable);
-                callAndRemoveListener(message, kWriteable);
-            }
+            result = handleInterruption(message);
         }
 
         for (SOCKET s : all_fds) {
@@ -245,6 +282,71 @@ namespace litecore { namespace net {
         return result;
     }
 
+#elif defined(LITECORE_USE_EPOLL)
+
+    // Registers `fd` with epoll for the events its listeners are waiting for. Registrations are
+    // one-shot: once an event is reported the fd is disabled until it's re-armed here, so a
+    // listener is never called twice for one readiness, and idle fds cost nothing per wakeup.
+    // Must be called with _mutex locked.
+    void Poller::rearm(int fd, const array<Listener,2> &listeners) {
+        epoll_event ev = {};
+        ev.events = EPOLLONESHOT;
+        if (listeners[kReadable])
+            ev.events |= EPOLLIN | EPOLLRDHUP;
+        if (listeners[kWriteable])
+            ev.events |= EPOLLOUT;
+        if (ev.events == EPOLLONESHOT)
+            return;                         // Nothing to wait for; leave it disarmed
+        ev.data.fd = fd;
+        if (::epoll_ctl(_epollFD, EPOLL_CTL_MOD, fd, &ev) == 0)
+            return;
+        if (errno == ENOENT && ::epoll_ctl(_epollFD, EPOLL_CTL_ADD, fd, &ev) == 0)
+            return;
+        // Most likely the fd is already closed. poll() would report POLLNVAL, so do the
+        // equivalent and have the poll thread call the listeners:
+        LOG(Debug, "Poller: can't register fd %d with epoll (errno %d)", fd, errno);
+        interrupt(fd);
+    }
+
+
+    bool Poller::poll() {
+        static constexpr int kMaxEvents = 64;
+        epoll_event events[kMaxEvents];
+
+        // Wait in epoll_wait():
+        int nEvents;
+        while ((nEvents = ::epoll_wait(_epollFD, events, kMaxEvents, -1)) < 0) {
+            if (errno != EINTR)
+                return false;
+        }
+
+        // Dispatch the events:
+        bool result = true;
+        for (int e = 0; e < nEvents; ++e) {
+            int fd = events[e].data.fd;
+            uint32_t revents = events[e].events;
+            if (fd == _interruptReadFD) {
+                // This is an interrupt -- read the message from the pipe:
+                int message;
+                ::read(_interruptReadFD, &message, sizeof(message));
+                if (!handleInterruption(message))
+                    result = false;
+            } else {
+                LOG(Debug, "Poller: fd %d got event 0x%02x", fd, revents);
+                if (revents & (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP))
+                    callAndRemoveListener(fd, kReadable);
+                if (revents & (EPOLLOUT | EPOLLERR | EPOLLHUP))
+                    callAndRemoveListener(fd, kWriteable);
+                // The one-shot registration is now disabled; re-arm it if a listener is still
+                // waiting for the other event:
+                lock_guard<mutex> lock(_mutex);
+                if (auto i = _listeners.find(fd); i != _listeners.end())
+                    rearm(fd, i->second);
+            }
+        }
+        return result;
+    }
+
 #else
 
     bool Poller::poll() {
@@ -282,15 +384,8 @@ namespace litecore { namespace net {
                     // This is an interrupt -- read the byte from the pipe:
                     int message;
                     ::read(_interruptReadFD, &message, sizeof(message));
-                    LOG(Debug, "Poller: interruption %d", message);
-                    if (message < 0) {
-                        // Receiving a negative message aborts the loop
+                    if (!handleInterruption(message))
                         result = false;
-                    } else if (message > 0) {
-                        // A positive message is a file descriptor to call:
-                        callAndRemoveListener(message, kReadable);
-                        callAndRemoveListener(message, kWriteable);
-                    }
                 } else {
                     LOG(Debug, "Poller: fd %d got event 0x%02x", fd, entry.revents);
                     if (entry.revents & (POLLIN | POLLERR | POLLHUP | POLLNVAL))
@@ -14,13 +14,19 @@
 #include "sockpp/platform.h"
 #include "sockpp/socket.h"
 
+#if defined(__linux__)
+    // Linux (and Android) have epoll, which keeps registrations in the kernel instead of
+    // passing the entire fd set to every `poll` call.
+    #define LITECORE_USE_EPOLL 1
+#endif
+
 namespace litecore { namespace net {
 	// This needs to stay here because of the platform variations of
 	// socket_t and INVALID_SOCKET (Windows has them globally and
 	// Unix has them in this namespace)
 	using namespace sockpp; 
 	
-    /** Enables async I/O by running `poll` on a background thread. */
+    /** Enables async I/O by running `poll` (or `epoll_wait` on Linux) on a background thread. */
     class Poller {
     public:
         /// The single shared instance (all that's necessary in normal use)
@@ -53,7 +59,11 @@ namespace litecore { namespace net {
     private:
         Poller(bool startNow)               :Poller() {if (startNow) start();}
         bool poll();
+        bool handleInterruption(int message);
         void callAndRemoveListener(int fd, Event);
+#ifdef LITECORE_USE_EPOLL
+        void rearm(int fd, const std::array<Listener,2>&);
+#endif
         
         std::mutex _mutex;
         std::unordered_map<socket_t, std::array<Listener,2>> _listeners;
@@ -62,6 +72,9 @@ namespace litecore { namespace net {
 
         socket_t _interruptReadFD  {INVALID_SOCKET}; // Pipe used to interrupt poll()
         socket_t _interruptWriteFD {INVALID_SOCKET}; // Other end of the pipe
+#ifdef LITECORE_USE_EPOLL
+        int _epollFD {-1};                           // epoll instance holding registrations
+#endif
     };
 
 } }
@@ -27,6 +27,7 @@
 #include "SecureRandomize.hh"
 #include "Error.hh"
 #include "StringUtil.hh"
+#include "Stopwatch.hh"
 #include "sockpp/exception.h"
 #include "sockpp/inet6_address.h"
 #include "sockpp/tcp_acceptor.h"
@@ -100,13 +101,20 @@ namespace litecore { namespace net {
 
 
     bool TCPSocket::wrapTLS(slice hostname) {
-        if (!_tlsContext)
-            _tlsContext = new TLSContext(_isClient ? TLSContext::Client : TLSContext::Server);
+        if (!_tlsContext) {
+            if (_isClient)
+                _tlsContext = TLSContext::defaultClientContext();
+            else
+                _tlsContext = new TLSContext(TLSContext::Server);
+        }
         string hostnameStr(hostname);
         auto oldSocket = move(_socket);
-        return setSocket(_tlsContext->_context->wrap_socket(move(oldSocket),
+        Stopwatch st;
+        bool ok = setSocket(_tlsContext->_context->wrap_socket(move(oldSocket),
                                             (_isClient ? tls_context::CLIENT : tls_context::SERVER),
                                             hostnameStr.c_str()));
+        _tlsHandshakeTime = st.elapsed();
+        return ok;
     }
 
 
@@ -59,6 +59,9 @@ namespace litecore::net {
         /// Peer's TLS certificate (if it has one)
         fleece::Retained<crypto::Cert> peerTLSCertificate();
 
+        /// Time in seconds the TLS handshake took, or 0 if there wasn't one.
+        double tlsHandshakeTime() const         {return _tlsHandshakeTime;}
+
         /// Last error
         C4Error error() const                   {return _error;}
 
@@ -141,6 +144,7 @@ namespace litecore::net {
         size_t _unreadLen {0};                              // Length of valid data in _unread
         bool _eofOnRead {false};                            // Has read stream reached EOF?
         bool _eofOnWrite {false};                           // Has write stream reached EOF?
+        double _tlsHandshakeTime {0};                       // Duration of TLS handshake (secs)
         std::function<void()> _onClose;
     };
 
@@ -22,7 +22,11 @@
 #include "WebSocketInterface.hh"
 #include "sockpp/mbedtls_context.h"
 #include "mbedtls/debug.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/ssl_cache.h"
+#include <mutex>
 #include <string>
+#include <unordered_map>
 
 using namespace std;
 using namespace sockpp;
@@ -63,10 +67,15 @@ namespace litecore { namespace net {
             TLSLogDomain.log(kLogLevels[level], "mbedTLS(%s): %.*s",
                              (role == Client ? "C" : "S"), int(len), message);
         });
+
+        enableSessionCache();
     }
 
-    TLSContext::~TLSContext()
-    { }
+    TLSContext::~TLSContext() {
+        _context.reset();   // Its SSL config points to _serverSessionCache
+        if (_serverSessionCache)
+            mbedtls_ssl_cache_free(_serverSessionCache.get());
+    }
 
 
     void TLSContext::setRootCerts(slice certsData) {
@@ -144,12 +153,154 @@ namespace litecore { namespace net {
     void TLSContext::setIdentity(crypto::Identity *id) {
         _context->set_identity(id->cert->context(), id->privateKey->context());
         _identity = id;
+        _hasIdentity = true;
     }
 
     void TLSContext::setIdentity(slice certData, slice keyData) {
         _context->set_identity(string(certData), string(keyData));
+        _hasIdentity = true;
+    }
+
+    TLSContext* TLSContext::defaultClientContext() {
+        static TLSContext* const sContext = retain(new TLSContext(Client));
+        return sContext;
+    }
+
+
+#pragma mark - CACHE:
+
+
+    using CacheClock = chrono::steady_clock;
+
+    struct CachedContext {
+        Retained<TLSContext> context;
+        CacheClock::time_point expires;
+    };
+
+    static mutex sCacheMutex;
+    static unordered_map<string, CachedContext> sCache;
+    static chrono::seconds sCacheLifetime = chrono::minutes(10);
+
+
+    // Removes expired contexts. Must be called with sCacheMutex locked.
+    static void pruneCache(CacheClock::time_point now) {
+        for (auto i = sCache.begin(); i != sCache.end(); ) {
+            if (i->second.expires <= now)
+                i = sCache.erase(i);
+            else
+                ++i;
+        }
+    }
+
+
+    Retained<TLSContext> TLSContext::cachedContext(const string &key) {
+        lock_guard<mutex> lock(sCacheMutex);
+        pruneCache(CacheClock::now());
+        auto i = sCache.find(key);
+        return (i != sCache.end()) ? i->second.context : nullptr;
+    }
+
+
+    void TLSContext::cacheContext(const string &key, TLSContext *context) {
+        if (context->hasIdentity())
+            return;
+        lock_guard<mutex> lock(sCacheMutex);
+        auto now = CacheClock::now();
+        pruneCache(now);
+        if (sCacheLifetime.count() > 0)
+            sCache[key] = {context, now + sCacheLifetime};
+    }
+
+
+    void TLSContext::setCacheLifetime(chrono::seconds lifetime) {
+        lock_guard<mutex> lock(sCacheMutex);
+        sCacheLifetime = lifetime;
+        if (lifetime.count() <= 0)
+            sCache.clear();
+    }
+
+
+    static chrono::seconds cacheLifetime() {
+        lock_guard<mutex> lock(sCacheMutex);
+        return sCacheLifetime;
     }
 
+
+#pragma mark - SESSION RESUMPTION:
+
+
+    static void freeSession(mbedtls_ssl_session *session) {
+        mbedtls_ssl_session_free(session);
+        delete session;
+    }
+
+
+    // A resumed session skips the certificate exchange and key agreement, so a reconnect costs
+    // one round trip and no public-key operations.
+    void TLSContext::enableSessionCache() {
+        if (_role == Client) {
+            // sockpp calls these around the handshake of each socket it wraps:
+            _context->set_session_callbacks(
+                [this](mbedtls_ssl_context *ssl, const string &peer) {restoreSession(ssl, peer);},
+                [this](mbedtls_ssl_context *ssl, const string &peer) {saveSession(ssl, peer);});
+        } else {
+            auto lifetime = cacheLifetime();
+            if (lifetime.count() <= 0)
+                return;
+            _serverSessionCache = make_unique<mbedtls_ssl_cache_context>();
+            mbedtls_ssl_cache_init(_serverSessionCache.get());
+            mbedtls_ssl_cache_set_timeout(_serverSessionCache.get(), int(lifetime.count()));
+            mbedtls_ssl_conf_session_cache(_context->ssl_config(), _serverSessionCache.get(),
+                                           mbedtls_ssl_cache_get, mbedtls_ssl_cache_set);
+        }
+    }
+
+
+    // Called before a client handshake: offers the session last negotiated with the peer.
+    void TLSContext::restoreSession(mbedtls_ssl_context *ssl, const string &peer) {
+        lock_guard<mutex> lock(_sessionsMutex);
+        auto i = _sessions.find(peer);
+        if (i == _sessions.end())
+            return;
+        if (i->second.expires <= SessionClock::now()) {
+            _sessions.erase(i);
+            return;
+        }
+        if (int err = mbedtls_ssl_set_session(ssl, i->second.session.get()); err != 0) {
+            TLSLogDomain.log(LogLevel::Warning, "Couldn't resume TLS session with %s: -0x%04X",
+                             peer.c_str(), -err);
+            _sessions.erase(i);
+            return;
+        }
+        ++_sessionsOffered;
+    }
+
+
+    // Called after a successful client handshake: saves the session for the next connection.
+    void TLSContext::saveSession(const mbedtls_ssl_context *ssl, const string &peer) {
+        auto lifetime = cacheLifetime();
+        lock_guard<mutex> lock(_sessionsMutex);
+        if (lifetime.count() <= 0) {
+            _sessions.clear();
+            return;
+        }
+        auto now = SessionClock::now();
+        for (auto i = _sessions.begin(); i != _sessions.end(); ) {
+            if (i->second.expires <= now)
+                i = _sessions.erase(i);
+            else
+                ++i;
+        }
+
+        SavedSession saved {{new mbedtls_ssl_session, &freeSession}, now + lifetime};
+        mbedtls_ssl_session_init(saved.session.get());
+        if (mbedtls_ssl_get_session(ssl, saved.session.get()) == 0)
+            _sessions.insert_or_assign(peer, move(saved));
+        else
+            _sessions.erase(peer);
+    }
+
+
     void TLSContext::resetRootCertFinder() {
         #ifdef ROOT_CERT_LOOKUP_AVAILABLE
         _context->set_root_cert_locator([this](string certStr, string &rootStr) {
@@ -7,8 +7,17 @@
 #pragma once
 #include "RefCounted.hh"
 #include "fleece/slice.hh"
+#include <atomic>
+#include <chrono>
 #include <functional>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+struct mbedtls_ssl_context;
+struct mbedtls_ssl_session;
+struct mbedtls_ssl_cache_context;
 
 namespace sockpp {
     class mbedtls_context;
@@ -77,17 +86,59 @@ namespace litecore { namespace net {
         void setIdentity(crypto::Identity* NONNULL);
         void setIdentity(fleece::slice certData, fleece::slice privateKeyData);
 
+        // The context used by client sockets that aren't given one. Sharing it saves every
+        // connection from building its own mbedTLS configuration.
+        static TLSContext* defaultClientContext();
+
+        // True if setIdentity has been called.
+        bool hasIdentity() const                        {return _hasIdentity;}
+
+        // Returns the context stored under `key` by cacheContext, if that was less than the
+        // cache lifetime ago; else nullptr. Reconnections to the same peer with the same
+        // settings can then skip parsing the certificates again, and can resume the TLS
+        // session saved by the context's last handshake with that peer.
+        static fleece::Retained<TLSContext> cachedContext(const std::string &key);
+
+        // Stores a context for cachedContext. A context with an identity isn't cached, so that
+        // a private key isn't kept in memory after the connections using it have closed.
+        static void cacheContext(const std::string &key, TLSContext* NONNULL);
+
+        // Sets how long cached contexts and TLS sessions are kept. Default is 10 minutes;
+        // zero disables caching and session resumption.
+        static void setCacheLifetime(std::chrono::seconds);
+
+        // Number of client handshakes that offered a saved session, for tests and diagnostics.
+        unsigned sessionsOffered() const                {return _sessionsOffered;}
+
     protected:
         ~TLSContext();
         bool findSigningRootCert(const std::string &certStr, std::string &rootStr);
 
     private:
+        using SessionClock = std::chrono::steady_clock;
+
+        struct SavedSession {
+            std::unique_ptr<mbedtls_ssl_session, void(*)(mbedtls_ssl_session*)> session;
+            SessionClock::time_point expires;
+        };
+
         void resetRootCertFinder();
+        void enableSessionCache();
+        void restoreSession(mbedtls_ssl_context*, const std::string &peer);
+        void saveSession(const mbedtls_ssl_context*, const std::string &peer);
         
         std::unique_ptr<sockpp::mbedtls_context> _context;
         fleece::Retained<crypto::Identity> _identity;
         role_t _role;
         bool _onlySelfSigned {false};
+        bool _hasIdentity {false};
+
+        // Client: the last session negotiated with each peer (hostname), for resumption.
+        std::mutex _sessionsMutex;
+        std::unordered_map<std::string, SavedSession> _sessions;
+        std::atomic<unsigned> _sessionsOffered {0};
+        // Server: mbedTLS's session-ID cache.
+        std::unique_ptr<mbedtls_ssl_cache_context> _serverSessionCache;
 
         friend class TCPSocket;
     };
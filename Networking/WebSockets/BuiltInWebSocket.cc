@@ -25,6 +25,7 @@
 #include "c4Socket+Internal.hh"
 #include "c4.hh"
 #include "Error.hh"
+#include "SecureDigest.hh"
 #include "StringUtil.hh"
 #include "ThreadUtil.hh"
 #include "sockpp/exception.h"
@@ -84,6 +85,7 @@ namespace litecore { namespace websocket {
     :BuiltInWebSocket(url, Role::Server, Parameters())
     {
         _socket.reset(socket.release());
+        setTLSHandshakeTime(_socket->tlsHandshakeTime());
     }
 
 
@@ -172,15 +174,33 @@ namespace litecore { namespace websocket {
                 return nullptr;
             }
             
-            _tlsContext = new TLSContext(TLSContext::Client);
-            _tlsContext->allowOnlySelfSigned(selfSignedOnly);
-            if (rootCerts)
-                _tlsContext->setRootCerts(rootCerts);
-            if (pinnedCert)
-                _tlsContext->allowOnlyCert(pinnedCert);
-            if (authType == slice(kC4AuthTypeClientCert)) {
-                if (!configureClientCert(authDict))
-                    return nullptr;
+            // Reuse the context of a recent connection to the same peer with the same settings,
+            // if any, instead of parsing the certs again; it also holds the TLS session to
+            // resume. (A context with a client cert isn't cached, since it holds the private key.)
+            bool clientCert = (authType == slice(kC4AuthTypeClientCert));
+            string cacheKey;
+            if (!clientCert) {
+                Address addr(url());
+                SHA1Builder settings;
+                settings << rootCerts << uint8_t(0) << pinnedCert << uint8_t(0)
+                         << uint8_t(selfSignedOnly);
+                cacheKey = format("%.*s:%u/", SPLAT(addr.hostname), addr.port)
+                         + slice(settings.finish()).hexString();
+                _tlsContext = TLSContext::cachedContext(cacheKey);
+            }
+            if (!_tlsContext) {
+                _tlsContext = new TLSContext(TLSContext::Client);
+                _tlsContext->allowOnlySelfSigned(selfSignedOnly);
+                if (rootCerts)
+                    _tlsContext->setRootCerts(rootCerts);
+                if (pinnedCert)
+                    _tlsContext->allowOnlyCert(pinnedCert);
+                if (clientCert) {
+                    if (!configureClientCert(authDict))
+                        return nullptr;
+                } else {
+                    TLSContext::cacheContext(cacheKey, _tlsContext);
+                }
             }
         }
 
@@ -251,6 +271,10 @@ namespace litecore { namespace websocket {
         if (logic.status() != HTTPStatus::undefined)
             gotHTTPResponse(int(logic.status()), logic.responseHeaders());
         if (lastDisposition == HTTPLogic::kSuccess) {
+            if (double tlsTime = socket->tlsHandshakeTime(); tlsTime > 0) {
+                logInfo("TLS handshake took %.3f sec", tlsTime);
+                setTLSHandshakeTime(tlsTime);
+            }
             return socket;
         } else {
             closeWithError(error);
@@ -400,11 +424,22 @@ namespace litecore { namespace websocket {
 
     // WebSocket API -- client wants to send a message
     void BuiltInWebSocket::sendBytes(alloc_slice bytes) {
+        sendFrameBytes(nullslice, bytes);
+    }
+
+
+    // The header and payload become separate outbox entries, which writeToSocket sends with a
+    // single gathered write; so the payload is never copied.
+    void BuiltInWebSocket::sendFrameBytes(alloc_slice header, alloc_slice payload) {
         unique_lock<mutex> lock(_outboxMutex);
         bool first = _outbox.empty();
-        _outboxAlloced.push_back(bytes);
-        _outbox.push_back(bytes);
-        if (first)
+        for (const alloc_slice &bytes : {header, payload}) {
+            if (bytes.size > 0) {
+                _outboxAlloced.push_back(bytes);
+                _outbox.push_back(bytes);
+            }
+        }
+        if (first && !_outbox.empty())
             awaitWriteable();
     }
 
@@ -50,6 +50,7 @@ namespace litecore { namespace websocket {
         // Implementations of WebSocketImpl abstract methods:
         virtual void closeSocket() override;
         virtual void sendBytes(fleece::alloc_slice) override;
+        virtual void sendFrameBytes(fleece::alloc_slice header, fleece::alloc_slice payload) override;
         virtual void receiveComplete(size_t byteCount) override;
         virtual void requestClose(int status, fleece::slice message) override;
 
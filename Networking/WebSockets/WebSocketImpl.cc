@@ -134,6 +134,54 @@ namespace litecore { namespace websocket {
     }
 
 
+    bool WebSocketImpl::sendBuffer(alloc_slice message, bool binary) {
+        logVerbose("Sending %zu-byte message", message.size);
+        alloc_slice header;
+        bool writeable;
+        {
+            lock_guard<std::mutex> lock(_mutex);
+            if (_closeSent)
+                return false;
+            if (_framing) {
+                // Only the header is formatted here; the payload goes out from the caller's
+                // buffer, which a client masks in place instead of copying it.
+                auto opcode = binary ? uWS::BINARY : uWS::TEXT;
+                char headerBuf[ClientProtocol::MAX_HEADER_SIZE];
+                char mask[4];
+                size_t headerSize;
+                if (role() == Role::Server) {
+                    headerSize = ServerProtocol::formatMessageHeader(headerBuf, opcode,
+                                                                     message.size, false, mask);
+                } else {
+                    headerSize = ClientProtocol::formatMessageHeader(headerBuf, opcode,
+                                                                     message.size, false, mask);
+                    ClientProtocol::maskPayload((char*)message.buf, message.size, mask);
+                }
+                header = alloc_slice(headerBuf, headerSize);
+            } else {
+                DebugAssert(binary);
+            }
+            _bufferedBytes += header.size + message.size;
+            writeable = (_bufferedBytes <= kSendBufferSize);
+        }
+        // As in sendOp, call out without holding the lock:
+        sendFrameBytes(header, message);
+        return writeable;
+    }
+
+
+    void WebSocketImpl::sendFrameBytes(alloc_slice header, alloc_slice payload) {
+        if (header.size == 0) {
+            sendBytes(payload);
+        } else {
+            alloc_slice frame(header.size + payload.size);
+            memcpy((void*)frame.buf, header.buf, header.size);
+            memcpy((void*)&frame[header.size], payload.buf, payload.size);
+            sendBytes(frame);
+        }
+    }
+
+
     bool WebSocketImpl::sendOp(fleece::slice message, int opcode) {
         alloc_slice frame;
         bool writeable;
@@ -501,9 +549,10 @@ namespace litecore { namespace websocket {
 
                 _timeConnected.stop();
                 double t = _timeConnected.elapsed();
-                logInfo("sent %" PRIu64 " bytes, rcvd %" PRIu64 ", in %.3f sec (%.0f/sec, %.0f/sec)",
+                logInfo("sent %" PRIu64 " bytes, rcvd %" PRIu64 ", in %.3f sec (%.0f/sec, %.0f/sec)"
+                        ", TLS handshake %.3f sec",
                     _bytesSent, _bytesReceived, t,
-                    _bytesSent/t, _bytesReceived/t);
+                    _bytesSent/t, _bytesReceived/t, _tlsHandshakeTime.load());
             } else {
                 logError("WebSocket failed to connect! (reason=%-s %d)",
                          status.reasonName(), status.code);
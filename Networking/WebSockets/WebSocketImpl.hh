@@ -20,6 +20,7 @@
 #include "WebSocketInterface.hh"
 #include "Logging.hh"
 #include "Stopwatch.hh"
+#include <atomic>
 #include <chrono>
 #include <cstdlib>
 #include <memory>
@@ -56,6 +57,7 @@ namespace litecore { namespace websocket {
 
         virtual void connect() override;
         virtual bool send(fleece::slice message, bool binary =true) override;
+        virtual bool sendBuffer(fleece::alloc_slice message, bool binary =true) override;
         virtual void close(int status =kCodeNormal, fleece::slice message =fleece::nullslice) override;
 
         // Concrete socket implementation needs to call these:
@@ -69,6 +71,9 @@ namespace litecore { namespace websocket {
 
         const Parameters& parameters() const         {return _parameters;}
         const fleece::AllocedDict& options() const   {return _parameters.options;}
+
+        /// Time in seconds the TLS handshake took (0 if none, or not connected yet.)
+        double tlsHandshakeTime() const             {return _tlsHandshakeTime;}
     protected:
         // Timeout for WebSocket connection (until HTTP response received)
         static constexpr long kConnectTimeoutSecs = 15;
@@ -77,9 +82,17 @@ namespace litecore { namespace websocket {
         virtual std::string loggingIdentifier() const override;
         void protocolError();
 
+        // Records how long the TLS handshake took; call before onConnect.
+        void setTLSHandshakeTime(double secs)           {_tlsHandshakeTime = secs;}
+
         // These methods have to be implemented in subclasses:
         virtual void closeSocket() =0;
         virtual void sendBytes(fleece::alloc_slice) =0;
+
+        // Sends a frame whose header and payload are in separate buffers, which must be written
+        // consecutively. The default implementation concatenates them and calls sendBytes;
+        // subclasses that can do gathered writes should override it.
+        virtual void sendFrameBytes(fleece::alloc_slice header, fleece::alloc_slice payload);
         virtual void receiveComplete(size_t byteCount) =0;
         virtual void requestClose(int status, fleece::slice message) =0;
 
@@ -132,6 +145,7 @@ namespace litecore { namespace websocket {
         // Connection diagnostics, logged on close:
         fleece::Stopwatch _timeConnected {false};           // Time since socket opened
         uint64_t _bytesSent {0}, _bytesReceived {0};// Total byte count sent/received
+        std::atomic<double> _tlsHandshakeTime {0};          // TLS handshake duration, if any
     };
 
 } }
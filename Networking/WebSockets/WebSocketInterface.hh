@@ -139,6 +139,13 @@ namespace litecore { namespace websocket {
             then stop sending until it gets an onWebSocketWriteable delegate call. */
         virtual bool send(fleece::slice message, bool binary =true) =0;
 
+        /** Sends a message that's in a heap buffer the caller won't use again. An implementation
+            can then send the bytes without copying them, and may modify them in place (e.g. to
+            apply WebSocket masking). The default implementation just calls `send`. */
+        virtual bool sendBuffer(fleece::alloc_slice message, bool binary =true) {
+            return send(message, binary);
+        }
+
         /** Closes the WebSocket. Callable from any thread. */
         virtual void close(int status =kCodeNormal, fleece::slice message =fleece::nullslice) =0;
         
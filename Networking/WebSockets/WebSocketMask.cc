@@ -0,0 +1,154 @@
+//
+// WebSocketMask.cc
+//
+// Copyright (c) 2020 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "WebSocketMask.hh"
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+    #define MASK_SSE2 1
+    #include <emmintrin.h>
+    #if defined(__GNUC__) || defined(__clang__)
+        // GCC and Clang can compile a single function for AVX2 and check for it at runtime
+        #define MASK_AVX2 1
+        #include <immintrin.h>
+    #endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(__aarch64__)
+    #define MASK_NEON 1
+    #include <arm_neon.h>
+#endif
+
+namespace litecore { namespace websocket {
+
+    // All the implementations process the data front to back, loading each block before
+    // storing it, which is what makes it safe for `dst` to overlap `src` at a lower address.
+    // Each one masks as many whole vectors as it can, then hands the rest to a narrower one;
+    // since the vector sizes are multiples of 4, the mask phase is 0 at every hand-off.
+
+
+    void ApplyWebSocketMaskPortable(char *dst, const char *src, size_t length, const char mask[4]) {
+        uint64_t mask64;
+        memcpy(&mask64, mask, 4);
+        memcpy((char*)&mask64 + 4, mask, 4);
+        size_t i = 0;
+        for (; i + 8 <= length; i += 8) {
+            uint64_t word;
+            memcpy(&word, src + i, 8);
+            word ^= mask64;
+            memcpy(dst + i, &word, 8);
+        }
+        for (; i < length; ++i)
+            dst[i] = src[i] ^ mask[i & 3];
+    }
+
+
+    // Fills `pattern` with the mask repeated, so a vector load of it matches memory order.
+    static inline void repeatMask(char *pattern, size_t size, const char mask[4]) {
+        for (size_t i = 0; i < size; i += 4)
+            memcpy(pattern + i, mask, 4);
+    }
+
+
+#ifdef MASK_SSE2
+    static void maskSSE2(char *dst, const char *src, size_t length, const char mask[4]) {
+        size_t i = 0;
+        if (length >= 16) {
+            char pattern[16];
+            repeatMask(pattern, sizeof(pattern), mask);
+            __m128i vmask = _mm_loadu_si128((const __m128i*)pattern);
+            for (; i + 16 <= length; i += 16) {
+                __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+                _mm_storeu_si128((__m128i*)(dst + i), _mm_xor_si128(v, vmask));
+            }
+        }
+        ApplyWebSocketMaskPortable(dst + i, src + i, length - i, mask);
+    }
+#endif
+
+
+#ifdef MASK_AVX2
+    __attribute__((target("avx2")))
+    static void maskAVX2(char *dst, const char *src, size_t length, const char mask[4]) {
+        size_t i = 0;
+        if (length >= 32) {
+            char pattern[32];
+            repeatMask(pattern, sizeof(pattern), mask);
+            __m256i vmask = _mm256_loadu_si256((const __m256i*)pattern);
+            for (; i + 32 <= length; i += 32) {
+                __m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+                _mm256_storeu_si256((__m256i*)(dst + i), _mm256_xor_si256(v, vmask));
+            }
+        }
+        maskSSE2(dst + i, src + i, length - i, mask);
+    }
+#endif
+
+
+#ifdef MASK_NEON
+    static void maskNEON(char *dst, const char *src, size_t length, const char mask[4]) {
+        size_t i = 0;
+        if (length >= 16) {
+            char pattern[16];
+            repeatMask(pattern, sizeof(pattern), mask);
+            uint8x16_t vmask = vld1q_u8((const uint8_t*)pattern);
+            for (; i + 16 <= length; i += 16) {
+                uint8x16_t v = vld1q_u8((const uint8_t*)(src + i));
+                vst1q_u8((uint8_t*)(dst + i), veorq_u8(v, vmask));
+            }
+        }
+        ApplyWebSocketMaskPortable(dst + i, src + i, length - i, mask);
+    }
+#endif
+
+
+    using MaskFn = void (*)(char*, const char*, size_t, const char*);
+
+    struct MaskImpl {
+        MaskFn fn;
+        const char *name;
+    };
+
+
+    static const MaskImpl& maskImpl() {
+        static const MaskImpl sImpl = []() -> MaskImpl {
+#ifdef MASK_AVX2
+            if (__builtin_cpu_supports("avx2"))
+                return {maskAVX2, "AVX2"};
+#endif
+#if defined(MASK_SSE2)
+            return {maskSSE2, "SSE2"};
+#elif defined(MASK_NEON)
+            return {maskNEON, "NEON"};
+#else
+            return {ApplyWebSocketMaskPortable, "word"};
+#endif
+        }();
+        return sImpl;
+    }
+
+
+    void ApplyWebSocketMask(char *dst, const char *src, size_t length, const char mask[4]) {
+        maskImpl().fn(dst, src, length, mask);
+    }
+
+
+    const char* WebSocketMaskImplementation() {
+        return maskImpl().name;
+    }
+
+} }
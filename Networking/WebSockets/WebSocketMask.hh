@@ -0,0 +1,37 @@
+//
+// WebSocketMask.hh
+//
+// Copyright (c) 2020 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include <stddef.h>
+
+namespace litecore { namespace websocket {
+
+    /** XORs `length` bytes from `src` with the repeating 4-byte WebSocket masking key `mask`,
+        writing the result to `dst`. (Masking and unmasking are the same operation.)
+        `dst` may be equal to `src`, or overlap it as long as `dst` is at a lower address.
+        Uses the fastest SIMD implementation the CPU supports, chosen at runtime. */
+    void ApplyWebSocketMask(char *dst, const char *src, size_t length, const char mask[4]);
+
+    /** Returns the name of the implementation ApplyWebSocketMask uses ("AVX2", "SSE2", "NEON"
+        or "word"); for tests and benchmarks. */
+    const char* WebSocketMaskImplementation();
+
+    /** The portable word-at-a-time implementation; exposed for tests and benchmarks. */
+    void ApplyWebSocketMaskPortable(char *dst, const char *src, size_t length, const char mask[4]);
+
+} }
@@ -73,6 +73,7 @@
 
 #include <cstring>
 #include <cstdlib>
+#include "WebSocketMask.hh"
 
 namespace uWS {
 
@@ -95,6 +96,7 @@ public:
     static const int SHORT_MESSAGE_HEADER = isServer ? 6 : 2;
     static const int MEDIUM_MESSAGE_HEADER = isServer ? 8 : 4;
     static const int LONG_MESSAGE_HEADER = isServer ? 14 : 10;
+    static const int MAX_HEADER_SIZE = 14;      // Largest header formatMessageHeader writes
 
 private:
     typedef uint16_t frameFormat;
@@ -107,14 +109,7 @@ private:
 
     static inline void unmaskPrecise(char *dst, char *src, char *mask, unsigned int length)
     {
-        for (; length >= 4; length -= 4) {
-            *(dst++) = *(src++) ^ mask[0];
-            *(dst++) = *(src++) ^ mask[1];
-            *(dst++) = *(src++) ^ mask[2];
-            *(dst++) = *(src++) ^ mask[3];
-        }
-        for (; length > 0; --length)
-            *(dst++) = *(src++) ^ *(mask++);
+        litecore::websocket::ApplyWebSocketMask(dst, src, length, mask);
     }
 
     static inline void unmaskPreciseCopyMask(char *dst, char *src, char *maskPtr, unsigned int length)
@@ -134,15 +129,7 @@ private:
 
     static inline void unmaskInplace(char *data, char *stop, char *mask)
     {
-        char *stop1 = stop - 3;
-        while (data < stop1) {
-            *(data++) ^= mask[0];
-            *(data++) ^= mask[1];
-            *(data++) ^= mask[2];
-            *(data++) ^= mask[3];
-        }
-        while (data < stop)
-            *(data++) ^= *(mask++);
+        litecore::websocket::ApplyWebSocketMask(data, data, stop - data, mask);
     }
 
     enum state_t {
@@ -331,8 +318,10 @@ public:
         return 0;
     }
 
-    static inline size_t formatMessage(char *dst, const char *src, size_t length, OpCode opCode, size_t reportedLength, bool compressed) {
-        size_t messageLength;
+    // Writes a frame header to `dst`, which needs room for MAX_HEADER_SIZE bytes, and returns
+    // its length. On the client side this includes a new random masking key, which is also
+    // copied to `mask` so the caller can apply it to the payload with maskPayload().
+    static inline size_t formatMessageHeader(char *dst, OpCode opCode, size_t reportedLength, bool compressed, char mask[4]) {
         size_t headerLength;
         if (reportedLength < 126) {
             headerLength = 2;
@@ -353,7 +342,6 @@ public:
             dst[0] |= opCode;
         }
 
-        char mask[4];
         if (!isServer) {
             ((uint8_t*)dst)[1] |= 0x80;
             uint32_t random = arc4random();
@@ -361,24 +349,21 @@ public:
             memcpy(dst + headerLength, &random, 4);
             headerLength += 4;
         }
+        return headerLength;
+    }
 
-        messageLength = headerLength + length;
-        memcpy(dst + headerLength, src, length);
-
-        if (!isServer) {
-
-            // overwrites up to 3 bytes outside of the given buffer!
-            //WebSocketProtocol<isServer>::unmaskInplace(dst + headerLength, dst + headerLength + length, mask);
+    // Applies a client frame's masking key to its payload, in place.
+    static inline void maskPayload(char *data, size_t length, const char mask[4]) {
+        litecore::websocket::ApplyWebSocketMask(data, data, length, mask);
+    }
 
-            // this is not optimal
-            char *start = dst + headerLength;
-            char *stop = start + length;
-            int i = 0;
-            while (start != stop) {
-                (*start++) ^= mask[i++ % 4];
-            }
-        }
-        return messageLength;
+    static inline size_t formatMessage(char *dst, const char *src, size_t length, OpCode opCode, size_t reportedLength, bool compressed) {
+        char mask[4];
+        size_t headerLength = formatMessageHeader(dst, opCode, reportedLength, compressed, mask);
+        memcpy(dst + headerLength, src, length);
+        if (!isServer)
+            maskPayload(dst + headerLength, length, mask);
+        return headerLength + length;
     }
 
     void consume(const char *src, unsigned int length, void *user) {
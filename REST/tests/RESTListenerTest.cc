@@ -21,6 +21,7 @@
 #include "ListenerHarness.hh"
 #include "FilePath.hh"
 #include "Response.hh"
+#include "TLSContext.hh"
 #include "NetworkInterfaces.hh"
 #include "c4Internal.hh"
 #include "fleece/Mutable.hh"
@@ -588,6 +589,22 @@ TEST_CASE_METHOD(C4RESTTest, "TLS REST pinned cert", "[REST][Listener][TLS][C]")
 }
 
 
+TEST_CASE_METHOD(C4RESTTest, "TLS REST session resumption", "[REST][Listener][TLS][C]") {
+    pinnedCert = useServerTLSWithTemporaryKey();
+    share(db, "db"_sl);
+    // The second request, using the same client context, should offer the first one's session:
+    Retained<TLSContext> tlsContext = new TLSContext(TLSContext::Client);
+    tlsContext->allowOnlyCert(pinnedCert);
+    auto port = c4listener_getPort(listener());
+    for (unsigned i = 0; i < 2; ++i) {
+        Response r("https", "GET", requestHostname, port, "/");
+        r.setTLSContext(tlsContext);
+        CHECK(r.status() == HTTPStatus::OK);
+        CHECK(tlsContext->sessionsOffered() == i);
+    }
+}
+
+
 #ifdef PERSISTENT_PRIVATE_KEY_AVAILABLE
 TEST_CASE_METHOD(C4RESTTest, "TLS REST pinned cert persistent key", "[REST][Listener][TLS][C]") {
     pinnedCert = useServerTLSWithPersistentKey();
@@ -19,6 +19,7 @@
 #include "DBAccess.hh"
 #include "ReplicatedRev.hh"
 #include "ReplicatorTuning.hh"
+#include "FleeceDelta.hh"
 #include "Error.hh"
 #include "Stopwatch.hh"
 #include "StringUtil.hh"
@@ -331,7 +332,8 @@ namespace litecore { namespace repl {
 
 
     Doc DBAccess::applyDelta(const C4Revision *baseRevision,
-                             slice deltaJSON,
+                             slice delta,
+                             bool fleeceDelta,
                              bool useDBSharedKeys,
                              C4Error *outError)
     {
@@ -341,7 +343,18 @@ namespace litecore { namespace repl {
             return {};
         }
 
-        bool useLegacyAttachments = !_disableBlobSupport && containsAttachmentsProperty(deltaJSON);
+        Value fleeceDeltaRoot;
+        if (fleeceDelta) {
+            fleeceDeltaRoot = Value::fromData(delta, kFLUntrusted);
+            if (!fleeceDeltaRoot.asDict()) {
+                if (outError) *outError = c4error_make(LiteCoreDomain, kC4ErrorCorruptDelta, "Invalid delta"_sl);
+                return {};
+            }
+        }
+
+        bool useLegacyAttachments = !_disableBlobSupport
+            && (fleeceDelta ? fleeceDeltaRoot.asDict()[slice(kC4LegacyAttachmentsProperty)] != nullptr
+                            : containsAttachmentsProperty(delta));
         Doc reEncodedDoc;
         if (useLegacyAttachments || !useDBSharedKeys) {
             Encoder enc;
@@ -359,17 +372,26 @@ namespace litecore { namespace repl {
         
         Doc result;
         FLError flErr;
+        auto applyTo = [&](Encoder &enc) {
+            if (!fleeceDelta) {
+                JSONDelta::apply(srcRoot, delta, enc);
+                result = enc.finishDoc(&flErr);
+            } else if (FleeceDelta::apply(srcRoot, fleeceDeltaRoot, enc)) {
+                result = enc.finishDoc(&flErr);
+            } else {
+                enc.reset();
+                flErr = kFLInvalidData;
+            }
+        };
         if (useDBSharedKeys) {
             useForInsert([&](C4Database *idb) {
                 SharedEncoder enc(c4db_getSharedFleeceEncoder(idb));
-                JSONDelta::apply(srcRoot, deltaJSON, enc);
-                result = enc.finishDoc(&flErr);
+                applyTo(enc);
             });
         } else {
             Encoder enc;
             enc.setSharedKeys(tempSharedKeys());
-            JSONDelta::apply(srcRoot, deltaJSON, enc);
-            result = enc.finishDoc(&flErr);
+            applyTo(enc);
         }
         ++gNumDeltasApplied;
 
@@ -385,14 +407,15 @@ namespace litecore { namespace repl {
 
     Doc DBAccess::applyDelta(slice docID,
                              slice baseRevID,
-                             slice deltaJSON,
+                             slice delta,
+                             bool fleeceDelta,
                              C4Error *outError)
     {
         return useForInsert<Doc>([&](C4Database *idb)->Doc {
             c4::ref<C4Document> doc = c4doc_get(idb, docID, true, outError);
             if (doc && c4doc_selectRevision(doc, baseRevID, true, outError)) {
                 if (doc->selectedRev.body.buf) {
-                    return applyDelta(&doc->selectedRev, deltaJSON, false, outError);
+                    return applyDelta(&doc->selectedRev, delta, fleeceDelta, false, outError);
                 } else {
                     string msg = format("Couldn't apply delta: Don't have body of '%.*s' #%.*s [current is %.*s]",
                                         SPLAT(docID), SPLAT(baseRevID), SPLAT(doc->revID));
@@ -94,16 +94,19 @@ namespace litecore { namespace repl {
 
         //////// DELTAS:
 
-        /** Applies a delta to an existing revision. */
+        /** Applies a delta to an existing revision. The delta is JSON, unless `fleeceDelta`
+            is true in which case it's in FleeceDelta's binary format. */
         fleece::Doc applyDelta(const C4Revision *baseRevision NONNULL,
-                               slice deltaJSON,
+                               slice delta,
+                               bool fleeceDelta,
                                bool useDBSharedKeys,
                                C4Error *outError);
 
         /** Reads a document revision and applies a delta to it. */
         fleece::Doc applyDelta(slice docID,
                                slice baseRevID,
-                               slice deltaJSON,
+                               slice delta,
+                               bool fleeceDelta,
                                C4Error *outError);
 
         //////// BLOBS / ATTACHMENTS:
@@ -134,6 +137,10 @@ namespace litecore { namespace repl {
             isn't in a transaction. */
         fleece::Doc tempEncodeJSON(slice jsonBody, FLError *err);
 
+        /** The temporary SharedKeys used by tempEncodeJSON. Documents encoded elsewhere with
+            these keys can also be passed to reEncodeForDatabase. */
+        fleece::SharedKeys tempSharedKeys();
+
         /** Takes a document produced by tempEncodeJSON and re-encodes it if necessary with the
             database's real SharedKeys, so it's suitable for saving. This can only be called
             inside a transaction. */
@@ -193,7 +200,6 @@ namespace litecore { namespace repl {
         friend class Transaction;
         
         void markRevsSyncedLater();
-        fleece::SharedKeys tempSharedKeys();
         fleece::SharedKeys updateTempSharedKeys();
         bool beginTransaction(C4Error*);
         bool endTransaction(bool commit, C4Error*);
@@ -0,0 +1,249 @@
+//
+// FleeceDelta.cc
+//
+// Copyright (c) 2020 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "FleeceDelta.hh"
+#include <algorithm>
+#include <stdio.h>
+#include <utility>
+#include <vector>
+
+using namespace std;
+using namespace fleece;
+
+namespace litecore { namespace repl {
+
+    static const slice kArrayLengthKey = "-"_sl;
+
+    static void writeDelta(Value old, Value nuu, Encoder &enc);
+
+
+    static void writeReplacement(Value nuu, Encoder &enc) {
+        enc.beginArray(1);
+        enc.writeValue(nuu);
+        enc.endArray();
+    }
+
+
+    static void writeIndexKey(uint32_t index, Encoder &enc) {
+        char buf[16];
+        enc.writeKey(slice(buf, sprintf(buf, "%u", index)));
+    }
+
+
+    static void writeDictDelta(Dict old, Dict nuu, Encoder &enc) {
+        enc.beginDict();
+        for (Dict::iterator i(old); i; ++i) {
+            slice key = i.keyString();
+            Value nuuValue = nuu[key];
+            if (!nuuValue) {
+                enc.writeKey(key);
+                enc.beginArray();           // `[]` means "removed"
+                enc.endArray();
+            } else if (!i.value().isEqual(nuuValue)) {
+                enc.writeKey(key);
+                writeDelta(i.value(), nuuValue, enc);
+            }
+        }
+        for (Dict::iterator i(nuu); i; ++i) {
+            slice key = i.keyString();
+            if (!old[key]) {
+                enc.writeKey(key);
+                writeReplacement(i.value(), enc);
+            }
+        }
+        enc.endDict();
+    }
+
+
+    static void writeArrayDelta(Array old, Array nuu, Encoder &enc) {
+        uint32_t oldCount = old.count(), nuuCount = nuu.count();
+        uint32_t minCount = min(oldCount, nuuCount);
+
+        // If most of the items changed (an insertion near the start, say), just replace it:
+        uint32_t changed = 0;
+        for (uint32_t i = 0; i < minCount; ++i) {
+            if (!old[i].isEqual(nuu[i]))
+                ++changed;
+        }
+        if (changed > minCount / 2) {
+            writeReplacement(nuu, enc);
+            return;
+        }
+
+        enc.beginDict();
+        for (uint32_t i = 0; i < minCount; ++i) {
+            if (!old[i].isEqual(nuu[i])) {
+                writeIndexKey(i, enc);
+                writeDelta(old[i], nuu[i], enc);
+            }
+        }
+        for (uint32_t i = minCount; i < nuuCount; ++i) {
+            writeIndexKey(i, enc);
+            writeReplacement(nuu[i], enc);
+        }
+        if (nuuCount != oldCount) {
+            enc.writeKey(kArrayLengthKey);
+            enc.writeUInt(nuuCount);
+        }
+        enc.endDict();
+    }
+
+
+    // Writes a delta between two unequal values.
+    static void writeDelta(Value old, Value nuu, Encoder &enc) {
+        if (old.type() == kFLDict && nuu.type() == kFLDict)
+            writeDictDelta(old.asDict(), nuu.asDict(), enc);
+        else if (old.type() == kFLArray && nuu.type() == kFLArray)
+            writeArrayDelta(old.asArray(), nuu.asArray(), enc);
+        else
+            writeReplacement(nuu, enc);
+    }
+
+
+    bool FleeceDelta::create(Dict old, Dict nuu, Encoder &enc) {
+        if (old.isEqual(nuu))
+            return false;
+        writeDictDelta(old, nuu, enc);
+        return true;
+    }
+
+
+    alloc_slice FleeceDelta::create(Dict old, Dict nuu) {
+        Encoder enc;
+        if (!create(old, nuu, enc))
+            return nullslice;
+        return enc.finish();
+    }
+
+
+#pragma mark - APPLYING:
+
+
+    static bool applyToDict(Dict old, Dict delta, Encoder &enc) {
+        enc.beginDict(old.count());
+        for (Dict::iterator i(old); i; ++i) {
+            slice key = i.keyString();
+            Value valueDelta = delta[key];
+            if (!valueDelta) {
+                enc.writeKey(key);
+                enc.writeValue(i.value());
+            } else if (Array a = valueDelta.asArray(); a && a.empty()) {
+                // removed
+            } else {
+                enc.writeKey(key);
+                if (!FleeceDelta::apply(i.value(), valueDelta, enc))
+                    return false;
+            }
+        }
+        for (Dict::iterator i(delta); i; ++i) {
+            slice key = i.keyString();
+            if (!old[key]) {
+                Array a = i.value().asArray();
+                if (!a || a.count() > 1)
+                    return false;
+                if (a.count() == 1) {
+                    enc.writeKey(key);
+                    enc.writeValue(a[0]);
+                }
+            }
+        }
+        enc.endDict();
+        return true;
+    }
+
+
+    static bool applyToArray(Array old, Dict delta, Encoder &enc) {
+        // Collect the item deltas in index order (Dict keys are sorted as strings, not numbers):
+        uint32_t oldCount = old.count(), nuuCount = oldCount;
+        vector<pair<uint32_t,Value>> items;
+        items.reserve(delta.count());
+        for (Dict::iterator i(delta); i; ++i) {
+            slice key = i.keyString();
+            if (key == kArrayLengthKey) {
+                if (!i.value().isInteger() || i.value().asInt() < 0)
+                    return false;
+                nuuCount = uint32_t(i.value().asUnsigned());
+                continue;
+            }
+            if (key.size == 0 || key.size > 9 || (key.size > 1 && key[0] == '0'))
+                return false;       // (a leading zero would make "1" and "01" the same index)
+            uint32_t index = 0;
+            for (uint8_t c : key) {
+                if (c < '0' || c > '9')
+                    return false;
+                index = 10 * index + (c - '0');
+            }
+            items.emplace_back(index, i.value());
+        }
+        sort(items.begin(), items.end(), [](const pair<uint32_t,Value> &a,
+                                            const pair<uint32_t,Value> &b) {
+            return a.first < b.first;
+        });
+        if (!items.empty() && items.back().first >= nuuCount)
+            return false;
+        for (size_t i = 1; i < items.size(); ++i) {
+            if (items[i].first == items[i-1].first)
+                return false;       // duplicate index
+        }
+
+        enc.beginArray(nuuCount);
+        auto item = items.begin();
+        for (uint32_t i = 0; i < nuuCount; ++i) {
+            if (item != items.end() && item->first == i) {
+                Value itemDelta = (item++)->second;
+                if (i < oldCount) {
+                    if (!FleeceDelta::apply(old[i], itemDelta, enc))
+                        return false;
+                } else {
+                    Array a = itemDelta.asArray();
+                    if (!a || a.count() != 1)
+                        return false;
+                    enc.writeValue(a[0]);
+                }
+            } else if (i < oldCount) {
+                enc.writeValue(old[i]);
+            } else {
+                return false;       // new item with no value
+            }
+        }
+        if (item != items.end())
+            return false;           // unused item delta
+        enc.endArray();
+        return true;
+    }
+
+
+    bool FleeceDelta::apply(Value old, Value delta, Encoder &enc) {
+        if (Array replacement = delta.asArray(); replacement) {
+            if (replacement.count() != 1)
+                return false;
+            enc.writeValue(replacement[0]);
+            return true;
+        }
+        Dict changes = delta.asDict();
+        if (!changes)
+            return false;
+        if (Dict oldDict = old.asDict(); oldDict)
+            return applyToDict(oldDict, changes, enc);
+        else if (Array oldArray = old.asArray(); oldArray)
+            return applyToArray(oldArray, changes, enc);
+        else
+            return false;
+    }
+
+} }
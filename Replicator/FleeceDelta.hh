@@ -0,0 +1,50 @@
+//
+// FleeceDelta.hh
+//
+// Copyright (c) 2020 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "fleece/Fleece.hh"
+
+namespace litecore { namespace repl {
+
+    /** Binary deltas between Fleece values, used by delta sync between two LiteCore peers.
+        Unlike JSONDelta, creating or applying one works directly on the Fleece trees, with no
+        JSON conversion of the revision bodies.
+
+        A delta is itself a Fleece value, with the same structure as a JSON delta:
+        - A Dict describes changes to a Dict. Each key maps to a nested delta for that key:
+          `[value]` sets it, `[]` removes it, and a Dict is a delta of the existing value.
+        - A Dict also describes changes to an Array. Its keys are decimal item indexes, each
+          mapping to a nested delta as above (except that `[]` isn't allowed); the special key
+          "-" gives the new array length if it changed.
+        Strings are always replaced whole; there's no string-diff form. */
+    class FleeceDelta {
+    public:
+        /** Encodes a delta that transforms `old` into `nuu`, which must both be Dicts.
+            Returns false (and writes nothing) if they're equal. */
+        static bool create(fleece::Dict old, fleece::Dict nuu, fleece::Encoder&);
+
+        /** Convenience that returns the encoded delta, or null if the values are equal. */
+        static fleece::alloc_slice create(fleece::Dict old, fleece::Dict nuu);
+
+        /** Writes the result of applying `delta` to `old` to the encoder.
+            Returns false if the delta is invalid or doesn't fit `old`; in that case the
+            encoder's output is garbage and should be discarded. */
+        static bool apply(fleece::Value old, fleece::Value delta, fleece::Encoder&);
+    };
+
+} }
@@ -22,6 +22,7 @@
 #include "StringUtil.hh"
 #include "MessageBuilder.hh"
 #include "c4BlobStore.h"
+#include <algorithm>
 #include <atomic>
 
 using namespace fleece;
@@ -59,17 +60,51 @@ namespace litecore { namespace repl {
         if (c4blob_getSize(_db->blobStore(), _blob->key) >= 0)
             return false;  // already have it
 
-        logVerbose("Requesting blob (%" PRIu64 " bytes, compress=%d)", _blob->length, _blob->compressible);
-
+        // Open the writer first: it may already have data from an earlier, interrupted download
+        // of this blob, in which case only the rest needs to be requested.
+        C4Error err;
+        _writer = c4blob_openResumableWriteStream(_db->blobStore(), _blob->key, &err);
         addProgress({0, _blob->length});
         _blobBytesWritten = 0;
+        _blobSkipBytes = 0;
+        if (!_writer) {
+            blobGotError(err);
+            return true;
+        }
+#if DEBUG
+        int n = ++sNumOpenWriters;
+        if (n > sMaxOpenWriters) {
+            sMaxOpenWriters = n;
+            logInfo("There are now %d blob writers open", n);
+        }
+        logVerbose("Opened blob writer  [%d open; max %d]", n, (int)sMaxOpenWriters);
+#endif
+
+        uint64_t offset = c4stream_bytesWritten(_writer);
+        if (offset > 0) {
+            _blobBytesWritten = offset;
+            addProgress({offset, 0});
+            if (offset >= _blob->length && _blob->length > 0) {
+                // Already have all of it; installing will verify the digest:
+                finishBlob();
+                return true;
+            }
+            logInfo("Resuming download of blob at offset %" PRIu64 " of %" PRIu64,
+                    offset, _blob->length);
+        } else {
+            logVerbose("Requesting blob (%" PRIu64 " bytes, compress=%d)",
+                       _blob->length, _blob->compressible);
+        }
 
         MessageBuilder req("getAttachment"_sl);
         alloc_slice digest = c4blob_keyToString(_blob->key);
         req["digest"_sl] = digest;
+        if (offset > 0)
+            req["offset"_sl] = int64_t(offset);
         if (_blob->compressible)
             req["compress"_sl] = "true"_sl;
-        sendRequest(req, [=](blip::MessageProgress progress) {
+        bool checkedOffset = (offset == 0);
+        sendRequest(req, [=](blip::MessageProgress progress) mutable {
             //... After request is sent:
             if (_blob != _pendingBlobs.end()) {
                 if (progress.state == MessageProgress::kDisconnected) {
@@ -82,6 +117,15 @@ namespace litecore { namespace repl {
                                  SPLAT(err.domain), err.code, SPLAT(err.message));
                         blobGotError(blipToC4Error(err));
                     } else {
+                        if (!checkedOffset) {
+                            // A peer that doesn't support ranges ignores "offset" and sends the
+                            // whole blob, so skip the part I already have:
+                            checkedOffset = true;
+                            if (uint64_t(progress.reply->intProperty("offset"_sl)) != offset) {
+                                logInfo("Peer ignored blob offset; skipping %" PRIu64 " bytes", offset);
+                                _blobSkipBytes = offset;
+                            }
+                        }
                         bool complete = progress.state == MessageProgress::kComplete;
                         auto data = progress.reply->extractBody();
                         writeToBlob(data);
@@ -98,21 +142,16 @@ namespace litecore { namespace repl {
 
 
     // Writes data to the blob on disk.
-    void IncomingRev::writeToBlob(alloc_slice data) {
+    void IncomingRev::writeToBlob(alloc_slice allocedData) {
         C4Error err;
-		if(_writer == nullptr) {
-            _writer = c4blob_openWriteStream(_db->blobStore(), &err);
-            if (!_writer)
-                return gotError(err);
-#if DEBUG
-            int n = ++sNumOpenWriters;
-            if (n > sMaxOpenWriters) {
-                sMaxOpenWriters = n;
-                logInfo("There are now %d blob writers open", n);
-            }
-            logVerbose("Opened blob writer  [%d open; max %d]", n, (int)sMaxOpenWriters);
-#endif
-		}
+        if (!_writer)
+            return;     // (already failed)
+        slice data = allocedData;
+        if (_blobSkipBytes > 0) {
+            size_t skip = (size_t)std::min(_blobSkipBytes, uint64_t(data.size));
+            data.moveStart(skip);
+            _blobSkipBytes -= skip;
+        }
         if (data.size > 0) {
             if (!c4stream_write(_writer, data.buf, data.size, &err))
                 return gotError(err);
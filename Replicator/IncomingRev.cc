@@ -42,6 +42,11 @@ namespace litecore { namespace repl {
         return json.containsBytes("\"digest\""_sl);
     }
 
+    // Fleece strings are stored unquoted, and the sender doesn't use SharedKeys (see Pusher.)
+    static inline bool fleeceMightContainBlobs(slice data) {
+        return data.containsBytes("digest"_sl);
+    }
+
     IncomingRev::IncomingRev(Puller *puller)
     :Worker(puller, "inc")
     ,_puller(puller)
@@ -75,6 +80,8 @@ namespace litecore { namespace repl {
                                _revMessage->boolProperty("noconflicts"_sl)
                                    || _options.noIncomingConflicts());
         _rev->deltaSrcRevID = _revMessage->property("deltaSrc"_sl);
+        _rev->fleeceDelta = _rev->deltaSrcRevID && _revMessage->boolProperty("fleeceDelta"_sl);
+        _fleeceBody = _revMessage->boolProperty("fleeceBody"_sl);
         slice sequenceStr = _revMessage->property(slice("sequence"));
         _remoteSequence = RemoteSequence(sequenceStr);
 
@@ -102,16 +109,87 @@ namespace litecore { namespace repl {
         if (!_rev->historyBuf && c4rev_getGeneration(_rev->revID) > 1)
             warn("Server sent no history with '%.*s' #%.*s", SPLAT(_rev->docID), SPLAT(_rev->revID));
 
-        auto jsonBody = _revMessage->extractBody();
+        if (!_revMessage->isComplete()) {
+            // The body is still arriving, so process it incrementally:
+            streamBody();
+            return;
+        }
+
+        auto body = _revMessage->extractBody();
         if (_revMessage->noReply())
             _revMessage = nullptr;
 
         // Decide whether to continue now (on the Puller thread) or asynchronously on my own:
-        if (_options.pullValidator|| jsonBody.size > kMaxImmediateParseSize
-                                  || jsonMightContainBlobs(jsonBody))
-            enqueue(&IncomingRev::parseAndInsert, move(jsonBody));
+        bool mightContainBlobs = (_fleeceBody || _rev->fleeceDelta) ? fleeceMightContainBlobs(body)
+                                                                    : jsonMightContainBlobs(body);
+        if (_options.pullValidator|| body.size > kMaxImmediateParseSize || mightContainBlobs)
+            enqueue(&IncomingRev::parseAndInsert, move(body));
         else
-            parseAndInsert(move(jsonBody));
+            parseAndInsert(move(body));
+    }
+
+
+    // Sets up to receive the rest of the 'rev' message's body as its frames arrive, instead of
+    // waiting for BLIP to buffer the whole thing. A regular JSON body is converted to Fleece
+    // frame by frame, so the full JSON never has to be held in memory. A delta or a Fleece body
+    // can't be used until it's complete, so it's just accumulated.
+    void IncomingRev::streamBody() {
+        logVerbose("Streaming body of '%.*s' #%.*s", SPLAT(_rev->docID), SPLAT(_rev->revID));
+        if (!_rev->deltaSrcRevID && !_fleeceBody)
+            _jsonStream.reset(new JSONStreamConverter(_db->tempSharedKeys()));
+        _streamingBody = true;
+        Retained<IncomingRev> retainSelf = this;
+        _revMessage->streamBody([retainSelf](slice data, bool complete) {
+            // (This is called on the BLIP thread, so pass the data over to mine.)
+            retainSelf->enqueue(&IncomingRev::_gotBodyData, alloc_slice(data), complete);
+        });
+    }
+
+
+    // Receives a piece of a streamed 'rev' body (see streamBody.)
+    void IncomingRev::_gotBodyData(alloc_slice data, bool complete) {
+        if (complete)
+            _streamingBody = false;
+        if (complete && !_revMessage->isComplete()) {
+            // The body ended prematurely because the connection closed:
+            _jsonStream.reset();
+            _bodyBuffer.reset();
+            _revMessage = nullptr;
+            _rev->errorIsTransient = true;
+            failWithError(WebSocketDomain, 503, "connection closed while receiving revision"_sl);
+            return;
+        }
+
+        if (_jsonStream) {
+            if (data)
+                _jsonStream->write(data);
+            if (!complete)
+                return;
+            FLError encodeErr;
+            Doc fleeceDoc = _jsonStream->finish(&encodeErr);
+            if (!fleeceDoc)
+                warn("Streamed rev body is invalid: %s", _jsonStream->errorMessage());
+            _jsonStream.reset();
+            if (_revMessage->noReply())
+                _revMessage = nullptr;
+            if (!fleeceDoc) {
+                failWithError(c4error_make(FleeceDomain, (int)encodeErr,
+                                           "Incoming rev failed to encode"_sl));
+                return;
+            }
+            processFleeceBody(fleeceDoc);
+
+        } else {
+            if (data)
+                _bodyBuffer.write(data);
+            if (!complete)
+                return;
+            alloc_slice body = _bodyBuffer.finish();
+            _bodyBuffer.reset();
+            if (_revMessage->noReply())
+                _revMessage = nullptr;
+            parseAndInsert(move(body));
+        }
     }
 
 
@@ -119,19 +197,29 @@ namespace litecore { namespace repl {
         // First create a Fleece document:
         Doc fleeceDoc;
         C4Error err = {};
-        if (_rev->deltaSrcRevID == nullslice) {
+        if (_fleeceBody) {
+            // The body is already Fleece (from a LiteCore peer); just validate it:
+            fleeceDoc = Doc(jsonBody, kFLUntrusted);
+            if (!fleeceDoc || !fleeceDoc.asDict())
+                err = c4error_make(FleeceDomain, kFLInvalidData, "Incoming Fleece rev is invalid"_sl);
+            else
+                ++gNumFleeceBodiesReceived;
+
+        } else if (_rev->deltaSrcRevID == nullslice) {
             // It's not a delta. Convert body to Fleece and process:
             FLError encodeErr;
             fleeceDoc = _db->tempEncodeJSON(jsonBody, &encodeErr);
             if (!fleeceDoc)
                 err = c4error_make(FleeceDomain, (int)encodeErr, "Incoming rev failed to encode"_sl);
 
-        } else if (_options.pullValidator || jsonMightContainBlobs(jsonBody)) {
+        } else if (_options.pullValidator || (_rev->fleeceDelta ? fleeceMightContainBlobs(jsonBody)
+                                                                : jsonMightContainBlobs(jsonBody))) {
             // It's a delta, but we need the entire document body now because either it has to be
             // passed to the validation function, or it may contain new blobs to download.
             logVerbose("Need to apply delta immediately for '%.*s' #%.*s ...",
                        SPLAT(_rev->docID), SPLAT(_rev->revID));
-            fleeceDoc = _db->applyDelta(_rev->docID, _rev->deltaSrcRevID, jsonBody, &err);
+            fleeceDoc = _db->applyDelta(_rev->docID, _rev->deltaSrcRevID, jsonBody,
+                                        _rev->fleeceDelta, &err);
             if (!fleeceDoc && err.domain==LiteCoreDomain && err.code==kC4ErrorDeltaBaseUnknown) {
                 // Don't have the body of the source revision. This might be because I'm in
                 // no-conflict mode and the peer is trying to push me a now-obsolete revision.
@@ -139,6 +227,7 @@ namespace litecore { namespace repl {
                     err = {WebSocketDomain, 409};
             }
             _rev->deltaSrcRevID = nullslice;
+            _rev->fleeceDelta = false;
 
         } else {
             // It's a delta, but it can be applied later while inserting.
@@ -152,6 +241,12 @@ namespace litecore { namespace repl {
             return;
         }
 
+        processFleeceBody(fleeceDoc);
+    }
+
+
+    // Handles the revision body once it's been converted to Fleece.
+    void IncomingRev::processFleeceBody(Doc fleeceDoc) {
         // Note: fleeceDoc is _not_ yet suitable for inserting into the
         // database because it doesn't use the same SharedKeys, but it lets us look at the doc
         // metadata and blobs.
@@ -292,6 +387,7 @@ namespace litecore { namespace repl {
 
     Worker::ActivityLevel IncomingRev::computeActivityLevel() const {
         if (Worker::computeActivityLevel() == kC4Busy || _pendingCallbacks > 0
+                                                      || _streamingBody
                                                       || (_blob != _pendingBlobs.end())) {
             return kC4Busy;
         } else {
@@ -299,5 +395,8 @@ namespace litecore { namespace repl {
         }
     }
 
+
+    atomic<unsigned> IncomingRev::gNumFleeceBodiesReceived;
+
 } }
 
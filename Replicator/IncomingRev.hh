@@ -21,8 +21,11 @@
 #include "ReplicatorTypes.hh"
 #include "RemoteSequence.hh"
 #include "Timer.hh"
+#include "JSONStreamConverter.hh"
+#include "Writer.hh"
 #include "c4.hh"
 #include <atomic>
+#include <memory>
 #include <vector>
 
 namespace litecore { namespace repl {
@@ -46,6 +49,8 @@ namespace litecore { namespace repl {
         void revisionProvisionallyInserted();
         void revisionInserted();
 
+        static std::atomic<unsigned> gNumFleeceBodiesReceived;  // For unit tests only
+
     protected:
         ActivityLevel computeActivityLevel() const override;
 
@@ -55,6 +60,8 @@ namespace litecore { namespace repl {
         void _handleRev(Retained<blip::MessageIn>);
         void gotDeltaSrc(alloc_slice deltaSrcBody);
         fleece::Doc parseBody(alloc_slice jsonBody);
+        void streamBody();
+        void _gotBodyData(alloc_slice data, bool complete);
         void processFleeceBody(fleece::Doc);
         void insertRevision();
         void _revisionInserted();
@@ -79,11 +86,16 @@ namespace litecore { namespace repl {
         RemoteSequence              _remoteSequence;
         uint32_t                    _serialNumber {0};
         std::atomic<bool>           _provisionallyInserted {false};
+        std::unique_ptr<JSONStreamConverter> _jsonStream; // Parses streamed JSON body
+        fleece::Writer              _bodyBuffer;    // Accumulates streamed delta/Fleece body
+        bool                        _streamingBody {false}; // Waiting for more body data
+        bool                        _fleeceBody {false};    // Body is binary Fleece, not JSON
         // blob stuff:
         std::vector<PendingBlob>    _pendingBlobs;
         std::vector<PendingBlob>::const_iterator _blob;
         c4::ref<C4WriteStream>      _writer;
         uint64_t                    _blobBytesWritten;
+        uint64_t                    _blobSkipBytes {0};     // Resent bytes to ignore
         actor::Timer::time          _lastNotifyTime;
     };
 
@@ -145,13 +145,20 @@ namespace litecore { namespace repl {
 
             alloc_slice bodyForDB;
             if (rev->deltaSrc) {
-                // If this is a delta, put the JSON delta in the put-request:
+                // If this is a delta, put the JSON or Fleece delta in the put-request:
                 bodyForDB = move(rev->deltaSrc);
                 put.deltaSourceRevID = rev->deltaSrcRevID;
-                put.deltaCB = [](void *context, const C4Revision *baseRev,
-                                 C4Slice delta, C4Error *outError) {
-                    return ((Inserter*)context)->applyDeltaCallback(baseRev, delta, outError);
-                };
+                if (rev->fleeceDelta) {
+                    put.deltaCB = [](void *context, const C4Revision *baseRev,
+                                     C4Slice delta, C4Error *outError) {
+                        return ((Inserter*)context)->applyDeltaCallback(baseRev, delta, true, outError);
+                    };
+                } else {
+                    put.deltaCB = [](void *context, const C4Revision *baseRev,
+                                     C4Slice delta, C4Error *outError) {
+                        return ((Inserter*)context)->applyDeltaCallback(baseRev, delta, false, outError);
+                    };
+                }
                 put.deltaCBContext = this;
                 // Preserve rev body as the source of a future delta I may push back:
                 put.revFlags |= kRevKeepBody;
@@ -191,10 +198,11 @@ namespace litecore { namespace repl {
 
     // Callback from c4doc_put() that applies a delta, during _insertRevisionsNow()
     C4SliceResult Inserter::applyDeltaCallback(const C4Revision *baseRevision,
-                                               C4Slice deltaJSON,
+                                               C4Slice delta,
+                                               bool fleeceDelta,
                                                C4Error *outError)
     {
-        Doc doc = _db->applyDelta(baseRevision, deltaJSON, true, outError);
+        Doc doc = _db->applyDelta(baseRevision, delta, fleeceDelta, true, outError);
         if (!doc)
             return {};
         alloc_slice body = doc.allocedData();
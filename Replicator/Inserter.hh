@@ -35,7 +35,8 @@ namespace litecore { namespace repl {
         void _insertRevisionsNow(int gen);
         bool insertRevisionNow(RevToInsert* NONNULL, C4Error*);
         C4SliceResult applyDeltaCallback(const C4Revision *baseRevision NONNULL,
-                                         C4Slice deltaJSON,
+                                         C4Slice delta,
+                                         bool fleeceDelta,
                                          C4Error *outError);
 
         actor::ActorBatcher<Inserter,RevToInsert> _revsToInsert; // Pending revs to be added to db
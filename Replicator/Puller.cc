@@ -47,7 +47,7 @@ namespace litecore { namespace repl {
 #endif
     {
         _passive = _options.pull <= kC4Passive;
-        registerHandler("rev",              &Puller::handleRev);
+        registerHandler("rev",              &Puller::handleRev, true);   // body may be incomplete
         registerHandler("norev",            &Puller::handleNoRev);
         _spareIncomingRevs.reserve(tuning::kMaxActiveIncomingRevs);
         _skipDeleted = _options.skipDeleted();
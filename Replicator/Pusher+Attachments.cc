@@ -52,7 +52,9 @@ namespace litecore::repl {
     }
 
 
-    // Incoming request to send an attachment/blob
+    // Incoming request to send an attachment/blob.
+    // Optional "offset" and "length" properties request a byte range, so that an interrupted
+    // download can be resumed; the reply's "offset" property confirms the range was honored.
     void Pusher::handleGetAttachment(Retained<MessageIn> req) {
         slice digest;
         Replicator::BlobProgress progress;
@@ -63,11 +65,30 @@ namespace litecore::repl {
             return;
         }
 
+        int64_t offset = req->intProperty("offset"_sl);
+        int64_t length = req->intProperty("length"_sl, -1);
+        if (offset < 0 || uint64_t(offset) > progress.bytesTotal) {
+            c4stream_close(blob);
+            req->respondWithError({"HTTP"_sl, 416, "Invalid blob offset"_sl});
+            return;
+        }
+        if (offset > 0 && !c4stream_seek(blob, offset, &err)) {
+            c4stream_close(blob);
+            req->respondWithError(c4ToBLIPError(err));
+            return;
+        }
+        uint64_t remaining = progress.bytesTotal - offset;
+        if (length >= 0)
+            remaining = min(remaining, uint64_t(length));
+        progress.bytesCompleted = offset;
+
         increment(_blobsInFlight);
         MessageBuilder reply(req);
         reply.compressed = req->boolProperty("compress"_sl);
-        logVerbose("Sending blob %.*s (length=%" PRId64 ", compress=%d)",
-                   SPLAT(digest), c4stream_getLength(blob, nullptr), reply.compressed);
+        if (offset > 0)
+            reply["offset"_sl] = offset;
+        logVerbose("Sending blob %.*s (length=%" PRId64 ", offset=%" PRId64 ", compress=%d)",
+                   SPLAT(digest), c4stream_getLength(blob, nullptr), offset, reply.compressed);
         Retained<Replicator> repl = replicator();
         auto lastNotifyTime = actor::Timer::clock::now();
         if (progressNotificationLevel() >= 2)
@@ -78,7 +99,9 @@ namespace litecore::repl {
             // my state directly; instead it calls _attachmentSent() at the end.
             C4Error err;
             bool done = false;
-            ssize_t bytesRead = c4stream_read(blob, buf, capacity, &err);
+            size_t wanted = (size_t)min(uint64_t(capacity), remaining);
+            ssize_t bytesRead = c4stream_read(blob, buf, wanted, &err);
+            remaining -= bytesRead;
             progress.bytesCompleted += bytesRead;
             if (bytesRead < capacity) {
                 c4stream_close(blob);
@@ -18,6 +18,7 @@
 
 #include "Pusher.hh"
 #include "DBAccess.hh"
+#include "FleeceDelta.hh"
 #include "ReplicatorTuning.hh"
 #include "BLIP.hh"
 #include "HTTPTypes.hh"
@@ -100,10 +101,27 @@ namespace litecore::repl {
 
             // Delta compression:
             alloc_slice delta = createRevisionDelta(doc, request, root, revisionBody.size,
-                                                    sendLegacyAttachments);
+                                                    sendLegacyAttachments, _fleeceDeltasOK);
             if (delta) {
                 msg["deltaSrc"_sl] = doc->selectedRev.revID;
-                msg.jsonBody().writeRaw(delta);
+                if (_fleeceDeltasOK) {
+                    msg["fleeceDelta"_sl] = true;
+                    msg.write(delta);
+                } else {
+                    msg.jsonBody().writeRaw(delta);
+                }
+            } else if (_fleeceBodiesOK) {
+                // The peer is LiteCore, so send binary Fleece instead of making it parse JSON.
+                // The body has to be re-encoded without the database's SharedKeys, since the
+                // peer doesn't have them; it will re-encode with its own when inserting.
+                Encoder bodyEncoder;
+                if (sendLegacyAttachments)
+                    _db->encodeRevWithLegacyAttachments(bodyEncoder, root,
+                                                       c4rev_getGeneration(request->revID));
+                else
+                    bodyEncoder.writeValue(root);
+                msg["fleeceBody"_sl] = true;
+                msg.write(bodyEncoder.finish());
             } else if (root.empty()) {
                 msg.write("{}"_sl);
             } else {
@@ -224,10 +242,11 @@ namespace litecore::repl {
     }
 
 
-    // Attempt to delta-compress the revision; returns JSON delta or a null slice.
+    // Attempt to delta-compress the revision; returns JSON delta (or binary FleeceDelta if
+    // `fleeceDelta` is true), or a null slice.
     alloc_slice Pusher::createRevisionDelta(C4Document *doc, RevToSend *request,
                                             Dict root, size_t revisionSize,
-                                            bool sendLegacyAttachments)
+                                            bool sendLegacyAttachments, bool fleeceDelta)
     {
         alloc_slice delta;
         if (!request->deltaOK || revisionSize < tuning::kMinBodySizeForDelta
@@ -270,16 +289,21 @@ namespace litecore::repl {
             }
         }
 
-        delta = FLCreateJSONDelta(ancestor, root);
+        if (fleeceDelta)
+            delta = FleeceDelta::create(ancestor, root);
+        else
+            delta = FLCreateJSONDelta(ancestor, root);
         if (!delta || delta.size > revisionSize * 1.2)
             return {};          // Delta failed, or is (probably) bigger than body; don't use
 
         if (willLog(LogLevel::Verbose)) {
             alloc_slice old (ancestor.toJSON());
             alloc_slice nuu (root.toJSON());
-            logVerbose("Encoded revision as delta, saving %zd bytes:\n\told = %.*s\n\tnew = %.*s\n\tDelta = %.*s",
-                       nuu.size - delta.size,
-                       SPLAT(old), SPLAT(nuu), SPLAT(delta));
+            alloc_slice deltaJSON = fleeceDelta ? Value::fromData(delta, kFLTrusted).toJSON()
+                                                : delta;
+            logVerbose("Encoded revision as %sdelta, saving %zd bytes:\n\told = %.*s\n\tnew = %.*s\n\tDelta = %.*s",
+                       (fleeceDelta ? "Fleece " : ""), nuu.size - delta.size,
+                       SPLAT(old), SPLAT(nuu), SPLAT(deltaJSON));
         }
         return delta;
     }
@@ -302,6 +302,14 @@ namespace litecore { namespace repl {
         if (!_deltasOK && reply->boolProperty("deltas"_sl)
                        && !_options.properties[kC4ReplicatorOptionDisableDeltas].asBool())
             _deltasOK = true;
+        if (!_fleeceDeltasOK && reply->boolProperty("fleeceDeltas"_sl)
+                             && !_options.disableFleeceBodies())
+            _fleeceDeltasOK = true;
+        if (!_fleeceBodiesOK && reply->boolProperty("fleeceBodies"_sl)
+                             && !_options.disableFleeceBodies()) {
+            logInfo("Peer accepts Fleece-encoded revision bodies");
+            _fleeceBodiesOK = true;
+        }
 
         // The response body consists of an array that parallels the `changes` array I sent:
         Array::iterator iResponse(reply->JSONBody().asArray());
@@ -88,7 +88,7 @@ namespace litecore { namespace repl {
         void doneWithRev(RevToSend*, bool successful, bool pushed);
         alloc_slice createRevisionDelta(C4Document *doc NONNULL, RevToSend *request NONNULL,
                                         fleece::Dict root, size_t revSize,
-                                        bool sendLegacyAttachments);
+                                        bool sendLegacyAttachments, bool fleeceDelta);
         void revToSendIsObsolete(const RevToSend &request, C4Error *c4err);
 
         using DocIDToRevMap = std::unordered_map<alloc_slice, Retained<RevToSend>>;
@@ -106,6 +106,8 @@ namespace litecore { namespace repl {
         bool _caughtUp {false};                   // Received backlog of pre-existing changes?
         bool _continuousCaughtUp {true};          // Caught up with change notifications?
         bool _deltasOK {false};                   // OK to send revs in delta form?
+        bool _fleeceBodiesOK {false};             // OK to send rev bodies as binary Fleece?
+        bool _fleeceDeltasOK {false};             // OK to send deltas in FleeceDelta format?
         unsigned _changeListsInFlight {0};        // # change lists being requested from db or sent to peer
         unsigned _revisionsInFlight {0};          // # 'rev' messages being sent
         blip::MessageSize _revisionBytesAwaitingReply {0}; // # 'rev' message bytes sent but not replied
@@ -96,6 +96,7 @@ namespace litecore { namespace repl {
         Retained<IncomingRev>   owner;                  // Object that's processing this rev
         alloc_slice             deltaSrc;
         alloc_slice             deltaSrcRevID;          // Source revision if body is a delta
+        bool                    fleeceDelta {false};    // Delta is binary (FleeceDelta), not JSON
         
         RevToInsert(IncomingRev* owner,
                     slice docID, slice revID,
@@ -124,8 +124,15 @@ namespace litecore { namespace repl {
                 response["blobs"_sl] = "true"_sl;
             if ( !_announcedDeltaSupport && !_options.disableDeltaSupport()) {
                 response["deltas"_sl] = "true"_sl;
+                if (!_options.disableFleeceBodies())
+                    response["fleeceDeltas"_sl] = "true"_sl;    // I can apply FleeceDelta format
                 _announcedDeltaSupport = true;
             }
+            if ( !_announcedFleeceSupport && !_options.disableFleeceBodies()) {
+                // Tells a LiteCore peer it may send rev bodies as binary Fleece (see Pusher)
+                response["fleeceBodies"_sl] = "true"_sl;
+                _announcedFleeceSupport = true;
+            }
 
             Stopwatch st;
 
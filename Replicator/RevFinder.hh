@@ -75,6 +75,7 @@ namespace litecore { namespace repl {
         std::deque<Retained<blip::MessageIn>> _waitingChangesMessages; // Queued 'changes' messages
         unsigned _numRevsBeingRequested {0};   // # of 'rev' msgs requested but not yet received
         bool _announcedDeltaSupport {false};                // Did I send "deltas:true" yet?
+        bool _announcedFleeceSupport {false};               // Did I send "fleeceBodies:true" yet?
     };
 
 } }
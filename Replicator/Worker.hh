@@ -88,13 +88,16 @@ namespace litecore { namespace repl {
             return _parent ? _parent->mailboxForChildren() : nullptr;
         }
 
-        /** Registers a callback to run when a BLIP request with the given profile arrives. */
+        /** Registers a callback to run when a BLIP request with the given profile arrives.
+            If `atBeginning` is true, the callback may be called before the message's body has
+            been completely received (see blip::Connection::setRequestHandler.) */
         template <class ACTOR>
         void registerHandler(const char *profile NONNULL,
-                             void (ACTOR::*method)(Retained<blip::MessageIn>)) {
+                             void (ACTOR::*method)(Retained<blip::MessageIn>),
+                             bool atBeginning =false) {
             std::function<void(Retained<blip::MessageIn>)> fn(
                                         std::bind(method, (ACTOR*)this, std::placeholders::_1) );
-            _connection->setRequestHandler(profile, false, asynchronize(fn));
+            _connection->setRequestHandler(profile, atBeginning, asynchronize(fn));
         }
 
         /** Implementation of connectionClosed(). May be overridden, but call super. */
@@ -246,6 +246,12 @@ namespace c4Internal {
         // Options to pass to the C4Socket
         alloc_slice socketOptions() const {
             string protocolString = string(blip::Connection::kWSProtocolName) + kReplicatorProtocolName;
+            if (_options.properties[kC4ReplicatorCompressionDictionary].asBool()) {
+                // Offer BLIP with the preset compression dictionary first, falling back to plain
+                // BLIP for servers that don't know it:
+                protocolString = string(blip::Connection::kWSProtocolNameWithDictionary)
+                                    + kReplicatorProtocolName + "," + protocolString;
+            }
             Replicator::Options opts(kC4Disabled, kC4Disabled, _options.properties);
             opts.setProperty(slice(kC4SocketOptionWSProtocols), protocolString.c_str());
             return opts.properties.data();
@@ -9,9 +9,11 @@
 #include "ReplicatorLoopbackTest.hh"
 #include "Worker.hh"
 #include "DBAccess.hh"
+#include "IncomingRev.hh"
 #include "Timer.hh"
 #include "c4Database.hh"
 #include "PrebuiltCopier.hh"
+#include "FleeceDelta.hh"
 #include <chrono>
 #include "betterassert.hh"
 #include "fleece/Mutable.hh"
@@ -117,6 +119,50 @@ TEST_CASE_METHOD(ReplicatorLoopbackTest, "Push large docs", "[Push]") {
 }
 
 
+TEST_CASE_METHOD(ReplicatorLoopbackTest, "Push large docs JSON vs Fleece bodies", "[Push]") {
+    // Compares throughput of sending rev bodies as Fleece (the default between two LiteCore
+    // peers) with JSON (what's sent to Sync Gateway, or when the passive side opts out):
+    importJSONLines(sFixturesDir + "wikipedia_100.json");
+    _expectedDocumentCount = 100;
+    for (int fleece = 1; fleece >= 0; --fleece) {
+        auto serverOpts = Replicator::Options::passive();
+        if (!fleece)
+            serverOpts.setNoFleeceBodies();
+        auto before = IncomingRev::gNumFleeceBodiesReceived.load();
+        Stopwatch st;
+        runReplicators(Replicator::Options::pushing(), serverOpts);
+        double elapsed = st.elapsed();
+        Log(">>> Pushed 100 docs as %s in %.3f sec (%.0f docs/sec)",
+            (fleece ? "Fleece" : "JSON"), elapsed, 100 / elapsed);
+        // Make sure the bodies really were sent in the format being measured:
+        CHECK(IncomingRev::gNumFleeceBodiesReceived - before == (fleece ? 100u : 0u));
+        compareDatabases();
+        deleteAndRecreateDB(db2);
+    }
+}
+
+
+TEST_CASE_METHOD(ReplicatorLoopbackTest, "Pull huge doc", "[Pull]") {
+    // A doc much bigger than a BLIP frame, so its body is streamed and parsed incrementally:
+    {
+        TransactionHelper t(db);
+        string json = "{\"items\":[";
+        for (int i = 0; i < 50000; i++) {
+            if (i > 0)
+                json += ",";
+            json += format("{\"i\":%d,\"name\":\"Item number %d\",\"ok\":%s}",
+                           i, i, (i % 2 ? "true" : "false"));
+        }
+        json += "]}";
+        createFleeceRev(db, "hugedoc"_sl, nullslice, slice(json));
+    }
+    _expectedDocumentCount = 1;
+    runPullReplication();
+    compareDatabases();
+    validateCheckpoints(db2, db, "{\"remote\":1}");
+}
+
+
 TEST_CASE_METHOD(ReplicatorLoopbackTest, "Push deletion", "[Push]") {
     createRev("dok"_sl, kRevID, kFleeceBody);
     _expectedDocumentCount = 1;
@@ -742,6 +788,43 @@ TEST_CASE_METHOD(ReplicatorLoopbackTest, "Pull Large Attachments", "[Pull][blob]
 }
 
 
+TEST_CASE_METHOD(ReplicatorLoopbackTest, "Pull Attachment Resumes Partial Download", "[Pull][blob]") {
+    string att(100000, ' ');
+    for (size_t i = 0; i < att.size(); ++i)
+        att[i] = char('A' + (i * 7) % 26);
+    vector<string> attachments = {att};
+    vector<C4BlobKey> blobKeys;
+    {
+        TransactionHelper t(db);
+        blobKeys = addDocWithAttachments("att1"_sl, attachments, "text/plain");
+        _expectedDocumentCount = 1;
+    }
+
+    // Simulate an interrupted earlier download, by leaving the start of the blob in db2:
+    static constexpr size_t kAlreadyHave = 40000;
+    {
+        C4Error error;
+        C4WriteStream *out = c4blob_openResumableWriteStream(c4db_getBlobStore(db2, nullptr),
+                                                             blobKeys[0], &error);
+        REQUIRE(out);
+        REQUIRE(c4stream_write(out, att.data(), kAlreadyHave, &error));
+        c4stream_closeWriter(out);      // without installing, so the partial file is kept
+    }
+
+    auto pullOpts = Replicator::Options::pulling().setProperty(C4STR(kC4ReplicatorOptionProgressLevel), 2);
+    auto serverOpts = Replicator::Options::passive().setProperty(C4STR(kC4ReplicatorOptionProgressLevel), 2);
+    runReplicators(serverOpts, pullOpts);
+
+    compareDatabases();
+    checkAttachments(db2, blobKeys, attachments);
+
+    // The pusher was only asked for the rest of the blob:
+    CHECK(_firstBlobPushProgress.bytesCompleted == kAlreadyHave);
+    CHECK(_lastBlobPushProgress.bytesCompleted == att.size());
+    CHECK(_lastBlobPullProgress.bytesCompleted == att.size());
+}
+
+
 TEST_CASE_METHOD(ReplicatorLoopbackTest, "Pull Lots Of Attachments", "[Pull][blob]") {
     static const int kNumDocs = 1000, kNumBlobsPerDoc = 5;
     Log("Creating %d docs, with %d blobs each ...", kNumDocs, kNumBlobsPerDoc);
@@ -1481,6 +1564,9 @@ TEST_CASE_METHOD(ReplicatorLoopbackTest, "Delta Push+Push", "[Push][Delta]") {
     atomic<int> validationCount {0};
     SECTION("No filter") {
     }
+    SECTION("JSON deltas") {
+        serverOpts.setNoFleeceBodies();
+    }
     SECTION("With filter") {
         // Using a pull filter forces deltas to be applied earlier, before rev insertion.
         serverOpts.callbackContext = &validationCount;
@@ -1552,6 +1638,107 @@ TEST_CASE_METHOD(ReplicatorLoopbackTest, "Bigger Delta Push+Push", "[Push][Delta
 }
 
 
+TEST_CASE("FleeceDelta", "[Delta]") {
+    auto check = [](const char *oldJSON5, const char *nuuJSON5) {
+        Doc old = Doc::fromJSON(json5(oldJSON5)), nuu = Doc::fromJSON(json5(nuuJSON5));
+        alloc_slice delta = FleeceDelta::create(old.asDict(), nuu.asDict());
+        if (old.root().isEqual(nuu.root())) {
+            CHECK(!delta);
+            return;
+        }
+        REQUIRE(delta);
+        Value deltaRoot = Value::fromData(delta, kFLUntrusted);
+        REQUIRE(deltaRoot);
+        Encoder enc;
+        REQUIRE(FleeceDelta::apply(old.root(), deltaRoot, enc));
+        Doc result = enc.finishDoc();
+        CHECK(result.root().toJSON() == nuu.root().toJSON());
+    };
+    check("{}", "{}");
+    check("{a:1}", "{a:1}");
+    check("{a:1}", "{a:2}");
+    check("{a:1,b:2}", "{b:2}");
+    check("{a:1}", "{a:1,b:[1,2]}");
+    check("{a:{b:{c:1,d:2}}}", "{a:{b:{c:1,d:3}}}");
+    check("{a:{b:1}}", "{a:'now a string'}");
+    check("{a:[1,2,3,4,5,6]}", "{a:[1,2,9,4,5,6]}");
+    check("{a:[1,2,3,4,5,6]}", "{a:[1,2,3,4,5,6,7,8,9,10,11,12]}");
+    check("{a:[1,2,3,4,5,6,7,8,9,10,11,12]}", "{a:[1,2,3,4,5,6]}");
+    check("{a:[1,2,3,4,5,6]}", "{a:[0,1,2,3,4,5,6]}");
+    check("{a:[{x:1},{x:2}]}", "{a:[{x:1},{x:2,y:null}]}");
+    check("{a:null}", "{a:false}");
+
+    // Invalid deltas, or ones that don't fit the old value, are rejected:
+    Doc old = Doc::fromJSON(json5("{a:[1,2,3],b:{c:1}}"));
+    for (const char *badDelta : {"{a:{'7':[1]}}", "{a:{'x':[1]}}", "{a:{'-':5}}", "{b:{c:[1,2]}}",
+                                 "{c:{d:[1]}}", "{b:{c:{d:[1]}}}", "{a:{'01':[9]}}",
+                                 "{a:{'1':[8],'01':[9]}}", "{a:{'00':[9]}}"}) {
+        INFO("Delta is " << badDelta);
+        Doc delta = Doc::fromJSON(json5(badDelta));
+        Encoder enc;
+        CHECK(!FleeceDelta::apply(old.root(), delta.root(), enc));
+    }
+}
+
+
+TEST_CASE("FleeceDelta vs JSONDelta Performance", "[Delta][Perf][.slow]") {
+    // A ~1MB doc with a small edit, as in a typical incremental update to a large doc:
+    static constexpr int kNumItems = 20000;
+    Encoder enc;
+    enc.beginDict();
+    enc.writeKey("items"_sl);
+    enc.beginArray();
+    for (int i = 0; i < kNumItems; ++i) {
+        enc.beginDict();
+        enc.writeKey("id"_sl);          enc.writeInt(i);
+        enc.writeKey("name"_sl);        enc.writeString(format("Item number %d", i));
+        enc.writeKey("description"_sl); enc.writeString(format("This is the description of item #%d.", i));
+        enc.endDict();
+    }
+    enc.endArray();
+    enc.endDict();
+    Doc old = enc.finishDoc();
+    enc.reset();
+
+    MutableDict mnuu = old.asDict().mutableCopy(kFLDeepCopyImmutables);
+    mnuu.getMutableArray("items"_sl).getMutableDict(kNumItems / 2)["name"_sl] = "Changed!"_sl;
+    enc.writeValue(mnuu);
+    Doc nuu = enc.finishDoc();
+    Log("Body is %zu bytes of Fleece, %zu bytes of JSON",
+        old.data().size, old.root().toJSON().size);
+
+    static constexpr int kReps = 20;
+    double jsonCreate = 0, jsonApply = 0, fleeceCreate = 0, fleeceApply = 0;
+    for (int rep = 0; rep < kReps; ++rep) {
+        Stopwatch st;
+        alloc_slice jsonDelta = JSONDelta::create(old.root(), nuu.root());
+        jsonCreate += st.elapsed();
+        st.reset();
+        Encoder jsonEnc;
+        REQUIRE(JSONDelta::apply(old.root(), jsonDelta, jsonEnc));
+        Doc jsonResult = jsonEnc.finishDoc();
+        jsonApply += st.elapsed();
+        CHECK(jsonResult.root().isEqual(nuu.root()));
+
+        st.reset();
+        alloc_slice fleeceDelta = FleeceDelta::create(old.asDict(), nuu.asDict());
+        fleeceCreate += st.elapsed();
+        st.reset();
+        Encoder fleeceEnc;
+        REQUIRE(FleeceDelta::apply(old.root(), Value::fromData(fleeceDelta, kFLTrusted), fleeceEnc));
+        Doc fleeceResult = fleeceEnc.finishDoc();
+        fleeceApply += st.elapsed();
+        CHECK(fleeceResult.root().isEqual(nuu.root()));
+
+        if (rep == 0)
+            Log("JSON delta is %zu bytes, Fleece delta is %zu bytes",
+                jsonDelta.size, fleeceDelta.size);
+    }
+    Log("JSONDelta:   create %.3f ms, apply %.3f ms", jsonCreate * 1000 / kReps, jsonApply * 1000 / kReps);
+    Log("FleeceDelta: create %.3f ms, apply %.3f ms", fleeceCreate * 1000 / kReps, fleeceApply * 1000 / kReps);
+}
+
+
 TEST_CASE_METHOD(ReplicatorLoopbackTest, "Delta Push+Pull", "[Push][Pull][Delta]") {
     auto serverOpts = Replicator::Options::passive();
 
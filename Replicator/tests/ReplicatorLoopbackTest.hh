@@ -80,10 +80,10 @@ public:
 
         // Create client (active) and server (passive) replicators:
         _replClient = new Replicator(dbClient,
-                                     new LoopbackWebSocket(alloc_slice("ws://srv/"_sl), Role::Client, kLatency),
+                                     new LoopbackWebSocket(alloc_slice("ws://srv/"_sl), Role::Client, _latency, _bandwidth),
                                      *this, opts1);
         _replServer = new Replicator(dbServer,
-                                     new LoopbackWebSocket(alloc_slice("ws://cli/"_sl), Role::Server, kLatency),
+                                     new LoopbackWebSocket(alloc_slice("ws://cli/"_sl), Role::Server, _latency, _bandwidth),
                                      *this, opts2);
         Log("Client replicator is %s", _replClient->loggingName().c_str());
 
@@ -261,7 +261,8 @@ public:
         unique_lock<mutex> lock(_mutex);
 
         if (p.dir == Dir::kPushing) {
-            ++_blobPushProgressCallbacks;
+            if (++_blobPushProgressCallbacks == 1)
+                _firstBlobPushProgress = p;
             _lastBlobPushProgress = p;
         } else {
             ++_blobPullProgressCallbacks;
@@ -546,6 +547,8 @@ public:
     }
 
     C4Database* db2 {nullptr};
+    duration _latency {kLatency};               // Simulated one-way network latency
+    double _bandwidth {0};                      // Simulated bandwidth (bytes/sec), 0 = unlimited
     Retained<Replicator> _replClient, _replServer;
     alloc_slice _checkpointID;
     unique_ptr<thread> _parallelThread;
@@ -565,6 +568,7 @@ public:
     bool _checkDocsFinished {true};
     multiset<string> _docsFinished, _expectedDocsFinished;
     unsigned _blobPushProgressCallbacks {0}, _blobPullProgressCallbacks {0};
+    Replicator::BlobProgress _firstBlobPushProgress {};
     Replicator::BlobProgress _lastBlobPushProgress {}, _lastBlobPullProgress {};
     function<void(ReplicatedRev*)> _conflictHandler;
     bool _conflictHandlerRunning {false};
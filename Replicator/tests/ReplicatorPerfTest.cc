@@ -0,0 +1,391 @@
+//
+// ReplicatorPerfTest.cc
+//
+// Copyright (c) 2020 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "ReplicatorLoopbackTest.hh"
+#include <cmath>
+#include <fstream>
+#include <unordered_map>
+
+#ifdef __APPLE__
+#include <mach/mach.h>
+#elif !defined(_MSC_VER)
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+// Replicator throughput benchmarks. These run parameterized synthetic workloads over a
+// LoopbackWebSocket, and report the results as a JSON object per workload. The results are
+// logged, and also appended (one object per line) to the file named by the environment
+// variable `LiteCoreBenchmarkResults`, if it's set.
+//
+// The tests are tagged [.Perf] so they don't run by default; run them with `CppTests "[Perf]"`.
+
+
+class ReplicatorPerfTest : public ReplicatorLoopbackTest {
+public:
+
+    struct Workload {
+        const char*     name;
+        Dir             dir             = Dir::kPushing;
+        bool            continuous      = false;
+        unsigned        numDocs         = 1000;
+        size_t          minBodySize     = 100;      // Body sizes are log-uniformly distributed
+        size_t          maxBodySize     = 4000;     //   between these two limits
+        double          blobRatio       = 0.0;      // Fraction of docs that have a blob
+        size_t          blobSize        = 64*1024;
+        double          conflictRate    = 0.0;      // Fraction of docs that conflict at the dest
+        duration        latency         = duration::zero();
+        double          bandwidth       = 0;        // bytes/sec, or 0 for unlimited
+    };
+
+
+    void run(const Workload &w) {
+        _latency = w.latency;
+        _bandwidth = w.bandwidth;
+        _checkDocsFinished = false;
+        _expectedDocumentCount = -1;
+        _revLatencies.clear();
+        _revLatencies.reserve(w.numDocs);
+        _docCreated.clear();
+        _conflicts = 0;
+        uint64_t rssBefore = currentRSS();
+
+        // Pushing goes from db to db2, pulling from db2 to db:
+        C4Database *source = (w.dir == Dir::kPushing) ? db : db2;
+        C4Database *dest   = (w.dir == Dir::kPushing) ? db2 : db;
+
+        for (unsigned i = 0; i < w.numDocs; ++i) {
+            if (randomFraction() < w.conflictRate) {
+                TransactionHelper t(dest);
+                createFleeceRev(dest, slice(docIDFor(i)), "1-00000000"_sl, "{\"conflict\":true}"_sl);
+            }
+        }
+
+        C4ReplicatorMode mode = w.continuous ? kC4Continuous : kC4OneShot;
+        auto opts = (w.dir == Dir::kPushing) ? Replicator::Options::pushing(mode)
+                                             : Replicator::Options::pulling(mode);
+        if (w.continuous) {
+            // Create the docs gradually while the replicator runs:
+            setRunStart();
+            _parallelThread.reset(runInParallel([=]() {
+                static constexpr unsigned kBatchSize = 100;
+                for (unsigned i = 0; i < w.numDocs; i += kBatchSize) {
+                    sleepFor(chrono::milliseconds(50));
+                    createDocs(source, w, i, min(kBatchSize, w.numDocs - i));
+                }
+                sleepFor(chrono::seconds(1)); // give replicator a moment to detect the latest revs
+                stopWhenIdle();
+            }));
+        } else {
+            createDocs(source, w, 0, w.numDocs);
+            setRunStart();
+        }
+
+        Stopwatch st;
+        runReplicators(opts, Replicator::Options::passive());
+        double elapsed = st.elapsed();
+        if (_parallelThread) {
+            _parallelThread->join();
+            _parallelThread.reset();
+        }
+
+        uint64_t rssAfter = currentRSS();
+        if (w.conflictRate == 0)
+            compareDatabases();
+        report(w, elapsed, rssBefore, rssAfter);
+    }
+
+
+    void report(const Workload &w, double elapsed, uint64_t rssBefore, uint64_t rssAfter) {
+        lock_guard<mutex> lock(_statsMutex);
+        sort(_revLatencies.begin(), _revLatencies.end());
+        auto percentile = [&](double p) -> double {
+            if (_revLatencies.empty())
+                return 0.0;
+            size_t i = min(_revLatencies.size() - 1, size_t(p * _revLatencies.size()));
+            return _revLatencies[i] * 1000.0;
+        };
+        auto bytes = _statusReceived.progress.unitsCompleted;
+        size_t docs = _revLatencies.size();
+
+        JSONEncoder enc;
+        enc.beginDict();
+        enc.writeKey("workload"_sl);        enc.writeString(w.name);
+        enc.writeKey("direction"_sl);       enc.writeString(w.dir == Dir::kPushing ? "push" : "pull");
+        enc.writeKey("continuous"_sl);      enc.writeBool(w.continuous);
+        enc.writeKey("numDocs"_sl);         enc.writeUInt(w.numDocs);
+        enc.writeKey("minBodySize"_sl);     enc.writeUInt(w.minBodySize);
+        enc.writeKey("maxBodySize"_sl);     enc.writeUInt(w.maxBodySize);
+        enc.writeKey("blobRatio"_sl);       enc.writeDouble(w.blobRatio);
+        enc.writeKey("blobSize"_sl);        enc.writeUInt(w.blobSize);
+        enc.writeKey("conflictRate"_sl);    enc.writeDouble(w.conflictRate);
+        enc.writeKey("latencyMs"_sl);       enc.writeDouble(chrono::duration<double, milli>(w.latency).count());
+        enc.writeKey("bandwidth"_sl);       enc.writeDouble(w.bandwidth);
+        enc.writeKey("elapsedSec"_sl);      enc.writeDouble(elapsed);
+        enc.writeKey("docs"_sl);            enc.writeUInt(docs);
+        enc.writeKey("conflicts"_sl);       enc.writeUInt(_conflicts);
+        enc.writeKey("bytes"_sl);           enc.writeUInt(bytes);
+        enc.writeKey("docsPerSec"_sl);      enc.writeDouble(docs / elapsed);
+        enc.writeKey("bytesPerSec"_sl);     enc.writeDouble(bytes / elapsed);
+        enc.writeKey("revLatencyP50Ms"_sl); enc.writeDouble(percentile(0.50));
+        enc.writeKey("revLatencyP99Ms"_sl); enc.writeDouble(percentile(0.99));
+        enc.writeKey("rssBefore"_sl);       enc.writeUInt(rssBefore);
+        enc.writeKey("rssAfter"_sl);        enc.writeUInt(rssAfter);
+        // (This is the high-water mark of the whole process so far, not just of this workload:)
+        enc.writeKey("processPeakRSS"_sl);  enc.writeUInt(processPeakRSS());
+        enc.endDict();
+        alloc_slice json = enc.finish();
+
+        C4Log("BENCHMARK: %.*s", SPLAT(json));
+        if (const char *path = getenv("LiteCoreBenchmarkResults"); path) {
+            ofstream out(path, ios::app);
+            out << string(json) << '\n';
+        }
+    }
+
+
+    virtual void replicatorDocumentsEnded(Replicator *repl,
+                                          const vector<Retained<ReplicatedRev>> &revs) override
+    {
+        // Note: Can't use Catch (CHECK, REQUIRE) on a background thread
+        ReplicatorLoopbackTest::replicatorDocumentsEnded(repl, revs);
+        if (repl != _replClient)
+            return;
+        auto now = clock::now();
+        lock_guard<mutex> lock(_statsMutex);
+        for (auto &rev : revs) {
+            // A rev's latency is measured from when its doc was created, or if it already
+            // existed, from when the replication started:
+            auto start = _runStart;
+            if (auto i = _docCreated.find(string(rev->docID)); i != _docCreated.end())
+                start = max(start, i->second);
+            _revLatencies.push_back(chrono::duration<double>(now - start).count());
+            if (isConflict(rev->error)) {
+                // Conflicts are an expected part of the workload, not test failures:
+                ++_conflicts;
+                unique_lock<mutex> lock2(_mutex);
+                _docPushErrors.erase(string(rev->docID));
+                _docPullErrors.erase(string(rev->docID));
+            }
+        }
+    }
+
+
+private:
+
+    static bool isConflict(C4Error err) {
+        return (err.domain == LiteCoreDomain && err.code == kC4ErrorConflict)
+            || (err.domain == WebSocketDomain && err.code == 409);
+    }
+
+    static string docIDFor(unsigned i) {
+        return format("doc-%07u", i);
+    }
+
+    static double randomFraction() {
+        return RandomNumber() / double(UINT32_MAX);
+    }
+
+    static string randomText(size_t size) {
+        string text(size, ' ');
+        for (auto &c : text)
+            c = 'a' + char(RandomNumber(26));
+        return text;
+    }
+
+    static size_t randomBodySize(const Workload &w) {
+        double logMin = log(double(w.minBodySize)), logMax = log(double(w.maxBodySize));
+        return size_t(exp(logMin + randomFraction() * (logMax - logMin)));
+    }
+
+    // The process's resident set size right now, in bytes, or 0 if unknown.
+    static uint64_t currentRSS() {
+#if defined(__APPLE__)
+        mach_task_basic_info info;
+        mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+        if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count)
+                != KERN_SUCCESS)
+            return 0;
+        return info.resident_size;
+#elif defined(_MSC_VER)
+        return 0;
+#else
+        long pages = 0;
+        ifstream statm("/proc/self/statm");
+        if (!(statm >> pages >> pages))     // (the second number is the resident page count)
+            return 0;
+        return uint64_t(pages) * sysconf(_SC_PAGESIZE);
+#endif
+    }
+
+    // The most memory the process has had resident since it started, in bytes, or 0 if unknown.
+    static uint64_t processPeakRSS() {
+#if defined(__APPLE__)
+        mach_task_basic_info info;
+        mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+        if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count)
+                != KERN_SUCCESS)
+            return 0;
+        return info.resident_size_max;
+#elif defined(_MSC_VER)
+        return 0;
+#else
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0)
+            return 0;
+        return usage.ru_maxrss * 1024ull;   // kilobytes
+#endif
+    }
+
+    void setRunStart() {
+        lock_guard<mutex> lock(_statsMutex);
+        _runStart = clock::now();
+    }
+
+    // Creates docs [first, first+count) in `inDB`, and records when they were created.
+    // Note: Can't use Catch (CHECK, REQUIRE) here since it's called on a background thread.
+    void createDocs(C4Database *inDB, const Workload &w, unsigned first, unsigned count) {
+        C4BlobStore *blobStore = c4db_getBlobStore(inDB, nullptr);
+        c4::Transaction t(inDB);
+        C4Error err;
+        Assert(t.begin(&err));
+        for (unsigned i = first; i < first + count; ++i) {
+            Encoder enc(c4db_createFleeceEncoder(inDB));
+            enc.beginDict();
+            enc.writeKey("n"_sl);
+            enc.writeUInt(i);
+            enc.writeKey("text"_sl);
+            enc.writeString(randomText(randomBodySize(w)));
+            if (w.blobRatio > 0 && randomFraction() < w.blobRatio) {
+                string contents = randomText(w.blobSize);
+                C4BlobKey key;
+                Assert(c4blob_create(blobStore, slice(contents), nullptr, &key, &err));
+                alloc_slice digest = c4blob_keyToString(key);
+                enc.writeKey("attachment"_sl);
+                enc.beginDict();
+                enc.writeKey(slice(kC4ObjectTypeProperty));
+                enc.writeString(slice(kC4ObjectType_Blob));
+                enc.writeKey(slice(kC4BlobDigestProperty));
+                enc.writeString(digest);
+                enc.writeKey("length"_sl);
+                enc.writeUInt(w.blobSize);
+                enc.writeKey("content_type"_sl);
+                enc.writeString("application/octet-stream"_sl);
+                enc.endDict();
+            }
+            enc.endDict();
+            alloc_slice body = enc.finish();
+            createNewRev(inDB, slice(docIDFor(i)), body);
+        }
+        Assert(t.commit(&err));
+
+        auto now = clock::now();
+        lock_guard<mutex> lock(_statsMutex);
+        for (unsigned i = first; i < first + count; ++i)
+            _docCreated[docIDFor(i)] = now;
+    }
+
+    using clock = chrono::steady_clock;
+
+    mutex _statsMutex;
+    clock::time_point _runStart;                // When the replication started
+    unordered_map<string, clock::time_point> _docCreated;   // When each doc was created
+    vector<double> _revLatencies;               // Seconds from doc's creation/run start to completion
+    unsigned _conflicts {0};
+};
+
+
+TEST_CASE_METHOD(ReplicatorPerfTest, "Perf Push Small Docs", "[.Perf][Push]") {
+    Workload w;
+    w.name = "push-small";
+    w.numDocs = 10000;
+    w.minBodySize = 50;
+    w.maxBodySize = 1000;
+    run(w);
+}
+
+
+TEST_CASE_METHOD(ReplicatorPerfTest, "Perf Push Large Docs", "[.Perf][Push]") {
+    Workload w;
+    w.name = "push-large";
+    w.numDocs = 500;
+    w.minBodySize = 10*1024;
+    w.maxBodySize = 500*1024;
+    run(w);
+}
+
+
+TEST_CASE_METHOD(ReplicatorPerfTest, "Perf Pull Small Docs", "[.Perf][Pull]") {
+    Workload w;
+    w.name = "pull-small";
+    w.dir = Dir::kPulling;
+    w.numDocs = 10000;
+    w.minBodySize = 50;
+    w.maxBodySize = 1000;
+    run(w);
+}
+
+
+TEST_CASE_METHOD(ReplicatorPerfTest, "Perf Pull With Blobs", "[.Perf][Pull][blob]") {
+    Workload w;
+    w.name = "pull-blobs";
+    w.dir = Dir::kPulling;
+    w.numDocs = 1000;
+    w.blobRatio = 0.2;
+    w.blobSize = 100*1024;
+    run(w);
+}
+
+
+TEST_CASE_METHOD(ReplicatorPerfTest, "Perf Push With Conflicts", "[.Perf][Push]") {
+    Workload w;
+    w.name = "push-conflicts";
+    w.numDocs = 2000;
+    w.conflictRate = 0.1;
+    run(w);
+}
+
+
+TEST_CASE_METHOD(ReplicatorPerfTest, "Perf Pull With Conflicts", "[.Perf][Pull]") {
+    Workload w;
+    w.name = "pull-conflicts";
+    w.dir = Dir::kPulling;
+    w.numDocs = 2000;
+    w.conflictRate = 0.1;
+    run(w);
+}
+
+
+TEST_CASE_METHOD(ReplicatorPerfTest, "Perf Continuous Push", "[.Perf][Push][Continuous]") {
+    Workload w;
+    w.name = "push-continuous";
+    w.continuous = true;
+    w.numDocs = 2000;
+    run(w);
+}
+
+
+TEST_CASE_METHOD(ReplicatorPerfTest, "Perf Pull Slow Network", "[.Perf][Pull]") {
+    Workload w;
+    w.name = "pull-slow-network";
+    w.dir = Dir::kPulling;
+    w.numDocs = 1000;
+    w.latency = chrono::milliseconds(100);
+    w.bandwidth = 1024*1024;
+    run(w);
+}
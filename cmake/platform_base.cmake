@@ -31,11 +31,16 @@ function(set_litecore_source_base)
         Crypto/PublicKey.cc
         Crypto/SecureDigest.cc
         Crypto/SecureSymmetricCrypto.cc
+        LiteCore/BlobStore/BlobImporter.cc
         LiteCore/BlobStore/BlobStore.cc
+        LiteCore/BlobStore/ChunkedBlob.cc
+        LiteCore/BlobStore/MappedFile.cc
         LiteCore/BlobStore/Stream.cc
         LiteCore/Database/BackgroundDB.cc
+        LiteCore/Database/BlobRefCounts.cc
         LiteCore/Database/Database.cc
         LiteCore/Database/Document.cc
+        LiteCore/Database/DocumentCache.cc
         LiteCore/Database/Housekeeper.cc
         LiteCore/Database/LeafDocument.cc
         LiteCore/Database/LegacyAttachments.cc
@@ -89,6 +94,7 @@ function(set_litecore_source_base)
         Replicator/Checkpointer.cc
         Replicator/DatabaseCookies.cc
         Replicator/DBAccess.cc
+        Replicator/FleeceDelta.cc
         Replicator/IncomingRev.cc
         Replicator/IncomingRev+Blobs.cc
         Replicator/Inserter.cc
@@ -106,6 +112,8 @@ function(set_litecore_source_base)
         LiteCore/Support/Error.cc
         LiteCore/Support/EncryptedStream.cc
         LiteCore/Support/FilePath.cc
+        LiteCore/Support/JSONStreamConverter.cc
+        LiteCore/Support/LogBuffer.cc
         LiteCore/Support/LogDecoder.cc
         LiteCore/Support/LogEncoder.cc
         LiteCore/Support/PlatformIO.cc